@@ -0,0 +1,278 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _CAPINDEX_H_
+#define _CAPINDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Magic number and layout version at the start of a capture index, so an 
+ * index built for the other byte order, or by another version, is rebuilt 
+ * rather than misread
+ */
+#define CAPINDEX_MAGIC 0x47434958
+#define CAPINDEX_VERSION 1
+
+/** An index is kept beside its capture, named by appending the suffix
+ */
+#define CAPINDEX_SUFFIX ".idx"
+
+/** Frames between the entries of the sparse time index
+ */
+#define CAPINDEX_STRIDE 1024
+
+/** Interfaces of a pcapng capture whose time resolution is kept
+ */
+#define CAPTURE_MAX_IFACES 16
+
+/** Formats of a capture
+ */
+#define CAPTURE_PCAP 1
+#define CAPTURE_PCAPNG 2
+
+
+/** Capture mapped read-only, a classic pcap file or a pcapng file such as a 
+ * flight recorder segment, in either byte order. Only Ethernet frames are 
+ * returned, and only on the interfaces described before the first frame.
+ */
+typedef struct _capture_t_ {
+  const uint8_t *base;                  /* Mapping of the capture */
+  size_t size;                          /* Bytes of the capture */
+  uint64_t mtime;                       /* Modification time, in ns */
+  uint32_t format;                      /* CAPTURE_PCAP or CAPTURE_PCAPNG */
+  uint32_t swap;                        /* Non-zero if the other byte order */
+  uint64_t start;                       /* Offset of the first record */
+  uint32_t num_ifaces;                  /* Interfaces described (pcapng) */
+  uint16_t linktype[CAPTURE_MAX_IFACES];   /* Link type of each interface */
+  uint8_t tsresol[CAPTURE_MAX_IFACES];     /* if_tsresol of each interface */
+} capture_t;
+
+/** Frame of a capture, pointing into the mapping
+ */
+typedef struct _capture_frame_t_ {
+  const uint8_t *data;                  /* Frame, from the destination MAC */
+  uint32_t caplen;                      /* Bytes captured */
+  uint32_t len;                         /* Bytes on the wire */
+  uint64_t ns;                          /* Receive time, in ns since epoch */
+  uint64_t offset;                      /* Offset of the record of the frame */
+} capture_frame_t;
+
+
+/** Entry of the sparse time index, the time and record of every 
+ * CAPINDEX_STRIDE-th frame
+ */
+typedef struct _capindex_time_t_ {
+  uint64_t ns;                /* Receive time of the frame */
+  uint64_t offset;            /* Offset of its record in the capture */
+} capindex_time_t;
+
+/** GOOSE stream of a capture, by APPID and gocbRef. The streams are sorted 
+ * by APPID, then gocbRef, and each has a posting list of its state changes.
+ */
+typedef struct _capindex_stream_t_ {
+  uint16_t appid;             /* APPID */
+  uint16_t reserved;          /* Zero */
+  uint32_t gocbref;           /* gocbRef, offset into the string table */
+  uint32_t num_changes;       /* Number of state changes */
+  uint32_t changes;           /* Index of the first in the change array */
+  uint64_t frames;            /* Frames of the stream */
+} capindex_stream_t;
+
+/** State change of a stream, the first frame seen with a new stNum, and the 
+ * first frame of the stream in the capture
+ */
+typedef struct _capindex_change_t_ {
+  uint64_t ns;                /* Receive time of the frame */
+  uint64_t offset;            /* Offset of its record in the capture */
+  uint32_t stNum;             /* stNum */
+  uint32_t sqNum;             /* sqNum */
+} capindex_change_t;
+
+/** Header of a capture index, built by capindex_build() beside a capture. 
+ * Like a configuration image, every reference is an offset from the start 
+ * of the header, so the index is used where it is mapped.
+ */
+typedef struct _capindex_t_ {
+  uint32_t magic;             /* CAPINDEX_MAGIC */
+  uint32_t version;           /* CAPINDEX_VERSION */
+  uint64_t size;              /* Bytes of the index */
+  uint64_t capture_size;      /* Bytes of the capture indexed */
+  uint64_t capture_mtime;     /* Modification time of the capture, in ns */
+  uint64_t frames;            /* Frames of the capture */
+  uint64_t goose;             /* GOOSE frames of the capture */
+  uint64_t first_ns;          /* Earliest receive time */
+  uint64_t last_ns;           /* Latest receive time */
+  uint32_t stride;            /* Frames between time entries */
+  uint32_t num_times;         /* Number of time entries */
+  uint32_t times;             /* Offset of the capindex_time_t */
+  uint32_t num_streams;       /* Number of streams */
+  uint32_t streams;           /* Offset of the capindex_stream_t */
+  uint32_t num_changes;       /* Number of state changes */
+  uint32_t changes;           /* Offset of the capindex_change_t */
+  uint32_t strings;           /* Offset of the string table */
+  uint32_t strings_len;       /* Bytes of the string table */
+  uint32_t reserved;          /* Zero, keeps the header 8 byte aligned */
+} capindex_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to map a capture read-only and read its file header, and for 
+ * pcapng the interface descriptions that precede the first frame
+ *
+ * @param cap	- pointer to the capture to initialise
+ * @param path	- path of the capture
+ * @return int	- 0 on success, else -1 if it could not be mapped or is not 
+ * 			a capture
+ */
+int capture_open(capture_t *cap, const char *path);
+
+/**
+ * Function to unmap a capture opened by capture_open()
+ *
+ * @param cap	- pointer to the capture
+ */
+void capture_close(capture_t *cap);
+
+/**
+ * Function to read the next Ethernet frame of a capture, from the record at 
+ * an offset, skipping other records. A run of zeros ends the capture, as it 
+ * does a flight recorder segment left by a crash.
+ *
+ * @param cap	- pointer to the capture
+ * @param offset	- pointer to the offset of the record to read, cap->start 
+ * 		to begin, advanced past the frame returned
+ * @param frame	- pointer to the frame to populate
+ * @return int	- 1 if a frame was read, 0 at the end of the capture, else -1 
+ * 			if a record is corrupt
+ */
+int capture_next(const capture_t *cap, uint64_t *offset, 
+  capture_frame_t *frame);
+
+/**
+ * Function to build the index of a capture, written beside the index path 
+ * and renamed over it, so that a reader mapping the previous index keeps it
+ *
+ * @param capture	- path of the capture
+ * @param path	- path of the index, else NULL for capture CAPINDEX_SUFFIX
+ * @return int	- 0 on success, else -1
+ */
+int capindex_build(const char *capture, const char *path);
+
+/**
+ * Function to map a capture index read-only and check it. Nothing is 
+ * parsed, the checks only bound every offset so that the index can be used 
+ * in place.
+ *
+ * @param path	- path of the index
+ * @return const capindex_t *	- pointer to the mapped index, else NULL if 
+ * 			it could not be mapped or is not a valid index
+ */
+const capindex_t *capindex_map(const char *path);
+
+/**
+ * Function to unmap an index mapped by capindex_map()
+ *
+ * @param idx	- pointer to the mapped index, may be NULL
+ */
+void capindex_unmap(const capindex_t *idx);
+
+/**
+ * Function to check that an index still describes a capture, which has not 
+ * been changed since the index was built
+ *
+ * @param idx	- pointer to the mapped index
+ * @param cap	- pointer to the capture
+ * @return int	- 1 if the index is current, else 0
+ */
+int capindex_current(const capindex_t *idx, const capture_t *cap);
+
+/**
+ * Function to return a string of an index
+ *
+ * @param idx	- pointer to the mapped index
+ * @param offset	- offset of the string in the string table
+ * @return const char *	- pointer to the '\0' terminated string
+ */
+const char *capindex_str(const capindex_t *idx, uint32_t offset);
+
+/**
+ * Function to find the streams of an APPID, by a binary search of the 
+ * sorted streams
+ *
+ * @param idx	- pointer to the mapped index
+ * @param appid	- APPID to find
+ * @param count	- pointer to hold the number of streams with the APPID
+ * @return const capindex_stream_t *	- pointer to the first of them, else 
+ * 			NULL if there are none
+ */
+const capindex_stream_t *capindex_find(const capindex_t *idx, uint16_t appid,
+  uint32_t *count);
+
+/**
+ * Function to return the stream at an index of the sorted streams
+ *
+ * @param idx	- pointer to the mapped index
+ * @param i	- index of the stream
+ * @return const capindex_stream_t *	- pointer to the stream, else NULL if 
+ * 			i is out of range
+ */
+const capindex_stream_t *capindex_stream(const capindex_t *idx, uint32_t i);
+
+/**
+ * Function to return the state changes of a stream from a time on, by a 
+ * binary search of its posting list, which is sorted by time
+ *
+ * @param idx	- pointer to the mapped index
+ * @param stream	- pointer to a stream of the index
+ * @param from_ns	- earliest receive time wanted
+ * @param count	- pointer to hold the number of changes from from_ns on
+ * @return const capindex_change_t *	- pointer to the first of them
+ */
+const capindex_change_t *capindex_changes(const capindex_t *idx, 
+  const capindex_stream_t *stream, uint64_t from_ns, uint32_t *count);
+
+/**
+ * Function to return the offset of the record to scan a capture from, to 
+ * reach every frame received at or after a time. Receive times in a capture 
+ * only go forward, so this is the last time entry before from_ns.
+ *
+ * @param idx	- pointer to the mapped index
+ * @param from_ns	- earliest receive time wanted
+ * @return uint64_t	- offset of a record, else 0 to scan from the start
+ */
+uint64_t capindex_seek(const capindex_t *idx, uint64_t from_ns);
+
+#endif /* _CAPINDEX_H_ */
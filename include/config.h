@@ -0,0 +1,190 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+#include "goose.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Magic number and layout version at the start of a configuration image, 
+ * so a runtime built from other sources, or for the other byte order, 
+ * refuses an image it would misread
+ */
+#define CONFIG_MAGIC 0x47434647
+#define CONFIG_VERSION 1
+
+/** Maximum length of an IED name, including the '\0'
+ */
+#define CONFIG_NAME_LEN 64
+
+/** Empty slot of the subscription hash table
+ */
+#define CONFIG_EMPTY 0xffffffffu
+
+
+/** Control block of a configuration image, published or subscribed to. 
+ * Strings are offsets into the string table of the image and '\0' 
+ * terminated there, so a frame can point straight at them.
+ */
+typedef struct _config_cb_t_ {
+  uint8_t mac[6];             /* Destination multicast address */
+  uint16_t appid;             /* APPID */
+  uint16_t vid;               /* 802.1Q VLAN identifier */
+  uint8_t pcp;                /* 802.1Q priority code point */
+  uint8_t tagged;             /* Non-zero if frames are 802.1Q tagged */
+  uint32_t confRev;           /* confRev */
+  uint32_t numDatSetEntries;  /* Number of FCDAs of the dataset */
+  uint32_t min_time;          /* MinTime, ms to the first repetition, or 0 */
+  uint32_t max_time;          /* MaxTime, ms between heartbeats, or 0 */
+  uint32_t ied;               /* Name of the publishing IED */
+  uint32_t gocbref;           /* gocbRef */
+  uint32_t datSet;            /* datSet */
+  uint32_t goID;              /* goID */
+  uint32_t reserved;          /* Zero, keeps the arrays 8 byte aligned */
+} config_cb_t;
+
+
+/** Header of a configuration image, compiled from SCL by goose_scl. The 
+ * image is position independent, every reference is an offset from the 
+ * start of the header, so it is used where it is mapped.
+ */
+typedef struct _config_t_ {
+  uint32_t magic;             /* CONFIG_MAGIC */
+  uint32_t version;           /* CONFIG_VERSION */
+  uint64_t size;              /* Bytes of the image */
+  char ied[CONFIG_NAME_LEN];  /* Name of the IED configured */
+  uint32_t num_pubs;          /* Number of control blocks published */
+  uint32_t pubs;              /* Offset of the published config_cb_t */
+  uint32_t num_subs;          /* Number of control blocks subscribed to */
+  uint32_t subs;              /* Offset of the subscribed config_cb_t */
+  uint32_t hash_len;          /* Slots of the subscription table, power of 2 */
+  uint32_t hash;              /* Offset of the slots, subs index or empty */
+  uint32_t strings;           /* Offset of the string table */
+  uint32_t strings_len;       /* Bytes of the string table */
+} config_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to map a configuration image read-only and check it. Nothing is 
+ * parsed, the checks only bound every offset so that the image can be used 
+ * in place.
+ *
+ * @param path	- path of the image
+ * @return const config_t *	- pointer to the mapped image, else NULL if it 
+ * 			could not be mapped or is not a valid image
+ */
+const config_t *config_map(const char *path);
+
+/**
+ * Function to unmap a configuration image mapped by config_map()
+ *
+ * @param config	- pointer to the mapped image, may be NULL
+ */
+void config_unmap(const config_t *config);
+
+/**
+ * Function to return a published control block of an image
+ *
+ * @param config	- pointer to the mapped image
+ * @param i	- index of the control block
+ * @return const config_cb_t *	- pointer to the control block, else NULL if 
+ * 			i is out of range
+ */
+const config_cb_t *config_pub(const config_t *config, uint32_t i);
+
+/**
+ * Function to return a subscribed control block of an image
+ *
+ * @param config	- pointer to the mapped image
+ * @param i	- index of the control block
+ * @return const config_cb_t *	- pointer to the control block, else NULL if 
+ * 			i is out of range
+ */
+const config_cb_t *config_sub(const config_t *config, uint32_t i);
+
+/**
+ * Function to return a string of an image
+ *
+ * @param config	- pointer to the mapped image
+ * @param offset	- offset of the string in the string table
+ * @return const char *	- pointer to the '\0' terminated string
+ */
+const char *config_str(const config_t *config, uint32_t offset);
+
+/**
+ * Function to look up the subscribed control block of a received frame in 
+ * the hash table of the image
+ *
+ * @param config	- pointer to the mapped image
+ * @param appid	- APPID of the frame
+ * @param gocbref	- gocbRef of the frame, not '\0' terminated
+ * @param len	- number of bytes at gocbref
+ * @return const config_cb_t *	- pointer to the control block, else NULL if 
+ * 			the frame is not subscribed to
+ */
+const config_cb_t *config_find_sub(const config_t *config, uint16_t appid, 
+  const uint8_t *gocbref, size_t len);
+
+/**
+ * Function to hash the key of a subscribed control block, as the compiler 
+ * places it in the table
+ *
+ * @param appid	- APPID of the control block
+ * @param gocbref	- gocbRef of the control block
+ * @param len	- number of bytes at gocbref
+ * @return uint32_t	- hash, to be masked by hash_len - 1
+ */
+uint32_t config_hash(uint16_t appid, const uint8_t *gocbref, size_t len);
+
+/**
+ * Function to set up a GOOSE frame to publish a control block of an image. 
+ * The destination address, 802.1Q tag, APPID, confRev and numDatSetEntries 
+ * are copied, timeAllowedtoLive is twice MaxTime if it is set, and gocbRef, 
+ * datSet and goID point into the image, which must stay mapped while the 
+ * frame is used.
+ * The source address, t and the state numbers are left to the caller.
+ *
+ * @param config	- pointer to the mapped image
+ * @param cb	- pointer to a published control block of the image
+ * @param goose_frame	- pointer to the GOOSE frame to set up
+ * @return int	- 0 on success, else -1 if a parameter is not specified
+ */
+int config_frame(const config_t *config, const config_cb_t *cb, 
+  goose_frame_t *goose_frame);
+
+#endif /* _CONFIG_H_ */
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _DIFF_H_
+#define _DIFF_H_
+
+#include "goose.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Maximum number of dataset entries compared, a full frame of the shortest 
+ * entries
+ */
+#define DIFF_MAX_ENTRIES 512
+
+
+/** Number of words in a changed-mask, one bit per dataset entry
+ */
+#define DIFF_MASK_WORDS (DIFF_MAX_ENTRIES / 64)
+
+
+/** Previous state of a stream, its allData as received and the offset of 
+ * each entry, so the next state is compared byte for byte
+ */
+typedef struct _diff_state_t_ {
+  _Alignas(32) uint8_t data[MAX_FRAME_SIZE];   /* allData of the state */
+  size_t len;                                  /* Number of bytes at data */
+  uint16_t start[DIFF_MAX_ENTRIES + 1];        /* Entry offsets, then len */
+  uint16_t value[DIFF_MAX_ENTRIES];            /* Offsets of entry values */
+  size_t count;                                /* Number of entries */
+  int valid;                                   /* Non-zero once a state is kept */
+} diff_state_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to select the compare implementation once, AVX2 or SSE2 when the 
+ * CPU supports them, NEON on 64-bit ARM, else portable code. It is safe to 
+ * call more than once and from more than one thread, and is called by 
+ * diff_update().
+ */
+void diff_init(void);
+
+/**
+ * Function to return the name of the selected compare implementation
+ *
+ * @return const char *	- "avx2", "sse2", "neon" or "portable"
+ */
+const char *diff_impl_name(void);
+
+/**
+ * Function to compare the allData of a new state of a stream with the state 
+ * before, and keep the new state. Bit i of the mask, bit i % 64 of word 
+ * i / 64, is set if entry i changed. While only values change, allData 
+ * keeps its length and layout, so the two are compared a vector at a time 
+ * and each difference is mapped to its entry by the offsets kept, without 
+ * walking the entries. Otherwise, when a tag or length differs, the new 
+ * state is walked and compared entry by entry. Every entry of the first state, and every 
+ * entry past the end of the previous state, is changed.
+ *
+ * @param state	- pointer to the previous state of the stream, zeroed 
+ * 		before the first state
+ * @param all_data	- pointer to the allData of the new state
+ * @param len	- number of bytes at all_data
+ * @param changed	- pointer to DIFF_MASK_WORDS words to hold the mask
+ * @param count	- pointer to hold the number of entries of the new state
+ * @return int	- 0 on success, else -1 if allData is malformed or has more 
+ * 		than DIFF_MAX_ENTRIES entries, when the state is left as it was
+ */
+int diff_update(diff_state_t *state, const uint8_t *all_data, size_t len, 
+ uint64_t *changed, size_t *count);
+
+#endif /* _DIFF_H_ */
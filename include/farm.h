@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _FARM_H_
+#define _FARM_H_
+
+#include "goose.h"
+#include "transport.h"
+#include "types.h"
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Maximum number of boolean entries of the dataset of a virtual IED
+ */
+#define FARM_MAX_ENTRIES 64
+
+/** Maximum length of the name prefix of the virtual IEDs, and of their 
+ * gocbRef, datSet and goID, including the '\0'
+ */
+#define FARM_NAME_LEN 24
+#define FARM_REF_LEN 48
+
+/** Default retransmission curve, the first repetition MinTime after a state 
+ * change, doubling up to the MaxTime heartbeat
+ */
+#define FARM_MIN_TIME_MS 4
+#define FARM_MAX_TIME_MS 1000
+
+/** Default window of a batch, frames due within it of the first frame of a 
+ * batch are sent with it in one call
+ */
+#define FARM_BATCH_NS 50000ULL
+
+
+/** Template of the virtual IEDs of a farm. IED i is named name followed by i 
+ * in five digits, and its APPID, source address and the last two octets of 
+ * its destination address are those of the template plus i.
+ */
+typedef struct _farm_template_t_ {
+  char name[FARM_NAME_LEN];       /* Name prefix of the IEDs */
+  uint8_t dmac[6];                /* Destination multicast address of IED 0 */
+  uint8_t smac[6];                /* Source address of IED 0 */
+  uint16_t appid;                 /* APPID of IED 0 */
+  vlan_tag_t vlan;                /* 802.1Q tag of every IED */
+  uint32_t confRev;               /* confRev */
+  uint32_t numDatSetEntries;      /* Booleans of each dataset */
+  uint32_t min_time_ms;           /* MinTime, ms to the first repetition */
+  uint32_t max_time_ms;           /* MaxTime, ms between heartbeats */
+} farm_template_t;
+
+/** Virtual IED, one GOOSE control block on its retransmission curve
+ */
+typedef struct _farm_ied_t_ {
+  goose_frame_t frame;                    /* Frame published */
+  timevalq_t t;                           /* Time of the current state */
+  uint64_t deadline;                      /* Monotonic time of the next frame */
+  uint64_t interval;                      /* Interval after the next frame */
+  uint32_t heap;                          /* Position in the scheduler heap */
+  uint32_t index;                         /* Number of the IED in the farm */
+  char gocbref[FARM_REF_LEN];             /* gocbRef */
+  char datSet[FARM_REF_LEN];              /* datSet */
+  char goID[FARM_REF_LEN];                /* goID */
+  uint8_t all_data[3 * FARM_MAX_ENTRIES]; /* Dataset, BER booleans */
+} farm_ied_t;
+
+/** Scripted state change, an entry of the dataset of an IED set to a value
+ */
+typedef struct _farm_event_t_ {
+  uint64_t at_ns;             /* Time from the start of the farm */
+  uint32_t ied;               /* Number of the IED */
+  uint32_t entry;             /* Dataset entry */
+  uint8_t value;              /* Boolean value */
+} farm_event_t;
+
+/** Scheduler of a range of the IEDs of a farm, run by one thread. The IEDs 
+ * are kept in a binary heap by the deadline of their next frame, so the 
+ * next frame is found in constant time and rescheduled in O(log n) 
+ * whatever the number of IEDs.
+ */
+typedef struct _farm_t_ {
+  const farm_template_t *tmpl;            /* Template of the IEDs */
+  farm_ied_t *ied;                        /* IEDs of the scheduler */
+  uint32_t *heap;                         /* IEDs ordered by deadline */
+  uint32_t num_ieds;                      /* Number of IEDs */
+  uint32_t first;                         /* Number of the first IED */
+  uint64_t batch_ns;                      /* Window of a batch */
+  uint64_t event_ns;                      /* Mean time between random state 
+                                           * changes of an IED, 0 for none */
+  const farm_event_t *script;             /* Scripted state changes, by time */
+  size_t num_script;                      /* Number of scripted changes */
+  uint64_t rng;                           /* State of the random generator */
+  volatile sig_atomic_t *stop;            /* Set to stop, may be NULL */
+  uint64_t *late;                         /* Lateness of each frame, or NULL */
+  size_t max_late;                        /* Samples that fit at late */
+  size_t timed;                           /* Samples written to late */
+  uint64_t frames;                        /* Frames sent */
+  uint64_t batches;                       /* Batches sent */
+  uint64_t errors;                        /* Frames not sent */
+  uint64_t events;                        /* State changes */
+  uint64_t overruns;                      /* Frames sent after the next 
+                                           * frame of their IED was due */
+} farm_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to set a template to the defaults, 8 booleans per dataset on the 
+ * default retransmission curve
+ *
+ * @param tmpl	- pointer to the template to initialise
+ */
+void farm_template_init(farm_template_t *tmpl);
+
+/**
+ * Function to create the IEDs of a scheduler, each from the template with 
+ * its own addresses, APPID, names and dataset
+ *
+ * @param farm	- pointer to the scheduler to initialise
+ * @param tmpl	- pointer to the template, which must outlive the scheduler
+ * @param first	- number of the first IED of the scheduler
+ * @param count	- number of IEDs of the scheduler
+ * @return int	- 0 on success, else -1
+ */
+int farm_init(farm_t *farm, const farm_template_t *tmpl, uint32_t first, 
+  uint32_t count);
+
+/**
+ * Function to release the IEDs of a scheduler
+ *
+ * @param farm	- pointer to the scheduler
+ */
+void farm_free(farm_t *farm);
+
+/**
+ * Function to read a script of state changes, one per line as the time in 
+ * ms from the start, the IED number, the dataset entry and the value 0 or 
+ * 1, with # starting a comment. The changes are sorted by time.
+ *
+ * @param path	- path of the script
+ * @param events	- pointer to hold the allocated changes, freed by the 
+ * 		caller
+ * @param count	- pointer to hold the number of changes
+ * @return int	- 0 on success, else -1
+ */
+int farm_load_script(const char *path, farm_event_t **events, size_t *count);
+
+/**
+ * Function to publish the IEDs of a scheduler through a transport for a 
+ * number of seconds. Every IED starts on its heartbeat at a random phase, 
+ * and moves back to the start of its retransmission curve on each random or 
+ * scripted state change. Frames due within the batch window of each other, 
+ * or already due, are encoded and sent together with 
+ * transport_send_batch(), each deadline fixed from the last so that a late 
+ * frame does not delay the frames after it.
+ *
+ * @param farm	- pointer to the scheduler
+ * @param tp	- pointer to the open transport, used by this scheduler only
+ * @param start	- monotonic time of the start, in ns, shared by the 
+ * 		schedulers of a farm
+ * @param secs	- seconds to publish for
+ * @return int	- 0 on success, else -1
+ */
+int farm_run(farm_t *farm, transport_t *tp, uint64_t start, unsigned int secs);
+
+#endif /* _FARM_H_ */
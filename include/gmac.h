@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _GMAC_H_
+#define _GMAC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Size of an AES block, and of the GMAC tag, in bytes
+ */
+#define GMAC_BLOCK_LEN 16
+
+
+/** Size of the GMAC initialisation vector in bytes (See: NIST SP800-38D)
+ */
+#define GMAC_IV_LEN 12
+
+
+/** Implementations of AES and GHASH
+ */
+typedef enum _gmac_impl_t_ {
+  GMAC_IMPL_AUTO = 0,     /* Fastest supported by the CPU */
+  GMAC_IMPL_PORTABLE = 1, /* Table-driven AES and 4-bit GHASH tables */
+  GMAC_IMPL_AESNI = 2     /* AES-NI and PCLMULQDQ carry-less multiply */
+} gmac_impl_t;
+
+
+/** AES-GMAC key schedule. The AES round keys are kept both as words for the 
+ * portable table-driven implementation and as bytes for AES-NI, together 
+ * with the hash subkey H and its 4-bit multiplication table.
+ */
+typedef struct _gmac_key_t_ {
+  _Alignas(16) uint8_t rk[240]; /* AES round keys as bytes, for AES-NI */
+  uint32_t w[60];               /* AES round keys as big-endian words */
+  int rounds;                   /* Number of AES rounds, 10 or 14 */
+  _Alignas(16) uint8_t h[GMAC_BLOCK_LEN]; /* Hash subkey H = E(K, 0^128) */
+  uint64_t hl[16];              /* Low halves of multiples of H */
+  uint64_t hh[16];              /* High halves of multiples of H */
+} gmac_key_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to select the AES and GHASH implementations once, using AES-NI and 
+ * carry-less multiply when the CPU supports them, else the portable 
+ * table-driven code. It is safe to call more than once and from more than one 
+ * thread, and is called by gmac_set_key().
+ */
+void gmac_init(void);
+
+/**
+ * Function to select the AES and GHASH implementation, for checking and 
+ * comparing implementations. The fastest the CPU supports is used unless 
+ * this is called. Key schedules hold the round keys and tables of every 
+ * implementation, so keys already set remain valid, but no other thread may 
+ * be computing a tag while the implementation is changed.
+ *
+ * @param impl	- implementation to use
+ * @return int	- 0 on success, else -1 if the CPU does not support it
+ */
+int gmac_set_impl(gmac_impl_t impl);
+
+/**
+ * Function to return the name of the selected GMAC implementation
+ *
+ * @return const char *	- "aesni-pclmul" or "portable"
+ */
+const char *gmac_impl_name(void);
+
+/**
+ * Function to expand an AES-128 or AES-256 key into a GMAC key schedule
+ *
+ * @param key	- pointer to the key schedule to populate
+ * @param k	- pointer to the key bytes
+ * @param k_len	- number of key bytes, 16 or 32
+ * @return int	- 0 on success, else -1 if the parameters are invalid
+ */
+int gmac_set_key(gmac_key_t *key, const uint8_t *k, size_t k_len);
+
+/**
+ * Function to compute the GMAC tag of a message, i.e. AES-GCM with the 
+ * message as additional authenticated data and no plaintext.
+ *
+ * @param key	- pointer to the key schedule
+ * @param iv	- pointer to the GMAC_IV_LEN byte initialisation vector, which 
+ * 		must never repeat for the same key
+ * @param msg	- pointer to the message bytes
+ * @param len	- number of message bytes
+ * @param tag	- pointer to the buffer to hold GMAC_BLOCK_LEN bytes
+ */
+void gmac_compute(const gmac_key_t *key, const uint8_t *iv, 
+ const uint8_t *msg, size_t len, uint8_t *tag);
+
+#endif /* _GMAC_H_ */
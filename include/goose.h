@@ -31,6 +31,9 @@
 #ifndef _GOOSE_H_
 #define _GOOSE_H_
 
+#include "metrics.h"
+#include "pool.h"
+#include "security.h"
 #include "types.h"
 
 #include <net/ethernet.h>
@@ -40,11 +43,43 @@
  */
 static const uint16_t GOOSE_TPID=0x8100;
 
+/** Default 802.1Q priority code point for GOOSE, so that switches queue GOOSE 
+ * ahead of bulk traffic (See: IEC61850-8-1 Annex C)
+ */
+static const uint8_t GOOSE_DEFAULT_PCP=4;
+
+/** Length of the 802.1Q tag inserted after the source address
+ */
+#define VLAN_TAG_LEN 4
+
+/** Length of the encoded ethernet header ahead of the ethertype, i.e. the 
+ * addresses and the 802.1Q tag of a tagged frame
+ */
+#define ETHER_PREFIX_LEN (2 * ETHER_ADDR_LEN + VLAN_TAG_LEN)
+
 /** GOOSE PDU preamble (See: IEC61850-8-1 Annex A)
  */
 static const uint8_t GOOSE_PREAMBLE=0x61;
 
 
+/** Flag in the Reserved 1 field of the GOOSE header (host order) indicating 
+ * that a protected checksum extension follows the GOOSE PDU
+ */
+static const uint16_t GOOSE_RES1_PROTECTED=0x8000;
+
+/** ASN.1 tag of the protected checksum extension which follows the GOOSE PDU
+ */
+static const uint8_t GOOSE_SEC_EXT_TAG=0xaf;
+
+/** ASN.1 tag of the allData element of the GOOSE PDU
+ */
+static const uint8_t GOOSE_ALLDATA_TAG=0xab;
+
+/** Length of the GOOSE header, i.e. APPID, length, reserved 1 and 2
+ */
+#define GOOSE_HDR_LEN 8
+
+
 /** Ethertype for IEC61850-8-1 GOOSE frames
  */
 static const uint16_t ETHER_GOOSE=0x88b8;
@@ -69,6 +104,15 @@ static const uint16_t MAX_FRAME_SIZE=1518;
 #endif
 
 
+/** 802.1Q VLAN tag
+ */
+typedef struct _vlan_tag_t_ {
+  uint8_t tagged; /* Non-zero if the frame carries an 802.1Q tag */
+  uint8_t pcp;    /* Priority code point (0-7) */
+  uint16_t vid;   /* VLAN identifier (0-4095) */
+} vlan_tag_t;
+
+
 /** GOOSE Header
  */
 typedef struct _goose_header_t_ {
@@ -96,7 +140,8 @@ typedef struct _goose_pdu_t_ {
   uint32_t confRev;           /* confRev */
   uint8_t ndsCom;             /* ndsCom */
   uint32_t numDatSetEntries;  /* numDatSetEntries */
-  uint8_t *allData;           /* allData */
+  uint8_t *allData;           /* allData, BER encoded dataset entries */
+  uint16_t allDataLen;        /* Number of bytes at allData */
   uint8_t *security;          /* security (optional) */
 } goose_pdu_t;
 
@@ -105,11 +150,75 @@ typedef struct _goose_pdu_t_ {
  */
 typedef struct _goose_frame_t_ {
   struct ether_header eth_hdr; /* Ethernet header */
+  vlan_tag_t vlan;             /* 802.1Q tag (optional) */
+  uint8_t eth_prefix[ETHER_PREFIX_LEN]; /* Encoded addresses and tag */
+  uint8_t eth_prefix_len;      /* Bytes at eth_prefix, 0 until a set_*() */
   goose_header_t goose_header; /* GOOSE header */
   goose_pdu_t goose_pdu;       /* GOOSE PDU */
+  goose_sec_t *sec;            /* Security context (optional) */
+  metrics_stream_t *metrics;   /* Counters of the stream (optional) */
+  const struct _goose_codec_t_ *codec; /* Generated encoder (optional) */
+  const void *dataset;         /* Dataset values for the generated encoder */
 } goose_frame_t;
 
 
+/** Read-only view of a received GOOSE frame. The view points into the 
+ * captured frame rather than copying it, so it is only valid for as long as 
+ * the frame is, and string elements are not '\0' terminated.
+ */
+typedef struct _goose_view_t_ {
+  const uint8_t *goose_hdr;     /* GOOSE header (APPID) */
+  size_t len;                   /* Bytes from goose_hdr, per the header len */
+  uint16_t appid;               /* APPId */
+  uint16_t res1;                /* Reserved 1 */
+  const uint8_t *gocbref;       /* gocbref */
+  size_t gocbrefLen;            /* Number of bytes at gocbref */
+  uint32_t timeAllowedtoLive;   /* timeAllowedtoLive */
+  const uint8_t *datSet;        /* datSet */
+  size_t datSetLen;             /* Number of bytes at datSet */
+  const uint8_t *goID;          /* goID (optional), else NULL */
+  size_t goIDLen;               /* Number of bytes at goID */
+  const uint8_t *t;             /* t, 8 octet UtcTime */
+  uint32_t stNum;               /* stNum */
+  uint32_t sqNum;               /* sqNum */
+  uint8_t test;                 /* test */
+  uint32_t confRev;             /* confRev */
+  uint8_t ndsCom;               /* ndsCom */
+  uint32_t numDatSetEntries;    /* numDatSetEntries */
+  const uint8_t *allData;       /* allData, BER encoded dataset entries */
+  size_t allDataLen;            /* Number of bytes at allData */
+  const uint8_t *next;          /* Next element to decode */
+  const uint8_t *end;           /* End of the GOOSE PDU */
+  uint16_t seen;                /* Bit per context tag of elements decoded */
+} goose_view_t;
+
+
+/** Encoder and decoder specialised to the dataset layout of one control 
+ * block, generated by goose_gen from a control block description. A frame 
+ * with a codec is encoded by the codec from its dataset struct, rather than 
+ * from allData, by every publisher.
+ */
+typedef struct _goose_codec_t_ {
+  const char *name;             /* Name of the control block description */
+  uint32_t numDatSetEntries;    /* Number of dataset entries */
+  size_t data_size;             /* Size of the dataset struct */
+  void (*encode)(const goose_frame_t *goose_frame, uint8_t *encoded_data, 
+   uint16_t *encoded_len, int now);     /* Encode, stamping t if now is set */
+  int (*decode)(const goose_view_t *view, void *data);    /* Decode allData */
+} goose_codec_t;
+
+
+/** Read-only view of a dataset entry in the allData of a received GOOSE 
+ * frame. Structures and arrays are a single entry whose value holds the BER 
+ * encoded members.
+ */
+typedef struct _data_entry_t_ {
+  uint8_t tag;                  /* BER tag of the entry, e.g. 0x83 boolean */
+  const uint8_t *value;         /* Value, pointing into the frame */
+  size_t len;                   /* Number of bytes at value */
+} data_entry_t;
+
+
 /*
  * Function Prototypes
  */
@@ -118,7 +227,8 @@ typedef struct _goose_frame_t_ {
  * and populate the encoded_length variable with the number of bytes in the 
  * populated buffer. If the GOOSE frame or the buffer are NULL then encoded 
  * length is reset to 0, else the GOOSE frame is ASN.1 encoded into the encoded 
- * data buffer and the encoded_length value updated appropriately. 
+ * data buffer and the encoded_length value updated appropriately. Frames 
+ * with a codec are encoded by the codec from their dataset.
  *
  * @param goose_frame	- pointer to the GOOSE frame struct to be encoded
  * @param encoded_data	- pointer to the buffer to store the ASN.1 encoded bytes
@@ -128,6 +238,123 @@ typedef struct _goose_frame_t_ {
 void encode_goose_frame(const goose_frame_t *goose_frame, uint8_t *encoded_data, 
   uint16_t *encoded_len );
 
+/**
+ * Function to encode a GOOSE frame as encode_goose_frame(), with t stamped 
+ * straight into the encoded frame from the nanosecond realtime clock, rather 
+ * than taken from the microsecond timeval of the frame. Only the time quality 
+ * of the frame's t is used.
+ *
+ * @param goose_frame	- pointer to the GOOSE frame struct to be encoded
+ * @param encoded_data	- pointer to the buffer to store the ASN.1 encoded bytes
+ * @param encoded_len	- pointer to memory to hold the length of the encoded 
+ * 			bytes
+ */
+void encode_goose_frame_now(const goose_frame_t *goose_frame, 
+  uint8_t *encoded_data, uint16_t *encoded_len );
+
+/**
+ * Function to encode the ethernet header of the GOOSE frame, including the 
+ * 802.1Q tag carrying the priority and VLAN identifier if the frame is tagged, 
+ * into the buffer. The header is the same for every frame published on a 
+ * control block, so set_dest_mac(), set_src_mac() and set_vlan() keep the 
+ * addresses and tag encoded on the frame and they are copied as is, with 
+ * only the ethertype taken from eth_hdr. Frames whose addresses or tag are 
+ * written directly must call one of those functions afterwards.
+ *
+ * @param goose_frame	- pointer to the GOOSE frame whose header is encoded
+ * @param encoded_data	- pointer to the buffer to store the header bytes
+ * @return size_t	- number of bytes encoded, ETHER_HDR_LEN for untagged or 
+ * 			ETHER_HDR_LEN + VLAN_TAG_LEN for tagged frames, else 0 
+ * 			if either parameter is not specified
+ */
+size_t encode_eth_header(const goose_frame_t *goose_frame, 
+  uint8_t *encoded_data);
+
+/**
+ * Function to encode an ethernet header, including the 802.1Q tag if the tag 
+ * is set, into the buffer. This is shared by the GOOSE and sampled values 
+ * encoders.
+ *
+ * @param eth_hdr	- pointer to the ethernet header to encode
+ * @param vlan	- pointer to the 802.1Q tag
+ * @param encoded_data	- pointer to the buffer to store the header bytes
+ * @return size_t	- number of bytes encoded, else 0 if a parameter is not 
+ * 			specified
+ */
+size_t encode_ether_vlan(const struct ether_header *eth_hdr, 
+  const vlan_tag_t *vlan, uint8_t *encoded_data);
+
+/**
+ * Function to locate the payload of a received ethernet frame without copying 
+ * it. If the frame carries an 802.1Q tag then the tag is skipped and its tag 
+ * control information returned, so tagged and untagged frames are handled by 
+ * the same code path.
+ *
+ * @param packet	- pointer to the received frame
+ * @param caplen	- number of bytes captured
+ * @param ethertype	- pointer to hold the (inner) ethertype in host order
+ * @param tci	- pointer to hold the tag control information in host order, 
+ * 		or 0 if the frame is untagged, may be NULL
+ * @return const uint8_t *	- pointer to the first byte after the ethertype, 
+ * 			else NULL if the frame is truncated
+ */
+const uint8_t *get_ether_payload(const uint8_t *packet, size_t caplen, 
+  uint16_t *ethertype, uint16_t *tci);
+
+/**
+ * Function to decode a received GOOSE frame into a view of its fields without 
+ * copying them. The GOOSE header length bounds the decode, so any protected 
+ * checksum extension after the PDU is not part of the view.
+ *
+ * @param packet	- pointer to the received frame
+ * @param caplen	- number of bytes captured
+ * @param view	- pointer to the view to populate
+ * @return int	- 0 if the frame is a well formed GOOSE frame, else -1
+ */
+int decode_goose_frame(const uint8_t *packet, size_t caplen, 
+  goose_view_t *view);
+
+/**
+ * Function to decode the first stage of a received GOOSE frame, the header, 
+ * gocbRef, timeAllowedtoLive, datSet, goID, t, stNum and sqNum, which lead 
+ * the PDU. The scan stops at sqNum, so the cost does not grow with the 
+ * dataset, and test, confRev, ndsCom, numDatSetEntries and allData are left 
+ * unset until decode_goose_body() is called. Most frames are retransmissions 
+ * of an unchanged state, for which the first stage is all a subscriber needs.
+ *
+ * @param packet	- pointer to the received frame
+ * @param caplen	- number of bytes captured
+ * @param view	- pointer to the view to populate
+ * @return int	- 0 if the first stage is well formed, else -1
+ */
+int decode_goose_header(const uint8_t *packet, size_t caplen, 
+  goose_view_t *view);
+
+/**
+ * Function to complete the decode of a view from decode_goose_header(), 
+ * after which the view is as decode_goose_frame() returns it. Calling it 
+ * again does nothing more.
+ *
+ * @param view	- pointer to the view to complete
+ * @return int	- 0 if the frame is a well formed GOOSE frame, else -1
+ */
+int decode_goose_body(goose_view_t *view);
+
+/**
+ * Function to decode the dataset entries of a received GOOSE frame. The 
+ * entries are allocated from the arena, which the caller resets once it is 
+ * done with the frame, so decoding does not touch the heap.
+ *
+ * @param view	- pointer to the view of the frame
+ * @param arena	- pointer to the arena to allocate the entries from
+ * @param entries	- pointer to hold the array of entries
+ * @param count	- pointer to hold the number of entries
+ * @return int	- 0 on success, else -1 if allData is malformed or the arena 
+ * 		does not have room for the entries
+ */
+int decode_goose_dataset(const goose_view_t *view, arena_t *arena, 
+  data_entry_t **entries, size_t *count);
+
 /**
  * Function to return a pointer to the Reserve 1 field in the GOOSE header for 
  * the GOOSE frame specified. If the GOOSE frame is not specified (NULL) then 
@@ -151,7 +378,8 @@ void print_goose_pdu_elem_str(uint8_t *goose_pdu_elem);
 /**
  * Function to set the destination EUI hardware address on the GOOSE frame to 
  * the specified value. If the GOOSE frame or value is not set then 0 is 
- * returned, else the destination address is set and 1 is returned
+ * returned, else the destination address and the encoded header of the 
+ * frame are set and 1 is returned
  *
  * @param goose_frame	- pointer to the GOOSE frame to be updated
  * @param dmac	- pointer to the hardware address to set to
@@ -162,7 +390,8 @@ int set_dest_mac( goose_frame_t *goose_frame, const uint8_t *dmac );
 /**
  * Function to set the source EUI hardware address on the GOOSE frame to 
  * the specified value. If the GOOSE frame or value is not set then 0 is 
- * returned, else the source address is set and 1 is returned
+ * returned, else the source address and the encoded header of the frame 
+ * are set and 1 is returned
  *
  * @param goose_frame	- pointer to the GOOSE frame to be updated
  * @param smac	- pointer to the hardware address to set to
@@ -170,17 +399,48 @@ int set_dest_mac( goose_frame_t *goose_frame, const uint8_t *dmac );
  */
 int set_src_mac( goose_frame_t *goose_frame, const uint8_t *smac );
 
+/**
+ * Function to tag the GOOSE frame with the specified 802.1Q VLAN identifier 
+ * and priority. If the GOOSE frame is not set or the values are out of range 
+ * then 0 is returned, else the frame is tagged, its encoded header updated 
+ * and 1 is returned
+ *
+ * @param goose_frame	- pointer to the GOOSE frame to be updated
+ * @param vid	- VLAN identifier (0-4095), 0 for priority tagging only
+ * @param pcp	- priority code point (0-7)
+ * @return int	- 1 if the tag is updated, else 0
+ */
+int set_vlan( goose_frame_t *goose_frame, uint16_t vid, uint8_t pcp );
+
+/**
+ * Function to append the protected checksum extension to an encoded GOOSE 
+ * frame. The extension tag and length are appended after the GOOSE PDU, the 
+ * GOOSE header length and the protected flag in res1 are updated, and the 
+ * authentication value is computed over the GOOSE header, the PDU and the 
+ * extension tag and length and written into the extension.
+ *
+ * @param sec	- pointer to the security context to sign with
+ * @param encoded_data	- pointer to the encoded frame, which must have room 
+ * 			for MAX_FRAME_SIZE bytes
+ * @param encoded_len	- pointer to the length of the encoded frame, updated 
+ * 			to include the extension
+ * @return int	- 0 on success, else -1 if the frame could not be signed
+ */
+int sign_goose_frame(goose_sec_t *sec, uint8_t *encoded_data, 
+  uint16_t *encoded_len);
+
 /**
  * Function to verify if the protected checksum for the GOOSE frame is correct.
  *
- * @param goose_frame	- pointer to the GOOSE frame to verify
- * @param int	- returns -2 if the GOOSE frame is not specified, else 0 if the 
+ * @param sec	- pointer to the security context to verify with
+ * @param goose_hdr	- pointer to the GOOSE header (APPID) of the frame
+ * @param len	- number of bytes available from the GOOSE header
+ * @param int	- returns -2 if a parameter is not specified, -1 if the frame 
+ *		has no well formed protected checksum extension, else 0 if the 
  *		computed protected checksum is the same as the protected 
- *		checksum supplied with the GOOSE frame, second, else less than 
- *		or greater than zero if computed protected checksum is matched 
- * 		relative to the protected checksum supplied with the GOOSE 
- *		frame address.
+ *		checksum supplied with the GOOSE frame, else 1.
  */
-int verify_protected_checksum(goose_frame_t *goose_frame);
+int verify_protected_checksum(const goose_sec_t *sec, const uint8_t *goose_hdr,
+  size_t len);
 
 #endif /* _GOOSE_H_ */
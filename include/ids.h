@@ -0,0 +1,203 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _IDS_H_
+#define _IDS_H_
+
+#include "config.h"
+#include "goose.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Maximum length of a gocbRef, a VisibleString65 (See: IEC61850-8-1 Annex A)
+ */
+#define IDS_MAX_REF_LEN 65
+
+/** Window over which the frames of a stream are counted for rate spikes
+ */
+#define IDS_WINDOW_NS 1000000000ULL
+
+/** Default number of windows over which a stream learns its rate and range 
+ * of timeAllowedtoLive before departures from them are alerted
+ */
+#define IDS_LEARN_WINDOWS 10
+
+/** Default rate spike, a window with more than factor times the most frames 
+ * of a learned window, and never fewer than the minimum
+ */
+#define IDS_RATE_FACTOR 4
+#define IDS_RATE_MIN 64
+
+/** Default time a frame may arrive after the TAL of the previous frame 
+ * expired before it is alerted, for the jitter of the publisher and the 
+ * network at the short TAL of the first repetitions
+ */
+#define IDS_TAL_GRACE_MS 10
+
+/** Default number of consecutive frames from the learned source address, 
+ * each following on from the last but going back from the state of the 
+ * stream, after which the stream resynchronises to them as a restart
+ */
+#define IDS_RESYNC_FRAMES 4
+
+/** Maximum number of alerts of a stream in a window, so that a flood does 
+ * not also flood the log, further alerts are only counted
+ */
+#define IDS_MAX_ALERTS 8
+
+
+/** Kinds of alert, each logged as its own event
+ */
+typedef enum _ids_alert_t_ {
+  IDS_ALERT_UNKNOWN = 0,    /* Stream not configured, or new after learning */
+  IDS_ALERT_SRC_MAC,        /* Source address other than the learned one */
+  IDS_ALERT_CONFREV,        /* confRev or numDatSetEntries changed */
+  IDS_ALERT_STNUM_BACK,     /* stNum older than the current state */
+  IDS_ALERT_SQNUM_BACK,     /* sqNum repeated or older within the state */
+  IDS_ALERT_STATE_SQNUM,    /* New state whose first frame is not sqNum 0 */
+  IDS_ALERT_RESTART,        /* stNum back to 1, the publisher restarted */
+  IDS_ALERT_TIME_CHANGED,   /* t changed within a state */
+  IDS_ALERT_TIME_BACK,      /* t of a new state not after the previous */
+  IDS_ALERT_TAL,            /* timeAllowedtoLive zero or out of range */
+  IDS_ALERT_TAL_EXPIRED,    /* Frame after the TAL of the previous expired */
+  IDS_ALERT_RATE,           /* More frames in a window than learned */
+  IDS_ALERT_COUNT           /* Number of kinds */
+} ids_alert_t;
+
+
+/** Learned behaviour of one stream, i.e. one control block of one 
+ * publisher, with its state as of the last frame accepted
+ */
+typedef struct _ids_stream_t_ {
+  uint8_t used;                     /* Non-zero if the slot is in use */
+  uint8_t ref_len;                  /* Number of bytes in ref */
+  uint16_t appid;                   /* APPID of the stream */
+  uint32_t id;                      /* Number of the stream, as logged */
+  uint8_t smac[6];                  /* Source address learned */
+  uint16_t alerts;                  /* Alerts logged in the window */
+  uint32_t confRev;                 /* confRev learned or configured */
+  uint32_t numDatSetEntries;        /* numDatSetEntries learned or configured */
+  uint32_t stNum;                   /* stNum of the current state */
+  uint32_t sqNum;                   /* sqNum of the last frame */
+  uint64_t t;                       /* t of the current state, 2^-24 s */
+  uint32_t tal_ms;                  /* TAL of the last frame */
+  uint32_t tal_min;                 /* Lowest TAL configured, or 0 */
+  uint32_t tal_max;                 /* Highest TAL learned or configured */
+  uint32_t window_frames;           /* Frames of the current window */
+  uint32_t rate_max;                /* Most frames of a learned window */
+  uint32_t learn;                   /* Windows left to learn, 0 when done */
+  uint64_t last_ns;                 /* Time of the last frame */
+  uint64_t window_ns;               /* Start of the current window */
+  uint32_t resync_stNum;            /* stNum of the last frame gone back */
+  uint32_t resync_sqNum;            /* sqNum of the last frame gone back */
+  uint64_t resync_t;                /* t of the last frame gone back */
+  uint32_t resync_frames;           /* Consecutive frames gone back */
+  uint8_t ref[IDS_MAX_REF_LEN];     /* gocbRef of the stream */
+} ids_stream_t;
+
+
+/** Intrusion detection engine of a subscriber. The slots are allocated once 
+ * and open addressed on the APPID and gocbRef, so each frame is checked in 
+ * constant time and memory, and alerts go to the log ring rather than 
+ * being written from the receive path.
+ */
+typedef struct _ids_t_ {
+  ids_stream_t *streams;            /* Slots, a power of two */
+  size_t mask;                      /* Number of slots less one */
+  size_t used;                      /* Number of slots in use */
+  size_t max_streams;               /* Number of streams tracked */
+  const config_t *config;           /* Streams expected, or NULL to learn */
+  uint32_t learn_windows;           /* Windows each stream learns for */
+  uint32_t rate_factor;             /* Rate spike, times the learned rate */
+  uint32_t rate_min;                /* Rate spike, minimum frames */
+  uint32_t tal_grace_ms;            /* Time allowed past an expired TAL */
+  uint32_t resync_frames;           /* Frames gone back to resynchronise */
+  uint64_t learn_until;             /* End of learning of the streams seen */
+  uint64_t frames;                  /* Frames checked */
+  uint64_t malformed;               /* Frames that could not be decoded */
+  uint64_t untracked;               /* Frames of streams beyond max_streams */
+  uint64_t lost;                    /* States or frames missed by sequence */
+  uint64_t suppressed;              /* Alerts counted but not logged */
+  uint64_t alerts[IDS_ALERT_COUNT]; /* Alerts of each kind */
+} ids_t;
+
+
+/** Names of the kinds of alert, indexed by ids_alert_t */
+extern const char *const IDS_ALERT_NAMES[IDS_ALERT_COUNT];
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to initialise an intrusion detection engine for up to the number 
+ * of streams specified. With a configuration image, the streams subscribed 
+ * to are expected, with their confRev, numDatSetEntries and a TAL range from 
+ * MinTime and MaxTime, and any other stream is alerted. Without one, streams 
+ * seen in the first learning period are taken as expected.
+ *
+ * @param ids	- pointer to the engine to initialise
+ * @param max_streams	- maximum number of streams to track
+ * @param config	- pointer to the mapped image, which must stay mapped, 
+ * 		or NULL
+ * @return int	- 0 on success, else -1 if a parameter is invalid
+ */
+int ids_init(ids_t *ids, size_t max_streams, const config_t *config);
+
+/**
+ * Function to release the slots of an intrusion detection engine
+ *
+ * @param ids	- pointer to the engine to release
+ */
+void ids_free(ids_t *ids);
+
+/**
+ * Function to check a received GOOSE frame against the learned behaviour of 
+ * its stream, logging an alert as a LOG_LEVEL_WARN record for each 
+ * departure. The header and body are decoded, allData is not. A frame from 
+ * another source address, or whose stNum or sqNum goes back other than on 
+ * a restart, does not change the state of its stream, so the genuine 
+ * publisher is still followed. A stream resynchronises, with one restart 
+ * alert, to frames from its learned source address that go back after its 
+ * TAL expired, or that follow on from each other for resync_frames frames 
+ * while no frame follows on from the state of the stream.
+ *
+ * @param ids	- pointer to the engine
+ * @param packet	- pointer to the received frame
+ * @param caplen	- number of bytes captured
+ * @param ns	- time the frame was received, in ns
+ * @return int	- number of alerts raised, else -1 if the frame is malformed
+ */
+int ids_check(ids_t *ids, const uint8_t *packet, size_t caplen, uint64_t ns);
+
+#endif /* _IDS_H_ */
@@ -0,0 +1,248 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _LOG_H_
+#define _LOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+/** Number of records in the ring of each thread, a power of two
+ */
+#define LOG_RING_LEN 4096
+
+/** Maximum number of threads writing records
+ */
+#define LOG_MAX_THREADS 64
+
+/** Maximum number of arguments of a record
+ */
+#define LOG_MAX_ARGS 6
+
+/** Maximum number of characters of a text record, enough for a datSet 
+ * VisibleString129, longer text is truncated
+ */
+#define LOG_MAX_TEXT 129
+
+/** Number of characters of a text record held in its own slot, the rest 
+ * continue in the whole of the slots which follow it
+ */
+#define LOG_SLOT_TEXT (LOG_MAX_ARGS * 8)
+
+/** Interval at which the writer thread checks the rings when they are empty
+ */
+#define LOG_FLUSH_US 1000
+
+
+/** Verbosity levels, a record is kept if its level is at or below the level 
+ * set when logging is started
+ */
+typedef enum _log_level_t_ {
+  LOG_LEVEL_NONE = -1,  /* Logging is stopped, nothing is kept */
+  LOG_LEVEL_ERROR = 0,  /* Failures, printed as [!] */
+  LOG_LEVEL_WARN = 1,   /* Rejected frames, printed as [!] */
+  LOG_LEVEL_INFO = 2,   /* Frame contents, printed as [-] */
+  LOG_LEVEL_DEBUG = 3,  /* Per-frame progress, printed as [.] */
+  LOG_LEVEL_TRACE = 4   /* Per-frame detail, printed as [.] */
+} log_level_t;
+
+
+/** Identifiers of the events that can be logged, each with a level and a 
+ * format in LOG_EVENTS
+ */
+typedef enum _log_event_t_ {
+  LOG_EV_INVALID_PARAMS = 0,  /* Handler called with invalid parameters */
+  LOG_EV_PUBLISHED,           /* Frame published, count */
+  LOG_EV_INJECTED,            /* Frame injected, bytes */
+  LOG_EV_RECEIVED,            /* Frame received, count */
+  LOG_EV_HANDLED,             /* Frame handled by the dummy handler */
+  LOG_EV_AUTH_FAILED,         /* Frame failed authentication, result */
+  LOG_EV_REPLAYED,            /* Frame rejected as replayed */
+  LOG_EV_GOOSE_ETH,           /* Ethernet header of a GOOSE frame */
+  LOG_EV_GOOSE_HDR,           /* GOOSE header */
+  LOG_EV_GOOSE_GOCBREF,       /* gocbRef, text */
+  LOG_EV_GOOSE_DATSET,        /* datSet, text */
+  LOG_EV_GOOSE_GOID,          /* goID, text */
+  LOG_EV_GOOSE_TIME,          /* timeAllowedtoLive, t and quality */
+  LOG_EV_GOOSE_STATE,         /* stNum, sqNum and the flags */
+  LOG_EV_GOOSE_REPEAT,        /* stNum and sqNum of an unchanged state */
+  LOG_EV_GOOSE_ENTRY,         /* Dataset entry */
+  LOG_EV_GOOSE_MALFORMED,     /* GOOSE frame that could not be decoded */
+  LOG_EV_IDS_STREAM,          /* Stream learned by the IDS */
+  LOG_EV_IDS_GOCBREF,         /* gocbRef of a stream learned, text */
+  LOG_EV_IDS_UNKNOWN,         /* IDS alerts, in the order of ids_alert_t */
+  LOG_EV_IDS_SRC_MAC,
+  LOG_EV_IDS_CONFREV,
+  LOG_EV_IDS_STNUM_BACK,
+  LOG_EV_IDS_SQNUM_BACK,
+  LOG_EV_IDS_STATE_SQNUM,
+  LOG_EV_IDS_RESTART,
+  LOG_EV_IDS_TIME_CHANGED,
+  LOG_EV_IDS_TIME_BACK,
+  LOG_EV_IDS_TAL,
+  LOG_EV_IDS_TAL_EXPIRED,
+  LOG_EV_IDS_RATE,
+  LOG_EV_COUNT                /* Number of events */
+} log_event_t;
+
+
+/** Definition of an event. The arguments of numeric events are passed to the 
+ * format as unsigned long long, text events pass the length and characters 
+ * to a "%.*s" conversion.
+ */
+typedef struct _log_event_def_t_ {
+  log_level_t level;        /* Level of the event */
+  uint8_t text;             /* Non-zero if the record holds text */
+  const char *format;       /* printf format of the record */
+} log_event_def_t;
+
+
+/** Binary record, one cache line, written by the hot path and formatted by 
+ * the writer thread. Text longer than LOG_SLOT_TEXT continues in the next 
+ * slots of the ring, which are written and formatted with the record.
+ */
+typedef struct _log_record_t_ {
+  uint64_t ts;                      /* Monotonic time in ns */
+  uint16_t event;                   /* log_event_t of the record */
+  uint8_t len;                      /* Number of arguments or characters */
+  uint8_t cont;                     /* Slots of text following the record */
+  uint8_t res[4];                   /* Reserved, for alignment */
+  union {
+    uint64_t arg[LOG_MAX_ARGS];     /* Arguments of a numeric event */
+    char text[LOG_SLOT_TEXT];       /* First characters of a text event */
+  } u;
+} log_record_t;
+
+
+/** Definitions of the events, indexed by log_event_t */
+extern const log_event_def_t LOG_EVENTS[LOG_EV_COUNT];
+
+/** Level of the records kept, LOG_LEVEL_NONE until logging is started */
+extern volatile int LOG_LEVEL;
+
+
+/**
+ * Macro to log a numeric event. The level is checked before the arguments 
+ * are evaluated, so a suppressed event costs a load and a compare. The 
+ * arguments are converted to uint64_t, at least one must be given.
+ *
+ * @param EVENT	log_event_t of the record
+ */
+#define LOG_EVENT(EVENT, ...) \
+do \
+{ \
+  if ((int)LOG_EVENTS[(EVENT)].level <= LOG_LEVEL) \
+  { \
+    const uint64_t log_args_[] = { __VA_ARGS__ }; \
+    log_write((EVENT), log_args_, sizeof(log_args_) / sizeof(uint64_t)); \
+  } \
+} \
+while (0)
+
+/**
+ * Macro to log a text event, e.g. a string element of a received frame
+ *
+ * @param EVENT	log_event_t of the record
+ * @param TEXT	pointer to the characters, need not be '\0' terminated
+ * @param LEN	number of characters
+ */
+#define LOG_TEXT(EVENT, TEXT, LEN) \
+do \
+{ \
+  if ((int)LOG_EVENTS[(EVENT)].level <= LOG_LEVEL) \
+  { \
+    log_write_text((EVENT), (const void *)(TEXT), (LEN)); \
+  } \
+} \
+while (0)
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to start logging, creating the writer thread which formats the 
+ * records of every thread, in time order, and writes them out in batches
+ *
+ * @param out	- stream to write the formatted records to
+ * @param level	- level of the records to keep
+ * @return int	- 0 on success, else -1 if logging is already started or the 
+ * 		writer thread could not be created
+ */
+int log_start(FILE *out, log_level_t level);
+
+/**
+ * Function to stop logging, writing out every record still in the rings and 
+ * releasing them. Threads writing records should have finished.
+ */
+void log_stop(void);
+
+/**
+ * Function to change the level of the records kept while logging
+ *
+ * @param level	- level of the records to keep
+ */
+void log_set_level(log_level_t level);
+
+/**
+ * Function to return the number of records dropped because a ring was full 
+ * or too many threads were writing
+ *
+ * @return uint64_t	- number of records dropped
+ */
+uint64_t log_dropped(void);
+
+/**
+ * Function to write a numeric record to the ring of the calling thread, use 
+ * LOG_EVENT() rather than calling this directly. The record is dropped 
+ * rather than waiting if the ring is full.
+ *
+ * @param event	- event of the record
+ * @param args	- pointer to the arguments
+ * @param nargs	- number of arguments, at most LOG_MAX_ARGS are kept
+ */
+void log_write(log_event_t event, const uint64_t *args, size_t nargs);
+
+/**
+ * Function to write a text record to the ring of the calling thread, use 
+ * LOG_TEXT() rather than calling this directly. Text which does not fit in 
+ * the slot of the record takes the slots after it, and the record is 
+ * dropped unless the ring has room for all of them.
+ *
+ * @param event	- event of the record
+ * @param text	- pointer to the characters
+ * @param len	- number of characters, at most LOG_MAX_TEXT are kept
+ */
+void log_write_text(log_event_t event, const void *text, size_t len);
+
+#endif /* _LOG_H_ */
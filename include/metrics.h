@@ -0,0 +1,285 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Default name of the shared memory segment holding the metrics
+ */
+#define METRICS_SHM_NAME "/cgoose_metrics"
+
+/** Magic number and layout version at the start of the segment, so a reader 
+ * built from other sources refuses a segment it would misread
+ */
+#define METRICS_MAGIC 0x474f4f53
+#define METRICS_VERSION 3
+
+/** Number of interfaces and streams in the segment
+ */
+#define METRICS_MAX_IFACES 8
+#define METRICS_MAX_STREAMS 256
+
+/** Maximum length of an interface name, including the '\0'
+ */
+#define METRICS_IFACE_LEN 16
+
+/** Maximum length of a gocbRef, a VisibleString65
+ */
+#define METRICS_MAX_REF_LEN 65
+
+/** Number of latency histogram buckets, bucket n counts latencies of 2^n to 
+ * 2^(n+1) - 1 ns, and the last bucket every latency above. The transmit 
+ * jitter histograms use the same buckets.
+ */
+#define METRICS_HIST_BUCKETS 32
+
+/** State of an interface or stream slot. A slot is claimed by moving it 
+ * from free to claimed with a compare and swap on the shared segment, so 
+ * that processes attached to it never claim the same slot, and made ready 
+ * once its key is written.
+ */
+#define METRICS_SLOT_FREE 0
+#define METRICS_SLOT_CLAIMED 1
+#define METRICS_SLOT_READY 2
+
+/** Number of times to yield waiting for a claimed slot to become ready, 
+ * after which the claimer is taken to have died and the slot is skipped
+ */
+#define METRICS_CLAIM_SPINS 1000
+
+
+/**
+ * Macro to add to a counter in the segment. Each counter has a single writer 
+ * in practice, relaxed ordering keeps the update a plain locked add with no 
+ * fence, and readers only need each counter to be read whole.
+ *
+ * @param COUNTER	the counter, a uint64_t
+ * @param N	the amount to add
+ */
+#define METRICS_ADD(COUNTER, N) \
+  __atomic_fetch_add(&(COUNTER), (uint64_t)(N), __ATOMIC_RELAXED)
+
+
+/** Counters of one interface, two cache lines
+ */
+typedef struct _metrics_iface_t_ {
+  uint32_t state;                /* METRICS_SLOT_FREE, _CLAIMED or _READY */
+  char name[METRICS_IFACE_LEN];  /* Interface name */
+  uint64_t tx_frames;            /* Frames sent */
+  uint64_t tx_bytes;             /* Bytes sent */
+  uint64_t tx_errors;            /* Frames that could not be sent */
+  uint64_t rx_frames;            /* Frames received */
+  uint64_t rx_bytes;             /* Bytes received */
+  uint64_t decode_errors;        /* Frames that could not be decoded */
+  uint64_t rx_drops;             /* Frames dropped before they were received */
+} __attribute__((aligned(64))) metrics_iface_t;
+
+
+/** Counters of one GOOSE stream, i.e. one control block, with the identity, 
+ * the publisher and subscriber counters and the histogram each on their own 
+ * cache lines, so a process publishing and subscribing to the same stream 
+ * does not share lines between its threads
+ */
+typedef struct _metrics_stream_t_ {
+  uint32_t state;                    /* METRICS_SLOT_FREE, _CLAIMED or _READY */
+  uint16_t appid;                    /* APPID of the stream */
+  uint16_t iface;                    /* Index of the interface */
+  uint8_t ref_len;                   /* Number of bytes in ref */
+  char ref[METRICS_MAX_REF_LEN];     /* gocbRef of the stream */
+  uint64_t tx_frames __attribute__((aligned(64))); /* Frames published */
+  uint64_t tx_late[METRICS_HIST_BUCKETS];  /* Send returned after deadline */
+  uint64_t tx_wire[METRICS_HIST_BUCKETS];  /* Kernel sent after deadline */
+  uint64_t rx_frames __attribute__((aligned(64))); /* Frames received */
+  uint64_t auth_failures;            /* Frames that failed authentication */
+  uint64_t replayed;                 /* Frames rejected as replayed */
+  uint64_t tal_expiries;   /* Frames received after the TAL of the previous */
+  uint64_t stnum_changes;            /* Frames with a new stNum */
+  uint64_t gaps;           /* Frames missed, by the stNum and sqNum received */
+  uint64_t last_stnum;               /* stNum of the last frame received */
+  uint64_t last_sqnum;               /* sqNum of the last frame received */
+  uint64_t last_rx_ns;     /* Monotonic time the last frame was received */
+  uint64_t tal_ms;                   /* TAL of the last frame received */
+  uint64_t latency[METRICS_HIST_BUCKETS] __attribute__((aligned(64)));
+} metrics_stream_t;
+
+
+/** Layout of the shared memory segment
+ */
+typedef struct _metrics_t_ {
+  uint32_t magic;                           /* METRICS_MAGIC */
+  uint32_t version;                         /* METRICS_VERSION */
+  uint64_t pid;                             /* Process that created it */
+  metrics_iface_t iface[METRICS_MAX_IFACES];
+  metrics_stream_t stream[METRICS_MAX_STREAMS];
+} metrics_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to create, or attach to, the metrics segment of this process. 
+ * Until this is called every update function does nothing.
+ *
+ * @param name	- name of the segment, e.g. METRICS_SHM_NAME
+ * @return int	- 0 on success, else -1
+ */
+int metrics_init(const char *name);
+
+/**
+ * Function to detach from the metrics segment of this process. The segment 
+ * is left in place so that it can still be read.
+ */
+void metrics_fini(void);
+
+/**
+ * Function to map a metrics segment read-only, for a monitoring tool
+ *
+ * @param name	- name of the segment
+ * @return const metrics_t *	- pointer to the segment, else NULL if it does 
+ * 				not exist or is not a metrics segment
+ */
+const metrics_t *metrics_map(const char *name);
+
+/**
+ * Function to unmap a segment mapped by metrics_map()
+ *
+ * @param metrics	- pointer to the segment
+ */
+void metrics_unmap(const metrics_t *metrics);
+
+/**
+ * Function to return the index of the counters of an interface, claiming a 
+ * slot the first time the interface is seen
+ *
+ * @param name	- name of the interface
+ * @return int	- index of the interface, else -1 if metrics are not 
+ * 		initialised or every slot is taken
+ */
+int metrics_iface(const char *name);
+
+/**
+ * Function to return the counters of a stream, claiming a slot the first 
+ * time the stream is seen. The slots are open addressed on the APPID and 
+ * gocbRef, so callers that see many streams need not cache the result.
+ *
+ * @param iface	- index of the interface, from metrics_iface()
+ * @param appid	- APPID of the stream
+ * @param ref	- gocbRef of the stream
+ * @param ref_len	- number of bytes in ref
+ * @return metrics_stream_t *	- pointer to the counters, else NULL if 
+ * 				metrics are not initialised or every slot is 
+ * 				taken
+ */
+metrics_stream_t *metrics_stream(int iface, uint16_t appid, 
+ const uint8_t *ref, size_t ref_len);
+
+/**
+ * Function to count a frame published on a stream
+ *
+ * @param stream	- pointer to the counters, may be NULL
+ * @param bytes	- length of the frame
+ * @param ok	- non-zero if the frame was sent
+ */
+void metrics_tx(metrics_stream_t *stream, size_t bytes, int ok);
+
+/**
+ * Function to add the lateness of a frame published on a schedule to the 
+ * transmit jitter histograms of a stream. A frame sent before its deadline 
+ * counts as on time.
+ *
+ * @param stream	- pointer to the counters, may be NULL
+ * @param deadline	- monotonic time the frame was scheduled for, in ns
+ * @param sent_ns	- monotonic time the send call returned
+ * @param wire_ns	- monotonic time of the kernel transmit timestamp, 0 if 
+ * 		there is none
+ */
+void metrics_jitter(metrics_stream_t *stream, uint64_t deadline, 
+ uint64_t sent_ns, uint64_t wire_ns);
+
+/**
+ * Function to count a frame received on a stream, counting a state change 
+ * if the stNum differs from the last frame, a TAL expiry if the frame 
+ * arrived after the timeAllowedtoLive of the last frame had passed, and 
+ * the frames missed if the stNum or sqNum skipped ahead. At least one frame 
+ * is counted missed for each state skipped, and the first sqNum of each 
+ * for a new state that does not start at 0.
+ *
+ * @param stream	- pointer to the counters, may be NULL
+ * @param bytes	- length of the frame
+ * @param stnum	- stNum of the frame
+ * @param sqnum	- sqNum of the frame
+ * @param tal_ms	- timeAllowedtoLive of the frame
+ * @param now_ns	- monotonic time the frame was received
+ */
+void metrics_rx(metrics_stream_t *stream, size_t bytes, uint32_t stnum, 
+ uint32_t sqnum, uint32_t tal_ms, uint64_t now_ns);
+
+/**
+ * Function to count a received frame that could not be decoded
+ *
+ * @param iface	- index of the interface, may be -1
+ */
+void metrics_rx_error(int iface);
+
+/**
+ * Function to set the number of frames dropped on an interface before they 
+ * were received, as counted since the capture was opened, e.g. ps_drop of 
+ * pcap_stats() or transport_drops()
+ *
+ * @param iface	- index of the interface, may be -1
+ * @param drops	- number of frames dropped
+ */
+void metrics_rx_drops(int iface, uint64_t drops);
+
+/**
+ * Function to count the result of authenticating a frame, see 
+ * authenticate_goose_frame()
+ *
+ * @param stream	- pointer to the counters, may be NULL
+ * @param result	- -3 for a replay, -1 or -2 for a failure, else nothing 
+ * 		is counted
+ */
+void metrics_auth(metrics_stream_t *stream, int result);
+
+/**
+ * Function to add a latency to the histogram of a stream
+ *
+ * @param stream	- pointer to the counters, may be NULL
+ * @param ns	- latency in ns
+ */
+void metrics_latency(metrics_stream_t *stream, uint64_t ns);
+
+#endif /* _METRICS_H_ */
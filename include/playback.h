@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _PLAYBACK_H_
+#define _PLAYBACK_H_
+
+#include "capindex.h"
+#include "transport.h"
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Default window of a batch, frames due within it of the first frame of a 
+ * batch are sent with it in one call
+ */
+#define PLAYBACK_BATCH_NS 20000ULL
+
+/** Time from the start of a playback to the deadline of its first frame
+ */
+#define PLAYBACK_START_NS 10000000ULL
+
+
+/** Playback of a capture through a transport, each frame on the absolute 
+ * deadline given by its receive time relative to the first frame, divided 
+ * by the speed. Frames are copied to be sent, so the addresses and APPID 
+ * can be rewritten.
+ */
+typedef struct _playback_t_ {
+  const capture_t *cap;       /* Capture played */
+  uint64_t offset;            /* Offset of the first record played */
+  uint64_t until_ns;          /* Receive time to stop after, 0 for the end */
+  double speed;               /* Speed factor, 0 for as fast as possible */
+  uint64_t batch_ns;          /* Window of a batch, 0 to send one by one */
+  uint64_t spin_ns;           /* Time before a deadline to spin, or 0 */
+  uint8_t dmac[6];            /* Destination address written, if set */
+  uint8_t smac[6];            /* Source address written, if set */
+  uint8_t set_dmac;           /* Non-zero to rewrite the destination */
+  uint8_t set_smac;           /* Non-zero to rewrite the source */
+  int32_t appid;              /* APPID written to GOOSE and SV, or -1 */
+  uint64_t *error;            /* Timing error of each frame in ns, or NULL */
+  size_t max_error;           /* Number of samples that fit at error */
+  volatile sig_atomic_t stop; /* Set, e.g. by a signal handler, to stop */
+  uint64_t frames;            /* Frames sent */
+  uint64_t batches;           /* Batches sent */
+  uint64_t bytes;             /* Bytes sent */
+  uint64_t errors;            /* Frames the transport did not send */
+  uint64_t skipped;           /* Frames too long to send */
+  uint64_t early;             /* Frames sent ahead of their deadline */
+  size_t timed;               /* Samples written to error */
+  uint64_t duration;          /* Time the playback took, in ns */
+} playback_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to initialise a playback of a capture at the original speed, 
+ * from its first frame, with nothing rewritten
+ *
+ * @param pb	- pointer to the playback to initialise
+ * @param cap	- pointer to the capture, opened by capture_open()
+ */
+void playback_init(playback_t *pb, const capture_t *cap);
+
+/**
+ * Function to play a capture through a transport. Frames due within the 
+ * batch window of each other are sent together with transport_send_batch() 
+ * on the deadline of the first, and the timing error of each frame, the 
+ * time the batch was sent less the frame's deadline, is kept as an absolute 
+ * value. A frame that falls behind is sent at once, with every frame 
+ * already due, and the frames after it keep their deadlines, so the 
+ * playback catches up rather than drifts.
+ *
+ * @param pb	- pointer to the playback
+ * @param tp	- pointer to the open transport
+ * @return int	- 0 on success, else -1 if the capture is corrupt
+ */
+int playback_run(playback_t *pb, transport_t *tp);
+
+#endif /* _PLAYBACK_H_ */
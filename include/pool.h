@@ -0,0 +1,169 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _POOL_H_
+#define _POOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Size of a pool buffer, a whole number of cache lines which holds the 
+ * largest ethernet frame
+ */
+#define POOL_BUF_SIZE 1536
+
+/** Size of a cache line, the alignment of pool buffers
+ */
+#define POOL_ALIGN 64
+
+/** Number of buffers held by each thread before returning buffers to the 
+ * shared free list
+ */
+#define POOL_CACHE_LEN 32
+
+/** Number of buffers in the default pool
+ */
+#define POOL_DEFAULT_COUNT 1024
+
+/** Index marking the end of the free list
+ */
+#define POOL_NIL 0xffffffffu
+
+
+/** Fixed size frame buffer pool. The buffers are carved out of one aligned 
+ * allocation made when the pool is initialised. Free buffers are kept on a 
+ * lock-free stack, whose head carries a tag in the upper 32 bits so that a 
+ * buffer taken and returned between a load and compare-and-swap is detected, 
+ * and each thread keeps a small cache in front of the stack.
+ */
+typedef struct _frame_pool_t_ {
+  uint8_t *base;           /* count * POOL_BUF_SIZE bytes, POOL_ALIGN aligned */
+  uint32_t *next;          /* Free list link of each buffer */
+  uint32_t count;          /* Number of buffers */
+  uint64_t head;           /* Tag and index of the first free buffer */
+  uint64_t exhausted;      /* Number of requests with no buffer free */
+} frame_pool_t;
+
+
+/** Bump allocator over a caller supplied region, for scratch space which is 
+ * released all at once, e.g. when the frame it was decoded from is done
+ */
+typedef struct _arena_t_ {
+  uint8_t *base;   /* Start of the region */
+  size_t size;     /* Number of bytes in the region */
+  size_t used;     /* Number of bytes allocated */
+} arena_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to initialise a frame buffer pool. All the memory of the pool is 
+ * allocated here, so taking and returning buffers never allocates.
+ *
+ * @param pool	- pointer to the pool to initialise
+ * @param count	- number of buffers
+ * @return int	- 0 on success, else -1 if a parameter is invalid or memory 
+ * 		could not be allocated
+ */
+int pool_init(frame_pool_t *pool, uint32_t count);
+
+/**
+ * Function to release the memory of a pool. No thread may use the pool, or 
+ * hold its buffers, afterwards.
+ *
+ * @param pool	- pointer to the pool to release
+ */
+void pool_destroy(frame_pool_t *pool);
+
+/**
+ * Function to return the default pool, shared by the publisher and 
+ * subscriber, initialised on first use
+ *
+ * @return frame_pool_t *	- pointer to the default pool, else NULL if it 
+ * 				could not be initialised
+ */
+frame_pool_t *pool_default(void);
+
+/**
+ * Function to take a buffer from the pool, from the cache of the calling 
+ * thread if it has one
+ *
+ * @param pool	- pointer to the pool
+ * @return uint8_t *	- pointer to POOL_BUF_SIZE bytes, not initialised, else 
+ * 			NULL if no buffer is free
+ */
+uint8_t *pool_get(frame_pool_t *pool);
+
+/**
+ * Function to return a buffer to the pool it was taken from
+ *
+ * @param pool	- pointer to the pool
+ * @param buf	- pointer to the buffer returned by pool_get()
+ */
+void pool_put(frame_pool_t *pool, uint8_t *buf);
+
+/**
+ * Function to return the buffers cached by the calling thread to the shared 
+ * free list, which a thread should do before it exits
+ */
+void pool_flush_cache(void);
+
+/**
+ * Function to initialise an arena over a region of memory
+ *
+ * @param arena	- pointer to the arena to initialise
+ * @param buf	- pointer to the region
+ * @param size	- number of bytes in the region
+ */
+void arena_init(arena_t *arena, void *buf, size_t size);
+
+/**
+ * Function to allocate from an arena
+ *
+ * @param arena	- pointer to the arena
+ * @param size	- number of bytes to allocate
+ * @param align	- alignment of the allocation, a power of two
+ * @return void *	- pointer to the allocation, else NULL if the arena does 
+ * 			not have room
+ */
+void *arena_alloc(arena_t *arena, size_t size, size_t align);
+
+/**
+ * Function to release every allocation of an arena at once
+ *
+ * @param arena	- pointer to the arena
+ */
+void arena_reset(arena_t *arena);
+
+#endif /* _POOL_H_ */
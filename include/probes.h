@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _PROBES_H_
+#define _PROBES_H_
+
+/*
+ * Statically defined tracepoints (USDT) for profiling a running publisher or 
+ * subscriber with bpftrace, perf or SystemTap, without rebuilding. When 
+ * <sys/sdt.h> is installed, e.g. from systemtap-sdt-dev, each probe compiles 
+ * to a nop and a note in the binary, behind a test of a semaphore that the 
+ * tracer increments when it attaches, so that the arguments are not 
+ * evaluated until then. Without the header, or when built with 
+ * -DGOOSE_NO_PROBES, the probes compile to nothing.
+ *
+ * Probes of the cgoose provider, and their arguments:
+ *   publish_start   appid, stNum, sqNum
+ *   publish         appid, stNum, sqNum, length, result of the inject
+ *   encode_start    appid, stNum, sqNum
+ *   encode_done     appid, stNum, sqNum, length
+ *   dispatch        ethertype, caplen
+ *   receive         caplen, of subscribe() calls started while attached
+ *   decode          appid, stNum, sqNum, caplen, result
+ *   stream_add      appid, stNum, sqNum
+ *   state_change    appid, previous stNum, stNum, sqNum
+ *   tal_expired     appid, ms since the previous frame, TAL in ms
+ *
+ * e.g. the distribution of encode times of a running goose_ping, in ns:
+ *   bpftrace -e 'usdt:bin/release/goose_ping:cgoose:encode_start 
+ *    { @s[tid] = nsecs; } usdt:bin/release/goose_ping:cgoose:encode_done 
+ *    /@s[tid]/ { @ns = hist(nsecs - @s[tid]); delete(@s[tid]); }'
+ */
+
+#if !defined(GOOSE_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define GOOSE_PROBES 1
+#endif
+#endif
+
+
+#ifdef GOOSE_PROBES
+/**
+ * Macro to define the semaphore of a probe, in the .probes section where 
+ * tracers look for it. The definitions are weak, so that every translation 
+ * unit including this header shares one semaphore for each probe.
+ *
+ * @param NAME	name of the probe
+ */
+#define GOOSE_SEMAPHORE(NAME) \
+  __attribute__((weak, section(".probes"))) \
+  volatile unsigned short cgoose_##NAME##_semaphore
+
+GOOSE_SEMAPHORE(publish_start);
+GOOSE_SEMAPHORE(publish);
+GOOSE_SEMAPHORE(encode_start);
+GOOSE_SEMAPHORE(encode_done);
+GOOSE_SEMAPHORE(dispatch);
+GOOSE_SEMAPHORE(receive);
+GOOSE_SEMAPHORE(decode);
+GOOSE_SEMAPHORE(stream_add);
+GOOSE_SEMAPHORE(state_change);
+GOOSE_SEMAPHORE(tal_expired);
+#endif
+
+
+/**
+ * Macro to test if a tracer is attached to a probe of the cgoose provider, 
+ * for work done only to fire it
+ *
+ * @param NAME	name of the probe, as listed above
+ */
+#ifdef GOOSE_PROBES
+#define GOOSE_PROBE_ENABLED(NAME) \
+  __builtin_expect(0 != cgoose_##NAME##_semaphore, 0)
+#else
+#define GOOSE_PROBE_ENABLED(NAME) 0
+#endif
+
+/**
+ * Macro to fire a probe of the cgoose provider. The arguments are integers, 
+ * and are only evaluated while a tracer is attached to the probe, so they 
+ * must not have side effects.
+ *
+ * @param NAME	name of the probe, as listed above
+ * @param ...	arguments of the probe
+ */
+#ifdef GOOSE_PROBES
+#define GOOSE_PROBE(NAME, ...) \
+do \
+{ \
+  if (GOOSE_PROBE_ENABLED(NAME)) \
+  { \
+    STAP_PROBEV(cgoose, NAME, __VA_ARGS__); \
+  } \
+} \
+while (0)
+#else
+#define GOOSE_PROBE(NAME, ...) do { } while (0)
+#endif
+
+#endif /* _PROBES_H_ */
@@ -0,0 +1,175 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _PRP_H_
+#define _PRP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Suffix closing the redundancy control trailer (See: IEC62439-3 4.1.10)
+ */
+static const uint16_t PRP_SUFFIX=0x88fb;
+
+/** Length of the redundancy control trailer, i.e. sequence number, LAN 
+ * identifier, LSDU size and suffix
+ */
+#define PRP_RCT_LEN 6
+
+/** Minimum length of a frame, excluding the FCS, which a trailer is appended 
+ * at the end of so that the padding is not mistaken for the trailer
+ */
+#define PRP_MIN_FRAME_LEN 60
+
+/** LAN identifiers carried in the trailer
+ */
+#define PRP_LAN_A 0xa
+#define PRP_LAN_B 0xb
+
+/** Number of sequence numbers tracked behind the newest frame of a source, 
+ * so a copy arriving up to this many frames late on the slower LAN is still 
+ * recognised as a duplicate
+ */
+#define PRP_WINDOW 64
+
+
+/** Result of checking a received frame against the duplicate table
+ */
+typedef enum _prp_verdict_t_ {
+  PRP_ACCEPT = 0,     /* First copy of the frame, pass it on */
+  PRP_DUPLICATE = 1,  /* Copy already received on the other LAN, drop it */
+  PRP_NO_RCT = 2      /* Frame has no trailer, from a singly attached node */
+} prp_verdict_t;
+
+
+/** Duplicate state of one source. The source MAC is in the upper 48 bits of 
+ * key and the newest sequence number in the lower 16, so a node is one 
+ * compare and four nodes share a cache line.
+ */
+typedef struct _prp_node_t_ {
+  uint64_t key;         /* Source MAC and newest sequence number, 0 if free */
+  uint64_t window;      /* Bit n set if newest - n has been received */
+} prp_node_t;
+
+
+/** Table of duplicate state, open addressed on the source MAC, with the 
+ * counters of both LANs
+ */
+typedef struct _prp_table_t_ {
+  prp_node_t *nodes;     /* Slots, a power of two */
+  size_t mask;           /* Number of slots less one */
+  size_t count;          /* Number of slots in use */
+  size_t max_nodes;      /* Number of sources tracked before refusing */
+  uint64_t lan[2];       /* Frames with a trailer received on LAN A and B */
+  uint64_t accepted;     /* Frames passed on */
+  uint64_t duplicates;   /* Frames dropped as duplicates */
+  uint64_t wrong_lan;    /* Frames whose trailer names the other LAN */
+  uint64_t no_rct;       /* Frames without a trailer, passed on */
+  uint64_t untracked;    /* Frames passed on unchecked as the table is full */
+} prp_table_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to append the redundancy control trailer to an encoded frame, 
+ * padding the frame first if it is shorter than the minimum. The buffer must 
+ * have room for PRP_MIN_FRAME_LEN bytes, or len + PRP_RCT_LEN bytes if more.
+ *
+ * @param frame	- pointer to the encoded frame
+ * @param len	- length of the encoded frame
+ * @param seq	- sequence number of the frame, the same on both LANs
+ * @param lan	- PRP_LAN_A or PRP_LAN_B
+ * @return size_t	- length of the frame with the trailer, else 0 if a 
+ * 			parameter is invalid
+ */
+size_t prp_append_rct(uint8_t *frame, size_t len, uint16_t seq, uint8_t lan);
+
+/**
+ * Function to change the LAN identifier in the trailer of a frame, so that 
+ * the frame sent on one LAN is reused for the other without encoding it again
+ *
+ * @param frame	- pointer to the frame with the trailer
+ * @param len	- length of the frame with the trailer
+ * @param lan	- PRP_LAN_A or PRP_LAN_B
+ */
+void prp_set_lan(uint8_t *frame, size_t len, uint8_t lan);
+
+/**
+ * Function to read the redundancy control trailer of a received frame. A 
+ * trailer is only recognised if the suffix and the LSDU size both match.
+ *
+ * @param packet	- pointer to the received frame
+ * @param caplen	- number of bytes captured
+ * @param seq	- pointer to hold the sequence number
+ * @param lan	- pointer to hold the LAN identifier
+ * @return int	- 0 if the frame has a trailer, else -1
+ */
+int prp_get_rct(const uint8_t *packet, size_t caplen, uint16_t *seq, 
+ uint8_t *lan);
+
+/**
+ * Function to initialise a duplicate table for up to the number of sources 
+ * specified. The slots are allocated once, with at least twice as many slots 
+ * as sources to keep the probe sequences short.
+ *
+ * @param table	- pointer to the table to initialise
+ * @param max_nodes	- maximum number of sources to track
+ * @return int	- 0 on success, else -1 if a parameter is invalid
+ */
+int prp_init(prp_table_t *table, size_t max_nodes);
+
+/**
+ * Function to release the slots of a duplicate table
+ *
+ * @param table	- pointer to the table to release
+ */
+void prp_free(prp_table_t *table);
+
+/**
+ * Function to check if a received frame is the first copy of its sequence 
+ * number from its source, recording it if so. The check is a hash of the 
+ * source MAC and a shift of the window, so it takes constant time.
+ *
+ * @param table	- pointer to the duplicate table
+ * @param packet	- pointer to the received frame
+ * @param caplen	- number of bytes captured
+ * @param lan	- LAN the frame was received on, PRP_LAN_A or PRP_LAN_B
+ * @param len	- pointer to hold the length of the frame without trailer
+ * @return prp_verdict_t	- PRP_DUPLICATE if the frame is to be dropped, 
+ * 			else PRP_ACCEPT or PRP_NO_RCT
+ */
+prp_verdict_t prp_discard(prp_table_t *table, const uint8_t *packet, 
+ size_t caplen, uint8_t lan, size_t *len);
+
+#endif /* _PRP_H_ */
@@ -33,16 +33,142 @@
 #define _PUBLISHER_H_
 
 #include "goose.h"
+#include "prp.h"
+#include "sv.h"
+#include "transport.h"
+#include "uring.h"
 #include <pcap.h>
 
 
 
 
 
+/** Times taken while publishing a frame on a schedule, on the monotonic 
+ * clock in ns
+ */
+typedef struct _publish_timing_t_ {
+  uint64_t deadline;   /* Time the frame was scheduled to be sent */
+  uint64_t encoded;    /* Time encoding, and signing, finished */
+  uint64_t sent;       /* Time the inject call returned */
+  uint64_t wire;       /* Time of the kernel transmit timestamp, 0 if none */
+} publish_timing_t;
+
+
+/** Kernel transmit timestamping state of a packet capture descriptor
+ */
+typedef struct _tx_stamp_t_ {
+  int fd;              /* Socket of the descriptor, -1 if not enabled */
+  int pending;         /* Non-zero if the stamp of a frame was not read */
+} tx_stamp_t;
+
+
 /*
  * Function prototypes
  */
 
 int publish( goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr );
 
+/**
+ * Function to publish a GOOSE frame as publish(), with t stamped from the 
+ * realtime clock as the frame is encoded. Only for a publisher that takes 
+ * every frame as a new state, i.e. that changes stNum with every frame, as 
+ * a subscriber rejects a t that changes within a state (See: IEC61850-7-2 
+ * 18.2.3.5).
+ *
+ * @param goose_frame_ptr	pointer to a GOOSE frame type struct
+ * @param pcap_ptr	pointer to packet capture descriptor
+ * @return int	-1 on error, else 0
+ */
+int publish_now( goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr );
+
+/**
+ * Function to enable software transmit timestamps on the socket of a packet 
+ * capture descriptor, so that publish_at() can record when the kernel passed 
+ * each frame to the driver. Only enable them on a descriptor used to 
+ * publish, a descriptor that is also read reports the queued timestamps as 
+ * an error.
+ *
+ * @param stamp	pointer to the timestamping state to initialise, the fd is 
+ * 		-1 if timestamps are unavailable
+ * @param pcap_ptr	pointer to packet capture descriptor
+ * @return int	-1 if timestamps are unavailable, else 0
+ */
+int tx_stamp_enable( tx_stamp_t *stamp, pcap_t *pcap_ptr );
+
+/**
+ * Function to publish a GOOSE frame scheduled for a deadline, recording when 
+ * the frame was encoded, when the inject call returned and, if transmit 
+ * timestamps are enabled, when the kernel sent it. As with publish() the 
+ * timestamp on the frame is not updated, the caller sets it when the state 
+ * changes, so that retransmissions carry the time of the event. The lateness 
+ * of the frame is added to the transmit jitter histograms of the stream.
+ *
+ * @param goose_frame_ptr	pointer to a GOOSE frame type struct
+ * @param pcap_ptr	pointer to packet capture descriptor
+ * @param deadline	monotonic time the frame is scheduled for in ns, 0 to 
+ * 		record nothing
+ * @param stamp	pointer to the timestamping state, NULL for none
+ * @param timing	pointer to the times to populate, may be NULL
+ * @return int	-1 on error, else 0
+ */
+int publish_at( goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr, 
+ uint64_t deadline, tx_stamp_t *stamp, publish_timing_t *timing );
+
+/**
+ * Function to publish a GOOSE frame through an io_uring transmit ring. The 
+ * frame is encoded, with the t set by the caller, directly into a 
+ * registered frame buffer and queued. The frame is not transmitted until the 
+ * caller submits the ring with uring_tx_submit(), which allows a publisher 
+ * tick to emit many frames with a single system call.
+ *
+ * @param goose_frame_ptr	pointer to a GOOSE frame type struct
+ * @param tx	pointer to the io_uring transmit ring
+ * @return int	-1 on error, else 0
+ */
+int publish_uring( goose_frame_t *goose_frame_ptr, uring_tx_t *tx );
+
+/**
+ * Function to publish the current samples of a sampled values frame to a 
+ * packet capture descriptor. The samples are patched into the frame 
+ * previously encoded by encode_sv_frame(), so nothing is encoded or copied 
+ * per sample.
+ *
+ * @param sv_frame_ptr	pointer to the sampled values frame holding the samples
+ * @param encoded_data	pointer to the frame encoded by encode_sv_frame()
+ * @param len	length of the encoded frame
+ * @param pcap_ptr	pointer to packet capture descriptor
+ * @return int	-1 on error, else 0
+ */
+int publish_sv( const sv_frame_t *sv_frame_ptr, uint8_t *encoded_data, 
+ uint16_t len, pcap_t *pcap_ptr );
+
+/**
+ * Function to publish a GOOSE frame on both LANs of a parallel redundancy 
+ * protocol (PRP) node. The frame is encoded once, the redundancy control 
+ * trailer appended, and the same buffer sent on LAN A and then, with the LAN 
+ * identifier changed, on LAN B.
+ *
+ * @param goose_frame_ptr	pointer to a GOOSE frame type struct
+ * @param lan_a	pointer to packet capture descriptor of LAN A
+ * @param lan_b	pointer to packet capture descriptor of LAN B
+ * @param seq	pointer to the sequence number of the node, which is 
+ * 		incremented for every frame the node sends
+ * @return int	-1 if the frame could not be sent on either LAN, else 0
+ */
+int publish_prp( goose_frame_t *goose_frame_ptr, pcap_t *lan_a, 
+ pcap_t *lan_b, uint16_t *seq );
+
+/**
+ * Function to publish a batch of GOOSE frames through a transport. Each 
+ * frame is encoded, with the t set by the caller, into a pool buffer and 
+ * the batch is sent with transport_send_batch().
+ *
+ * @param goose_frames	pointers to the GOOSE frames
+ * @param count	number of frames, at most TRANSPORT_BATCH_MAX
+ * @param tp	pointer to the transport
+ * @return int	number of frames sent, else -1 on error
+ */
+int publish_transport( goose_frame_t *const *goose_frames, int count, 
+ transport_t *tp );
+
 #endif /* _PUBLISHER_H_ */
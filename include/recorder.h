@@ -0,0 +1,165 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _RECORDER_H_
+#define _RECORDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Default size of a capture segment, allocated whole when it is opened
+ */
+#define RECORDER_SEG_SIZE (64UL << 20)
+
+/** Maximum length of the path prefix of the segments and of an interface 
+ * name, including the '\0'
+ */
+#define RECORDER_PATH_LEN 240
+#define RECORDER_IFACE_LEN 32
+
+/** Snapshot length recorded in the segments, every frame is kept whole
+ */
+#define RECORDER_SNAPLEN 65535
+
+/** pcapng block types and byte-order magic (See: draft-ietf-opsawg-pcapng)
+ */
+#define PCAPNG_SHB 0x0a0d0d0a
+#define PCAPNG_IDB 0x00000001
+#define PCAPNG_EPB 0x00000006
+#define PCAPNG_MAGIC 0x1a2b3c4d
+
+/** Bytes of an enhanced packet block ahead of the frame, and after it
+ */
+#define PCAPNG_EPB_HDR_LEN 28
+#define PCAPNG_EPB_TRAILER_LEN 4
+
+
+/** Flight recorder writing frames to a series of pcapng segments. Each 
+ * segment is allocated and mapped whole when it is opened, so a frame is 
+ * appended with a copy and no system call, and segments rotate by size or by 
+ * the time they cover. A worker thread opens the next segment ahead, and 
+ * closes, and indexes through on_close, the segments left behind, so that 
+ * a rotation only swaps mappings under a lock. A segment is cut to the 
+ * blocks written when it is closed; a segment left by a crash ends in zeros 
+ * after its last frame.
+ */
+typedef struct _recorder_t_ {
+  char prefix[RECORDER_PATH_LEN];   /* Segments are prefix-NNNNNN.pcapng */
+  char iface[RECORDER_IFACE_LEN];   /* Interface named in the segments */
+  size_t seg_size;                  /* Bytes allocated for each segment */
+  uint64_t seg_ns;                  /* Time a segment covers, 0 for no limit */
+  unsigned int keep;                /* Segments kept, 0 to keep them all */
+  unsigned int seq;                 /* Sequence number of the open segment */
+  int fd;                           /* Descriptor of the open segment */
+  uint8_t *map;                     /* Mapping of the open segment */
+  size_t used;                      /* Bytes written to the open segment */
+  uint64_t seg_start;               /* Time of the first frame, in ns */
+  uint64_t frames;                  /* Frames recorded */
+  uint64_t bytes;                   /* Bytes of the frames recorded */
+  uint64_t segments;                /* Segments opened */
+  uint64_t errors;                  /* Frames lost to a failed rotation */
+  void (*on_close)(void *user, const char *path);  /* Segment closed */
+  void *user;                       /* Argument passed to on_close */
+  void *worker;                     /* State of the worker, private to it */
+} recorder_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to start a recorder, open its first segment and start the worker 
+ * thread that opens the next. on_close is called on the worker thread.
+ *
+ * @param rec	- pointer to the recorder to initialise
+ * @param prefix	- path prefix of the segments
+ * @param iface	- name of the interface recorded, written to the segments
+ * @param seg_size	- bytes of each segment, 0 for RECORDER_SEG_SIZE
+ * @param seg_sec	- seconds a segment covers before rotating, 0 to 
+ * 		rotate by size only
+ * @param keep	- number of segments kept, besides the next one opened 
+ * 		ahead, the oldest is deleted with any index beside it once the 
+ * 		segment retired by a rotation is closed, 0 to keep every 
+ * 		segment
+ * @return int	- 0 on success, else -1
+ */
+int recorder_open(recorder_t *rec, const char *prefix, const char *iface, 
+ size_t seg_size, unsigned int seg_sec, unsigned int keep);
+
+/**
+ * Function to append a frame to the open segment as an enhanced packet 
+ * block, rotating first if the frame does not fit or the segment has covered 
+ * its time. Only a rotation makes system calls, to hand the segment over to 
+ * the worker, and only waits for it if the worker has fallen behind.
+ *
+ * @param rec	- pointer to the recorder
+ * @param frame	- pointer to the frame, from the destination MAC address
+ * @param caplen	- number of bytes captured
+ * @param len	- number of bytes of the frame on the wire
+ * @param ns	- receive time in ns since the epoch
+ * @return int	- 0 on success, else -1 if the frame could not be recorded
+ */
+int recorder_write(recorder_t *rec, const uint8_t *frame, uint32_t caplen, 
+ uint32_t len, uint64_t ns);
+
+/**
+ * Function to hand the open segment to the worker to close, and start the 
+ * next segment it opened ahead
+ *
+ * @param rec	- pointer to the recorder
+ * @return int	- 0 on success, else -1 if the next segment could not be 
+ * 		opened, when the open segment is kept and frames that do not fit 
+ * 		it are dropped until a rotation succeeds
+ */
+int recorder_rotate(recorder_t *rec);
+
+/**
+ * Function to stop the worker once it has closed the segments handed to it, 
+ * close the open segment, cutting it to the blocks written, and delete the 
+ * next segment opened ahead
+ *
+ * @param rec	- pointer to the recorder
+ */
+void recorder_close(recorder_t *rec);
+
+/**
+ * Function to return the path of a segment of a recorder
+ *
+ * @param rec	- pointer to the recorder
+ * @param seq	- sequence number of the segment
+ * @param path	- buffer to hold the path
+ * @param len	- size of the buffer
+ */
+void recorder_path(const recorder_t *rec, unsigned int seq, char *path, 
+ size_t len);
+
+#endif /* _RECORDER_H_ */
@@ -0,0 +1,177 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+#include "goose.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Number of frames tracked behind the newest frame of a stream, so frames 
+ * reordered by up to this many positions are still accepted once
+ */
+#define REPLAY_WINDOW 64
+
+
+/** Number of authenticated frames that follow on from each other, all 
+ * behind the window, after which a stream is resynchronised to them when 
+ * the local clock is not checked
+ */
+#define REPLAY_RESYNC_FRAMES 4
+
+
+/** Maximum length of a gocbRef, a VisibleString65 (See: IEC61850-8-1 Annex A)
+ */
+#define REPLAY_MAX_REF_LEN 65
+
+
+/** Value of max_skew_ms that disables the timestamp checks against the local 
+ * clock, for publishers that are not time synchronised
+ */
+#define REPLAY_NO_CLOCK -1
+
+
+/** Result of checking a frame against the replay window of its stream
+ */
+typedef enum _replay_verdict_t_ {
+  REPLAY_OK = 0,        /* Frame has not been accepted before */
+  REPLAY_DUPLICATE = 1, /* Frame is in the window and was already accepted */
+  REPLAY_TOO_OLD = 2,   /* Frame is behind the window, or of an older state */
+  REPLAY_STALE = 3,     /* Timestamp is inconsistent or older than TAL */
+  REPLAY_NO_STREAM = 4, /* Stream cannot be tracked, table full or bad key */
+  REPLAY_RESYNC = 5     /* Frame is behind the window, of a new state that 
+                         * may be a restart of the publisher */
+} replay_verdict_t;
+
+
+/** Replay state of one stream, i.e. one control block of one publisher. The 
+ * sequence of a frame is stNum in the upper and sqNum in the lower 32 bits, 
+ * so a state change moves the window past every frame of the old state.
+ */
+typedef struct _replay_stream_t_ {
+  uint8_t used;                         /* Non-zero if the slot is in use */
+  uint8_t ref_len;                      /* Number of bytes in ref */
+  uint16_t appid;                       /* APPID of the stream */
+  uint8_t ref[REPLAY_MAX_REF_LEN];      /* gocbRef of the stream */
+  uint64_t high;                        /* Sequence of the newest frame */
+  uint64_t window;                      /* Bit n set if high - n accepted */
+  uint8_t t[8];                         /* Timestamp of the current state */
+  uint64_t resync_seq;                  /* Sequence of the last frame behind */
+  uint8_t resync_t[8];                  /* Timestamp of the last frame behind */
+  uint32_t resync_frames;               /* Consecutive frames behind */
+  int64_t floor_ms;       /* Timestamp of the state left by a resync, in ms */
+} replay_stream_t;
+
+
+/** Table of replay state, open addressed on the APPID and gocbRef so that a 
+ * frame is checked in constant time without allocating
+ */
+typedef struct _replay_table_t_ {
+  replay_stream_t *streams;  /* Slots, a power of two */
+  size_t mask;               /* Number of slots less one */
+  size_t used;               /* Number of slots in use */
+  size_t max_streams;        /* Number of streams tracked before refusing */
+  int32_t max_skew_ms;       /* Permitted clock offset, or REPLAY_NO_CLOCK */
+} replay_table_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to initialise a replay table for up to the number of streams 
+ * specified. The slots are allocated once, with at least twice as many slots 
+ * as streams to keep the probe sequences short.
+ *
+ * @param table	- pointer to the table to initialise
+ * @param max_streams	- maximum number of streams to track
+ * @param max_skew_ms	- permitted offset between the publisher and local 
+ * 			clocks in ms, else REPLAY_NO_CLOCK to only check 
+ * 			timestamps against the state they belong to
+ * @return int	- 0 on success, else -1 if a parameter is invalid
+ */
+int replay_init(replay_table_t *table, size_t max_streams, 
+ int32_t max_skew_ms);
+
+/**
+ * Function to release the slots of a replay table
+ *
+ * @param table	- pointer to the table to release
+ */
+void replay_free(replay_table_t *table);
+
+/**
+ * Function to check if a decoded frame is new for its stream. The check does 
+ * not change the window, so a frame that then fails authentication cannot 
+ * advance it; call replay_update() once the frame is authenticated. Within a 
+ * state the timestamp must not change. When the local clock is checked, a 
+ * new state must be no older than its timeAllowedtoLive, and must not be 
+ * ahead, allowing for the permitted skew.
+ *
+ * A publisher that restarts starts again from stNum 1, far behind the 
+ * window. A frame behind the window, of another state than the current one, 
+ * is returned as REPLAY_RESYNC: when the local clock is checked its 
+ * timestamp is fresh, and the frame is accepted once authenticated. Without 
+ * the clock, replay_update() only accepts it once REPLAY_RESYNC_FRAMES such 
+ * frames follow on from each other. After a resync, a frame of a state no 
+ * newer than the one left behind is stale, so the frames from before the 
+ * restart cannot be replayed.
+ *
+ * @param table	- pointer to the replay table
+ * @param view	- pointer to the decoded frame
+ * @param stream	- pointer to hold the stream slot to update, NULL if the 
+ * 			stream is not tracked yet
+ * @return replay_verdict_t	- REPLAY_OK if the frame is new, else the 
+ * 				reason it is rejected
+ */
+replay_verdict_t replay_check(const replay_table_t *table, 
+ const goose_view_t *view, replay_stream_t **stream);
+
+/**
+ * Function to record an authenticated frame in the window of its stream, 
+ * adding the stream to the table if it is not tracked yet. A frame returned 
+ * as REPLAY_RESYNC restarts the window from it, unless the clock is not 
+ * checked and fewer than REPLAY_RESYNC_FRAMES frames behind the window have 
+ * followed on from each other, when it is only counted.
+ *
+ * @param table	- pointer to the replay table
+ * @param stream	- stream slot returned by replay_check(), or NULL
+ * @param view	- pointer to the decoded frame
+ * @return int	- 0 on success, 1 if the frame is counted towards a resync 
+ * 		but is to be rejected, else -1 if the stream could not be added
+ */
+int replay_update(replay_table_t *table, replay_stream_t *stream, 
+ const goose_view_t *view);
+
+#endif /* _REPLAY_H_ */
@@ -0,0 +1,185 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _SECURITY_H_
+#define _SECURITY_H_
+
+#include "gmac.h"
+#include "sha256.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Authentication algorithms for the protected checksum (See: IEC62351-6)
+ */
+typedef enum _sec_alg_t_ {
+  SEC_NONE = 0,        /* No authentication */
+  SEC_HMAC_SHA256 = 1, /* HMAC-SHA256, optionally truncated */
+  SEC_AES_GMAC = 2     /* AES-GMAC with a 128-bit tag */
+} sec_alg_t;
+
+
+/** Maximum number of bytes of authentication value carried in a frame
+ */
+#define SEC_MAX_VALUE_LEN 32
+
+
+/** Minimum HMAC-SHA256 truncation permitted, 80 bits (See: IEC62351-6)
+ */
+#define SEC_MIN_HMAC_LEN 10
+
+
+/** HMAC-SHA256 key schedule. The key XOR ipad and key XOR opad blocks are 
+ * hashed once when the key is set, so that authenticating a frame only 
+ * compresses the message blocks and one block for each of the inner and 
+ * outer hashes.
+ */
+typedef struct _hmac_sha256_key_t_ {
+  sha256_ctx_t inner; /* SHA-256 state after absorbing key XOR ipad */
+  sha256_ctx_t outer; /* SHA-256 state after absorbing key XOR opad */
+} hmac_sha256_key_t;
+
+
+/** AES-GMAC key schedule and IV state. Each signed frame carries its IV, a 
+ * random salt chosen when the key is set followed by a 64-bit invocation 
+ * counter which starts from a random value, so the IV never repeats for a 
+ * key within a publisher and only by chance between publishers or restarts.
+ */
+typedef struct _gmac_sec_key_t_ {
+  gmac_key_t key;      /* AES round keys and GHASH table */
+  uint8_t salt[4];     /* Fixed field of the IV */
+  uint64_t invocation; /* Invocation field of the IV */
+  uint64_t start;      /* Random first invocation field */
+} gmac_sec_key_t;
+
+
+/** Security context used to compute and check the protected checksum of a 
+ * GOOSE frame. The sign and verify hooks are selected by the algorithm when 
+ * the key is set.
+ */
+typedef struct _goose_sec_t_ goose_sec_t;
+struct _goose_sec_t_ {
+  uint8_t alg;       /* Authentication algorithm, see sec_alg_t */
+  uint8_t value_len; /* Bytes of authentication value carried in the frame */
+  uint8_t timed;     /* Non-zero to measure the duration of each signing */
+  uint8_t unprotected; /* Non-zero to accept frames with no checksum too */
+  uint64_t sign_ns;  /* Duration of the last signing in nanoseconds, if timed */
+
+  /* Compute the authentication value of a message */
+  int (*sign)(goose_sec_t *sec, const uint8_t *msg, size_t len, 
+   uint8_t *value);
+  /* Check the authentication value of a message, 0 if authentic */
+  int (*verify)(const goose_sec_t *sec, const uint8_t *msg, size_t len, 
+   const uint8_t *value);
+
+  union {
+    hmac_sha256_key_t hmac; /* HMAC-SHA256 key schedule */
+    gmac_sec_key_t gmac;    /* AES-GMAC key schedule */
+  } key;
+};
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to compare two buffers in time which depends only on the length, 
+ * and not on the position of the first differing byte, so that comparing 
+ * authentication values does not leak how much of a forgery was correct.
+ *
+ * @param first	- pointer to the first buffer
+ * @param second	- pointer to the second buffer
+ * @param len	- number of bytes to compare
+ * @return int	- 0 if the buffers are equal, else 1
+ */
+int const_time_memcmp(const void *first, const void *second, size_t len);
+
+/**
+ * Function to initialise the security context for HMAC-SHA256 with the 
+ * specified key. The padded key blocks are precomputed here, so the key may 
+ * be discarded by the caller afterwards.
+ *
+ * @param sec	- pointer to the security context to initialise
+ * @param key	- pointer to the key bytes
+ * @param key_len	- number of key bytes, keys longer than a block are hashed
+ * @param mac_len	- number of MAC bytes to carry in the frame, between 
+ * 		SEC_MIN_HMAC_LEN and SHA256_DIGEST_LEN, or 0 for the full MAC
+ * @return int	- 0 on success, else -1 if the parameters are invalid
+ */
+int sec_init_hmac_sha256(goose_sec_t *sec, const uint8_t *key, 
+ size_t key_len, uint8_t mac_len);
+
+/**
+ * Function to initialise the security context for AES-GMAC with the specified 
+ * AES-128 or AES-256 key. The authentication value carried in each frame is 
+ * the GMAC_IV_LEN byte IV followed by the GMAC_BLOCK_LEN byte tag. The AES 
+ * and GHASH implementations are selected by CPU feature detection the first 
+ * time a key is set. The first IV is drawn from /dev/urandom.
+ *
+ * @param sec	- pointer to the security context to initialise
+ * @param key	- pointer to the key bytes
+ * @param key_len	- number of key bytes, 16 or 32
+ * @return int	- 0 on success, else -1 if the parameters are invalid or 
+ * 		no random IV could be drawn
+ */
+int sec_init_aes_gmac(goose_sec_t *sec, const uint8_t *key, size_t key_len);
+
+/**
+ * Function to compute the full HMAC-SHA256 of a message using a precomputed 
+ * key schedule.
+ *
+ * @param key	- pointer to the precomputed key schedule
+ * @param msg	- pointer to the message bytes
+ * @param len	- number of message bytes
+ * @param mac	- pointer to the buffer to hold SHA256_DIGEST_LEN bytes
+ */
+void hmac_sha256(const hmac_sha256_key_t *key, const uint8_t *msg, 
+ size_t len, uint8_t *mac);
+
+/**
+ * Function to check SHA-256, HMAC-SHA256 and AES-GMAC against their published 
+ * known answers, so that a build whose hashing or AES is broken is caught 
+ * before it authenticates frames. AES-GMAC is checked with the implementation 
+ * selected by gmac_set_impl(). Each failure is reported on stderr.
+ *
+ * @return int	- 0 if every known answer matches, else -1
+ */
+int sec_self_test(void);
+
+/**
+ * Function to clear the key material from the security context
+ *
+ * @param sec	- pointer to the security context to clear
+ */
+void sec_clear(goose_sec_t *sec);
+
+#endif /* _SECURITY_H_ */
@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _SHA256_H_
+#define _SHA256_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Size of a SHA-256 message block in bytes
+ */
+#define SHA256_BLOCK_LEN 64
+
+
+/** Size of a SHA-256 digest in bytes
+ */
+#define SHA256_DIGEST_LEN 32
+
+
+/** SHA-256 hashing state (See: FIPS 180-4). The struct may be copied to fork 
+ * a partially hashed message, which is how HMAC reuses its padded key blocks.
+ */
+typedef struct _sha256_ctx_t_ {
+  uint32_t state[8];                /* Intermediate hash value */
+  uint64_t count;                   /* Number of message bytes hashed */
+  uint8_t buf[SHA256_BLOCK_LEN];    /* Partial message block */
+  size_t buf_len;                   /* Number of bytes in partial block */
+} sha256_ctx_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to initialise a SHA-256 hashing state
+ *
+ * @param ctx	- pointer to the hashing state to initialise
+ */
+void sha256_init(sha256_ctx_t *ctx);
+
+/**
+ * Function to add message bytes to a SHA-256 hashing state. Whole blocks are 
+ * compressed directly from the message without being copied.
+ *
+ * @param ctx	- pointer to the hashing state
+ * @param data	- pointer to the message bytes
+ * @param len	- number of message bytes
+ */
+void sha256_update(sha256_ctx_t *ctx, const uint8_t *data, size_t len);
+
+/**
+ * Function to pad the message, complete the SHA-256 hash and write the digest.
+ * The hashing state must be re-initialised before it is used again.
+ *
+ * @param ctx	- pointer to the hashing state
+ * @param digest	- pointer to the buffer to hold SHA256_DIGEST_LEN bytes
+ */
+void sha256_final(sha256_ctx_t *ctx, uint8_t *digest);
+
+/**
+ * Function to compute the SHA-256 digest of a message in one call
+ *
+ * @param data	- pointer to the message bytes
+ * @param len	- number of message bytes
+ * @param digest	- pointer to the buffer to hold SHA256_DIGEST_LEN bytes
+ */
+void sha256(const uint8_t *data, size_t len, uint8_t *digest);
+
+#endif /* _SHA256_H_ */
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+/** Summary of a distribution of latency samples
+ */
+typedef struct _percentiles_t_ {
+  size_t count;  /* Number of samples */
+  uint64_t min;  /* Smallest sample */
+  uint64_t p50;  /* Median */
+  uint64_t p90;  /* 90th percentile */
+  uint64_t p99;  /* 99th percentile */
+  uint64_t p999; /* 99.9th percentile */
+  uint64_t max;  /* Largest sample */
+  uint64_t mean; /* Arithmetic mean */
+} percentiles_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to compute the percentiles of a set of samples. The samples are 
+ * sorted in place, using the nearest-rank method.
+ *
+ * @param samples	- pointer to the samples, which are reordered
+ * @param count	- number of samples
+ * @param pct	- pointer to the summary to populate, all zero if count is 0
+ */
+void compute_percentiles(uint64_t *samples, size_t count, percentiles_t *pct);
+
+/**
+ * Function to print a percentile summary on one line, with the values 
+ * divided by the scale, e.g. 1000 to print nanosecond samples in 
+ * microseconds.
+ *
+ * @param stream	- stream to print to
+ * @param label	- label printed at the start of the line
+ * @param pct	- pointer to the summary to print
+ * @param scale	- divisor applied to each value, 0 is treated as 1
+ */
+void print_percentiles(FILE *stream, const char *label, 
+ const percentiles_t *pct, uint64_t scale);
+
+#endif /* _STATS_H_ */
@@ -32,13 +32,114 @@
 #ifndef _SUBSCRIBER_H_
 #define _SUBSCRIBER_H_
 
+#include "diff.h"
 #include "goose.h"
+#include "ids.h"
+#include "prp.h"
+#include "recorder.h"
+#include "replay.h"
+#include "sv.h"
+#include "transport.h"
 #include <pcap.h>
 
 
 
 
 
+/** Maximum number of ethertypes in a dispatch table
+ */
+#define DISPATCH_MAX_ENTRIES 8
+
+
+/** Maximum number of streams whose state a lazy decoder tracks, frames of 
+ * further streams are always decoded in full
+ */
+#define LAZY_MAX_STREAMS 64
+
+
+/** Handler of a received frame of one ethertype, passed the payload after any 
+ * 802.1Q tag so that the frame is only unwrapped once
+ */
+typedef void (*ether_handler_t)(void *user, const struct pcap_pkthdr *header, 
+ const u_char *packet, const uint8_t *payload);
+
+
+/** Entry of a dispatch table
+ */
+typedef struct _dispatch_entry_t_ {
+  uint16_t ethertype;       /* Ethertype, in host order */
+  ether_handler_t handler;  /* Handler of the frames */
+  void *user;               /* Argument passed to the handler */
+} dispatch_entry_t;
+
+
+/** Table of handlers by ethertype, so that GOOSE, sampled values and any 
+ * other protocol are received through one subscription
+ */
+typedef struct _dispatch_table_t_ {
+  dispatch_entry_t entry[DISPATCH_MAX_ENTRIES]; /* Registered handlers */
+  size_t count;                                 /* Number of handlers */
+  uint64_t unhandled;           /* Frames with no handler for the ethertype */
+} dispatch_table_t;
+
+
+/** State of one stream, i.e. one control block of one publisher, as last 
+ * decoded in full by a lazy decoder
+ */
+typedef struct _lazy_stream_t_ {
+  uint16_t appid;                       /* APPID of the stream */
+  uint8_t ref_len;                      /* Number of bytes in ref */
+  uint8_t ref[REPLAY_MAX_REF_LEN];      /* gocbRef of the stream */
+  uint32_t stNum;                       /* stNum of the state */
+} lazy_stream_t;
+
+
+/** Recorder stage of a dispatch table, which records each frame of its 
+ * ethertype and passes it on
+ */
+typedef struct _record_stage_t_ {
+  recorder_t *rec;          /* Recorder of the frames */
+  uint32_t ts_scale;        /* ns per unit of ts.tv_usec, 1000, or 1 for a 
+                               capture opened with nanosecond precision */
+  ether_handler_t next;     /* Handler of the frames recorded, or NULL */
+  void *user;               /* Argument passed to next */
+} record_stage_t;
+
+
+/** Intrusion detection stage of a dispatch table, which checks each frame of 
+ * its ethertype and passes it on
+ */
+typedef struct _ids_stage_t_ {
+  ids_t *ids;               /* Intrusion detection engine */
+  uint32_t ts_scale;        /* ns per unit of ts.tv_usec, as record_stage_t */
+  ether_handler_t next;     /* Handler of the frames checked, or NULL */
+  void *user;               /* Argument passed to next */
+} ids_stage_t;
+
+
+/** Handler of a state change seen by a lazy decoder, passed the complete 
+ * view and the mask of the dataset entries that changed, see diff_update(). 
+ * The mask is NULL if the decoder keeps no previous states, or the dataset 
+ * could not be compared, when every entry is to be taken as changed.
+ */
+typedef void (*goose_change_t)(void *user, const goose_view_t *view, 
+ const uint64_t *changed, size_t count);
+
+
+/** Streams of a lazy decoder, see goose_decode_lazy(). Zero it before the 
+ * first frame, then set the optional members.
+ */
+typedef struct _goose_lazy_t_ {
+  lazy_stream_t stream[LAZY_MAX_STREAMS];   /* Streams seen */
+  size_t count;                             /* Number of streams */
+  uint64_t frames;                          /* Frames decoded */
+  uint64_t changes;                         /* Frames decoded in full */
+  diff_state_t *diff;       /* LAZY_MAX_STREAMS zeroed states, or NULL */
+  goose_change_t on_change; /* Handler of state changes, or NULL */
+  void *user;               /* Argument passed to on_change */
+} goose_lazy_t;
+
+
 /*
  * Function prototypes
  */
@@ -46,8 +147,10 @@
 
 /**
  * Simple GOOSE packet handler callback function. If the packet is a GOOSE frame 
- * and is for the subscribed hardware MAC address then the GOOSE is printed to 
- * stdout in human-readable format
+ * and is for the subscribed hardware MAC address then the GOOSE is logged as 
+ * LOG_LEVEL_INFO records, which the log writer prints in human-readable 
+ * format, so logging must be started with log_start(). The dataset is only 
+ * decoded and logged when stNum changes, see goose_decode_lazy().
  *
  * @param arg	- pointer to bytes containing arguments to the packet handler
  * @param header	- pointer to the packet capture header
@@ -56,6 +159,54 @@
 void goose_handler_print(u_char *args, const struct pcap_pkthdr *header, 
  const u_char *packet); 
 
+/**
+ * Function to decode a received GOOSE frame in two stages. The first stage, 
+ * decode_goose_header(), finds the stream and its stNum, and only a frame of 
+ * a new state, or of a stream not seen before, is decoded in full. 
+ * Retransmissions of an unchanged state then cost the same whatever the size 
+ * of the dataset. The application may still complete the view of any frame 
+ * with decode_goose_body(). On a state change the on_change handler, if 
+ * set, is passed the entries that changed, compared against the state kept 
+ * for the stream in diff, so it need only process those.
+ *
+ * @param lazy	- pointer to the streams of the decoder
+ * @param packet	- pointer to the received frame
+ * @param caplen	- number of bytes captured
+ * @param view	- pointer to the view to populate
+ * @returns int	- 1 if the frame changes the state of its stream and the 
+ * 		view is complete, 0 if the state is unchanged and only the first 
+ * 		stage is decoded, else -1 if the frame is malformed
+ */
+int goose_decode_lazy(goose_lazy_t *lazy, const uint8_t *packet, 
+ size_t caplen, goose_view_t *view);
+
+/**
+ * Function to authenticate a received GOOSE frame. If the protected flag is 
+ * set in the Reserved 1 field then the frame is checked against the replay 
+ * window of its stream, which is cheap, before the protected checksum 
+ * extension is verified against the security context in constant time. Only 
+ * frames that are authenticated advance the replay window. A subscriber with 
+ * a security context rejects frames without the protected flag, as clearing 
+ * it would otherwise bypass the check, unless the context accepts unprotected 
+ * frames for a deployment with publishers of both kinds.
+ *
+ * @param sec	- pointer to the security context, may be NULL if the 
+ * 		subscriber has no key
+ * @param replay	- pointer to the replay table, may be NULL to skip the 
+ * 		replay check
+ * @param packet	- pointer to bytes containing the actual frame
+ * @param caplen	- number of bytes captured
+ * @returns int	- 0 if the frame is protected and the checksum is correct, 
+ * 		1 if the frame is not protected and that is accepted, -1 if the 
+ * 		checksum is not correct or the frame is malformed, -2 if the 
+ * 		frame is protected but no security context is specified, or is 
+ * 		not protected but the security context requires it, -3 if the 
+ * 		frame is a replay or is not fresh, or only counts towards 
+ * 		resynchronising a restarted publisher, see replay_check()
+ */
+int authenticate_goose_frame(const goose_sec_t *sec, replay_table_t *replay, 
+ const u_char *packet, size_t caplen);
+
 /**
  * Function to subscribe to the hardware MAC address on a packet capture 
  * descriptor and pass on the read frame to a GOOSE message handler for a 
@@ -70,4 +221,120 @@ void goose_handler_print(u_char *args, const struct pcap_pkthdr *header,
 int subscribe(uint8_t *mac_ptr, pcap_t *pcap_ptr, int count, 
  pcap_handler goose_handler);
 
+/**
+ * Function to register the handler of an ethertype in a dispatch table, 
+ * replacing any handler already registered for it
+ *
+ * @param table	- pointer to the dispatch table
+ * @param ethertype	- ethertype in host order, e.g. ETHER_GOOSE
+ * @param handler	- handler of the frames
+ * @param user	- argument passed to the handler
+ * @returns int	- 0 on success, else -1 if the table is full
+ */
+int dispatch_register(dispatch_table_t *table, uint16_t ethertype, 
+ ether_handler_t handler, void *user);
+
+/**
+ * Packet handler callback function to pass a frame to the handler 
+ * registered for its ethertype
+ *
+ * @param args	- pointer to the dispatch table
+ * @param header	- pointer to the packet capture header
+ * @param packet	- pointer to bytes containing the actual frame
+ */
+void dispatch_frame(u_char *args, const struct pcap_pkthdr *header, 
+ const u_char *packet);
+
+/**
+ * Dispatch table handler to print GOOSE frames, see goose_handler_print()
+ */
+void goose_dispatch_print(void *user, const struct pcap_pkthdr *header, 
+ const u_char *packet, const uint8_t *payload);
+
+/**
+ * Dispatch table handler to record frames with a flight recorder, then pass 
+ * them to the next handler of the stage, e.g. goose_dispatch_print() for the 
+ * live decoder
+ *
+ * @param user	- pointer to the record_stage_t
+ */
+void record_dispatch(void *user, const struct pcap_pkthdr *header, 
+ const u_char *packet, const uint8_t *payload);
+
+/**
+ * Dispatch table handler to check frames with an intrusion detection engine, 
+ * see ids_check(), then pass them to the next handler of the stage, whatever 
+ * the alerts raised
+ *
+ * @param user	- pointer to the ids_stage_t
+ */
+void ids_dispatch(void *user, const struct pcap_pkthdr *header, 
+ const u_char *packet, const uint8_t *payload);
+
+/**
+ * Function to install a kernel BPF filter on a capture passing only GOOSE 
+ * frames, tagged or untagged, so other traffic is never copied to the 
+ * subscriber
+ *
+ * @param pcap_ptr	- pointer to packet capture descriptor
+ * @returns int	- 0 on success, else -1
+ */
+int goose_filter(pcap_t *pcap_ptr);
+
+/**
+ * Dispatch table handler to decode sampled values frames into the streams of 
+ * a subscriber, see decode_sv_frame()
+ *
+ * @param user	- pointer to the sampled values subscriber
+ */
+void sv_dispatch_decode(void *user, const struct pcap_pkthdr *header, 
+ const u_char *packet, const uint8_t *payload);
+
+/**
+ * Function to read frames from a packet capture descriptor and pass them to 
+ * the handlers of a dispatch table, for a specific number of frames, or 
+ * indefinitely if the count is 0
+ *
+ * @param pcap_ptr	pointer to packet capture descriptor
+ * @param count	number of frames to process, or forever if 0
+ * @param table	pointer to the dispatch table
+ * @returns int -1 on error, -2 if the break callback is invoked, else 0 
+ */
+int subscribe_dispatch(pcap_t *pcap_ptr, int count, dispatch_table_t *table);
+
+/**
+ * Function to read frames from the two LANs of a parallel redundancy protocol 
+ * (PRP) node and pass the first copy of each frame, without its redundancy 
+ * control trailer, to the handler. Both transports are polled from the 
+ * calling thread, so the duplicate table is never shared between threads. 
+ * Frames without a trailer are passed on as they are. Each transport is 
+ * received from with no wait, so a packet capture descriptor attached with 
+ * transport_pcap_attach() is to be non-blocking.
+ *
+ * @param lan_a	pointer to the transport of LAN A
+ * @param lan_b	pointer to the transport of LAN B
+ * @param count	number of frames to pass on, or forever if 0
+ * @param table	pointer to the duplicate table
+ * @param handler	handler of the frames passed on
+ * @param user	argument passed to the handler
+ * @returns int -1 on error, -2 if transport_break() is called on either 
+ * 		transport, else 0
+ */
+int subscribe_prp(transport_t *lan_a, transport_t *lan_b, int count, 
+ prp_table_t *table, pcap_handler handler, u_char *user);
+
+/**
+ * Function to receive frames from a transport and pass each to the handlers 
+ * of a dispatch table, for a specific number of frames, or until no frame 
+ * arrives within the timeout or transport_break() is called.
+ *
+ * @param tp	pointer to the transport
+ * @param count	number of frames to handle, 0 for no limit
+ * @param timeout_ms	time to wait for each batch of frames, -1 for no limit
+ * @param table	pointer to the dispatch table
+ * @return int	number of frames handled, else -1 on error
+ */
+int subscribe_transport(transport_t *tp, int count, int timeout_ms, 
+ dispatch_table_t *table);
+
 #endif /* _SUBSCRIBER_H_ */
@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _SV_H_
+#define _SV_H_
+
+#include "goose.h"
+
+#include <net/ethernet.h>
+#include <stdint.h>
+
+
+/** savPdu preamble (See: IEC61850-9-2 Clause 8)
+ */
+static const uint8_t SV_PREAMBLE=0x60;
+
+/** Number of channels in an ASDU, currents IA, IB, IC, IN followed by voltages 
+ * UA, UB, UC, UN (See: IEC61850-9-2LE)
+ */
+#define SV_NUM_CHANNELS 8
+
+/** Number of bytes of seqData, a 32-bit value and 32-bit quality per channel
+ */
+#define SV_SEQDATA_LEN (SV_NUM_CHANNELS * 8)
+
+/** Maximum number of ASDUs carried in one frame
+ */
+#define SV_MAX_ASDU 8
+
+/** Quality flag indicating that a sample is not valid (See: IEC61850-7-3)
+ */
+static const uint32_t SV_QUALITY_INVALID=0x00000001;
+
+/** Quality flag indicating that a sample is from a test source
+ */
+static const uint32_t SV_QUALITY_TEST=0x00000800;
+
+
+/** Maximum length of an svID, a VisibleString129 (See: IEC61850-9-2)
+ */
+#define SV_MAX_ID_LEN 129
+
+/** Number of samples kept per channel by a subscribed stream, a power of two
+ */
+#define SV_RING_LEN 4096
+
+
+/** Sampled values Application Service Data Unit (ASDU), the part of the frame 
+ * which changes with every sample
+ */
+typedef struct _sv_asdu_t_ {
+  uint16_t smpCnt;                     /* smpCnt, wraps at the sample rate */
+  uint8_t smpSynch;                    /* smpSynch, 0 if not synchronised */
+  int32_t value[SV_NUM_CHANNELS];      /* Channel values, scaled integers */
+  uint32_t quality[SV_NUM_CHANNELS];   /* Channel quality */
+} sv_asdu_t;
+
+
+/** Sampled values Ethernet Frame
+ */
+typedef struct _sv_frame_t_ {
+  struct ether_header eth_hdr;          /* Ethernet header */
+  vlan_tag_t vlan;                      /* 802.1Q tag (optional) */
+  goose_header_t sv_header;             /* Header, the same layout as GOOSE */
+  uint8_t *svID;                        /* svID */
+  uint8_t *datSet;                      /* datSet (optional), else NULL */
+  uint32_t confRev;                     /* confRev */
+  uint16_t smpRate;                     /* smpRate (optional), else 0 */
+  uint8_t noASDU;                       /* Number of ASDUs in the frame */
+  sv_asdu_t asdu[SV_MAX_ASDU];          /* ASDUs */
+  uint16_t smpCnt_offset[SV_MAX_ASDU];  /* Offsets set by encode_sv_frame */
+  uint16_t data_offset[SV_MAX_ASDU];    /* Offsets set by encode_sv_frame */
+} sv_frame_t;
+
+
+/** Implementations of the sample extraction in the subscriber
+ */
+typedef enum _sv_impl_t_ {
+  SV_IMPL_AUTO = 0,   /* Fastest supported by the CPU */
+  SV_IMPL_SCALAR = 1, /* Portable */
+  SV_IMPL_SSE4 = 2,   /* SSSE3 byte shuffle and SSE4.1 */
+  SV_IMPL_AVX2 = 3    /* AVX2 byte shuffle and permute */
+} sv_impl_t;
+
+
+/** Subscribed sampled values stream. The samples are kept as structure of 
+ * arrays, one ring per channel, so that analytics run over contiguous 
+ * samples of a channel. Sample n of the stream is at index n & 
+ * (SV_RING_LEN - 1) of every ring.
+ */
+typedef struct _sv_stream_t_ {
+  _Alignas(32) int32_t value[SV_NUM_CHANNELS][SV_RING_LEN];    /* Values */
+  _Alignas(32) uint32_t quality[SV_NUM_CHANNELS][SV_RING_LEN]; /* Quality */
+  uint16_t smpCnt[SV_RING_LEN];       /* smpCnt of each sample */
+  uint64_t samples;                   /* Number of samples received */
+  uint64_t gaps;                      /* Number of breaks in smpCnt */
+  uint64_t missing;                   /* Number of samples missed in gaps */
+  uint64_t stale;                     /* Repeated or reordered samples */
+  uint32_t wrap;                      /* smpCnt wraps at, e.g. the rate */
+  uint16_t appid;                     /* APPID of the stream */
+  uint16_t last_smpCnt;               /* smpCnt of the newest sample */
+  uint8_t channels;                   /* Number of channels in seqData */
+  uint8_t svIDLen;                    /* Number of bytes in svID */
+  uint8_t svID[SV_MAX_ID_LEN];        /* svID of the stream */
+} sv_stream_t;
+
+
+/** Sampled values subscriber, the streams being decoded
+ */
+typedef struct _sv_sub_t_ {
+  sv_stream_t *streams;   /* Streams, in the order first seen */
+  size_t count;           /* Number of streams */
+  size_t max_streams;     /* Number of streams allocated */
+  uint32_t wrap;          /* smpCnt wraps at for new streams */
+  uint64_t frames;        /* Number of frames decoded */
+  uint64_t malformed;     /* Number of frames that could not be decoded */
+  uint64_t dropped;       /* ASDUs of streams beyond max_streams */
+} sv_sub_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/** Function to encode the sampled values frame into the encoded_data buffer 
+ * and populate the encoded_length variable with the number of bytes in the 
+ * populated buffer. The offsets of smpCnt and seqData of each ASDU are 
+ * recorded in the frame, so that subsequent samples can be patched into the 
+ * encoded buffer without encoding the frame again. If the frame or buffer are 
+ * NULL, or the frame does not fit, then the encoded length is reset to 0.
+ *
+ * @param sv_frame	- pointer to the sampled values frame to be encoded
+ * @param encoded_data	- pointer to the buffer to store the encoded bytes
+ * @param encoded_len	- pointer to memory to hold the length of the encoded 
+ * 			bytes
+ */
+void encode_sv_frame(sv_frame_t *sv_frame, uint8_t *encoded_data, 
+  uint16_t *encoded_len);
+
+/**
+ * Function to patch smpCnt, smpSynch and seqData of every ASDU into a frame 
+ * previously encoded by encode_sv_frame. Nothing else in the frame changes 
+ * between samples, so the lengths and the rest of the frame stay valid.
+ *
+ * @param sv_frame	- pointer to the sampled values frame holding the samples
+ * @param encoded_data	- pointer to the encoded frame to update
+ */
+void patch_sv_frame(const sv_frame_t *sv_frame, uint8_t *encoded_data);
+
+/**
+ * Function to select the implementation used to extract samples, for 
+ * comparing implementations. The fastest the CPU supports is used unless 
+ * this is called.
+ *
+ * @param impl	- implementation to use
+ * @return int	- 0 on success, else -1 if the CPU does not support it
+ */
+int sv_set_impl(sv_impl_t impl);
+
+/**
+ * Function to return the name of the selected sample extraction
+ *
+ * @return const char *	- "avx2", "sse4" or "scalar"
+ */
+const char *sv_impl_name(void);
+
+/**
+ * Function to initialise a sampled values subscriber for up to the number of 
+ * streams specified. The streams are allocated once.
+ *
+ * @param sub	- pointer to the subscriber to initialise
+ * @param max_streams	- maximum number of streams to decode
+ * @param wrap	- value at which smpCnt wraps to 0, the sample rate for 
+ * 		IEC61850-9-2LE, or 0 for the full 16-bit range
+ * @return int	- 0 on success, else -1 if a parameter is invalid
+ */
+int sv_sub_init(sv_sub_t *sub, size_t max_streams, uint32_t wrap);
+
+/**
+ * Function to release the streams of a sampled values subscriber
+ *
+ * @param sub	- pointer to the subscriber to release
+ */
+void sv_sub_free(sv_sub_t *sub);
+
+/**
+ * Function to decode a received sampled values frame. Each ASDU is matched 
+ * to its stream by APPID and svID, adding the stream if it is new, checked 
+ * for a break in smpCnt, and its values and quality are byte swapped into 
+ * the channel rings of the stream.
+ *
+ * @param packet	- pointer to the received frame
+ * @param caplen	- number of bytes captured
+ * @param sub	- pointer to the subscriber
+ * @return int	- number of ASDUs decoded, else -1 if the frame is malformed
+ */
+int decode_sv_frame(const uint8_t *packet, size_t caplen, sv_sub_t *sub);
+
+#endif /* _SV_H_ */
@@ -0,0 +1,217 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _TRANSPORT_H_
+#define _TRANSPORT_H_
+
+#include <pcap.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+
+/** Maximum number of frames sent or received in one batch
+ */
+#define TRANSPORT_BATCH_MAX 64
+
+/** Number of frames a loopback transport holds before it drops, a power of 2
+ */
+#define TRANSPORT_LOOP_LEN 1024
+
+
+/** Frame received by a transport. The data belongs to the transport and is 
+ * valid until the next call to receive on it.
+ */
+typedef struct _transport_frame_t_ {
+  const uint8_t *data;      /* Frame, from the destination MAC address */
+  uint32_t len;             /* Number of bytes in the frame */
+  uint64_t ns;              /* Monotonic time the batch was received */
+  struct timeval ts;        /* Capture time, else the time of the batch */
+} transport_frame_t;
+
+
+typedef struct _transport_t_ transport_t;
+
+
+/** Operations of a transport. Each operation returns -1 on error, the batch 
+ * operations otherwise return the number of frames sent or received.
+ */
+typedef struct _transport_ops_t_ {
+  const char *name;                          /* Name of the transport */
+  int (*open)(transport_t *tp, const char *iface);
+  int (*send)(transport_t *tp, const uint8_t *frame, size_t len);
+  int (*send_batch)(transport_t *tp, uint8_t *const *frames, 
+   const size_t *lens, int count);
+  int (*recv_batch)(transport_t *tp, transport_frame_t *frames, int max, 
+   int timeout_ms);
+  int (*drops)(transport_t *tp, uint64_t *drops);
+  int (*fd)(transport_t *tp);
+  void (*close)(transport_t *tp);
+} transport_ops_t;
+
+
+/** Open transport, the state of the implementation is private to it
+ */
+struct _transport_t_ {
+  const transport_ops_t *ops;   /* Operations of the transport */
+  void *impl;                   /* State of the implementation */
+  int stop;                     /* Non-zero once transport_break() is called */
+};
+
+
+/** Transports, libpcap, a raw AF_PACKET socket, and an in-process lock-free 
+ * ring that needs no privileges or interface. Loopback transports opened 
+ * with the same name share a ring, each frame sent by one is received by 
+ * one receive call, with one thread sending and one receiving.
+ */
+extern const transport_ops_t TRANSPORT_PCAP;
+extern const transport_ops_t TRANSPORT_PACKET;
+extern const transport_ops_t TRANSPORT_LOOPBACK;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to wrap a packet capture descriptor opened by the caller, live or 
+ * from a capture file, in a transport. Frames are received one at a time, 
+ * without a copy, and keep their capture time. A receive waits up to the 
+ * read timeout of the descriptor, or for a frame if timeout_ms is -1. The 
+ * end of a capture file, or pcap_breakloop() on the descriptor, acts as 
+ * transport_break(). Closing the transport leaves the descriptor open. 
+ * Nothing is allocated, so a descriptor may be wrapped for each frame sent.
+ *
+ * @param tp	- pointer to the transport to initialise
+ * @param pcap_ptr	- pointer to the packet capture descriptor
+ * @return int	- 0 on success, else -1
+ */
+int transport_pcap_attach(transport_t *tp, pcap_t *pcap_ptr);
+
+/**
+ * Function to find a transport by name, "pcap", "packet" or "loopback"
+ *
+ * @param name	- name of the transport
+ * @return const transport_ops_t *	- pointer to the transport, else NULL
+ */
+const transport_ops_t *transport_find(const char *name);
+
+/**
+ * Function to open a transport on a network interface, or on a named ring 
+ * for the loopback transport. Receiving transports see only frames arriving 
+ * at the interface, not the frames sent from it.
+ *
+ * @param tp	- pointer to the transport to initialise
+ * @param ops	- pointer to the operations of the transport
+ * @param iface	- name of the interface, or of the loopback ring
+ * @return int	- 0 on success, else -1
+ */
+int transport_open(transport_t *tp, const transport_ops_t *ops, 
+ const char *iface);
+
+/**
+ * Function to send a frame
+ *
+ * @param tp	- pointer to the transport
+ * @param frame	- pointer to the frame
+ * @param len	- number of bytes in the frame
+ * @return int	- 0 on success, else -1, e.g. when a loopback ring is full
+ */
+int transport_send(transport_t *tp, const uint8_t *frame, size_t len);
+
+/**
+ * Function to send a batch of frames, with one system call where the 
+ * transport allows
+ *
+ * @param tp	- pointer to the transport
+ * @param frames	- pointers to the frames
+ * @param lens	- number of bytes in each frame
+ * @param count	- number of frames, at most TRANSPORT_BATCH_MAX
+ * @return int	- number of frames sent, else -1 if none could be
+ */
+int transport_send_batch(transport_t *tp, uint8_t *const *frames, 
+ const size_t *lens, int count);
+
+/**
+ * Function to receive a batch of frames, waiting up to a timeout for the 
+ * first. The frames of the previous call are released.
+ *
+ * @param tp	- pointer to the transport
+ * @param frames	- array of frames to populate
+ * @param max	- number of frames in the array, at most TRANSPORT_BATCH_MAX
+ * @param timeout_ms	- time to wait for a frame, 0 to return at once and 
+ * 		-1 to wait until a frame arrives or transport_break() is called
+ * @return int	- number of frames received, 0 on a timeout or a break, 
+ * 		else -1
+ */
+int transport_recv_batch(transport_t *tp, transport_frame_t *frames, int max, 
+ int timeout_ms);
+
+/**
+ * Function to return the number of frames dropped before they could be 
+ * received since the transport was opened, as counted by the kernel, or by 
+ * the ring of a loopback transport
+ *
+ * @param tp	- pointer to the transport
+ * @param drops	- pointer to the count to set
+ * @return int	- 0 on success, else -1
+ */
+int transport_drops(transport_t *tp, uint64_t *drops);
+
+/**
+ * Function to return a descriptor to poll for frames to receive, so that 
+ * one thread can wait on several transports. A descriptor that polls 
+ * readable may still yield no frames, and one that does not may still have 
+ * frames already read by the transport, so receive until none are returned 
+ * before polling again.
+ *
+ * @param tp	- pointer to the transport
+ * @return int	- descriptor, else -1 if the transport has none, i.e. the 
+ * 		loopback ring, which is then read without waiting
+ */
+int transport_fd(transport_t *tp);
+
+/**
+ * Function to make every later receive on the transport, and any receive 
+ * waiting on it, return 0. It may be called from any thread or a signal 
+ * handler.
+ *
+ * @param tp	- pointer to the transport
+ */
+void transport_break(transport_t *tp);
+
+/**
+ * Function to close a transport, releasing the frames of the last receive
+ *
+ * @param tp	- pointer to the transport
+ */
+void transport_close(transport_t *tp);
+
+#endif /* _TRANSPORT_H_ */
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _URING_H_
+#define _URING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+/** Default number of submission queue entries, and therefore registered frame 
+ * buffers, used by an io_uring transmit ring
+ */
+#define URING_DEFAULT_DEPTH 256
+
+
+/** Size of each registered frame buffer slot, MAX_FRAME_SIZE rounded up to a 
+ * multiple of the cache-line size
+ */
+#define URING_SLOT_SIZE 1536
+
+
+/** Opaque io_uring transmit ring bound to a network interface
+ */
+typedef struct _uring_tx_t_ uring_tx_t;
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to open an io_uring transmit ring on the named network interface. 
+ * A raw packet socket is bound to the interface and a pool of frame buffers is 
+ * registered with the kernel so that frames are transmitted with 
+ * IORING_OP_WRITE_FIXED without per-frame page pinning. If io_uring is not 
+ * available then NULL is returned.
+ *
+ * @param iface	- name of the network interface to transmit on
+ * @param depth	- number of submission queue entries and frame buffers, or 0 
+ * 		for URING_DEFAULT_DEPTH
+ * @return uring_tx_t *	- pointer to the transmit ring, else NULL on error
+ */
+uring_tx_t *uring_tx_open(const char *iface, unsigned int depth);
+
+/**
+ * Function to take a free registered frame buffer from the transmit ring 
+ * frame pool. If the pool is exhausted then the queued frames are submitted 
+ * and the function blocks until at least one completion returns a buffer.
+ *
+ * @param tx	- pointer to the transmit ring
+ * @return uint8_t *	- pointer to a URING_SLOT_SIZE byte frame buffer, else 
+ * 			NULL on error
+ */
+uint8_t *uring_tx_frame(uring_tx_t *tx);
+
+/**
+ * Function to queue a frame buffer previously returned by uring_tx_frame() for 
+ * transmission. The frame is not handed to the kernel until uring_tx_submit() 
+ * is called, so any number of frames up to the ring depth may be batched.
+ *
+ * @param tx	- pointer to the transmit ring
+ * @param frame	- pointer to the frame buffer holding the encoded frame
+ * @param len	- number of bytes in the encoded frame
+ * @return int	- 0 if the frame is queued, else -1
+ */
+int uring_tx_queue(uring_tx_t *tx, uint8_t *frame, uint16_t len);
+
+/**
+ * Function to return a frame buffer previously returned by uring_tx_frame() 
+ * to the frame pool without transmitting it.
+ *
+ * @param tx	- pointer to the transmit ring
+ * @param frame	- pointer to the unused frame buffer
+ */
+void uring_tx_release(uring_tx_t *tx, uint8_t *frame);
+
+/**
+ * Function to submit all queued frames with a single io_uring_enter and reap 
+ * any completions that are ready, returning their buffers to the pool. If wait 
+ * is non-zero then the call blocks until all frames in flight have completed.
+ *
+ * @param tx	- pointer to the transmit ring
+ * @param wait	- non-zero to wait for all outstanding completions
+ * @return int	- number of frames submitted, else -1 on error
+ */
+int uring_tx_submit(uring_tx_t *tx, int wait);
+
+/**
+ * Function to return the number of frames which completed with an error since 
+ * the transmit ring was opened.
+ *
+ * @param tx	- pointer to the transmit ring
+ * @return uint64_t	- count of failed transmissions
+ */
+uint64_t uring_tx_errors(const uring_tx_t *tx);
+
+/**
+ * Function to wait for all frames in flight, unregister the frame pool and 
+ * close the transmit ring. The pointer must not be used after this call.
+ *
+ * @param tx	- pointer to the transmit ring
+ */
+void uring_tx_close(uring_tx_t *tx);
+
+#endif /* _URING_H_ */
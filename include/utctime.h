@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+#ifndef _UTCTIME_H_
+#define _UTCTIME_H_
+
+#include <stdint.h>
+#include <time.h>
+
+
+/** Number of octets in an encoded UtcTime, the seconds since the epoch 
+ * (SOC), a 24-bit binary fraction of second (FRACSEC) and the time quality, 
+ * all big-endian (See: IEC61850-8-1 p.28)
+ */
+#define UTC_TIME_LEN 8
+
+
+/*
+ * Function Prototypes
+ */
+
+/**
+ * Function to encode a time in ns since the epoch, e.g. from 
+ * clock_gettime(CLOCK_REALTIME), as a UtcTime. The fraction of second is 
+ * rounded down to the 2^-24 s (59.6 ns) resolution. Only multiplies and 
+ * shifts are used, so the encoding is as fast on 32-bit targets.
+ *
+ * @param ns	- time in ns since 1970-01-01 00:00:00 UTC
+ * @param quality	- time quality octet, e.g. TIME_ACCURACY_UNSPECIFIED
+ * @param addr	- pointer to the UTC_TIME_LEN octets to write
+ */
+void utc_time_encode(uint64_t ns, uint8_t quality, uint8_t *addr);
+
+/**
+ * Function to encode a time split into seconds and nanoseconds as a UtcTime, 
+ * see utc_time_encode()
+ *
+ * @param ts	- pointer to the time since the epoch
+ * @param quality	- time quality octet
+ * @param addr	- pointer to the UTC_TIME_LEN octets to write
+ */
+void utc_time_encode_ts(const struct timespec *ts, uint8_t quality, 
+ uint8_t *addr);
+
+/**
+ * Function to stamp the current time, from CLOCK_REALTIME, as a UtcTime 
+ * straight into an encoded frame
+ *
+ * @param quality	- time quality octet
+ * @param addr	- pointer to the UTC_TIME_LEN octets to write
+ */
+void utc_time_now(uint8_t quality, uint8_t *addr);
+
+/**
+ * Function to decode a UtcTime into ns since the epoch. The result is the 
+ * earliest time that encodes to the same fraction of second, so that 
+ * decoding and then encoding returns the same octets.
+ *
+ * @param addr	- pointer to the UTC_TIME_LEN encoded octets
+ * @param quality	- pointer to the time quality octet to set, may be NULL
+ * @return uint64_t	- time in ns since 1970-01-01 00:00:00 UTC
+ */
+uint64_t utc_time_decode(const uint8_t *addr, uint8_t *quality);
+
+#endif /* _UTCTIME_H_ */
@@ -53,6 +53,12 @@ do \
 while (0)
 
 
+/** Number of allocations made through MALLOC, so that tools can confirm 
+ * their steady state does not allocate
+ */
+extern uint64_t MALLOC_COUNT;
+
+
 /**
  * Macro to invoke malloc and check that memory is allocated. If memory
  * allocation fails, then exit the program.
@@ -75,10 +81,90 @@ do \
     fflush(stderr); \
     exit(EXIT_FAILURE); \
   } \
+  else \
+  { \
+    __atomic_fetch_add(&MALLOC_COUNT, 1, __ATOMIC_RELAXED); \
+  } \
 } \
 while (0)
 
 
+/**
+ * Function to return the number of value octets of the shortest two's 
+ * complement encoding of an ASN.1 BER integer
+ *
+ * @param num	- integer to encode
+ * @return uint8_t	- number of value octets, 1 to 8
+ */
+uint8_t ber_int_size(const int64_t num);
+
+/**
+ * Function to encode the value octets of an ASN.1 BER integer, big-endian in 
+ * the shortest two's complement form, into the buffer specified. Unsigned 
+ * values with the most significant bit set take a leading zero octet.
+ *
+ * @param num	- integer to encode
+ * @param addr	- pointer to the buffer to add the octets to
+ * @return uint8_t	- number of octets added, see ber_int_size()
+ */
+uint8_t ber_int_to_bytes(const int64_t num, uint8_t *addr);
+
+/**
+ * Function to decode an ASN.1 BER definite length field, in either the short 
+ * form or the long form of up to 4 octets.
+ *
+ * @param addr	- pointer to the first octet of the length field
+ * @param avail	- number of octets available at addr
+ * @param len	- pointer to hold the decoded length
+ * @return uint8_t	- number of octets in the length field, else 0 if the 
+ * 			field is truncated, indefinite or too long
+ */
+uint8_t ber_len_from_bytes(const uint8_t *addr, size_t avail, size_t *len);
+
+/**
+ * Function to return the number of octets needed to BER encode a definite 
+ * length
+ *
+ * @param len	- length to encode
+ * @return uint8_t	- 1 for the short form, else 2 to 5 for the long form
+ */
+uint8_t ber_len_size(const size_t len);
+
+/**
+ * Function to BER encode a definite length in the shortest form into the 
+ * buffer specified
+ *
+ * @param len	- length to encode
+ * @param addr	- pointer to the buffer to add the octets to
+ * @return uint8_t	- number of octets added
+ */
+uint8_t ber_len_to_bytes(const size_t len, uint8_t *addr);
+
+/**
+ * Function to decode the big-endian value octets of an ASN.1 BER unsigned 
+ * integer of up to 32 bits. A leading zero octet, used by BER to keep values 
+ * with the most significant bit set positive, is accepted.
+ *
+ * @param addr	- pointer to the first value octet
+ * @param len	- number of value octets
+ * @param num	- pointer to hold the decoded value
+ * @return int	- 0 on success, else -1 if the value is empty or does not fit 
+ * 		in 32 bits
+ */
+int bytes_to_ui32(const uint8_t *addr, size_t len, uint32_t *num);
+
+/**
+ * Function to decode the big-endian two's complement value octets of an 
+ * ASN.1 BER integer of up to 32 bits
+ *
+ * @param addr	- pointer to the first value octet
+ * @param len	- number of value octets
+ * @param num	- pointer to hold the decoded value
+ * @return int	- 0 on success, else -1 if the value is empty or does not fit 
+ * 		in 32 bits
+ */
+int bytes_to_i32(const uint8_t *addr, size_t len, int32_t *num);
+
 /**
  * Function to compare EUI-48 hardware address. 
  * 
@@ -99,6 +185,18 @@ int compare_mac(const uint8_t *first, const uint8_t *second);
  */
 void hex_dump(const void *data, const size_t len);
 
+/**
+ * Function to convert a string of hexadecimal digits into bytes. The string 
+ * must contain an even number of hexadecimal digits and nothing else.
+ *
+ * @param hex	- pointer to the '\0' terminated hexadecimal string
+ * @param addr	- pointer to the buffer to add the octets to
+ * @param max_len	- size of the buffer
+ * @return size_t	- number of octets added, else 0 if the string is not 
+ * 			valid hexadecimal or does not fit in the buffer
+ */
+size_t hex_to_bytes(const char *hex, uint8_t *addr, size_t max_len);
+
 /** 
  * Function to return the actual number of bytes used by an unsigned 32-bit 
  * integer
@@ -143,7 +241,7 @@ void reverse_bytes(uint8_t *src, uint8_t *dst, size_t num_bytes);
 
 /** 
  * Function to convert the time value specified as a long into into a 4-byte 
- * value. The 4-byte value is put into the buffer specified.
+ * big-endian value. The 4-byte value is put into the buffer specified.
  *
  * @param tv	- long int representing the time value
  * @param addr	- pointer to the buffer to add the octets to
@@ -152,8 +250,8 @@ void time_to_bytes(const long int tv, uint8_t *addr);
 
 /** 
  * Function to convert the time value and quality struct specified as a 
- * timevalq_t into an 8-byte value. The 8-byte value is put into the buffer 
- * specified.
+ * timevalq_t into an 8-byte UtcTime, see utc_time_encode(). The 8-byte value 
+ * is put into the buffer specified.
  *
  * @param t	- timevalq_t struct representing the time and quality
  * @param addr	- pointer to the buffer to add the octets to
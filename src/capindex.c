@@ -0,0 +1,939 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "capindex.h"
+#include "config.h"
+#include "goose.h"
+#include "recorder.h"
+#include "replay.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/*
+ * Constants
+ */
+
+/** Classic pcap magic numbers, microsecond and nanosecond timestamps
+ */
+#define PCAP_MAGIC_US 0xa1b2c3d4
+#define PCAP_MAGIC_NS 0xa1b23c4d
+
+/** Bytes of the classic pcap file and record headers
+ */
+#define PCAP_FILE_HDR_LEN 24
+#define PCAP_REC_HDR_LEN 16
+
+/** pcapng if_tsresol option code, the block types are those the recorder 
+ * writes
+ */
+#define PCAPNG_OPT_TSRESOL 9
+
+/** Link type of Ethernet frames
+ */
+#define LINKTYPE_ETHERNET 1
+
+
+/** Stream of a capture while its index is built, with its posting list
+ */
+typedef struct _build_stream_t_ {
+  uint16_t appid;                       /* APPID */
+  uint8_t ref_len;                      /* Number of bytes at ref */
+  uint8_t ref[REPLAY_MAX_REF_LEN];      /* gocbRef */
+  uint32_t stNum;                       /* stNum of the last frame */
+  uint64_t frames;                      /* Frames of the stream */
+  capindex_change_t *change;            /* State changes */
+  uint32_t num_changes;                 /* Number of state changes */
+  uint32_t max_changes;                 /* Changes allocated */
+} build_stream_t;
+
+/** Index while it is built
+ */
+typedef struct _build_t_ {
+  build_stream_t *stream;               /* Streams, in the order seen */
+  uint32_t num_streams;                 /* Number of streams */
+  uint32_t max_streams;                 /* Streams allocated */
+  uint32_t *slot;                       /* Hash table of stream indexes */
+  uint32_t hash_len;                    /* Slots, a power of 2 */
+  capindex_time_t *time;                /* Sparse time index */
+  uint32_t num_times;                   /* Number of time entries */
+  uint32_t max_times;                   /* Time entries allocated */
+} build_t;
+
+
+
+/*
+ * Function Definitions
+ */
+
+/**
+ * Function to read a 32 bit value of a capture, in its byte order
+ */
+static inline uint32_t cap32(const capture_t *cap, const uint8_t *ptr)
+{
+  uint32_t value;
+
+  memcpy(&value, ptr, 4);
+  return cap->swap ? __builtin_bswap32(value) : value;
+}
+
+
+/**
+ * Function to read a 16 bit value of a capture, in its byte order
+ */
+static inline uint16_t cap16(const capture_t *cap, const uint8_t *ptr)
+{
+  uint16_t value;
+
+  memcpy(&value, ptr, 2);
+  return cap->swap ? __builtin_bswap16(value) : value;
+}
+
+
+/**
+ * Function to convert a timestamp of an interface to ns, as its if_tsresol 
+ * gives the units, a negative power of 10, or of 2 if the top bit is set
+ */
+static uint64_t capture_ns(uint64_t ts, uint8_t tsresol)
+{
+  /* Declare local variables */
+  static const uint64_t POW10[] = { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 
+   100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL }; 
+                                                        /* Powers of 10 */
+  uint8_t exp = tsresol & 0x7f;                  /* Exponent of the units */
+
+  if (tsresol & 0x80)
+  {
+    return (exp >= 64) ? 0 : (ts >> exp) * 1000000000ULL 
+     + (((ts & ((1ULL << exp) - 1)) * 1000000000ULL) >> exp);
+  }
+  if (exp <= 9)
+  {
+    return ts * POW10[9 - exp];
+  }
+  return (exp <= 18) ? ts / POW10[exp - 9] : 0;
+}
+
+
+/**
+ * Function to read the options of an interface description block, for its 
+ * if_tsresol
+ */
+static void capture_idb(capture_t *cap, const uint8_t *block, uint32_t len)
+{
+  /* Declare local variables */
+  const uint8_t *ptr = block + 16;                         /* First option */
+  const uint8_t *end = block + len - 4;            /* End of the options */
+  uint16_t code = 0;                                       /* Option code */
+  uint16_t opt_len = 0;                                  /* Option length */
+  uint32_t i = cap->num_ifaces;                       /* Interface index */
+
+  if (len < 20 || CAPTURE_MAX_IFACES <= i)
+  {
+    return;
+  }
+  cap->linktype[i] = cap16(cap, block + 8);
+  cap->tsresol[i] = 6;
+  while (ptr + 4 <= end)
+  {
+    code = cap16(cap, ptr);
+    opt_len = cap16(cap, ptr + 2);
+    if (0 == code || ptr + 4 + opt_len > end)
+    {
+      break;
+    }
+    if (PCAPNG_OPT_TSRESOL == code && 1 == opt_len)
+    {
+      cap->tsresol[i] = ptr[4];
+    }
+    ptr += 4 + ((opt_len + 3u) & ~3u);
+  }
+  cap->num_ifaces++;
+}
+
+
+int capture_open(capture_t *cap, const char *path)
+{
+  /* Check parameters */
+  if (NULL == cap || NULL == path)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  int fd = -1;                                 /* Descriptor of the capture */
+  struct stat st;                                   /* Status of the capture */
+  void *map = MAP_FAILED;                         /* Mapping of the capture */
+  uint32_t magic = 0;                            /* Magic number, as stored */
+  uint32_t type = 0;                                        /* Block type */
+  uint32_t len = 0;                                        /* Block length */
+
+  memset(cap, 0, sizeof(capture_t));
+  fd = open(path, O_RDONLY);
+  if (-1 == fd)
+  {
+    fprintf(stderr, "ERROR: could not open capture %s (%s)\n", path, 
+     strerror(errno));
+    return -1;
+  }
+  if (-1 == fstat(fd, &st) || (size_t)st.st_size < PCAP_FILE_HDR_LEN)
+  {
+    fprintf(stderr, "ERROR: %s is not a capture\n", path);
+    close(fd);
+    return -1;
+  }
+  map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (MAP_FAILED == map)
+  {
+    fprintf(stderr, "ERROR: could not map capture %s\n", path);
+    return -1;
+  }
+  cap->base = (const uint8_t *)map;
+  cap->size = (size_t)st.st_size;
+  cap->mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL 
+   + (uint64_t)st.st_mtim.tv_nsec;
+
+  /* A classic pcap file has a single interface, a pcapng file describes its 
+   * interfaces ahead of their frames */
+  memcpy(&magic, cap->base, 4);
+  if (PCAP_MAGIC_US == magic || PCAP_MAGIC_NS == magic 
+   || PCAP_MAGIC_US == __builtin_bswap32(magic) 
+   || PCAP_MAGIC_NS == __builtin_bswap32(magic))
+  {
+    cap->format = CAPTURE_PCAP;
+    cap->swap = (PCAP_MAGIC_US != magic && PCAP_MAGIC_NS != magic);
+    cap->start = PCAP_FILE_HDR_LEN;
+    cap->num_ifaces = 1;
+    cap->linktype[0] = (uint16_t)cap32(cap, cap->base + 20);
+    cap->tsresol[0] = (PCAP_MAGIC_NS == cap32(cap, cap->base)) ? 9 : 6;
+    return 0;
+  }
+  if (PCAPNG_SHB == magic)
+  {
+    memcpy(&magic, cap->base + 8, 4);
+    cap->format = CAPTURE_PCAPNG;
+    cap->swap = (PCAPNG_MAGIC != magic);
+    if (!cap->swap || PCAPNG_MAGIC == __builtin_bswap32(magic))
+    {
+      while (cap->start + 12 <= cap->size)
+      {
+        type = cap32(cap, cap->base + cap->start);
+        len = cap32(cap, cap->base + cap->start + 4);
+        if (len < 12 || 0 != len % 4 || len > cap->size - cap->start 
+         || (PCAPNG_SHB != type && PCAPNG_IDB != type))
+        {
+          break;
+        }
+        if (PCAPNG_IDB == type)
+        {
+          capture_idb(cap, cap->base + cap->start, len);
+        }
+        cap->start += len;
+      }
+      return 0;
+    }
+  }
+
+  fprintf(stderr, "ERROR: %s is not a pcap or pcapng capture\n", path);
+  capture_close(cap);
+  return -1;
+}
+
+
+void capture_close(capture_t *cap)
+{
+  if (NULL != cap && NULL != cap->base)
+  {
+    munmap((void *)cap->base, cap->size);
+    cap->base = NULL;
+  }
+}
+
+
+int capture_next(const capture_t *cap, uint64_t *offset, 
+  capture_frame_t *frame)
+{
+  /* Check parameters */
+  if (NULL == cap || NULL == offset || NULL == frame)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  const uint8_t *ptr = NULL;                              /* Current record */
+  uint32_t type = 0;                                        /* Block type */
+  uint32_t len = 0;                                       /* Record length */
+  uint32_t iface = 0;                                  /* Interface index */
+  uint64_t ts = 0;                                           /* Timestamp */
+
+  while (*offset + 12 <= cap->size)
+  {
+    ptr = cap->base + *offset;
+    if (CAPTURE_PCAP == cap->format)
+    {
+      if (*offset + PCAP_REC_HDR_LEN > cap->size)
+      {
+        return -1;
+      }
+      frame->caplen = cap32(cap, ptr + 8);
+      frame->len = cap32(cap, ptr + 12);
+      if (frame->caplen > cap->size - *offset - PCAP_REC_HDR_LEN)
+      {
+        return -1;
+      }
+      frame->data = ptr + PCAP_REC_HDR_LEN;
+      frame->ns = (uint64_t)cap32(cap, ptr) * 1000000000ULL 
+       + capture_ns(cap32(cap, ptr + 4), cap->tsresol[0]);
+      frame->offset = *offset;
+      *offset += PCAP_REC_HDR_LEN + frame->caplen;
+      if (LINKTYPE_ETHERNET != cap->linktype[0])
+      {
+        continue;
+      }
+      return 1;
+    }
+
+    /* Blocks of pcapng, which a crashed recorder leaves zeros after */
+    type = cap32(cap, ptr);
+    len = cap32(cap, ptr + 4);
+    if (0 == type && 0 == len)
+    {
+      return 0;
+    }
+    if (len < 12 || 0 != len % 4 || len > cap->size - *offset)
+    {
+      return -1;
+    }
+    *offset += len;
+    if (PCAPNG_EPB != type || len < PCAPNG_EPB_HDR_LEN + 4)
+    {
+      continue;
+    }
+    iface = cap32(cap, ptr + 8);
+    frame->caplen = cap32(cap, ptr + 20);
+    frame->len = cap32(cap, ptr + 24);
+    if (frame->caplen > len - PCAPNG_EPB_HDR_LEN - 4)
+    {
+      return -1;
+    }
+    if (iface >= cap->num_ifaces || LINKTYPE_ETHERNET != cap->linktype[iface])
+    {
+      continue;
+    }
+    ts = ((uint64_t)cap32(cap, ptr + 12) << 32) | cap32(cap, ptr + 16);
+    frame->data = ptr + PCAPNG_EPB_HDR_LEN;
+    frame->ns = capture_ns(ts, cap->tsresol[iface]);
+    frame->offset = *offset - len;
+    return 1;
+  }
+
+  return (*offset < cap->size && CAPTURE_PCAP == cap->format) ? -1 : 0;
+}
+
+
+/**
+ * Function to grow an array of a build to hold one more element
+ *
+ * @return int	0 on success, else -1 if out of memory
+ */
+static int build_grow(void **array, uint32_t *max, uint32_t num, size_t elem)
+{
+  /* Declare local variables */
+  void *grown = NULL;                                   /* Array reallocated */
+  uint32_t len = (*max) ? 2 * (*max) : 64;                 /* New capacity */
+
+  if (num < *max)
+  {
+    return 0;
+  }
+  grown = realloc(*array, len * elem);
+  if (NULL == grown)
+  {
+    fprintf(stderr, "ERROR: out of memory building the capture index\n");
+    return -1;
+  }
+  *array = grown;
+  *max = len;
+  return 0;
+}
+
+
+/**
+ * Function to find the stream of a frame, adding it if it is new
+ *
+ * @return build_stream_t *	stream, else NULL if out of memory or the 
+ * 			gocbRef is too long
+ */
+static build_stream_t *build_stream(build_t *build, const goose_view_t *view)
+{
+  /* Declare local variables */
+  uint32_t mask = build->hash_len - 1;                  /* Mask of the slots */
+  uint32_t h = 0;                                             /* Slot index */
+  uint32_t i = 0;                                           /* Stream index */
+  uint32_t *slot = NULL;                                    /* Grown table */
+  build_stream_t *stream = NULL;                            /* Stream found */
+
+  h = config_hash(view->appid, view->gocbref, view->gocbrefLen) & mask;
+  while (CONFIG_EMPTY != build->slot[h])
+  {
+    stream = &(build->stream[build->slot[h]]);
+    if (stream->appid == view->appid && stream->ref_len == view->gocbrefLen 
+     && 0 == memcmp(stream->ref, view->gocbref, view->gocbrefLen))
+    {
+      return stream;
+    }
+    h = (h + 1) & mask;
+  }
+
+  /* New stream, the table is kept at most half full */
+  if (REPLAY_MAX_REF_LEN <= view->gocbrefLen || 0 != build_grow(
+    (void **)&(build->stream), &(build->max_streams), build->num_streams, 
+    sizeof(build_stream_t)))
+  {
+    return NULL;
+  }
+  stream = &(build->stream[build->num_streams]);
+  memset(stream, 0, sizeof(build_stream_t));
+  stream->appid = view->appid;
+  stream->ref_len = (uint8_t)view->gocbrefLen;
+  memcpy(stream->ref, view->gocbref, view->gocbrefLen);
+  build->slot[h] = build->num_streams++;
+  if (2 * build->num_streams <= build->hash_len)
+  {
+    return stream;
+  }
+  slot = (uint32_t *)malloc(2 * build->hash_len * sizeof(uint32_t));
+  if (NULL == slot)
+  {
+    fprintf(stderr, "ERROR: out of memory building the capture index\n");
+    return NULL;
+  }
+  free(build->slot);
+  build->slot = slot;
+  build->hash_len *= 2;
+  mask = build->hash_len - 1;
+  memset(slot, 0xff, build->hash_len * sizeof(uint32_t));
+  for (i = 0; i < build->num_streams; i++)
+  {
+    h = config_hash(build->stream[i].appid, build->stream[i].ref, 
+     build->stream[i].ref_len) & mask;
+    while (CONFIG_EMPTY != slot[h])
+    {
+      h = (h + 1) & mask;
+    }
+    slot[h] = i;
+  }
+
+  /* Done */
+  return &(build->stream[build->num_streams - 1]);
+}
+
+
+/**
+ * Function to order streams by APPID, then gocbRef
+ */
+static int build_stream_cmp(const void *a, const void *b)
+{
+  /* Declare local variables */
+  const build_stream_t *sa = (const build_stream_t *)a;        /* Stream a */
+  const build_stream_t *sb = (const build_stream_t *)b;        /* Stream b */
+  int cmp = 0;                                     /* Comparison of refs */
+
+  if (sa->appid != sb->appid)
+  {
+    return (sa->appid < sb->appid) ? -1 : 1;
+  }
+  cmp = memcmp(sa->ref, sb->ref, 
+   (sa->ref_len < sb->ref_len) ? sa->ref_len : sb->ref_len);
+  return (0 != cmp) ? cmp : (int)sa->ref_len - (int)sb->ref_len;
+}
+
+
+/**
+ * Function to order state changes by time, then by their place in the 
+ * capture
+ */
+static int build_change_cmp(const void *a, const void *b)
+{
+  /* Declare local variables */
+  const capindex_change_t *ca = (const capindex_change_t *)a;  /* Change a */
+  const capindex_change_t *cb = (const capindex_change_t *)b;  /* Change b */
+
+  if (ca->ns != cb->ns)
+  {
+    return (ca->ns < cb->ns) ? -1 : 1;
+  }
+  return (ca->offset < cb->offset) ? -1 : (ca->offset > cb->offset);
+}
+
+
+/**
+ * Function to write a built index beside its path and rename it over it
+ *
+ * @return int	0 on success, else -1
+ */
+static int build_write(build_t *build, capindex_t *idx, const char *path)
+{
+  /* Declare local variables */
+  capindex_stream_t stream;                          /* Stream written */
+  char tmp[4096];                                 /* Index before rename */
+  FILE *out = NULL;                                           /* Index */
+  uint64_t size = 0;                            /* Bytes of the index */
+  uint32_t changes = 0;                        /* Changes written so far */
+  uint32_t strings = 1;                        /* String table written */
+  uint32_t i = 0;                                       /* Stream index */
+  int ok = 1;                                /* Zero if a write failed */
+
+  /* Lay out the index, each array on an 8 byte boundary */
+  idx->num_times = build->num_times;
+  idx->num_streams = build->num_streams;
+  idx->strings_len = 1;
+  for (i = 0; i < build->num_streams; i++)
+  {
+    idx->num_changes += build->stream[i].num_changes;
+    idx->strings_len += build->stream[i].ref_len + 1u;
+  }
+  idx->times = (uint32_t)sizeof(capindex_t);
+  size = idx->times + (uint64_t)idx->num_times * sizeof(capindex_time_t);
+  idx->streams = (uint32_t)size;
+  size += (uint64_t)idx->num_streams * sizeof(capindex_stream_t);
+  idx->changes = (uint32_t)size;
+  size += (uint64_t)idx->num_changes * sizeof(capindex_change_t);
+  idx->strings = (uint32_t)size;
+  size += idx->strings_len;
+  idx->size = size;
+  if (size > UINT32_MAX)
+  {
+    fprintf(stderr, "ERROR: index of %s would exceed 4 GiB\n", path);
+    return -1;
+  }
+
+  if (sizeof(tmp) <= (size_t)snprintf(tmp, sizeof(tmp), "%s.tmp", path))
+  {
+    fprintf(stderr, "ERROR: index path %s is too long\n", path);
+    return -1;
+  }
+  out = fopen(tmp, "wb");
+  if (NULL == out)
+  {
+    fprintf(stderr, "ERROR: could not create %s (%s)\n", tmp, 
+     strerror(errno));
+    return -1;
+  }
+  ok &= (1 == fwrite(idx, sizeof(capindex_t), 1, out));
+  ok &= (build->num_times == fwrite(build->time, sizeof(capindex_time_t), 
+   build->num_times, out));
+  for (i = 0; i < build->num_streams; i++)
+  {
+    memset(&stream, 0, sizeof(capindex_stream_t));
+    stream.appid = build->stream[i].appid;
+    stream.gocbref = strings;
+    stream.num_changes = build->stream[i].num_changes;
+    stream.changes = changes;
+    stream.frames = build->stream[i].frames;
+    strings += build->stream[i].ref_len + 1u;
+    changes += build->stream[i].num_changes;
+    ok &= (1 == fwrite(&stream, sizeof(capindex_stream_t), 1, out));
+  }
+  for (i = 0; i < build->num_streams; i++)
+  {
+    ok &= (build->stream[i].num_changes == fwrite(build->stream[i].change, 
+     sizeof(capindex_change_t), build->stream[i].num_changes, out));
+  }
+  ok &= (EOF != fputc('\0', out));
+  for (i = 0; i < build->num_streams; i++)
+  {
+    ok &= (build->stream[i].ref_len == fwrite(build->stream[i].ref, 1, 
+     build->stream[i].ref_len, out));
+    ok &= (EOF != fputc('\0', out));
+  }
+  ok &= (0 == fclose(out));
+  if (!ok || 0 != rename(tmp, path))
+  {
+    fprintf(stderr, "ERROR: could not write %s (%s)\n", path, 
+     strerror(errno));
+    remove(tmp);
+    return -1;
+  }
+
+  /* Done */
+  return 0;
+}
+
+
+int capindex_build(const char *capture, const char *path)
+{
+  /* Check parameters */
+  if (NULL == capture)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  capture_t cap;                                              /* Capture */
+  capture_frame_t frame;                                 /* Frame read */
+  goose_view_t view;                                  /* Decoded header */
+  capindex_t idx;                                       /* Index header */
+  build_t build;                                  /* Index being built */
+  build_stream_t *stream = NULL;                     /* Stream of a frame */
+  capindex_change_t *change = NULL;                     /* Change added */
+  char idx_path[4096];                                /* Path of the index */
+  uint64_t offset = 0;                              /* Offset of a record */
+  uint32_t i = 0;                                         /* Stream index */
+  int rc = 0;                                    /* Result of each read */
+  int ret = -1;                                    /* Result of the build */
+
+  if (NULL == path)
+  {
+    if (sizeof(idx_path) <= (size_t)snprintf(idx_path, sizeof(idx_path), 
+      "%s%s", capture, CAPINDEX_SUFFIX))
+    {
+      fprintf(stderr, "ERROR: capture path %s is too long\n", capture);
+      return -1;
+    }
+    path = idx_path;
+  }
+  if (0 != capture_open(&cap, capture))
+  {
+    return -1;
+  }
+  memset(&idx, 0, sizeof(capindex_t));
+  memset(&build, 0, sizeof(build_t));
+  idx.magic = CAPINDEX_MAGIC;
+  idx.version = CAPINDEX_VERSION;
+  idx.capture_size = cap.size;
+  idx.capture_mtime = cap.mtime;
+  idx.stride = CAPINDEX_STRIDE;
+  build.hash_len = 64;
+  build.slot = (uint32_t *)malloc(build.hash_len * sizeof(uint32_t));
+  if (NULL == build.slot)
+  {
+    goto done;
+  }
+  memset(build.slot, 0xff, build.hash_len * sizeof(uint32_t));
+
+  /* A single pass, the header stage of each GOOSE frame is enough to tell 
+   * its stream and state */
+  offset = cap.start;
+  while (1 == (rc = capture_next(&cap, &offset, &frame)))
+  {
+    if (0 == idx.frames % CAPINDEX_STRIDE)
+    {
+      if (0 != build_grow((void **)&(build.time), &(build.max_times), 
+        build.num_times, sizeof(capindex_time_t)))
+      {
+        goto done;
+      }
+      build.time[build.num_times].ns = frame.ns;
+      build.time[build.num_times++].offset = frame.offset;
+    }
+    if (0 == idx.frames++ || frame.ns < idx.first_ns)
+    {
+      idx.first_ns = frame.ns;
+    }
+    idx.last_ns = (frame.ns > idx.last_ns) ? frame.ns : idx.last_ns;
+
+    if (0 != decode_goose_header(frame.data, frame.caplen, &view))
+    {
+      continue;
+    }
+    idx.goose++;
+    stream = build_stream(&build, &view);
+    if (NULL == stream)
+    {
+      continue;
+    }
+    if (0 != stream->frames++ && stream->stNum == view.stNum)
+    {
+      continue;
+    }
+    stream->stNum = view.stNum;
+    if (0 != build_grow((void **)&(stream->change), &(stream->max_changes), 
+      stream->num_changes, sizeof(capindex_change_t)))
+    {
+      goto done;
+    }
+    change = &(stream->change[stream->num_changes++]);
+    change->ns = frame.ns;
+    change->offset = frame.offset;
+    change->stNum = view.stNum;
+    change->sqNum = view.sqNum;
+  }
+  if (-1 == rc)
+  {
+    fprintf(stderr, "ERROR: %s is corrupt at offset %llu, indexed the %llu "
+     "frames before\n", capture, (unsigned long long)offset, 
+     (unsigned long long)idx.frames);
+  }
+
+  /* Sort for binary searches, by APPID and gocbRef, and each posting list 
+   * by time, which is capture order unless the clock stepped back */
+  qsort(build.stream, build.num_streams, sizeof(build_stream_t), 
+   build_stream_cmp);
+  for (i = 0; i < build.num_streams; i++)
+  {
+    qsort(build.stream[i].change, build.stream[i].num_changes, 
+     sizeof(capindex_change_t), build_change_cmp);
+  }
+  ret = build_write(&build, &idx, path);
+
+done:
+  for (i = 0; i < build.num_streams; i++)
+  {
+    free(build.stream[i].change);
+  }
+  free(build.stream);
+  free(build.slot);
+  free(build.time);
+  capture_close(&cap);
+  return ret;
+}
+
+
+const capindex_t *capindex_map(const char *path)
+{
+  /* Check parameters */
+  if (NULL == path)
+  {
+    return NULL;
+  }
+
+  /* Declare local variables */
+  int fd = -1;                                   /* Descriptor of the index */
+  struct stat st;                                     /* Status of the index */
+  const capindex_t *idx = NULL;                       /* Mapping of the index */
+  const uint8_t *base = NULL;                        /* Start of the mapping */
+  const capindex_stream_t *stream = NULL;                 /* Stream checked */
+  uint32_t i = 0;                                           /* Stream index */
+
+  fd = open(path, O_RDONLY);
+  if (-1 == fd)
+  {
+    return NULL;
+  }
+  if (-1 == fstat(fd, &st) || (size_t)st.st_size < sizeof(capindex_t))
+  {
+    close(fd);
+    return NULL;
+  }
+  idx = (const capindex_t *)mmap(NULL, (size_t)st.st_size, PROT_READ, 
+   MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (MAP_FAILED == (const void *)idx)
+  {
+    fprintf(stderr, "ERROR: could not map index %s\n", path);
+    return NULL;
+  }
+  base = (const uint8_t *)idx;
+
+  /* Check the header, that the sections are in order so that their sizes 
+   * do not wrap, then that every offset stays in the index */
+  if (CAPINDEX_MAGIC != idx->magic || CAPINDEX_VERSION != idx->version 
+   || (uint64_t)st.st_size != idx->size 
+   || idx->times < sizeof(capindex_t) || idx->times > idx->streams 
+   || idx->streams > idx->changes || idx->changes > idx->strings 
+   || (uint64_t)idx->num_times * sizeof(capindex_time_t) 
+    > (uint64_t)idx->streams - idx->times 
+   || (uint64_t)idx->num_streams * sizeof(capindex_stream_t) 
+    > (uint64_t)idx->changes - idx->streams 
+   || (uint64_t)idx->num_changes * sizeof(capindex_change_t) 
+    > (uint64_t)idx->strings - idx->changes 
+   || 0 != (idx->times | idx->streams | idx->changes) % 8 
+   || 0 == idx->strings_len || idx->strings > idx->size 
+   || idx->strings_len != idx->size - idx->strings 
+   || '\0' != base[idx->size - 1])
+  {
+    munmap((void *)idx, (size_t)st.st_size);
+    return NULL;
+  }
+  stream = (const capindex_stream_t *)(base + idx->streams);
+  for (i = 0; i < idx->num_streams; i++)
+  {
+    if (stream[i].gocbref >= idx->strings_len 
+     || stream[i].changes > idx->num_changes 
+     || stream[i].num_changes > idx->num_changes - stream[i].changes)
+    {
+      munmap((void *)idx, (size_t)st.st_size);
+      return NULL;
+    }
+  }
+
+  /* Done */
+  return idx;
+}
+
+
+void capindex_unmap(const capindex_t *idx)
+{
+  if (NULL != idx)
+  {
+    munmap((void *)idx, (size_t)idx->size);
+  }
+}
+
+
+int capindex_current(const capindex_t *idx, const capture_t *cap)
+{
+  return NULL != idx && NULL != cap && idx->capture_size == cap->size 
+   && idx->capture_mtime == cap->mtime;
+}
+
+
+const char *capindex_str(const capindex_t *idx, uint32_t offset)
+{
+  /* Check parameters */
+  if (NULL == idx || offset >= idx->strings_len)
+  {
+    return "";
+  }
+
+  return (const char *)idx + idx->strings + offset;
+}
+
+
+const capindex_stream_t *capindex_stream(const capindex_t *idx, uint32_t i)
+{
+  /* Check parameters */
+  if (NULL == idx || i >= idx->num_streams)
+  {
+    return NULL;
+  }
+
+  return (const capindex_stream_t *)((const uint8_t *)idx + idx->streams) + i;
+}
+
+
+const capindex_stream_t *capindex_find(const capindex_t *idx, uint16_t appid,
+  uint32_t *count)
+{
+  /* Check parameters */
+  if (NULL == idx || NULL == count)
+  {
+    return NULL;
+  }
+
+  /* Declare local variables */
+  const capindex_stream_t *stream = capindex_stream(idx, 0);   /* Streams */
+  uint32_t lo = 0;                                     /* First candidate */
+  uint32_t hi = idx->num_streams;                 /* Past the candidates */
+  uint32_t mid = 0;                                        /* Probe index */
+
+  /* Lower bound of the APPID */
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    if (stream[mid].appid < appid)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  for (*count = 0; lo + *count < idx->num_streams 
+   && stream[lo + *count].appid == appid; (*count)++)
+  {
+  }
+
+  return (*count) ? &(stream[lo]) : NULL;
+}
+
+
+const capindex_change_t *capindex_changes(const capindex_t *idx, 
+  const capindex_stream_t *stream, uint64_t from_ns, uint32_t *count)
+{
+  /* Declare local variables */
+  const capindex_change_t *change = (const capindex_change_t *)(
+   (const uint8_t *)idx + idx->changes) + stream->changes;   /* Postings */
+  uint32_t lo = 0;                                     /* First candidate */
+  uint32_t hi = stream->num_changes;              /* Past the candidates */
+  uint32_t mid = 0;                                        /* Probe index */
+
+  /* Lower bound of the time */
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    if (change[mid].ns < from_ns)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  *count = stream->num_changes - lo;
+
+  return &(change[lo]);
+}
+
+
+uint64_t capindex_seek(const capindex_t *idx, uint64_t from_ns)
+{
+  /* Check parameters */
+  if (NULL == idx || 0 == idx->num_times)
+  {
+    return 0;
+  }
+
+  /* Declare local variables */
+  const capindex_time_t *time = (const capindex_time_t *)(
+   (const uint8_t *)idx + idx->times);                    /* Time entries */
+  uint32_t lo = 0;                                     /* First candidate */
+  uint32_t hi = idx->num_times;                   /* Past the candidates */
+  uint32_t mid = 0;                                        /* Probe index */
+
+  /* Frames up to an entry may share its time, so start at the last entry 
+   * strictly before from_ns */
+  while (lo < hi)
+  {
+    mid = lo + (hi - lo) / 2;
+    if (time[mid].ns < from_ns)
+    {
+      lo = mid + 1;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+
+  return (0 == lo) ? 0 : time[lo - 1].offset;
+}
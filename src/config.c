@@ -0,0 +1,300 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "config.h"
+#include "goose.h"
+#include "types.h"
+#include "utils.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/*
+ * Function Definitions
+ */
+
+/**
+ * Function to return non-zero if the range of an array lies in the image
+ */
+static int config_in_image(uint64_t size, uint32_t offset, uint64_t count, 
+  size_t elem)
+{
+  return (uint64_t)offset <= size && count * elem <= size - offset;
+}
+
+
+/**
+ * Function to check the string offsets of the control blocks of an image
+ */
+static int config_check_cbs(const config_t *config, const config_cb_t *cb, 
+  uint32_t count)
+{
+  /* Declare local variables */
+  uint32_t i = 0;                                    /* Control block index */
+
+  for (i = 0; i < count; i++)
+  {
+    if (cb[i].ied >= config->strings_len 
+     || cb[i].gocbref >= config->strings_len 
+     || cb[i].datSet >= config->strings_len 
+     || cb[i].goID >= config->strings_len)
+    {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
+const config_t *config_map(const char *path)
+{
+  /* Check parameters */
+  if (NULL == path)
+  {
+    return NULL;
+  }
+
+  /* Declare local variables */
+  int fd = -1;                                   /* Descriptor of the image */
+  struct stat st;                                     /* Status of the image */
+  const config_t *config = NULL;                       /* Mapping of the image */
+  const uint8_t *base = NULL;                      /* Start of the mapping */
+  const uint32_t *slot = NULL;                    /* Subscription table */
+  uint32_t i = 0;                                              /* Slot index */
+
+  fd = open(path, O_RDONLY);
+  if (-1 == fd)
+  {
+    fprintf(stderr, "ERROR: could not open configuration %s\n", path);
+    return NULL;
+  }
+  if (-1 == fstat(fd, &st) || (size_t)st.st_size < sizeof(config_t))
+  {
+    fprintf(stderr, "ERROR: %s is not a configuration image\n", path);
+    close(fd);
+    return NULL;
+  }
+  config = (const config_t *)mmap(NULL, (size_t)st.st_size, PROT_READ, 
+   MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (MAP_FAILED == (const void *)config)
+  {
+    fprintf(stderr, "ERROR: could not map configuration %s\n", path);
+    return NULL;
+  }
+  base = (const uint8_t *)config;
+
+  /* Check the header, then that every offset stays in the image */
+  if (CONFIG_MAGIC != config->magic || CONFIG_VERSION != config->version 
+   || (uint64_t)st.st_size != config->size)
+  {
+    fprintf(stderr, "ERROR: %s is not a version %u configuration image for "
+     "this host\n", path, CONFIG_VERSION);
+    munmap((void *)config, (size_t)st.st_size);
+    return NULL;
+  }
+  if (!config_in_image(config->size, config->pubs, config->num_pubs, 
+    sizeof(config_cb_t))
+   || !config_in_image(config->size, config->subs, config->num_subs, 
+    sizeof(config_cb_t))
+   || !config_in_image(config->size, config->hash, config->hash_len, 
+    sizeof(uint32_t))
+   || !config_in_image(config->size, config->strings, config->strings_len, 1)
+   || 0 != (config->pubs | config->subs | config->hash) % 8
+   || 0 == config->strings_len 
+   || '\0' != base[config->strings + config->strings_len - 1]
+   || 0 == config->hash_len || 0 != (config->hash_len & (config->hash_len - 1))
+   || config->hash_len <= config->num_subs 
+   || '\0' != config->ied[CONFIG_NAME_LEN - 1]
+   || 0 != config_check_cbs(config, 
+    (const config_cb_t *)(base + config->pubs), config->num_pubs)
+   || 0 != config_check_cbs(config, 
+    (const config_cb_t *)(base + config->subs), config->num_subs))
+  {
+    fprintf(stderr, "ERROR: configuration image %s is corrupt\n", path);
+    munmap((void *)config, (size_t)st.st_size);
+    return NULL;
+  }
+  slot = (const uint32_t *)(base + config->hash);
+  for (i = 0; i < config->hash_len; i++)
+  {
+    if (CONFIG_EMPTY != slot[i] && slot[i] >= config->num_subs)
+    {
+      fprintf(stderr, "ERROR: configuration image %s is corrupt\n", path);
+      munmap((void *)config, (size_t)st.st_size);
+      return NULL;
+    }
+  }
+
+  /* Done */
+  return config;
+}
+
+
+void config_unmap(const config_t *config)
+{
+  if (NULL != config)
+  {
+    munmap((void *)config, (size_t)config->size);
+  }
+}
+
+
+const config_cb_t *config_pub(const config_t *config, uint32_t i)
+{
+  /* Check parameters */
+  if (NULL == config || i >= config->num_pubs)
+  {
+    return NULL;
+  }
+
+  return (const config_cb_t *)((const uint8_t *)config + config->pubs) + i;
+}
+
+
+const config_cb_t *config_sub(const config_t *config, uint32_t i)
+{
+  /* Check parameters */
+  if (NULL == config || i >= config->num_subs)
+  {
+    return NULL;
+  }
+
+  return (const config_cb_t *)((const uint8_t *)config + config->subs) + i;
+}
+
+
+const char *config_str(const config_t *config, uint32_t offset)
+{
+  /* Check parameters */
+  if (NULL == config || offset >= config->strings_len)
+  {
+    return "";
+  }
+
+  return (const char *)config + config->strings + offset;
+}
+
+
+uint32_t config_hash(uint16_t appid, const uint8_t *gocbref, size_t len)
+{
+  /* Declare local variables */
+  uint32_t hash = 2166136261u;                          /* FNV offset basis */
+  size_t i = 0;                                               /* Loop index */
+
+  hash = (hash ^ (appid >> 8)) * 16777619u;
+  hash = (hash ^ (appid & 0xff)) * 16777619u;
+  for (i = 0; i < len; i++)
+  {
+    hash = (hash ^ gocbref[i]) * 16777619u;
+  }
+
+  return hash;
+}
+
+
+const config_cb_t *config_find_sub(const config_t *config, uint16_t appid, 
+  const uint8_t *gocbref, size_t len)
+{
+  /* Check parameters */
+  if (NULL == config || NULL == gocbref)
+  {
+    return NULL;
+  }
+
+  /* Declare local variables */
+  const uint32_t *slot = (const uint32_t *)((const uint8_t *)config 
+   + config->hash);                                  /* Subscription table */
+  uint32_t mask = config->hash_len - 1;                 /* Mask of the slots */
+  uint32_t i = config_hash(appid, gocbref, len) & mask;        /* Slot index */
+  const config_cb_t *cb = NULL;                      /* Control block of slot */
+  const char *ref = NULL;                           /* gocbRef of the slot */
+  size_t avail = 0;             /* Bytes of the string table from ref on */
+
+  /* Linear probing, the table always has an empty slot. The gocbRef of 
+   * a frame may hold a '\0', so it is compared by length, and the string 
+   * of the slot is never read past the end of the string table */
+  while (CONFIG_EMPTY != slot[i])
+  {
+    cb = config_sub(config, slot[i]);
+    ref = config_str(config, cb->gocbref);
+    avail = (cb->gocbref < config->strings_len) 
+     ? config->strings_len - cb->gocbref : 0;
+    if (cb->appid == appid && len < avail && len == strnlen(ref, avail) 
+     && 0 == memcmp(ref, gocbref, len))
+    {
+      return cb;
+    }
+    i = (i + 1) & mask;
+  }
+
+  return NULL;
+}
+
+
+int config_frame(const config_t *config, const config_cb_t *cb, 
+  goose_frame_t *goose_frame)
+{
+  /* Check parameters */
+  if (NULL == config || NULL == cb || NULL == goose_frame)
+  {
+    return -1;
+  }
+
+  goose_frame->vlan.tagged = 0;
+  set_dest_mac(goose_frame, cb->mac);
+  goose_frame->eth_hdr.ether_type = htons(ETHER_GOOSE);
+  if (cb->tagged)
+  {
+    set_vlan(goose_frame, cb->vid, cb->pcp);
+  }
+  goose_frame->goose_header.appid = htons(cb->appid);
+
+  /* The encoder only reads the strings, so they are used in place */
+  goose_frame->goose_pdu.gocbref = (uint8_t *)config_str(config, cb->gocbref);
+  goose_frame->goose_pdu.datSet = (uint8_t *)config_str(config, cb->datSet);
+  goose_frame->goose_pdu.goID = (uint8_t *)config_str(config, cb->goID);
+  if (cb->max_time)
+  {
+    goose_frame->goose_pdu.timeAllowedtoLive = 2 * cb->max_time;
+  }
+  goose_frame->goose_pdu.confRev = cb->confRev;
+  goose_frame->goose_pdu.numDatSetEntries = cb->numDatSetEntries;
+
+  /* Done */
+  return 0;
+}
@@ -0,0 +1,426 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "diff.h"
+#include "utils.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+
+/*
+ * Types
+ */
+
+/** Compare implementation, marking the entries of allData b that differ 
+ * from a, laid out as start and value, and returning non-zero, with the mask 
+ * incomplete, if the tag or length of an entry differs
+ */
+typedef int (*diff_impl_t)(const uint8_t *a, const uint8_t *b, size_t len, 
+ const uint16_t *start, const uint16_t *value, uint64_t *changed);
+
+
+
+/*
+ * Global variables
+ */
+
+/** Selected compare implementation */
+static int diff_portable(const uint8_t *a, const uint8_t *b, size_t len, 
+ const uint16_t *start, const uint16_t *value, uint64_t *changed);
+static diff_impl_t DIFF_IMPL = diff_portable;
+static const char *DIFF_IMPL_NAME = "portable";
+
+static pthread_once_t DIFF_ONCE = PTHREAD_ONCE_INIT;
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to mark the entries holding the differing bytes of a block
+ *
+ * @param m	bit per byte of the block, set if the byte differs
+ * @param off	offset of the block
+ * @param start	offsets of the entries, then the end of allData
+ * @param value	offsets of the values of the entries
+ * @param e	pointer to the entry holding the block so far, which only 
+ * 		moves forward
+ * @param changed	mask of the changed entries
+ * @return int	non-zero if a tag or length byte differs
+ */
+static inline int diff_mark(uint64_t m, size_t off, const uint16_t *start, 
+ const uint16_t *value, size_t *e, uint64_t *changed)
+{
+  /* Declare local variables */
+  size_t pos = 0;                                 /* Offset of a difference */
+  size_t skip = 0;                    /* Bytes of the block in the entry */
+
+  while (m)
+  {
+    pos = off + (size_t)__builtin_ctzll(m);
+    while (start[*e + 1] <= pos)
+    {
+      (*e)++;
+    }
+    if (pos < value[*e])
+    {
+      return 1;
+    }
+    changed[*e / 64] |= 1ULL << (*e % 64);
+
+    /* The rest of the entry is already marked */
+    skip = start[*e + 1] - off;
+    m = (skip >= 64) ? 0 : (m & ~((1ULL << skip) - 1));
+  }
+
+  return 0;
+}
+
+
+/**
+ * Function to compare two allData eight bytes at a time with the portable 
+ * implementation
+ */
+static int diff_portable(const uint8_t *a, const uint8_t *b, size_t len, 
+ const uint16_t *start, const uint16_t *value, uint64_t *changed)
+{
+  /* Declare local variables */
+  uint64_t x = 0;                                   /* Word of a */
+  uint64_t y = 0;                                   /* Word of b */
+  uint64_t m = 0;                         /* Bit per differing byte */
+  size_t e = 0;                                       /* Current entry */
+  size_t off = 0;                                   /* Offset of the block */
+  size_t i = 0;                                        /* Byte index */
+
+  for (off = 0; off < len; off += 8)
+  {
+    if (len - off >= 8)
+    {
+      memcpy(&x, a + off, 8);
+      memcpy(&y, b + off, 8);
+      if (x == y)
+      {
+        continue;
+      }
+    }
+    m = 0;
+    for (i = 0; i < 8 && off + i < len; i++)
+    {
+      m |= (uint64_t)(a[off + i] != b[off + i]) << i;
+    }
+    if (diff_mark(m, off, start, value, &e, changed))
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+#ifdef HAVE_X86_SIMD
+
+/**
+ * Function to compare two allData sixteen bytes at a time with SSE2
+ */
+__attribute__((target("sse2")))
+static int diff_sse2(const uint8_t *a, const uint8_t *b, size_t len, 
+ const uint16_t *start, const uint16_t *value, uint64_t *changed)
+{
+  /* Declare local variables */
+  __m128i x;                                             /* Block of a */
+  __m128i y;                                             /* Block of b */
+  uint64_t m = 0;                         /* Bit per differing byte */
+  size_t e = 0;                                       /* Current entry */
+  size_t off = 0;                                   /* Offset of the block */
+
+  for (off = 0; off + 16 <= len; off += 16)
+  {
+    x = _mm_loadu_si128((const __m128i *)(a + off));
+    y = _mm_loadu_si128((const __m128i *)(b + off));
+    m = (uint64_t)(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xffff);
+    if (m && diff_mark(m, off, start, value, &e, changed))
+    {
+      return 1;
+    }
+  }
+  for (; off < len; off++)
+  {
+    if (a[off] != b[off] && diff_mark(1, off, start, value, &e, changed))
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+/**
+ * Function to compare two allData thirty two bytes at a time with AVX2
+ */
+__attribute__((target("avx2")))
+static int diff_avx2(const uint8_t *a, const uint8_t *b, size_t len, 
+ const uint16_t *start, const uint16_t *value, uint64_t *changed)
+{
+  /* Declare local variables */
+  __m256i x;                                             /* Block of a */
+  __m256i y;                                             /* Block of b */
+  uint64_t m = 0;                         /* Bit per differing byte */
+  size_t e = 0;                                       /* Current entry */
+  size_t off = 0;                                   /* Offset of the block */
+
+  for (off = 0; off + 32 <= len; off += 32)
+  {
+    x = _mm256_loadu_si256((const __m256i *)(a + off));
+    y = _mm256_loadu_si256((const __m256i *)(b + off));
+    m = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) ^ 0xffffffffu;
+    if (m && diff_mark(m, off, start, value, &e, changed))
+    {
+      return 1;
+    }
+  }
+  for (; off < len; off++)
+  {
+    if (a[off] != b[off] && diff_mark(1, off, start, value, &e, changed))
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+#endif /* HAVE_X86_SIMD */
+
+
+#ifdef HAVE_NEON
+
+/**
+ * Function to compare two allData sixteen bytes at a time with NEON, which 
+ * has no byte mask, so a block that differs is narrowed to four bits a byte
+ */
+static int diff_neon(const uint8_t *a, const uint8_t *b, size_t len, 
+ const uint16_t *start, const uint16_t *value, uint64_t *changed)
+{
+  /* Declare local variables */
+  uint8x16_t ne;                               /* 0xff per differing byte */
+  uint64_t nibbles = 0;                       /* Four bits per byte of ne */
+  uint64_t m = 0;                         /* Bit per differing byte */
+  size_t e = 0;                                       /* Current entry */
+  size_t off = 0;                                   /* Offset of the block */
+  size_t i = 0;                                        /* Byte index */
+
+  for (off = 0; off + 16 <= len; off += 16)
+  {
+    ne = vmvnq_u8(vceqq_u8(vld1q_u8(a + off), vld1q_u8(b + off)));
+    if (0 == vmaxvq_u8(ne))
+    {
+      continue;
+    }
+    nibbles = vget_lane_u64(vreinterpret_u64_u8(
+     vshrn_n_u16(vreinterpretq_u16_u8(ne), 4)), 0);
+    for (m = 0, i = 0; i < 16; i++)
+    {
+      m |= ((nibbles >> (4 * i)) & 1) << i;
+    }
+    if (diff_mark(m, off, start, value, &e, changed))
+    {
+      return 1;
+    }
+  }
+  for (; off < len; off++)
+  {
+    if (a[off] != b[off] && diff_mark(1, off, start, value, &e, changed))
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+#endif /* HAVE_NEON */
+
+
+/**
+ * Function to select the implementation, called once
+ */
+static void diff_select(void)
+{
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+  {
+    DIFF_IMPL = diff_avx2;
+    DIFF_IMPL_NAME = "avx2";
+  }
+  else if (__builtin_cpu_supports("sse2"))
+  {
+    DIFF_IMPL = diff_sse2;
+    DIFF_IMPL_NAME = "sse2";
+  }
+#endif
+#ifdef HAVE_NEON
+  DIFF_IMPL = diff_neon;
+  DIFF_IMPL_NAME = "neon";
+#endif
+}
+
+
+void diff_init(void)
+{
+  pthread_once(&DIFF_ONCE, diff_select);
+}
+
+
+const char *diff_impl_name(void)
+{
+  diff_init();
+  return DIFF_IMPL_NAME;
+}
+
+
+/**
+ * Function to find the offset of each entry of allData, and of its value
+ *
+ * @return size_t	number of entries, else DIFF_MAX_ENTRIES + 1 if allData 
+ * 		is malformed or has too many entries
+ */
+static size_t diff_entries(const uint8_t *data, size_t len, uint16_t *start, 
+ uint16_t *value)
+{
+  /* Declare local variables */
+  size_t off = 0;                                  /* Offset of the entry */
+  size_t entry_len = 0;                       /* Length of the entry value */
+  uint8_t len_size = 0;            /* Number of octets in the length field */
+  size_t n = 0;                                     /* Number of entries */
+
+  while (off < len)
+  {
+    if (DIFF_MAX_ENTRIES == n)
+    {
+      return DIFF_MAX_ENTRIES + 1;
+    }
+    len_size = ber_len_from_bytes(data + off + 1, len - off - 1, &entry_len);
+    if (len - off < 2 || 0 == len_size 
+     || entry_len > len - off - 1 - len_size)
+    {
+      return DIFF_MAX_ENTRIES + 1;
+    }
+    start[n] = (uint16_t)off;
+    value[n++] = (uint16_t)(off + 1 + len_size);
+    off += 1 + len_size + entry_len;
+  }
+  start[n] = (uint16_t)len;
+  return n;
+}
+
+
+int diff_update(diff_state_t *state, const uint8_t *all_data, size_t len, 
+ uint64_t *changed, size_t *count)
+{
+  /* Check parameters */
+  if (NULL == state || NULL == changed || NULL == count 
+   || (NULL == all_data && len > 0) || len > MAX_FRAME_SIZE)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  uint16_t start[DIFF_MAX_ENTRIES + 1];    /* Entry offsets of the new state */
+  uint16_t value[DIFF_MAX_ENTRIES];        /* Value offsets of the new state */
+  size_t n = 0;                            /* Entries of the new state */
+  size_t i = 0;                                         /* Entry index */
+
+  diff_init();
+
+  /* Compare with the layout kept, which holds while only values differ, 
+   * so a state of the same length is not walked at all */
+  memset(changed, 0, DIFF_MASK_WORDS * sizeof(uint64_t));
+  if (state->valid && len == state->len 
+   && 0 == DIFF_IMPL(state->data, all_data, len, state->start, state->value, 
+    changed))
+  {
+    if (len > 0)
+    {
+      memcpy(state->data, all_data, len);
+    }
+    *count = state->count;
+    return 0;
+  }
+
+  /* An entry changed length, or this is the first state */
+  n = diff_entries(all_data, len, start, value);
+  if (n > DIFF_MAX_ENTRIES)
+  {
+    return -1;
+  }
+  memset(changed, 0, DIFF_MASK_WORDS * sizeof(uint64_t));
+  for (i = 0; i < n; i++)
+  {
+    if (!state->valid || i >= state->count 
+     || start[i + 1] - start[i] != state->start[i + 1] - state->start[i] 
+     || 0 != memcmp(all_data + start[i], state->data + state->start[i], 
+      start[i + 1] - start[i]))
+    {
+      changed[i / 64] |= 1ULL << (i % 64);
+    }
+  }
+  memcpy(state->start, start, (n + 1) * sizeof(uint16_t));
+  memcpy(state->value, value, n * sizeof(uint16_t));
+  state->count = n;
+
+  /* Keep the new state */
+  if (len > 0)
+  {
+    memcpy(state->data, all_data, len);
+  }
+  state->len = len;
+  state->valid = 1;
+  *count = n;
+
+  /* Done */
+  return 0;
+}
@@ -0,0 +1,525 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "farm.h"
+#include "goose.h"
+#include "probes.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+
+
+/*
+ * Function Definitions
+ */
+
+/**
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to sleep until an absolute deadline on the monotonic clock
+ */
+static void wait_until(const farm_t *farm, uint64_t deadline)
+{
+  /* Declare local variables */
+  struct timespec ts;                                /* Time to sleep until */
+
+  ts.tv_sec = (time_t)(deadline / 1000000000ULL);
+  ts.tv_nsec = (long)(deadline % 1000000000ULL);
+  while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) 
+   && (NULL == farm->stop || !*farm->stop))
+  {
+    /* Resume the sleep if interrupted by anything other than a stop */
+  }
+}
+
+
+/**
+ * Function to return the next value of the xorshift64* generator of a 
+ * scheduler
+ */
+static uint64_t farm_random(farm_t *farm)
+{
+  farm->rng ^= farm->rng >> 12;
+  farm->rng ^= farm->rng << 25;
+  farm->rng ^= farm->rng >> 27;
+  return farm->rng * 2685821657736338717ULL;
+}
+
+
+/**
+ * Function to return the time to the next random state change of the IEDs 
+ * of a scheduler, exponentially distributed
+ */
+static uint64_t farm_next_event(farm_t *farm)
+{
+  /* Declare local variables */
+  double u = (double)((farm_random(farm) >> 11) + 1) / 9007199254740993.0;
+
+  return (uint64_t)(-log(u) * (double)farm->event_ns / farm->num_ieds);
+}
+
+
+/**
+ * Function to restore the heap order from a position towards the root
+ */
+static void heap_up(farm_t *farm, uint32_t pos)
+{
+  /* Declare local variables */
+  uint32_t i = farm->heap[pos];                       /* IED being moved */
+  uint32_t parent = 0;                              /* Position of parent */
+
+  while (pos > 0)
+  {
+    parent = (pos - 1) / 2;
+    if (farm->ied[farm->heap[parent]].deadline <= farm->ied[i].deadline)
+    {
+      break;
+    }
+    farm->heap[pos] = farm->heap[parent];
+    farm->ied[farm->heap[pos]].heap = pos;
+    pos = parent;
+  }
+  farm->heap[pos] = i;
+  farm->ied[i].heap = pos;
+}
+
+
+/**
+ * Function to restore the heap order from a position towards the leaves
+ */
+static void heap_down(farm_t *farm, uint32_t pos)
+{
+  /* Declare local variables */
+  uint32_t i = farm->heap[pos];                       /* IED being moved */
+  uint32_t child = 0;                           /* Position of next child */
+
+  while ((child = 2 * pos + 1) < farm->num_ieds)
+  {
+    if (child + 1 < farm->num_ieds && farm->ied[farm->heap[child + 1]].deadline 
+     < farm->ied[farm->heap[child]].deadline)
+    {
+      child++;
+    }
+    if (farm->ied[i].deadline <= farm->ied[farm->heap[child]].deadline)
+    {
+      break;
+    }
+    farm->heap[pos] = farm->heap[child];
+    farm->ied[farm->heap[pos]].heap = pos;
+    pos = child;
+  }
+  farm->heap[pos] = i;
+  farm->ied[i].heap = pos;
+}
+
+
+/**
+ * Function to change the state of an IED, an entry of its dataset set to a 
+ * value, and move it to the start of its retransmission curve
+ */
+static void farm_change(farm_t *farm, farm_ied_t *ied, uint32_t entry, 
+  uint8_t value, uint64_t now)
+{
+  ied->all_data[3 * entry + 2] = value;
+  ied->frame.goose_pdu.stNum++;
+  ied->frame.goose_pdu.sqNum = 0;
+  gettimeofday(&(ied->t.timeval), NULL);
+  ied->deadline = now;
+  ied->interval = (uint64_t)farm->tmpl->min_time_ms * 1000000ULL;
+  heap_up(farm, ied->heap);
+  farm->events++;
+}
+
+
+void farm_template_init(farm_template_t *tmpl)
+{
+  /* Declare local variables */
+  static const uint8_t DMAC[6] = { 0x01, 0x0c, 0xcd, 0x01, 0x00, 0x00 }; 
+  static const uint8_t SMAC[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 };
+
+  memset(tmpl, 0, sizeof(farm_template_t));
+  snprintf(tmpl->name, FARM_NAME_LEN, "VIED");
+  memcpy(tmpl->dmac, DMAC, 6);
+  memcpy(tmpl->smac, SMAC, 6);
+  tmpl->appid = 0x1000;
+  tmpl->confRev = 1;
+  tmpl->numDatSetEntries = 8;
+  tmpl->min_time_ms = FARM_MIN_TIME_MS;
+  tmpl->max_time_ms = FARM_MAX_TIME_MS;
+}
+
+
+int farm_init(farm_t *farm, const farm_template_t *tmpl, uint32_t first, 
+  uint32_t count)
+{
+  /* Check parameters */
+  if (NULL == farm || NULL == tmpl || 0 == count 
+   || 0 == tmpl->numDatSetEntries 
+   || FARM_MAX_ENTRIES < tmpl->numDatSetEntries 
+   || 0 == tmpl->min_time_ms || tmpl->min_time_ms > tmpl->max_time_ms)
+  {
+    fprintf(stderr, "ERROR: invalid farm template\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  farm_ied_t *ied = NULL;                                  /* IED created */
+  uint32_t n = 0;                                  /* Number of the IED */
+  uint32_t host = 0;                     /* Host part of a source address */
+  uint8_t mac[ETHER_ADDR_LEN];                  /* Address of the IED */
+  uint32_t i = 0;                                            /* IED index */
+  uint32_t j = 0;                                          /* Entry index */
+
+  memset(farm, 0, sizeof(farm_t));
+  farm->tmpl = tmpl;
+  farm->first = first;
+  farm->num_ieds = count;
+  farm->batch_ns = FARM_BATCH_NS;
+  farm->rng = 0x9e3779b97f4a7c15ULL ^ ((uint64_t)first << 32) ^ now_ns();
+  farm->ied = (farm_ied_t *)calloc(count, sizeof(farm_ied_t));
+  farm->heap = (uint32_t *)calloc(count, sizeof(uint32_t));
+  if (NULL == farm->ied || NULL == farm->heap)
+  {
+    fprintf(stderr, "ERROR: unable to allocate %u IEDs\n", count);
+    farm_free(farm);
+    return -1;
+  }
+
+  /* Each IED is the template with its own identity, the frames point at 
+   * the strings and dataset of their IED, which never move */
+  for (i = 0; i < count; i++)
+  {
+    ied = &(farm->ied[i]);
+    n = first + i;
+    ied->index = n;
+    snprintf(ied->goID, FARM_REF_LEN, "%.23s%05u", tmpl->name, n);
+    snprintf(ied->gocbref, FARM_REF_LEN, "%.23s%05u/LLN0$GO$gcb01", 
+     tmpl->name, n);
+    snprintf(ied->datSet, FARM_REF_LEN, "%.23s%05u/LLN0$DS01", tmpl->name, n);
+    for (j = 0; j < tmpl->numDatSetEntries; j++)
+    {
+      ied->all_data[3 * j] = 0x83;
+      ied->all_data[3 * j + 1] = 1;
+    }
+
+    memcpy(mac, tmpl->dmac, 6);
+    mac[4] = (uint8_t)((tmpl->dmac[4] + ((tmpl->dmac[5] + n) >> 8)) & 0xff);
+    mac[5] = (uint8_t)((tmpl->dmac[5] + n) & 0xff);
+    set_dest_mac(&(ied->frame), mac);
+    memcpy(mac, tmpl->smac, 6);
+    host = ((uint32_t)tmpl->smac[3] << 16 | (uint32_t)tmpl->smac[4] << 8 
+     | tmpl->smac[5]) + n;
+    mac[3] = (uint8_t)((host >> 16) & 0xff);
+    mac[4] = (uint8_t)((host >> 8) & 0xff);
+    mac[5] = (uint8_t)(host & 0xff);
+    set_src_mac(&(ied->frame), mac);
+    ied->frame.eth_hdr.ether_type = htons(ETHER_GOOSE);
+    if (tmpl->vlan.tagged)
+    {
+      set_vlan(&(ied->frame), tmpl->vlan.vid, tmpl->vlan.pcp);
+    }
+    ied->frame.goose_header.appid = htons((uint16_t)((tmpl->appid + n) 
+     & 0x3fff));
+    ied->frame.goose_pdu.gocbref = (uint8_t *)ied->gocbref;
+    ied->frame.goose_pdu.datSet = (uint8_t *)ied->datSet;
+    ied->frame.goose_pdu.goID = (uint8_t *)ied->goID;
+    ied->frame.goose_pdu.t = &(ied->t);
+    ied->frame.goose_pdu.stNum = 1;
+    ied->frame.goose_pdu.confRev = tmpl->confRev;
+    ied->frame.goose_pdu.numDatSetEntries = tmpl->numDatSetEntries;
+    ied->frame.goose_pdu.allData = ied->all_data;
+    ied->frame.goose_pdu.allDataLen = (uint16_t)(3 * tmpl->numDatSetEntries);
+    gettimeofday(&(ied->t.timeval), NULL);
+    farm->heap[i] = i;
+    ied->heap = i;
+  }
+
+  /* Done */
+  return 0;
+}
+
+
+void farm_free(farm_t *farm)
+{
+  if (NULL != farm)
+  {
+    free(farm->ied);
+    free(farm->heap);
+    farm->ied = NULL;
+    farm->heap = NULL;
+  }
+}
+
+
+/**
+ * Function to order scripted state changes by time
+ */
+static int event_cmp(const void *a, const void *b)
+{
+  /* Declare local variables */
+  const farm_event_t *ea = (const farm_event_t *)a;            /* Change a */
+  const farm_event_t *eb = (const farm_event_t *)b;            /* Change b */
+
+  return (ea->at_ns > eb->at_ns) - (ea->at_ns < eb->at_ns);
+}
+
+
+int farm_load_script(const char *path, farm_event_t **events, size_t *count)
+{
+  /* Check parameters */
+  if (NULL == path || NULL == events || NULL == count)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  FILE *in = NULL;                                             /* Script */
+  char line[256];                                       /* Line of script */
+  unsigned long long ms = 0;                         /* Time of a change */
+  unsigned int ied = 0;                                /* IED of a change */
+  unsigned int entry = 0;                            /* Entry of a change */
+  unsigned int value = 0;                            /* Value of a change */
+  farm_event_t *grown = NULL;                          /* Changes resized */
+  size_t max = 0;                                    /* Changes allocated */
+  unsigned int num = 0;                                    /* Line number */
+  char *hash = NULL;                                  /* Start of comment */
+
+  in = fopen(path, "r");
+  if (NULL == in)
+  {
+    fprintf(stderr, "ERROR: could not open script %s (%s)\n", path, 
+     strerror(errno));
+    return -1;
+  }
+  *events = NULL;
+  *count = 0;
+  while (NULL != fgets(line, sizeof(line), in))
+  {
+    num++;
+    hash = strchr(line, '#');
+    if (NULL != hash)
+    {
+      *hash = '\0';
+    }
+    if (strspn(line, " \t\r\n") == strlen(line))
+    {
+      continue;
+    }
+    if (4 != sscanf(line, "%llu %u %u %u", &ms, &ied, &entry, &value) 
+     || entry >= FARM_MAX_ENTRIES || value > 1)
+    {
+      fprintf(stderr, "ERROR: %s:%u is not 'ms ied entry 0|1'\n", path, num);
+      break;
+    }
+    if (*count == max)
+    {
+      max = max ? 2 * max : 64;
+      grown = (farm_event_t *)realloc(*events, max * sizeof(farm_event_t));
+      if (NULL == grown)
+      {
+        fprintf(stderr, "ERROR: unable to allocate memory\n");
+        break;
+      }
+      *events = grown;
+    }
+    (*events)[*count].at_ns = ms * 1000000ULL;
+    (*events)[*count].ied = ied;
+    (*events)[*count].entry = entry;
+    (*events)[(*count)++].value = (uint8_t)value;
+  }
+  if (!feof(in))
+  {
+    fclose(in);
+    free(*events);
+    *events = NULL;
+    *count = 0;
+    return -1;
+  }
+  fclose(in);
+
+  /* Done */
+  qsort(*events, *count, sizeof(farm_event_t), event_cmp);
+  return 0;
+}
+
+
+int farm_run(farm_t *farm, transport_t *tp, uint64_t start, unsigned int secs)
+{
+  /* Check parameters */
+  if (NULL == farm || NULL == farm->ied || NULL == tp)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  uint8_t buf[TRANSPORT_BATCH_MAX][MAX_FRAME_SIZE];     /* Frames of a batch */
+  uint8_t *frames[TRANSPORT_BATCH_MAX];               /* Pointers to frames */
+  size_t lens[TRANSPORT_BATCH_MAX];                  /* Bytes of each frame */
+  uint64_t due[TRANSPORT_BATCH_MAX];              /* Deadline of each frame */
+  uint64_t next[TRANSPORT_BATCH_MAX];   /* Deadline of the IED's next frame */
+  uint64_t max_ns = (uint64_t)farm->tmpl->max_time_ms * 1000000ULL;
+  uint64_t end = start + (uint64_t)secs * 1000000000ULL;   /* End of the run */
+  uint64_t event = UINT64_MAX;               /* Time of next random change */
+  uint64_t deadline = 0;                    /* Time of next frame or change */
+  uint64_t horizon = 0;                  /* Latest deadline of the batch */
+  uint64_t done = 0;                            /* Time a batch was sent */
+  farm_ied_t *ied = NULL;                             /* IED of next frame */
+  const farm_event_t *script = NULL;                /* Next scripted change */
+  size_t scripted = 0;                          /* Scripted changes applied */
+  uint16_t len = 0;                                /* Bytes of a frame */
+  uint32_t i = 0;                                            /* IED index */
+  int count = 0;                                   /* Frames of the batch */
+  int sent = 0;                               /* Frames of the batch sent */
+  int k = 0;                                               /* Frame index */
+
+  for (k = 0; k < TRANSPORT_BATCH_MAX; k++)
+  {
+    frames[k] = buf[k];
+  }
+
+  /* Every IED starts on its heartbeat at a random phase, so that the farm 
+   * does not publish in bursts */
+  for (i = 0; i < farm->num_ieds; i++)
+  {
+    farm->ied[i].deadline = start + farm_random(farm) % max_ns;
+    farm->ied[i].interval = max_ns;
+  }
+  for (i = farm->num_ieds / 2; i-- > 0;)
+  {
+    heap_down(farm, i);
+  }
+  if (farm->event_ns)
+  {
+    event = start + farm_next_event(farm);
+  }
+
+  while (NULL == farm->stop || !*farm->stop)
+  {
+    /* Skip the scripted changes of the IEDs of other schedulers */
+    while (scripted < farm->num_script 
+     && (farm->script[scripted].ied < farm->first 
+      || farm->script[scripted].ied >= farm->first + farm->num_ieds 
+      || farm->script[scripted].entry >= farm->tmpl->numDatSetEntries))
+    {
+      scripted++;
+    }
+    script = (scripted < farm->num_script) ? &(farm->script[scripted]) : NULL;
+
+    /* Next frame, or state change, whichever is first */
+    ied = &(farm->ied[farm->heap[0]]);
+    deadline = ied->deadline;
+    deadline = (event < deadline) ? event : deadline;
+    if (NULL != script && start + script->at_ns < deadline)
+    {
+      deadline = start + script->at_ns;
+    }
+    if (deadline >= end)
+    {
+      break;
+    }
+    wait_until(farm, deadline);
+
+    /* State changes due are applied first, so that their first frame goes 
+     * out with this batch */
+    if (NULL != script && start + script->at_ns <= deadline)
+    {
+      farm_change(farm, &(farm->ied[script->ied - farm->first]), 
+       script->entry, script->value, deadline);
+      scripted++;
+      continue;
+    }
+    if (event <= deadline)
+    {
+      ied = &(farm->ied[farm_random(farm) % farm->num_ieds]);
+      i = (uint32_t)(farm_random(farm) % farm->tmpl->numDatSetEntries);
+      farm_change(farm, ied, i, (uint8_t)(ied->all_data[3 * i + 2] ^ 1), 
+       deadline);
+      event += farm_next_event(farm);
+      continue;
+    }
+
+    /* Encode the frames due within the window, or already due, each IED 
+     * then rescheduled on its curve */
+    done = now_ns();
+    horizon = ((deadline > done) ? deadline : done) + farm->batch_ns;
+    for (count = 0; count < TRANSPORT_BATCH_MAX 
+     && farm->ied[farm->heap[0]].deadline <= horizon; count++)
+    {
+      ied = &(farm->ied[farm->heap[0]]);
+      ied->frame.goose_pdu.timeAllowedtoLive = 
+       (uint32_t)(2 * ied->interval / 1000000ULL);
+      encode_goose_frame(&(ied->frame), buf[count], &len);
+      lens[count] = len;
+      due[count] = ied->deadline;
+      GOOSE_PROBE(publish_start, ntohs(ied->frame.goose_header.appid), 
+       ied->frame.goose_pdu.stNum, ied->frame.goose_pdu.sqNum);
+      ied->frame.goose_pdu.sqNum++;
+      ied->deadline += ied->interval;
+      next[count] = ied->deadline;
+      ied->interval = (2 * ied->interval < max_ns) ? 2 * ied->interval : max_ns;
+      heap_down(farm, 0);
+    }
+
+    sent = transport_send_batch(tp, frames, lens, count);
+    done = now_ns();
+    sent = (sent < 0) ? 0 : sent;
+    farm->batches++;
+    farm->frames += (uint64_t)sent;
+    farm->errors += (uint64_t)(count - sent);
+    for (k = 0; k < count; k++)
+    {
+      farm->overruns += (done >= next[k]);
+      if (NULL != farm->late && farm->timed < farm->max_late)
+      {
+        farm->late[farm->timed++] = (done > due[k]) ? done - due[k] : 0;
+      }
+    }
+  }
+
+  /* Done */
+  return 0;
+}
@@ -0,0 +1,560 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "gmac.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_AESNI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+
+/*
+ * Constants
+ */
+
+/** AES S-box (See: FIPS-197 Figure 7)
+ */
+static const uint8_t SBOX[256] = {
+  0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b,
+  0xfe, 0xd7, 0xab, 0x76, 0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+  0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0, 0xb7, 0xfd, 0x93, 0x26,
+  0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+  0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2,
+  0xeb, 0x27, 0xb2, 0x75, 0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+  0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84, 0x53, 0xd1, 0x00, 0xed,
+  0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+  0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f,
+  0x50, 0x3c, 0x9f, 0xa8, 0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+  0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2, 0xcd, 0x0c, 0x13, 0xec,
+  0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+  0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14,
+  0xde, 0x5e, 0x0b, 0xdb, 0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+  0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79, 0xe7, 0xc8, 0x37, 0x6d,
+  0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+  0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f,
+  0x4b, 0xbd, 0x8b, 0x8a, 0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+  0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e, 0xe1, 0xf8, 0x98, 0x11,
+  0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+  0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f,
+  0xb0, 0x54, 0xbb, 0x16
+};
+
+/** Reduction constants for the 4-bit GHASH table method
+ */
+static const uint64_t LAST4[16] = {
+  0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+  0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+};
+
+
+/*
+ * Macros
+ */
+
+#define GET_UI32_BE(B) \
+ (((uint32_t)(B)[0] << 24) | ((uint32_t)(B)[1] << 16) \
+  | ((uint32_t)(B)[2] << 8) | (uint32_t)(B)[3])
+
+#define PUT_UI32_BE(V, B) \
+do \
+{ \
+  (B)[0] = (uint8_t)((V) >> 24); \
+  (B)[1] = (uint8_t)((V) >> 16); \
+  (B)[2] = (uint8_t)((V) >> 8); \
+  (B)[3] = (uint8_t)(V); \
+} \
+while (0)
+
+#define ROTR8(X) (((X) >> 8) | ((X) << 24))
+
+
+/*
+ * Global variables
+ */
+
+/** AES encryption table combining SubBytes and MixColumns, the other three 
+ * tables of the usual four are byte rotations of this one
+ */
+static uint32_t TE0[256];
+
+/** Selected GMAC implementation */
+static void gmac_portable(const gmac_key_t *key, const uint8_t *iv, 
+ const uint8_t *msg, size_t len, uint8_t *tag);
+static void (*GMAC_IMPL)(const gmac_key_t *, const uint8_t *, 
+ const uint8_t *, size_t, uint8_t *) = gmac_portable;
+static const char *GMAC_IMPL_NAME = "portable";
+
+static pthread_once_t GMAC_ONCE = PTHREAD_ONCE_INIT;
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to encrypt a single block with the portable table-driven AES
+ */
+static void aes_encrypt_portable(const gmac_key_t *key, const uint8_t *in, 
+ uint8_t *out)
+{
+  /* Declare local variables */
+  const uint32_t *rk = key->w;                         /* Round key words */
+  uint32_t s0, s1, s2, s3;                                 /* Cipher state */
+  uint32_t t0, t1, t2, t3;                            /* Next cipher state */
+  int r = 0;                                                  /* Round index */
+
+  s0 = GET_UI32_BE(in) ^ rk[0];
+  s1 = GET_UI32_BE(in + 4) ^ rk[1];
+  s2 = GET_UI32_BE(in + 8) ^ rk[2];
+  s3 = GET_UI32_BE(in + 12) ^ rk[3];
+
+  for (r = 1; r < key->rounds; r++)
+  {
+    rk += 4;
+    t0 = TE0[s0 >> 24] ^ ROTR8(TE0[(s1 >> 16) & 0xff]) 
+     ^ ROTR8(ROTR8(TE0[(s2 >> 8) & 0xff])) 
+     ^ ROTR8(ROTR8(ROTR8(TE0[s3 & 0xff]))) ^ rk[0];
+    t1 = TE0[s1 >> 24] ^ ROTR8(TE0[(s2 >> 16) & 0xff]) 
+     ^ ROTR8(ROTR8(TE0[(s3 >> 8) & 0xff])) 
+     ^ ROTR8(ROTR8(ROTR8(TE0[s0 & 0xff]))) ^ rk[1];
+    t2 = TE0[s2 >> 24] ^ ROTR8(TE0[(s3 >> 16) & 0xff]) 
+     ^ ROTR8(ROTR8(TE0[(s0 >> 8) & 0xff])) 
+     ^ ROTR8(ROTR8(ROTR8(TE0[s1 & 0xff]))) ^ rk[2];
+    t3 = TE0[s3 >> 24] ^ ROTR8(TE0[(s0 >> 16) & 0xff]) 
+     ^ ROTR8(ROTR8(TE0[(s1 >> 8) & 0xff])) 
+     ^ ROTR8(ROTR8(ROTR8(TE0[s2 & 0xff]))) ^ rk[3];
+    s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+  }
+
+  /* Final round has no MixColumns */
+  rk += 4;
+  t0 = ((uint32_t)SBOX[s0 >> 24] << 24) ^ ((uint32_t)SBOX[(s1 >> 16) & 0xff] << 16)
+   ^ ((uint32_t)SBOX[(s2 >> 8) & 0xff] << 8) ^ (uint32_t)SBOX[s3 & 0xff] ^ rk[0];
+  t1 = ((uint32_t)SBOX[s1 >> 24] << 24) ^ ((uint32_t)SBOX[(s2 >> 16) & 0xff] << 16)
+   ^ ((uint32_t)SBOX[(s3 >> 8) & 0xff] << 8) ^ (uint32_t)SBOX[s0 & 0xff] ^ rk[1];
+  t2 = ((uint32_t)SBOX[s2 >> 24] << 24) ^ ((uint32_t)SBOX[(s3 >> 16) & 0xff] << 16)
+   ^ ((uint32_t)SBOX[(s0 >> 8) & 0xff] << 8) ^ (uint32_t)SBOX[s1 & 0xff] ^ rk[2];
+  t3 = ((uint32_t)SBOX[s3 >> 24] << 24) ^ ((uint32_t)SBOX[(s0 >> 16) & 0xff] << 16)
+   ^ ((uint32_t)SBOX[(s1 >> 8) & 0xff] << 8) ^ (uint32_t)SBOX[s2 & 0xff] ^ rk[3];
+
+  PUT_UI32_BE(t0, out);
+  PUT_UI32_BE(t1, out + 4);
+  PUT_UI32_BE(t2, out + 8);
+  PUT_UI32_BE(t3, out + 12);
+}
+
+
+/**
+ * Function to multiply the block x by H in GF(2^128) using the 4-bit table
+ */
+static void ghash_mult_portable(const gmac_key_t *key, uint8_t *x)
+{
+  /* Declare local variables */
+  uint64_t zh = 0;                               /* High half of product */
+  uint64_t zl = 0;                                /* Low half of product */
+  uint8_t lo = 0;                                    /* Low nibble of byte */
+  uint8_t hi = 0;                                   /* High nibble of byte */
+  uint8_t rem = 0;                            /* Nibble shifted out of zl */
+  int i = 0;                                                   /* Loop index */
+
+  lo = x[15] & 0xf;
+  zh = key->hh[lo];
+  zl = key->hl[lo];
+
+  for (i = 15; i >= 0; i--)
+  {
+    lo = x[i] & 0xf;
+    hi = (x[i] >> 4) & 0xf;
+
+    if (i != 15)
+    {
+      rem = (uint8_t)(zl & 0xf);
+      zl = (zh << 60) | (zl >> 4);
+      zh = (zh >> 4) ^ (LAST4[rem] << 48);
+      zh ^= key->hh[lo];
+      zl ^= key->hl[lo];
+    }
+
+    rem = (uint8_t)(zl & 0xf);
+    zl = (zh << 60) | (zl >> 4);
+    zh = (zh >> 4) ^ (LAST4[rem] << 48);
+    zh ^= key->hh[hi];
+    zl ^= key->hl[hi];
+  }
+
+  PUT_UI32_BE((uint32_t)(zh >> 32), x);
+  PUT_UI32_BE((uint32_t)zh, x + 4);
+  PUT_UI32_BE((uint32_t)(zl >> 32), x + 8);
+  PUT_UI32_BE((uint32_t)zl, x + 12);
+}
+
+
+/**
+ * Function to compute the GMAC tag with the portable implementation
+ */
+static void gmac_portable(const gmac_key_t *key, const uint8_t *iv, 
+ const uint8_t *msg, size_t len, uint8_t *tag)
+{
+  /* Declare local variables */
+  uint8_t x[GMAC_BLOCK_LEN] = {0};                    /* GHASH accumulator */
+  uint8_t j0[GMAC_BLOCK_LEN];                        /* Pre-counter block */
+  uint64_t bits = (uint64_t)len << 3;       /* Message length in bits */
+  size_t n = 0;                                 /* Bytes in current block */
+  size_t i = 0;                                                /* Loop index */
+
+  /* GHASH the message, zero padding the last block */
+  while (len > 0)
+  {
+    n = (len < GMAC_BLOCK_LEN) ? len : GMAC_BLOCK_LEN;
+    for (i = 0; i < n; i++)
+    {
+      x[i] ^= msg[i];
+    }
+    ghash_mult_portable(key, x);
+    msg += n;
+    len -= n;
+  }
+
+  /* GHASH the lengths, the message is AAD and there is no ciphertext */
+  for (i = 0; i < 8; i++)
+  {
+    x[7 - i] ^= (uint8_t)(bits >> (8 * i));
+  }
+  ghash_mult_portable(key, x);
+
+  /* Tag is E(K, IV || 0^31 || 1) XOR GHASH */
+  memcpy(j0, iv, GMAC_IV_LEN);
+  j0[12] = 0; j0[13] = 0; j0[14] = 0; j0[15] = 1;
+  aes_encrypt_portable(key, j0, tag);
+  for (i = 0; i < GMAC_BLOCK_LEN; i++)
+  {
+    tag[i] ^= x[i];
+  }
+}
+
+
+#ifdef HAVE_AESNI
+
+/**
+ * Function to multiply two byte-reflected blocks in GF(2^128) with carry-less 
+ * multiply and reduce modulo the GCM polynomial (See: Intel Carry-Less 
+ * Multiplication and Its Usage for Computing the GCM Mode, Algorithm 5)
+ */
+__attribute__((target("pclmul,sse2")))
+static __m128i ghash_mult_clmul(__m128i a, __m128i b)
+{
+  /* Declare local variables */
+  __m128i t2, t3, t4, t5, t6, t7, t8, t9;
+
+  /* 256-bit carry-less product */
+  t3 = _mm_clmulepi64_si128(a, b, 0x00);
+  t4 = _mm_clmulepi64_si128(a, b, 0x10);
+  t5 = _mm_clmulepi64_si128(a, b, 0x01);
+  t6 = _mm_clmulepi64_si128(a, b, 0x11);
+  t4 = _mm_xor_si128(t4, t5);
+  t5 = _mm_slli_si128(t4, 8);
+  t4 = _mm_srli_si128(t4, 8);
+  t3 = _mm_xor_si128(t3, t5);
+  t6 = _mm_xor_si128(t6, t4);
+
+  /* Shift left by one bit for the reflected representation */
+  t7 = _mm_srli_epi32(t3, 31);
+  t8 = _mm_srli_epi32(t6, 31);
+  t3 = _mm_slli_epi32(t3, 1);
+  t6 = _mm_slli_epi32(t6, 1);
+  t9 = _mm_srli_si128(t7, 12);
+  t8 = _mm_slli_si128(t8, 4);
+  t7 = _mm_slli_si128(t7, 4);
+  t3 = _mm_or_si128(t3, t7);
+  t6 = _mm_or_si128(t6, t8);
+  t6 = _mm_or_si128(t6, t9);
+
+  /* Reduce modulo x^128 + x^7 + x^2 + x + 1 */
+  t7 = _mm_slli_epi32(t3, 31);
+  t8 = _mm_slli_epi32(t3, 30);
+  t9 = _mm_slli_epi32(t3, 25);
+  t7 = _mm_xor_si128(t7, t8);
+  t7 = _mm_xor_si128(t7, t9);
+  t8 = _mm_srli_si128(t7, 4);
+  t7 = _mm_slli_si128(t7, 12);
+  t3 = _mm_xor_si128(t3, t7);
+  t2 = _mm_srli_epi32(t3, 1);
+  t4 = _mm_srli_epi32(t3, 2);
+  t5 = _mm_srli_epi32(t3, 7);
+  t2 = _mm_xor_si128(t2, t4);
+  t2 = _mm_xor_si128(t2, t5);
+  t2 = _mm_xor_si128(t2, t8);
+  t3 = _mm_xor_si128(t3, t2);
+  return _mm_xor_si128(t6, t3);
+}
+
+
+/**
+ * Function to compute the GMAC tag with AES-NI and carry-less multiply
+ */
+__attribute__((target("aes,pclmul,ssse3")))
+static void gmac_aesni(const gmac_key_t *key, const uint8_t *iv, 
+ const uint8_t *msg, size_t len, uint8_t *tag)
+{
+  /* Declare local variables */
+  const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11,
+   12, 13, 14, 15);                        /* Byte reflection shuffle mask */
+  const __m128i *rk = (const __m128i *)key->rk;         /* AES round keys */
+  __m128i h = _mm_shuffle_epi8(_mm_load_si128((const __m128i *)key->h), 
+   bswap);                                           /* Reflected subkey H */
+  __m128i x = _mm_setzero_si128();                  /* GHASH accumulator */
+  __m128i blk;                                        /* Current block */
+  __m128i j0;                                        /* Pre-counter block */
+  uint8_t last[GMAC_BLOCK_LEN];                  /* Zero padded last block */
+  uint8_t j0_bytes[GMAC_BLOCK_LEN];           /* IV || 0^31 || 1 as bytes */
+  uint64_t bits = (uint64_t)len << 3;       /* Message length in bits */
+  int r = 0;                                                  /* Round index */
+
+  /* Start the tag encryption early, it is independent of GHASH */
+  memcpy(j0_bytes, iv, GMAC_IV_LEN);
+  j0_bytes[12] = 0; j0_bytes[13] = 0; j0_bytes[14] = 0; j0_bytes[15] = 1;
+  j0 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)j0_bytes), rk[0]);
+  for (r = 1; r < key->rounds; r++)
+  {
+    j0 = _mm_aesenc_si128(j0, rk[r]);
+  }
+  j0 = _mm_aesenclast_si128(j0, rk[key->rounds]);
+
+  /* GHASH the whole message blocks */
+  while (len >= GMAC_BLOCK_LEN)
+  {
+    blk = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)msg), bswap);
+    x = ghash_mult_clmul(_mm_xor_si128(x, blk), h);
+    msg += GMAC_BLOCK_LEN;
+    len -= GMAC_BLOCK_LEN;
+  }
+
+  /* GHASH the zero padded last block */
+  if (len > 0)
+  {
+    memset(last, 0, GMAC_BLOCK_LEN);
+    memcpy(last, msg, len);
+    blk = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)last), bswap);
+    x = ghash_mult_clmul(_mm_xor_si128(x, blk), h);
+  }
+
+  /* GHASH the lengths, once reflected the AAD bit length is the high half */
+  blk = _mm_set_epi64x((long long)bits, 0);
+  x = ghash_mult_clmul(_mm_xor_si128(x, blk), h);
+
+  /* Tag is E(K, IV || 0^31 || 1) XOR GHASH */
+  x = _mm_xor_si128(_mm_shuffle_epi8(x, bswap), j0);
+  _mm_storeu_si128((__m128i *)tag, x);
+}
+
+#endif /* HAVE_AESNI */
+
+
+/**
+ * Function to check whether the CPU supports the AES-NI implementation
+ */
+static int gmac_aesni_supported(void)
+{
+#ifdef HAVE_AESNI
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) 
+   && (ecx & bit_AES) && (ecx & bit_PCLMUL) && (ecx & bit_SSSE3);
+#else
+  return 0;
+#endif
+}
+
+
+/**
+ * Function to build the AES table and select the implementation, called once
+ */
+static void gmac_select(void)
+{
+  /* Declare local variables */
+  uint32_t s = 0;                                        /* S-box output */
+  uint32_t s2 = 0;                                  /* S-box output times 2 */
+  int i = 0;                                                   /* Loop index */
+
+  /* TE0[x] = (2s, s, s, 3s) for s = S(x) */
+  for (i = 0; i < 256; i++)
+  {
+    s = SBOX[i];
+    s2 = ((s << 1) ^ ((s & 0x80) ? 0x1b : 0)) & 0xff;
+    TE0[i] = (s2 << 24) | (s << 16) | (s << 8) | (s2 ^ s);
+  }
+
+#ifdef HAVE_AESNI
+  if (gmac_aesni_supported())
+  {
+    GMAC_IMPL = gmac_aesni;
+    GMAC_IMPL_NAME = "aesni-pclmul";
+  }
+#endif
+}
+
+
+void gmac_init(void)
+{
+  pthread_once(&GMAC_ONCE, gmac_select);
+}
+
+
+int gmac_set_impl(gmac_impl_t impl)
+{
+  /* The tables are built by the first selection */
+  gmac_init();
+
+  switch (impl)
+  {
+    case GMAC_IMPL_AUTO:
+      return gmac_set_impl(gmac_aesni_supported() 
+       ? GMAC_IMPL_AESNI : GMAC_IMPL_PORTABLE);
+    case GMAC_IMPL_PORTABLE:
+      GMAC_IMPL = gmac_portable;
+      GMAC_IMPL_NAME = "portable";
+      return 0;
+    case GMAC_IMPL_AESNI:
+#ifdef HAVE_AESNI
+      if (gmac_aesni_supported())
+      {
+        GMAC_IMPL = gmac_aesni;
+        GMAC_IMPL_NAME = "aesni-pclmul";
+        return 0;
+      }
+#endif
+      return -1;
+    default:
+      return -1;
+  }
+}
+
+
+const char *gmac_impl_name(void)
+{
+  gmac_init();
+  return GMAC_IMPL_NAME;
+}
+
+
+int gmac_set_key(gmac_key_t *key, const uint8_t *k, size_t k_len)
+{
+  /* Check parameters */
+  if (NULL == key || NULL == k || (16 != k_len && 32 != k_len))
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  int nk = (int)(k_len / 4);                     /* Key length in words */
+  int nw = 0;                               /* Number of round key words */
+  int i = 0;                                                   /* Loop index */
+  int j = 0;                                                   /* Loop index */
+  uint32_t t = 0;                                       /* Temporary word */
+  uint32_t rcon = 0x01;                                /* Round constant */
+  uint64_t vh = 0;                              /* High half of multiple */
+  uint64_t vl = 0;                               /* Low half of multiple */
+  uint64_t carry = 0;                   /* Reduction of the shifted out bit */
+  uint8_t zero[GMAC_BLOCK_LEN] = {0};                   /* All zero block */
+
+  gmac_init();
+  memset(key, 0, sizeof(gmac_key_t));
+  key->rounds = nk + 6;
+  nw = 4 * (key->rounds + 1);
+
+  /* Expand the key (See: FIPS-197 Figure 11) */
+  for (i = 0; i < nk; i++)
+  {
+    key->w[i] = GET_UI32_BE(k + 4 * i);
+  }
+  for (i = nk; i < nw; i++)
+  {
+    t = key->w[i - 1];
+    if (0 == i % nk)
+    {
+      t = (t << 8) | (t >> 24);
+      t = ((uint32_t)SBOX[t >> 24] << 24) | ((uint32_t)SBOX[(t >> 16) & 0xff] << 16)
+       | ((uint32_t)SBOX[(t >> 8) & 0xff] << 8) | (uint32_t)SBOX[t & 0xff];
+      t ^= rcon << 24;
+      rcon = ((rcon << 1) ^ ((rcon & 0x80) ? 0x1b : 0)) & 0xff;
+    }
+    else if (nk > 6 && 4 == i % nk)
+    {
+      t = ((uint32_t)SBOX[t >> 24] << 24) | ((uint32_t)SBOX[(t >> 16) & 0xff] << 16)
+       | ((uint32_t)SBOX[(t >> 8) & 0xff] << 8) | (uint32_t)SBOX[t & 0xff];
+    }
+    key->w[i] = key->w[i - nk] ^ t;
+  }
+  for (i = 0; i < nw; i++)
+  {
+    PUT_UI32_BE(key->w[i], key->rk + 4 * i);
+  }
+
+  /* Hash subkey H = E(K, 0^128) */
+  aes_encrypt_portable(key, zero, key->h);
+
+  /* Table of the multiples of H for each nibble value, in the reflected bit 
+   * order of GCM, so index 8 holds H itself */
+  vh = ((uint64_t)GET_UI32_BE(key->h) << 32) | GET_UI32_BE(key->h + 4);
+  vl = ((uint64_t)GET_UI32_BE(key->h + 8) << 32) | GET_UI32_BE(key->h + 12);
+  key->hh[8] = vh;
+  key->hl[8] = vl;
+  for (i = 4; i > 0; i >>= 1)
+  {
+    carry = (vl & 1) ? 0xe100000000000000ULL : 0;
+    vl = (vh << 63) | (vl >> 1);
+    vh = (vh >> 1) ^ carry;
+    key->hh[i] = vh;
+    key->hl[i] = vl;
+  }
+  for (i = 2; i <= 8; i *= 2)
+  {
+    for (j = 1; j < i; j++)
+    {
+      key->hh[i + j] = key->hh[i] ^ key->hh[j];
+      key->hl[i + j] = key->hl[i] ^ key->hl[j];
+    }
+  }
+
+  return 0;
+}
+
+
+void gmac_compute(const gmac_key_t *key, const uint8_t *iv, 
+ const uint8_t *msg, size_t len, uint8_t *tag)
+{
+  GMAC_IMPL(key, iv, msg, len, tag);
+}
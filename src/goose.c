@@ -30,9 +30,12 @@
  */
 
 #include "goose.h"
+#include "probes.h"
+#include "utctime.h"
 #include "utils.h"
 
 #include <string.h>
+#include <time.h>
 #include <arpa/inet.h> 
 
 
@@ -40,8 +43,12 @@
  * Function Definitions 
  */
 
-void encode_goose_frame(const goose_frame_t *goose_frame, uint8_t *encoded_data,
-  uint16_t *encoded_len) 
+/**
+ * Function to encode a GOOSE frame, see encode_goose_frame(), with t taken 
+ * from the frame, or from the realtime clock if now is non-zero
+ */
+static void encode_goose(const goose_frame_t *goose_frame, 
+  uint8_t *encoded_data, uint16_t *encoded_len, int now) 
 {
   /* Check parameter */
   if (NULL == goose_frame || NULL == encoded_data) 
@@ -52,18 +59,33 @@ void encode_goose_frame(const goose_frame_t *goose_frame, uint8_t *encoded_data,
  
   /* Declare local variables */
   size_t offset = 0;                         /* Offset into the buffer */
+  size_t hdr_offset = 0;          /* Mark offset in buffer of GOOSE header */
   size_t len_offset = 0;      /* Mark offset in buffer for length byte */
+  size_t pdu_len = 0;                     /* Length of GOOSE PDU contents */
+  uint8_t len_size = 0;             /* Number of octets in PDU length field */
   size_t data_len = 0;              /* Length of the GOOSE PDU element */
   uint8_t tag = 0x80;                               /* Tag used for PDU data */
   // TODO: rename to use buffer to encoded data
   uint8_t *buffer = encoded_data;       /* Buffer to contain the encoded data */
 
+  GOOSE_PROBE(encode_start, ntohs(goose_frame->goose_header.appid), 
+   goose_frame->goose_pdu.stNum, goose_frame->goose_pdu.sqNum);
+
+  /* Control blocks with a generated codec are encoded from their dataset */
+  if (NULL != goose_frame->codec)
+  {
+    goose_frame->codec->encode(goose_frame, encoded_data, encoded_len, now);
+    GOOSE_PROBE(encode_done, ntohs(goose_frame->goose_header.appid), 
+     goose_frame->goose_pdu.stNum, goose_frame->goose_pdu.sqNum, 
+     *encoded_len);
+    return;
+  }
+
   /* Encode the ethernet header */
-  data_len = sizeof(struct ether_header);
-  memcpy(buffer, &(goose_frame->eth_hdr), data_len);
-  offset += data_len;
+  offset += encode_eth_header(goose_frame, buffer);
 
   /* Encode the GOOSE header */
+  hdr_offset = offset;
   data_len = sizeof(goose_header_t);
   memcpy(buffer+offset, &(goose_frame->goose_header), data_len);
   offset += data_len;
@@ -75,7 +97,7 @@ void encode_goose_frame(const goose_frame_t *goose_frame, uint8_t *encoded_data,
 
   buffer[offset++] = tag++; /* gocbref */
   data_len = strlen((const char *)(goose_frame->goose_pdu.gocbref));
-  buffer[offset++] = (uint8_t)data_len;
+  offset += ber_len_to_bytes(data_len, buffer+offset);
   if (data_len != 0) 
   {
     memcpy(buffer+offset, goose_frame->goose_pdu.gocbref, data_len);
@@ -88,7 +110,7 @@ void encode_goose_frame(const goose_frame_t *goose_frame, uint8_t *encoded_data,
 
   buffer[offset++] = tag++; /* datSet */
   data_len = strlen((const char *)(goose_frame->goose_pdu.datSet));
-  buffer[offset++] = (uint8_t)data_len;
+  offset += ber_len_to_bytes(data_len, buffer+offset);
   if (data_len != 0) 
   {
     memcpy(buffer+offset, goose_frame->goose_pdu.datSet, data_len);
@@ -97,7 +119,7 @@ void encode_goose_frame(const goose_frame_t *goose_frame, uint8_t *encoded_data,
 
   buffer[offset++] = tag++; /* goID (optional) */
   data_len = strlen((const char *)(goose_frame->goose_pdu.goID));
-  buffer[offset++] = (uint8_t)data_len;
+  offset += ber_len_to_bytes(data_len, buffer+offset);
   if (data_len != 0) 
   {
     memcpy(buffer+offset, goose_frame->goose_pdu.goID, data_len);
@@ -106,7 +128,14 @@ void encode_goose_frame(const goose_frame_t *goose_frame, uint8_t *encoded_data,
 
   buffer[offset++] = tag++; /* t */
   buffer[offset++] = 0x8; 
-  timevalq_to_bytes(goose_frame->goose_pdu.t, (uint8_t *)(buffer+offset));
+  if (now)
+  {
+    utc_time_now(goose_frame->goose_pdu.t->time_quality, buffer+offset);
+  }
+  else
+  {
+    timevalq_to_bytes(goose_frame->goose_pdu.t, (uint8_t *)(buffer+offset));
+  }
   offset += 0x8;
 
   buffer[offset++] = tag++; /* stNum */
@@ -133,21 +162,452 @@ void encode_goose_frame(const goose_frame_t *goose_frame, uint8_t *encoded_data,
   buffer[offset++] = num_bytes_for_ui32(goose_frame->goose_pdu.numDatSetEntries);
   offset += ui32_to_bytes(goose_frame->goose_pdu.numDatSetEntries, (uint8_t *)(buffer+offset));
 
-  /* allData */
-  /* TODO: Implement this */
+  /* allData, the entries are already BER encoded by the application */
+  if (NULL != goose_frame->goose_pdu.allData)
+  {
+    data_len = goose_frame->goose_pdu.allDataLen;
+    if (offset + 6 + data_len > MAX_FRAME_SIZE)
+    {
+      *encoded_len = 0;
+      return;
+    }
+    buffer[offset++] = GOOSE_ALLDATA_TAG;
+    offset += ber_len_to_bytes(data_len, buffer+offset);
+    memcpy(buffer+offset, goose_frame->goose_pdu.allData, data_len);
+    offset += data_len;
+  }
+
   /* security (optional) */
   /* TODO: Implement this */
 
-  /* Update the GOOSE PDU length */
-  /* TODO: There is a bug here in the calculation of the length */
-  buffer[len_offset] = ((offset - len_offset));
+  /* Update the GOOSE PDU length, moving the contents up if the length needs 
+   * the long form */
+  pdu_len = offset - (len_offset + 1);
+  len_size = ber_len_size(pdu_len);
+  if (len_size > 1)
+  {
+    memmove(buffer + len_offset + len_size, buffer + len_offset + 1, pdu_len);
+    offset += len_size - 1;
+  }
+  ber_len_to_bytes(pdu_len, buffer + len_offset);
+
+  /* Update the GOOSE header length, counted from the start of APPID */
+  data_len = offset - hdr_offset;
+  buffer[hdr_offset + 2] = (uint8_t)(data_len >> 8);
+  buffer[hdr_offset + 3] = (uint8_t)(data_len & 0xff);
 
   /* Update the encoded buffer length */ 
   *encoded_len = offset;
+  GOOSE_PROBE(encode_done, ntohs(goose_frame->goose_header.appid), 
+   goose_frame->goose_pdu.stNum, goose_frame->goose_pdu.sqNum, offset);
   return;
 }
 
 
+void encode_goose_frame(const goose_frame_t *goose_frame, uint8_t *encoded_data,
+  uint16_t *encoded_len) 
+{
+  encode_goose(goose_frame, encoded_data, encoded_len, 0);
+}
+
+
+void encode_goose_frame_now(const goose_frame_t *goose_frame, 
+  uint8_t *encoded_data, uint16_t *encoded_len) 
+{
+  encode_goose(goose_frame, encoded_data, encoded_len, 1);
+}
+
+
+size_t encode_eth_header(const goose_frame_t *goose_frame, 
+  uint8_t *encoded_data)
+{
+  /* Check parameter */
+  if (NULL == goose_frame || NULL == encoded_data) 
+  {
+    return 0;
+  }
+
+  /* Frames not set up by set_*() have no encoded header to copy */
+  if (0 == goose_frame->eth_prefix_len)
+  {
+    return encode_ether_vlan(&(goose_frame->eth_hdr), &(goose_frame->vlan), 
+     encoded_data);
+  }
+
+  /* Copy the addresses and tag, the ethertype may have been set since */
+  memcpy(encoded_data, goose_frame->eth_prefix, goose_frame->eth_prefix_len);
+  memcpy(encoded_data + goose_frame->eth_prefix_len, 
+   &(goose_frame->eth_hdr.ether_type), 2);
+  return goose_frame->eth_prefix_len + 2u;
+}
+
+
+/* Encode the addresses and tag of the frame, ahead of the ethertype, once 
+ * for every frame encoded afterwards */
+static void set_eth_prefix(goose_frame_t *goose_frame)
+{
+  /* Declare local variables */
+  uint8_t hdr[ETHER_HDR_LEN + VLAN_TAG_LEN];          /* Encoded header */
+  size_t len = 0;                                     /* Bytes encoded */
+
+  len = encode_ether_vlan(&(goose_frame->eth_hdr), &(goose_frame->vlan), hdr);
+  memcpy(goose_frame->eth_prefix, hdr, len - 2);
+  goose_frame->eth_prefix_len = (uint8_t)(len - 2);
+}
+
+
+size_t encode_ether_vlan(const struct ether_header *eth_hdr, 
+  const vlan_tag_t *vlan, uint8_t *encoded_data)
+{
+  /* Check parameter */
+  if (NULL == eth_hdr || NULL == vlan || NULL == encoded_data) 
+  {
+    return 0;
+  }
+
+  /* Declare local variables */
+  uint16_t tci = 0;                        /* 802.1Q tag control information */
+
+  /* Untagged frames are the ethernet header as is */
+  if (!vlan->tagged)
+  {
+    memcpy(encoded_data, eth_hdr, ETHER_HDR_LEN);
+    return ETHER_HDR_LEN;
+  }
+
+  /* Tagged frames insert TPID and TCI ahead of the ethertype */
+  tci = (uint16_t)(((vlan->pcp & 0x7) << 13) | (vlan->vid & 0x0fff));
+  memcpy(encoded_data, eth_hdr, 2 * ETHER_ADDR_LEN);
+  encoded_data[12] = (uint8_t)(GOOSE_TPID >> 8);
+  encoded_data[13] = (uint8_t)(GOOSE_TPID & 0xff);
+  encoded_data[14] = (uint8_t)(tci >> 8);
+  encoded_data[15] = (uint8_t)(tci & 0xff);
+  memcpy(encoded_data + 16, &(eth_hdr->ether_type), 2);
+  return ETHER_HDR_LEN + VLAN_TAG_LEN;
+}
+
+
+const uint8_t *get_ether_payload(const uint8_t *packet, size_t caplen, 
+  uint16_t *ethertype, uint16_t *tci)
+{
+  /* Check parameters */
+  if (NULL == packet || NULL == ethertype || caplen < ETHER_HDR_LEN)
+  {
+    return NULL;
+  }
+
+  /* Declare local variables */
+  uint16_t type = (uint16_t)((packet[12] << 8) | packet[13]);   /* Ethertype */
+
+  if (tci)
+  {
+    *tci = 0;
+  }
+
+  /* Untagged frame, payload follows the ethertype */
+  if (GOOSE_TPID != type)
+  {
+    *ethertype = type;
+    return packet + ETHER_HDR_LEN;
+  }
+
+  /* Tagged frame, skip the tag and read the encapsulated ethertype */
+  if (caplen < ETHER_HDR_LEN + VLAN_TAG_LEN)
+  {
+    return NULL;
+  }
+  if (tci)
+  {
+    *tci = (uint16_t)((packet[14] << 8) | packet[15]);
+  }
+  *ethertype = (uint16_t)((packet[16] << 8) | packet[17]);
+  return packet + ETHER_HDR_LEN + VLAN_TAG_LEN;
+}
+
+
+/** Elements that every GOOSE PDU carries (See: IEC61850-8-1 Annex A), and 
+ * those of them that decode_goose_header() stops after
+ */
+#define GOOSE_REQUIRED ((1 << 0x0) | (1 << 0x1) | (1 << 0x2) | (1 << 0x4) \
+ | (1 << 0x5) | (1 << 0x6) | (1 << 0x8) | (1 << 0xa))
+#define GOOSE_HEADER_REQUIRED ((1 << 0x0) | (1 << 0x1) | (1 << 0x2) \
+ | (1 << 0x4) | (1 << 0x5) | (1 << 0x6))
+
+
+/**
+ * Function to decode the elements of a view from view->next, until every 
+ * element of stop has been seen, or to the end of the PDU if stop is 0
+ *
+ * @return int	0 on success, else -1 if an element is malformed
+ */
+static int decode_goose_elems(goose_view_t *view, uint16_t stop)
+{
+  /* Declare local variables */
+  const uint8_t *ptr = view->next;           /* Pointer to the current element */
+  const uint8_t *end = view->end;                  /* End of the GOOSE PDU */
+  size_t len = 0;                           /* Length of the current element */
+  uint8_t len_size = 0;            /* Number of octets in the length field */
+  uint8_t tag = 0;                                  /* Tag of the element */
+  int ret = 0;                         /* Result of decoding integer elements */
+
+  /* Walk the elements, which are single octet context tags */
+  while (ptr < end && (0 == stop || (view->seen & stop) != stop))
+  {
+    tag = *ptr++;
+    len_size = ber_len_from_bytes(ptr, (size_t)(end - ptr), &len);
+    if (0 == len_size || len > (size_t)(end - ptr) - len_size)
+    {
+      return -1;
+    }
+    ptr += len_size;
+
+    switch (tag)
+    {
+      case 0x80: /* gocbref */
+        view->gocbref = ptr;
+        view->gocbrefLen = len;
+        break;
+      case 0x81: /* timeAllowedtoLive */
+        ret = bytes_to_ui32(ptr, len, &view->timeAllowedtoLive);
+        break;
+      case 0x82: /* datSet */
+        view->datSet = ptr;
+        view->datSetLen = len;
+        break;
+      case 0x83: /* goID */
+        view->goID = ptr;
+        view->goIDLen = len;
+        break;
+      case 0x84: /* t */
+        if (8 != len)
+        {
+          return -1;
+        }
+        view->t = ptr;
+        break;
+      case 0x85: /* stNum */
+        ret = bytes_to_ui32(ptr, len, &view->stNum);
+        break;
+      case 0x86: /* sqNum */
+        ret = bytes_to_ui32(ptr, len, &view->sqNum);
+        break;
+      case 0x87: /* test */
+        view->test = (len > 0) ? ptr[0] : 0;
+        break;
+      case 0x88: /* confRev */
+        ret = bytes_to_ui32(ptr, len, &view->confRev);
+        break;
+      case 0x89: /* ndsCom */
+        view->ndsCom = (len > 0) ? ptr[0] : 0;
+        break;
+      case 0x8a: /* numDatSetEntries */
+        ret = bytes_to_ui32(ptr, len, &view->numDatSetEntries);
+        break;
+      case 0xab: /* allData */
+        view->allData = ptr;
+        view->allDataLen = len;
+        break;
+      default: /* security and any unknown elements are skipped */
+        break;
+    }
+    if (ret)
+    {
+      return -1;
+    }
+    if (tag >= 0x80 && tag <= 0x8a)
+    {
+      view->seen |= (uint16_t)(1 << (tag - 0x80));
+    }
+    ptr += len;
+  }
+  view->next = ptr;
+
+  /* Done */
+  return 0;
+}
+
+
+/**
+ * Function to decode the header stage of a view, see decode_goose_header()
+ */
+static int decode_goose_hdr(const uint8_t *packet, size_t caplen, 
+  goose_view_t *view)
+{
+  /* Declare local variables */
+  const uint8_t *hdr = NULL;                  /* Pointer to the GOOSE header */
+  const uint8_t *ptr = NULL;                 /* Pointer to the GOOSE PDU */
+  const uint8_t *end = NULL;                       /* End of the GOOSE PDU */
+  uint16_t ethertype = 0;                 /* Ethertype of the received frame */
+  size_t len = 0;                                 /* Length of the GOOSE PDU */
+  uint8_t len_size = 0;            /* Number of octets in the length field */
+
+  memset(view, 0, sizeof(goose_view_t));
+
+  /* Locate the GOOSE header, bounded by the header length */
+  hdr = get_ether_payload(packet, caplen, &ethertype, NULL);
+  if (NULL == hdr || ETHER_GOOSE != ethertype)
+  {
+    return -1;
+  }
+  caplen -= (size_t)(hdr - packet);
+  if (caplen < GOOSE_HDR_LEN + 2)
+  {
+    return -1;
+  }
+  view->goose_hdr = hdr;
+  view->appid = (uint16_t)((hdr[0] << 8) | hdr[1]);
+  view->len = (size_t)((hdr[2] << 8) | hdr[3]);
+  view->res1 = (uint16_t)((hdr[4] << 8) | hdr[5]);
+  if (view->len < GOOSE_HDR_LEN + 2 || view->len > caplen)
+  {
+    return -1;
+  }
+
+  /* Locate the GOOSE PDU contents */
+  ptr = hdr + GOOSE_HDR_LEN;
+  end = hdr + view->len;
+  if (GOOSE_PREAMBLE != *ptr++)
+  {
+    return -1;
+  }
+  len_size = ber_len_from_bytes(ptr, (size_t)(end - ptr), &len);
+  if (0 == len_size || len > (size_t)(end - ptr) - len_size)
+  {
+    return -1;
+  }
+  view->next = ptr + len_size;
+  view->end = view->next + len;
+
+  /* The elements are in a fixed order, so the scan stops at sqNum */
+  if (0 != decode_goose_elems(view, GOOSE_HEADER_REQUIRED))
+  {
+    return -1;
+  }
+
+  /* Done */
+  return ((view->seen & GOOSE_HEADER_REQUIRED) == GOOSE_HEADER_REQUIRED) 
+   ? 0 : -1;
+}
+
+
+int decode_goose_header(const uint8_t *packet, size_t caplen, 
+  goose_view_t *view)
+{
+  /* Check parameters */
+  if (NULL == packet || NULL == view)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  int ret = decode_goose_hdr(packet, caplen, view);      /* Result of decode */
+
+  GOOSE_PROBE(decode, view->appid, view->stNum, view->sqNum, caplen, ret);
+  return ret;
+}
+
+
+int decode_goose_body(goose_view_t *view)
+{
+  /* Check parameters */
+  if (NULL == view || NULL == view->next)
+  {
+    return -1;
+  }
+
+  /* Decode the elements after sqNum, at most once */
+  if (0 != decode_goose_elems(view, 0))
+  {
+    return -1;
+  }
+
+  /* Done */
+  return ((view->seen & GOOSE_REQUIRED) == GOOSE_REQUIRED) ? 0 : -1;
+}
+
+
+int decode_goose_frame(const uint8_t *packet, size_t caplen, 
+  goose_view_t *view)
+{
+  /* Check parameters */
+  if (NULL == packet || NULL == view)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  int ret = decode_goose_hdr(packet, caplen, view);      /* Result of decode */
+
+  if (0 == ret)
+  {
+    ret = decode_goose_body(view);
+  }
+  GOOSE_PROBE(decode, view->appid, view->stNum, view->sqNum, caplen, ret);
+  return ret;
+}
+
+
+int decode_goose_dataset(const goose_view_t *view, arena_t *arena, 
+  data_entry_t **entries, size_t *count)
+{
+  /* Check parameters */
+  if (NULL == view || NULL == arena || NULL == entries || NULL == count)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  const uint8_t *ptr = view->allData;        /* Pointer to the current entry */
+  const uint8_t *end = view->allData + view->allDataLen;  /* End of allData */
+  size_t len = 0;                             /* Length of the current entry */
+  uint8_t len_size = 0;              /* Number of octets in the length field */
+  size_t num = 0;                                        /* Number of entries */
+
+  *entries = NULL;
+  *count = 0;
+  if (NULL == ptr)
+  {
+    return -1;
+  }
+
+  /* Count the entries, so the array is allocated once */
+  while (ptr < end)
+  {
+    len_size = ber_len_from_bytes(ptr + 1, (size_t)(end - ptr) - 1, &len);
+    if (0 == len_size || len > (size_t)(end - ptr) - 1 - len_size)
+    {
+      return -1;
+    }
+    ptr += 1 + len_size + len;
+    num++;
+  }
+  if (0 == num)
+  {
+    return 0;
+  }
+
+  *entries = (data_entry_t *)arena_alloc(arena, num * sizeof(data_entry_t), 
+   _Alignof(data_entry_t));
+  if (NULL == *entries)
+  {
+    return -1;
+  }
+
+  /* Fill in the entries, which the first pass has validated */
+  for (ptr = view->allData; ptr < end; (*count)++)
+  {
+    (*entries)[*count].tag = ptr[0];
+    len_size = ber_len_from_bytes(ptr + 1, (size_t)(end - ptr) - 1, &len);
+    (*entries)[*count].value = ptr + 1 + len_size;
+    (*entries)[*count].len = len;
+    ptr += 1 + len_size + len;
+  }
+
+  /* Done */
+  return 0;
+}
+
+
 uint16_t *get_res1(goose_frame_t *goose_frame)
 {
   /* Check parameters */
@@ -172,16 +632,12 @@ void print_goose_pdu_elem_str(uint8_t *goose_pdu_elem)
   /* Declare local variables */
   uint8_t *len_ptr = 0;        /* Pointer to the ASN.1 length of the element */
   uint8_t *val_ptr = 0;               /* Pointer to the value of the element */
-  uint8_t *tmp_val_ptr = 0;             /* Pointer to new string for element */
 
-  /* Process and print the element */
+  /* Process and print the element, the precision bounds the unterminated 
+   * string so it is printed in place without a copy */
   len_ptr = goose_pdu_elem + 1;  /* Get length, magic 1 skips ASN.1 tag byte */
   val_ptr = len_ptr + 1;       /* Get value, magic 1 skips ASN.1 length byte */
-  MALLOC(tmp_val_ptr, uint8_t, ((*len_ptr)+1)); /* Magic 1 is for extra '\0' */
-  memcpy(tmp_val_ptr, val_ptr, (*len_ptr));
-  tmp_val_ptr[(*len_ptr)] = '\0';      /* '\0' terminate to make it a string */
-  fprintf(stdout, "%s", tmp_val_ptr);
-  FREE(tmp_val_ptr);
+  fprintf(stdout, "%.*s", (int)(*len_ptr), (const char *)val_ptr);
 }
 
 
@@ -203,6 +659,7 @@ do \
   { \
     WHICH = MAC[i]; \
   } \
+  set_eth_prefix(FRAME); \
 \
   return 1; \
 \
@@ -240,25 +697,129 @@ int set_src_mac( goose_frame_t *goose_frame, const uint8_t *smac )
 }
 
 
-int verify_protected_checksum(goose_frame_t *goose_frame)
+int set_vlan( goose_frame_t *goose_frame, uint16_t vid, uint8_t pcp )
 {
   /* Check parameters */
-  if (NULL == goose_frame)
+  if (NULL == goose_frame || vid > 0x0fff || pcp > 0x7)
+  {
+    return 0;
+  }
+
+  /* Tag the frame */
+  goose_frame->vlan.tagged = 1;
+  goose_frame->vlan.vid = vid;
+  goose_frame->vlan.pcp = pcp;
+  set_eth_prefix(goose_frame);
+  return 1;
+}
+
+
+int sign_goose_frame(goose_sec_t *sec, uint8_t *encoded_data, 
+  uint16_t *encoded_len)
+{
+  /* Check parameters */
+  if (NULL == sec || NULL == sec->sign || NULL == encoded_data 
+   || NULL == encoded_len)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  uint8_t *goose_hdr = NULL;                /* Pointer to the GOOSE header */
+  uint16_t ethertype = 0;                 /* Ethertype of the encoded frame */
+  size_t hdr_offset = 0;                  /* Offset of the GOOSE header */
+  size_t signed_len = 0;          /* Bytes covered by the protected checksum */
+  size_t total_len = 0;              /* GOOSE header length with extension */
+  struct timespec start;                    /* Time signing started, if timed */
+  struct timespec end;                     /* Time signing finished, if timed */
+
+  goose_hdr = (uint8_t *)get_ether_payload(encoded_data, *encoded_len, 
+   &ethertype, NULL);
+  if (NULL == goose_hdr || ETHER_GOOSE != ethertype)
+  {
+    return -1;
+  }
+  hdr_offset = (size_t)(goose_hdr - encoded_data);
+
+  if ((size_t)*encoded_len + 2 + sec->value_len > MAX_FRAME_SIZE)
+  {
+    return -1;
+  }
+
+  /* Append the extension tag and length */
+  encoded_data[(*encoded_len)++] = GOOSE_SEC_EXT_TAG;
+  encoded_data[(*encoded_len)++] = sec->value_len;
+  signed_len = *encoded_len - hdr_offset;
+
+  /* Update the header to cover the extension and flag it as protected */
+  total_len = signed_len + sec->value_len;
+  goose_hdr[2] = (uint8_t)(total_len >> 8);
+  goose_hdr[3] = (uint8_t)(total_len & 0xff);
+  goose_hdr[4] |= (uint8_t)(GOOSE_RES1_PROTECTED >> 8);
+
+  /* Compute the authentication value into the extension */
+  if (sec->timed)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+  }
+  if (0 != sec->sign(sec, goose_hdr, signed_len, 
+   encoded_data + *encoded_len))
+  {
+    return -1;
+  }
+  if (sec->timed)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sec->sign_ns = (uint64_t)((end.tv_sec - start.tv_sec) * 1000000000L 
+     + (end.tv_nsec - start.tv_nsec));
+  }
+  *encoded_len += sec->value_len;
+
+  return 0;
+}
+
+
+int verify_protected_checksum(const goose_sec_t *sec, const uint8_t *goose_hdr,
+  size_t len)
+{
+  /* Check parameters */
+  if (NULL == sec || NULL == sec->verify || NULL == goose_hdr)
   {
     return -2;
   }
 
   /* Declare local variables */
-  uint8_t *calc_hmac = 0; /* Pointer to the bytes containing the computed 
-                             checksum */
-  uint8_t *msg_hmac = 0; /* Pointer to the bytes containing the protected 
-                            checksum */
-  size_t hmac_len = 0; /* Length of the checksum values to compare */
-
-  /* Compute the protected checksum for the GOOSE frame */
-  // TODO: here!
-  /* Get the protected checksum value from the GOOSE frame */
-
-  /* Compare and return the result */
-  return memcmp((const void *)calc_hmac, (const void *)msg_hmac, (size_t)hmac_len);
+  size_t total_len = 0;                 /* Length from the GOOSE header */
+  size_t pdu_len = 0;                        /* Length of the GOOSE PDU */
+  size_t signed_len = 0;          /* Bytes covered by the protected checksum */
+  uint8_t len_size = 0;             /* Number of octets in PDU length field */
+
+  /* Get the frame length, which must fit in what was received */
+  if (len < GOOSE_HDR_LEN + 2)
+  {
+    return -1;
+  }
+  total_len = ((size_t)goose_hdr[2] << 8) | goose_hdr[3];
+  if (total_len > len || GOOSE_PREAMBLE != goose_hdr[GOOSE_HDR_LEN])
+  {
+    return -1;
+  }
+
+  /* Find the extension after the end of the GOOSE PDU */
+  len_size = ber_len_from_bytes(goose_hdr + GOOSE_HDR_LEN + 1, 
+   total_len - GOOSE_HDR_LEN - 1, &pdu_len);
+  if (0 == len_size)
+  {
+    return -1;
+  }
+  signed_len = GOOSE_HDR_LEN + 1 + len_size + pdu_len + 2;
+  if (signed_len + sec->value_len != total_len 
+   || GOOSE_SEC_EXT_TAG != goose_hdr[signed_len - 2]
+   || sec->value_len != goose_hdr[signed_len - 1])
+  {
+    return -1;
+  }
+
+  /* Compute the protected checksum and compare with the one in the frame */
+  return sec->verify(sec, goose_hdr, signed_len, goose_hdr + signed_len);
 }
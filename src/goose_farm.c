@@ -0,0 +1,470 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#define _GNU_SOURCE             /* pthread_setaffinity_np */
+
+#include "config.h"
+#include "farm.h"
+#include "stats.h"
+#include "transport.h"
+#include "types.h"
+#include "utils.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+
+/*
+ * Constants
+ */
+
+/** 
+ * Version of goose_farm utility
+ */
+static const char VER[]="0.1a";
+
+/**
+ * Maximum number of frames whose timing is kept for the lateness report, 
+ * shared between the threads
+ */
+#define MAX_TIMED_FRAMES (1 << 22)
+
+/**
+ * Maximum number of scheduler threads
+ */
+#define MAX_THREADS 64
+
+/**
+ * Delay before the first deadline, so that every thread has started
+ */
+#define START_DELAY_NS 100000000ULL
+
+
+
+/*
+ * Global variables
+ */
+
+/**
+ * Set by the signal handler to stop publishing
+ */
+static volatile sig_atomic_t STOP = 0;
+
+/**
+ * Scheduler thread, its IEDs and its own transport
+ */
+typedef struct _farm_thread_t_ {
+  pthread_t thread;                       /* Thread running the scheduler */
+  farm_t farm;                            /* Scheduler of a range of IEDs */
+  transport_t tp;                         /* Transport of the scheduler */
+  uint64_t start;                         /* Monotonic time of the start */
+  unsigned int secs;                      /* Seconds to publish for */
+  int cpu;                                /* CPU to run on, or -1 */
+  int ret;                                /* Result of the scheduler */
+} farm_thread_t;
+
+
+
+/*
+ * Function prototypes
+ */
+
+/**
+ * Function to display the command usage to stdout
+ */
+void print_usage(void);
+
+/**
+ * Function to stop publishing when interrupted
+ *
+ * @param sig int for the signal number
+ */
+void signal_handler(int sig);
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to take the template of the IEDs from the first control block 
+ * published in a configuration image
+ *
+ * @return int	0 on success, else -1
+ */
+static int load_template(const char *path, farm_template_t *tmpl)
+{
+  /* Declare local variables */
+  const config_t *config = NULL;                   /* Configuration image */
+  const config_cb_t *cb = NULL;                      /* Control block used */
+
+  config = config_map(path);
+  if (NULL == config)
+  {
+    return -1;
+  }
+  cb = config_pub(config, 0);
+  if (NULL == cb || 0 == cb->numDatSetEntries 
+   || FARM_MAX_ENTRIES < cb->numDatSetEntries)
+  {
+    fprintf(stderr, "[!] %s publishes no control block of 1 to %d "
+     "entries\n", path, FARM_MAX_ENTRIES);
+    config_unmap(config);
+    return -1;
+  }
+  snprintf(tmpl->name, FARM_NAME_LEN, "%s", config_str(config, cb->ied));
+  memcpy(tmpl->dmac, cb->mac, 6);
+  tmpl->appid = cb->appid;
+  tmpl->vlan.tagged = cb->tagged;
+  tmpl->vlan.vid = cb->vid;
+  tmpl->vlan.pcp = cb->pcp;
+  tmpl->confRev = cb->confRev;
+  tmpl->numDatSetEntries = cb->numDatSetEntries;
+  if (cb->min_time)
+  {
+    tmpl->min_time_ms = cb->min_time;
+  }
+  if (cb->max_time)
+  {
+    tmpl->max_time_ms = cb->max_time;
+  }
+  config_unmap(config);
+
+  /* Done */
+  return 0;
+}
+
+
+/**
+ * Function to run the scheduler of a thread on its own CPU
+ */
+static void *farm_thread(void *arg)
+{
+  /* Declare local variables */
+  farm_thread_t *ft = (farm_thread_t *)arg;                /* This thread */
+  cpu_set_t cpus;                                    /* CPU of the thread */
+
+  if (ft->cpu >= 0)
+  {
+    CPU_ZERO(&cpus);
+    CPU_SET(ft->cpu, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  }
+  ft->ret = farm_run(&(ft->farm), &(ft->tp), ft->start, ft->secs);
+  return NULL;
+}
+
+
+int main(int argc, char *argv[]) 
+{
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  const transport_ops_t *ops = &TRANSPORT_PCAP;         /* Transport used */
+  static farm_template_t tmpl;                    /* Template of the IEDs */
+  static farm_thread_t threads[MAX_THREADS];          /* Scheduler threads */
+  struct sigaction signal_action;                     /* Sigaction structure */
+  struct sched_param param;                         /* Scheduling priority */
+  percentiles_t pct;                            /* Summary of a distribution */
+  farm_event_t *script = NULL;                   /* Scripted state changes */
+  size_t num_script = 0;                    /* Number of scripted changes */
+  uint64_t *late = NULL;                 /* Lateness of the frames timed */
+  size_t timed = 0;                                 /* Frames timed */
+  uint64_t frames = 0;                             /* Frames published */
+  uint64_t batches = 0;                             /* Batches published */
+  uint64_t errors = 0;                          /* Frames not published */
+  uint64_t events = 0;                                   /* State changes */
+  uint64_t overruns = 0;            /* Frames sent after their next was due */
+  uint64_t elapsed = 0;                          /* Time spent publishing */
+  unsigned int num_ieds = 5000;                          /* Number of IEDs */
+  unsigned int num_threads = 1;                       /* Number of threads */
+  unsigned int duration = 10;                  /* Seconds to publish for */
+  unsigned int first = 0;               /* Number of the next thread's IED */
+  unsigned int count = 0;                    /* IEDs of the next thread */
+  double event_sec = 0;             /* Mean time between random changes */
+  long batch_us = -1;                   /* Batch window, or -1 for default */
+  long ncpus = sysconf(_SC_NPROCESSORS_ONLN);            /* CPUs online */
+  int prio = 0;                     /* SCHED_FIFO priority, 0 to not change */
+  int started = 0;                  /* Schedulers with a transport open */
+  int created = 0;                               /* Threads created */
+  int ret = 0;                                        /* Result of the farm */
+  int i = 0;                                               /* Thread index */
+  const char *config_path = NULL;           /* Path of configuration image */
+  const char *script_path = NULL;                  /* Path of state script */
+  const char *iface = NULL;                    /* Name of network interface */
+
+  farm_template_init(&tmpl);
+
+  /* Check paramaters */
+  while (-1 != (opt = getopt(argc, argv, "b:c:d:e:E:j:n:P:t:")))
+  {
+    switch (opt)
+    {
+      case 'b':
+        batch_us = atol(optarg);
+        break;
+      case 'c':
+        config_path = optarg;
+        break;
+      case 'd':
+        duration = (unsigned int)atoi(optarg);
+        break;
+      case 'e':
+        event_sec = atof(optarg);
+        break;
+      case 'E':
+        script_path = optarg;
+        break;
+      case 'j':
+        num_threads = (unsigned int)atoi(optarg);
+        if (num_threads < 1 || num_threads > MAX_THREADS)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'n':
+        num_ieds = (unsigned int)atoi(optarg);
+        break;
+      case 'P':
+        prio = atoi(optarg);
+        if (prio < 1 || prio > 99)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 't':
+        ops = transport_find(optarg);
+        if (NULL == ops)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  if (argc - optind != 1 || 0 == duration || event_sec < 0 
+   || num_ieds < num_threads) 
+  {
+    print_usage();
+    return -1;
+  }
+  iface = argv[optind];
+
+  if (NULL != config_path && 0 != load_template(config_path, &tmpl))
+  {
+    exit(EXIT_FAILURE);
+  }
+  if (NULL != script_path 
+   && 0 != farm_load_script(script_path, &script, &num_script))
+  {
+    exit(EXIT_FAILURE);
+  }
+
+  memset(&signal_action, 0, sizeof(struct sigaction));
+  signal_action.sa_handler = &signal_handler;
+  if (-1 == sigaction(SIGINT, &signal_action, (struct sigaction *)NULL))
+  {
+    fprintf(stderr, "[!] unable to register signal handler\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Run ahead of other tasks, and keep the pages resident, the threads 
+   * inherit the policy */
+  if (prio > 0)
+  {
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = prio;
+    if (-1 == sched_setscheduler(0, SCHED_FIFO, &param))
+    {
+      perror("[!] sched_setscheduler");
+    }
+    if (-1 == mlockall(MCL_CURRENT | MCL_FUTURE))
+    {
+      perror("[!] mlockall");
+    }
+  }
+
+  /* Allocate the timings up front, nothing is allocated while publishing */
+  MALLOC(late, uint64_t, MAX_TIMED_FRAMES * sizeof(uint64_t));
+  if (NULL == late)
+  {
+    exit(EXIT_FAILURE);
+  }
+
+  /* Each thread schedules a contiguous range of the IEDs through its own 
+   * transport, nothing is shared while publishing */
+  for (i = 0; i < (int)num_threads; i++)
+  {
+    count = num_ieds / num_threads + ((unsigned int)i < num_ieds % num_threads);
+    if (0 != farm_init(&(threads[i].farm), &tmpl, first, count) 
+     || 0 != transport_open(&(threads[i].tp), ops, iface))
+    {
+      farm_free(&(threads[i].farm));
+      ret = -1;
+      break;
+    }
+    threads[i].farm.late = late + (size_t)i * (MAX_TIMED_FRAMES / num_threads);
+    threads[i].farm.max_late = MAX_TIMED_FRAMES / num_threads;
+    threads[i].farm.stop = &STOP;
+    threads[i].farm.script = script;
+    threads[i].farm.num_script = num_script;
+    threads[i].farm.event_ns = (uint64_t)(event_sec * 1e9);
+    threads[i].farm.batch_ns = (batch_us < 0) ? FARM_BATCH_NS 
+     : (uint64_t)batch_us * 1000;
+    threads[i].secs = duration;
+    threads[i].cpu = (ncpus > 1) ? (int)(i % ncpus) : -1;
+    first += count;
+    started++;
+  }
+
+  if (0 == ret)
+  {
+    fprintf(stdout, "[-] publishing %u IEDs %s00000 to %s%05u on %s over %s "
+     "from %u threads for %u s\n", num_ieds, tmpl.name, tmpl.name, 
+     num_ieds - 1, iface, ops->name, num_threads, duration);
+    fflush(stdout);
+    elapsed = now_ns();
+    for (i = 0; i < started; i++)
+    {
+      threads[i].start = elapsed + START_DELAY_NS;
+      if (0 != pthread_create(&(threads[i].thread), NULL, farm_thread, 
+       &(threads[i])))
+      {
+        fprintf(stderr, "[!] could not create thread %d\n", i);
+        STOP = 1;
+        ret = -1;
+        break;
+      }
+      created++;
+    }
+  }
+  for (i = 0; i < created; i++)
+  {
+    pthread_join(threads[i].thread, NULL);
+  }
+  elapsed = now_ns() - elapsed;
+
+  /* Merge the counters and timings of the threads */
+  for (i = 0; i < started; i++)
+  {
+    frames += threads[i].farm.frames;
+    batches += threads[i].farm.batches;
+    errors += threads[i].farm.errors;
+    events += threads[i].farm.events;
+    overruns += threads[i].farm.overruns;
+    memmove(late + timed, threads[i].farm.late, 
+     threads[i].farm.timed * sizeof(uint64_t));
+    timed += threads[i].farm.timed;
+    transport_close(&(threads[i].tp));
+    farm_free(&(threads[i].farm));
+  }
+
+  if (0 == ret)
+  {
+    fprintf(stdout, "[+] published %llu frames in %llu batches, %.0f frames "
+     "per second, %llu state changes, %llu errors, %llu sent after the next "
+     "frame of their IED was due\n", (unsigned long long)frames, 
+     (unsigned long long)batches, (elapsed > START_DELAY_NS) ? (double)frames 
+     * 1e9 / (double)(elapsed - START_DELAY_NS) : 0.0, 
+     (unsigned long long)events, (unsigned long long)errors, 
+     (unsigned long long)overruns);
+    fprintf(stdout, "[=] lateness after deadline in ns\n");
+    compute_percentiles(late, timed, &pct);
+    print_percentiles(stdout, "    sent", &pct, 1);
+  }
+
+  /* Done */
+  FREE(late);
+  free(script);
+  fflush(stdout);
+  return ret;
+}
+
+
+void print_usage(void) 
+{
+  fprintf(stdout, "goose_farm, version %s\n\n", VER);
+  fprintf(stdout, "usage: goose_farm [-b us] [-c config] [-d secs] [-e secs] "
+   "[-E script] [-j threads]\n");
+  fprintf(stdout, "                  [-n ieds] [-P prio] [-t transport] "
+   "iface\n\n");
+  fprintf(stdout, "  -b us : send frames due within us of each other "
+   "together, default %llu\n", FARM_BATCH_NS / 1000);
+  fprintf(stdout, "  -c config : take the IEDs from the first control block "
+   "published in config\n");
+  fprintf(stdout, "  -d secs : seconds to publish for, default 10\n");
+  fprintf(stdout, "  -e secs : mean time between random state changes of "
+   "each IED, default none\n");
+  fprintf(stdout, "  -E script : state changes, lines of 'ms ied entry "
+   "value'\n");
+  fprintf(stdout, "  -j threads : scheduler threads, one per CPU, default "
+   "1\n");
+  fprintf(stdout, "  -n ieds : number of IEDs, default 5000\n");
+  fprintf(stdout, "  -P prio : run with SCHED_FIFO priority prio\n");
+  fprintf(stdout, "  -t transport : pcap (default), packet or loopback\n");
+  fprintf(stdout, "  iface : network interface to publish on\n");
+  fflush(stdout);
+  return;
+}
+
+
+void signal_handler(int sig)
+{
+  (void)sig;
+  STOP = 1;
+}
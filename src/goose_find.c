@@ -0,0 +1,549 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "capindex.h"
+#include "goose.h"
+#include "replay.h"
+#include "types.h"
+#include "utils.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+/*
+ * Constants
+ */
+
+/** 
+ * Version of goose_find utility
+ */
+static const char VER[]="0.1a";
+
+/**
+ * Maximum length of a capture or index path
+ */
+#define FIND_PATH_LEN 4096
+
+
+
+/*
+ * Type definitions
+ */
+
+/**
+ * State change found, with its stream
+ */
+typedef struct _found_t_ {
+  const capindex_change_t *change;      /* State change */
+  const capindex_stream_t *stream;      /* Stream of the change */
+} found_t;
+
+
+
+/*
+ * Global variables
+ */
+
+/**
+ * Query, the same for every capture searched
+ */
+static struct {
+  int appid;                    /* APPID wanted, else -1 for any */
+  const char *gocbref;          /* gocbRef wanted, else NULL for any */
+  const char *from;             /* Earliest time wanted, as given */
+  const char *until;            /* Latest time wanted, as given */
+  uint64_t from_ns;             /* Earliest time wanted */
+  uint64_t until_ns;            /* Latest time wanted */
+  int resolved;                 /* Non-zero once the times are known */
+  int verbose;                  /* Non-zero to print the datasets */
+  uint64_t found;               /* Frames found */
+} QUERY = { -1, NULL, NULL, NULL, 0, UINT64_MAX, 0, 0, 0 };
+
+
+
+/*
+ * Function prototypes
+ */
+
+/**
+ * Function to display the command usage to stdout
+ */
+void print_usage(void);
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to parse a time of the query, @seconds since the epoch, a local 
+ * "YYYY-MM-DD HH:MM[:SS[.frac]]", or a local "HH:MM[:SS[.frac]]" on the day 
+ * of the first frame searched
+ *
+ * @param arg	time as given
+ * @param ref_ns	time of the first frame searched, for the day
+ * @param ns	pointer to hold the time in ns since the epoch
+ * @return int	0 on success, else -1 if the time is not understood
+ */
+static int parse_time(const char *arg, uint64_t ref_ns, uint64_t *ns)
+{
+  /* Declare local variables */
+  struct tm tm;                                   /* Broken down local time */
+  time_t sec = (time_t)(ref_ns / 1000000000ULL);      /* Day of reference */
+  const char *frac = NULL;                         /* Fraction of a second */
+  long secs = 0;                                /* Seconds since the epoch */
+  int date[3] = {0};                                  /* Year, month, day */
+  int n = 0;                                        /* Characters parsed */
+  uint64_t scale = 100000000ULL;               /* ns of the next digit */
+
+  memset(&tm, 0, sizeof(struct tm));
+  localtime_r(&sec, &tm);
+  tm.tm_sec = 0;
+  if ('@' == arg[0])
+  {
+    if (1 != sscanf(arg + 1, "%ld%n", &secs, &n) || secs < 0)
+    {
+      return -1;
+    }
+    sec = (time_t)secs;
+    frac = arg + 1 + n;
+  }
+  else
+  {
+    if (5 == sscanf(arg, "%d-%d-%d%*1[ T]%d:%d%n", &date[0], &date[1], 
+      &date[2], &tm.tm_hour, &tm.tm_min, &n))
+    {
+      tm.tm_year = date[0] - 1900;
+      tm.tm_mon = date[1] - 1;
+      tm.tm_mday = date[2];
+    }
+    else if (2 != sscanf(arg, "%d:%d%n", &tm.tm_hour, &tm.tm_min, &n))
+    {
+      return -1;
+    }
+    arg += n;
+    if (':' == arg[0] && 1 == sscanf(arg + 1, "%d%n", &tm.tm_sec, &n))
+    {
+      arg += 1 + n;
+    }
+    tm.tm_isdst = -1;
+    sec = mktime(&tm);
+    if ((time_t)-1 == sec)
+    {
+      return -1;
+    }
+    frac = arg;
+  }
+
+  *ns = (uint64_t)sec * 1000000000ULL;
+  if ('.' == *frac)
+  {
+    for (frac++; *frac >= '0' && *frac <= '9' && scale; frac++)
+    {
+      *ns += (uint64_t)(*frac - '0') * scale;
+      scale /= 10;
+    }
+  }
+
+  /* Done */
+  return ('\0' == *frac) ? 0 : -1;
+}
+
+
+/**
+ * Function to print a frame found, decoding its dataset if asked to
+ */
+static void print_frame(const capture_t *cap, const char *path, 
+  uint64_t offset, uint64_t ns, uint16_t appid, const char *gocbref, 
+  uint32_t stNum, uint32_t sqNum)
+{
+  /* Declare local variables */
+  char stamp[32];                                     /* Local date, time */
+  time_t sec = (time_t)(ns / 1000000000ULL);         /* Seconds of the time */
+  struct tm tm;                                   /* Broken down local time */
+  capture_frame_t frame;                                 /* Frame reread */
+  goose_view_t view;                                      /* Decoded frame */
+
+  localtime_r(&sec, &tm);
+  strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+  fprintf(stdout, "[-] %s.%09llu APPID 0x%04x %s stNum: %u sqNum: %u "
+   "(%s@%llu)\n", stamp, (unsigned long long)(ns % 1000000000ULL), appid, 
+   gocbref, stNum, sqNum, path, (unsigned long long)offset);
+  QUERY.found++;
+
+  if (QUERY.verbose && 1 == capture_next(cap, &offset, &frame) 
+   && 0 == decode_goose_frame(frame.data, frame.caplen, &view))
+  {
+    fprintf(stdout, "\tdatSet: %.*s confRev: %u numDatSetEntries: %u\n", 
+     (int)view.datSetLen, (const char *)view.datSet, view.confRev, 
+     view.numDatSetEntries);
+    hex_dump(view.allData, view.allDataLen);
+  }
+}
+
+
+/**
+ * Function to order state changes found in several streams by time
+ */
+static int change_cmp(const void *a, const void *b)
+{
+  /* Declare local variables */
+  const capindex_change_t *ca = ((const found_t *)a)->change;   /* Change a */
+  const capindex_change_t *cb = ((const found_t *)b)->change;   /* Change b */
+
+  if (ca->ns != cb->ns)
+  {
+    return (ca->ns < cb->ns) ? -1 : 1;
+  }
+  return (ca->offset < cb->offset) ? -1 : (ca->offset > cb->offset);
+}
+
+
+/**
+ * Function to print the state changes of the streams queried, from their 
+ * posting lists
+ *
+ * @return int	0 on success, else -1 if out of memory
+ */
+static int find_changes(const capture_t *cap, const capindex_t *idx, 
+  const char *path)
+{
+  /* Declare local variables */
+  const capindex_stream_t *stream = NULL;          /* Streams of the APPID */
+  const capindex_change_t *change = NULL;       /* Changes of a stream */
+  found_t *found = NULL;                             /* Changes in range */
+  size_t num_found = 0;                             /* Changes in range */
+  uint32_t num_streams = idx->num_streams;                /* Streams tried */
+  uint32_t count = 0;                             /* Changes from the time */
+  uint32_t i = 0;                                         /* Stream index */
+  uint32_t k = 0;                                /* Change of a stream */
+  size_t j = 0;                                           /* Change index */
+
+  /* The streams of the APPID, or of any APPID if only gocbRef is given */
+  if (QUERY.appid >= 0)
+  {
+    stream = capindex_find(idx, (uint16_t)QUERY.appid, &num_streams);
+  }
+  else
+  {
+    stream = capindex_stream(idx, 0);
+  }
+  if (NULL == stream)
+  {
+    return 0;
+  }
+
+  /* Collect the changes in range, to merge the streams by time */
+  found = (found_t *)malloc(idx->num_changes * sizeof(found_t) + 1);
+  if (NULL == found)
+  {
+    fprintf(stderr, "[!] out of memory\n");
+    return -1;
+  }
+  for (i = 0; i < num_streams; i++)
+  {
+    if (NULL != QUERY.gocbref 
+     && 0 != strcmp(QUERY.gocbref, capindex_str(idx, stream[i].gocbref)))
+    {
+      continue;
+    }
+    change = capindex_changes(idx, &(stream[i]), QUERY.from_ns, &count);
+    for (k = 0; k < count && change[k].ns <= QUERY.until_ns; k++)
+    {
+      found[num_found].change = &(change[k]);
+      found[num_found++].stream = &(stream[i]);
+    }
+  }
+  qsort(found, num_found, sizeof(found_t), change_cmp);
+  for (j = 0; j < num_found; j++)
+  {
+    change = found[j].change;
+    print_frame(cap, path, change->offset, change->ns, found[j].stream->appid,
+     capindex_str(idx, found[j].stream->gocbref), change->stNum, 
+     change->sqNum);
+  }
+
+  /* Done */
+  free(found);
+  return 0;
+}
+
+
+/**
+ * Function to print every GOOSE frame of the time range, scanning the 
+ * capture from the time index entry before it
+ */
+static void find_frames(const capture_t *cap, const capindex_t *idx, 
+  const char *path)
+{
+  /* Declare local variables */
+  capture_frame_t frame;                                   /* Frame read */
+  goose_view_t view;                                    /* Decoded header */
+  char ref[REPLAY_MAX_REF_LEN];                     /* gocbRef of a frame */
+  uint64_t offset = capindex_seek(idx, QUERY.from_ns);    /* Scan offset */
+
+  if (0 == offset)
+  {
+    offset = cap->start;
+  }
+  while (1 == capture_next(cap, &offset, &frame) 
+   && frame.ns <= QUERY.until_ns)
+  {
+    if (frame.ns < QUERY.from_ns 
+     || 0 != decode_goose_header(frame.data, frame.caplen, &view))
+    {
+      continue;
+    }
+    snprintf(ref, sizeof(ref), "%.*s", (int)view.gocbrefLen, 
+     (const char *)view.gocbref);
+    if (NULL != QUERY.gocbref && 0 != strcmp(QUERY.gocbref, ref))
+    {
+      continue;
+    }
+    print_frame(cap, path, frame.offset, frame.ns, view.appid, ref, 
+     view.stNum, view.sqNum);
+  }
+}
+
+
+/**
+ * Function to search a capture, through its index, which is built first if 
+ * it is missing or older than the capture
+ *
+ * @param path	path of the capture
+ * @param rebuild	non-zero to build the index only, whether or not it is 
+ * 		current
+ * @return int	1 if the capture was searched, 0 if out of range, else -1
+ */
+static int find_capture(const char *path, int rebuild)
+{
+  /* Declare local variables */
+  char idx_path[FIND_PATH_LEN];                       /* Path of the index */
+  capture_t cap;                                              /* Capture */
+  const capindex_t *idx = NULL;                         /* Mapped index */
+  uint64_t start = now_ns();                        /* Time of the build */
+  int ret = 1;                                   /* Result of the search */
+
+  /* Check parameters */
+  if (sizeof(idx_path) <= (size_t)snprintf(idx_path, sizeof(idx_path), 
+    "%s%s", path, CAPINDEX_SUFFIX))
+  {
+    fprintf(stderr, "[!] path %s is too long\n", path);
+    return -1;
+  }
+  if (0 != capture_open(&cap, path))
+  {
+    return -1;
+  }
+  if (!rebuild)
+  {
+    idx = capindex_map(idx_path);
+  }
+  if (!capindex_current(idx, &cap))
+  {
+    capindex_unmap(idx);
+    idx = NULL;
+    if (0 == capindex_build(path, idx_path))
+    {
+      idx = capindex_map(idx_path);
+    }
+    if (NULL == idx)
+    {
+      fprintf(stderr, "[!] could not index %s\n", path);
+      capture_close(&cap);
+      return -1;
+    }
+    fprintf(stdout, "[+] %s: %llu frames, %llu GOOSE, %u streams, %u state "
+     "changes, indexed in %.1f ms\n", path, (unsigned long long)idx->frames, 
+     (unsigned long long)idx->goose, idx->num_streams, idx->num_changes, 
+     (double)(now_ns() - start) / 1e6);
+  }
+
+  /* Relative times are on the day of the first frame searched, the times 
+   * were checked when given */
+  if (!QUERY.resolved && idx->frames > 0)
+  {
+    if (NULL != QUERY.from)
+    {
+      parse_time(QUERY.from, idx->first_ns, &QUERY.from_ns);
+    }
+    if (NULL != QUERY.until)
+    {
+      parse_time(QUERY.until, idx->first_ns, &QUERY.until_ns);
+    }
+    QUERY.resolved = 1;
+  }
+
+  /* Captures outside the time range are passed over by their header */
+  if (rebuild || 0 == idx->frames || idx->last_ns < QUERY.from_ns 
+   || idx->first_ns > QUERY.until_ns)
+  {
+    ret = 0;
+  }
+  else if (QUERY.appid >= 0 || NULL != QUERY.gocbref)
+  {
+    ret = (0 == find_changes(&cap, idx, path)) ? 1 : -1;
+  }
+  else
+  {
+    find_frames(&cap, idx, path);
+  }
+
+  /* Done */
+  capindex_unmap(idx);
+  capture_close(&cap);
+  return ret;
+}
+
+
+int main(int argc, char *argv[]) 
+{
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  int rebuild = 0;                          /* Non-zero to build indexes only */
+  int searched = 0;                          /* Captures in the time range */
+  int failed = 0;                           /* Captures that could not be read */
+  int ret = 0;                                    /* Result of each capture */
+  char *end = NULL;                              /* End of a parsed number */
+  uint64_t ns = 0;                                   /* Time checked */
+  uint64_t start = 0;                               /* Time of the search */
+  int i = 0;                                              /* Capture index */
+
+  /* Check paramaters */
+  while (-1 != (opt = getopt(argc, argv, "a:bf:g:u:v")))
+  {
+    switch (opt)
+    {
+      case 'a':
+        QUERY.appid = (int)strtol(optarg, &end, 0);
+        if ('\0' != *end || QUERY.appid < 0 || QUERY.appid > 0xffff)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'b':
+        rebuild = 1;
+        break;
+      case 'f':
+        QUERY.from = optarg;
+        break;
+      case 'g':
+        QUERY.gocbref = optarg;
+        break;
+      case 'u':
+        QUERY.until = optarg;
+        break;
+      case 'v':
+        QUERY.verbose = 1;
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  if (argc == optind) 
+  {
+    print_usage();
+    return -1;
+  }
+  if ((NULL != QUERY.from && 0 != parse_time(QUERY.from, 0, &ns)) 
+   || (NULL != QUERY.until && 0 != parse_time(QUERY.until, 0, &ns)))
+  {
+    fprintf(stderr, "[!] time not understood, use HH:MM[:SS[.frac]], "
+     "YYYY-MM-DD HH:MM[:SS[.frac]] or @seconds\n");
+    return -1;
+  }
+
+  /* Captures are searched in the order given, those outside the time range 
+   * by their index header alone */
+  start = now_ns();
+  for (i = optind; i < argc; i++)
+  {
+    ret = find_capture(argv[i], rebuild);
+    searched += (1 == ret);
+    failed += (-1 == ret);
+  }
+
+  /* Done */
+  if (!rebuild)
+  {
+    fprintf(stdout, "[=] %llu frames found in %d of %d captures, %.1f ms\n", 
+     (unsigned long long)QUERY.found, searched, argc - optind, 
+     (double)(now_ns() - start) / 1e6);
+  }
+  fflush(stdout);
+  return failed ? -1 : 0;
+}
+
+
+void print_usage(void) 
+{
+  fprintf(stdout, "goose_find, version %s\n\n", VER);
+  fprintf(stdout, "usage: goose_find [-a appid] [-g gocbRef] [-f from] "
+   "[-u until] [-v] capture...\n");
+  fprintf(stdout, "       goose_find -b capture...\n\n");
+  fprintf(stdout, "  -a appid : state changes of the APPID, e.g. 0x3001\n");
+  fprintf(stdout, "  -b : build the index of each capture, even if current\n");
+  fprintf(stdout, "  -f from : frames from the time, HH:MM[:SS[.frac]] on the "
+   "day of the first frame,\n");
+  fprintf(stdout, "            YYYY-MM-DD HH:MM[:SS[.frac]] or @seconds since "
+   "the epoch\n");
+  fprintf(stdout, "  -g gocbRef : state changes of the control block\n");
+  fprintf(stdout, "  -u until : frames up to the time, as for -f\n");
+  fprintf(stdout, "  -v : print the dataset of each frame\n");
+  fprintf(stdout, "  capture : pcap or pcapng file, indexed beside itself in "
+   "capture%s\n", CAPINDEX_SUFFIX);
+  fprintf(stdout, "Without -a or -g every GOOSE frame of the time range is "
+   "printed.\n");
+  fflush(stdout);
+  return;
+}
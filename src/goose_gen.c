@@ -0,0 +1,975 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+
+/*
+ * Constants
+ */
+
+/** 
+ * Version of goose_gen utility
+ */
+static const char VER[]="0.1a";
+
+/**
+ * Maximum number of characters of gocbRef, datSet and goID, which are 
+ * VisibleString129 (See: IEC61850-8-1 Annex A)
+ */
+#define GEN_MAX_STR 129
+
+/**
+ * Maximum number of characters of a name or a line of a description
+ */
+#define GEN_MAX_NAME 64
+#define GEN_MAX_LINE 512
+
+/**
+ * Maximum number of dataset entries of a control block
+ */
+#define GEN_MAX_ENTRIES 512
+
+/**
+ * Largest frame, the ethernet header with an 802.1Q tag and the GOOSE header, 
+ * see MAX_FRAME_SIZE and GOOSE_HDR_LEN in goose.h
+ */
+#define GEN_MAX_FRAME 1518
+#define GEN_HDR_LEN (14 + 4 + 8)
+
+/**
+ * Octets of the UtcTime t and of the largest unsigned integer of the header
+ */
+#define GEN_UTC_LEN 8
+#define GEN_UI32_LEN 4
+
+
+
+/*
+ * Types
+ */
+
+/** Dataset entry type, the MMS Data alternative it is encoded as 
+ * (See: IEC61850-8-1 Annex G)
+ */
+typedef struct _gen_type_t_ {
+  const char *name;         /* Name in the description */
+  const char *ctype;        /* C type of the dataset struct member */
+  uint8_t tag;              /* Tag of the MMS Data alternative */
+  uint8_t len;              /* Octets of the value, 0 if variable */
+  uint8_t max_len;          /* Largest number of value octets */
+} gen_type_t;
+
+
+/** Dataset entry of a control block description
+ */
+typedef struct _gen_entry_t_ {
+  const gen_type_t *type;       /* Type of the entry */
+  char member[GEN_MAX_NAME];    /* Name of the dataset struct member */
+} gen_entry_t;
+
+
+/** Control block description
+ */
+typedef struct _gen_cb_t_ {
+  char name[GEN_MAX_NAME];       /* Prefix of the generated identifiers */
+  char upper[GEN_MAX_NAME];      /* Prefix of the generated constants */
+  char gocbref[GEN_MAX_STR + 1]; /* gocbRef */
+  char datset[GEN_MAX_STR + 1];  /* datSet */
+  char goid[GEN_MAX_STR + 1];    /* goID, empty to leave it out */
+  uint32_t confrev;              /* confRev */
+  size_t count;                  /* Number of dataset entries */
+  gen_entry_t entry[GEN_MAX_ENTRIES];  /* Dataset entries */
+} gen_cb_t;
+
+
+/**
+ * Dataset entry types, fixed length types keep the offsets of the entries 
+ * that follow them constant
+ */
+static const gen_type_t TYPES[] = {
+  { "boolean", "uint8_t",  0x83, 1, 1 },
+  { "int8",    "int8_t",   0x85, 1, 1 },
+  { "int32",   "int32_t",  0x85, 0, 4 },
+  { "uint32",  "uint32_t", 0x86, 0, 5 },
+  { "float32", "float",    0x87, 5, 5 },
+  { "dbpos",   "uint8_t",  0x84, 2, 2 },
+  { "quality", "uint16_t", 0x84, 3, 3 },
+  { "utctime", "uint64_t", 0x91, 8, 8 }
+};
+
+
+
+/*
+ * Function prototypes
+ */
+
+/**
+ * Function to display the command usage to stdout
+ */
+void print_usage(void);
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return non-zero if the string is a C identifier
+ */
+static int is_ident(const char *str)
+{
+  if (!isalpha((unsigned char)*str) && '_' != *str)
+  {
+    return 0;
+  }
+  for (str++; *str; str++)
+  {
+    if (!isalnum((unsigned char)*str) && '_' != *str)
+    {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+
+/**
+ * Function to BER encode a definite length, as ber_len_to_bytes()
+ */
+static size_t put_len(size_t len, uint8_t *addr)
+{
+  if (len < 0x80)
+  {
+    addr[0] = (uint8_t)len;
+    return 1;
+  }
+  if (len < 0x100)
+  {
+    addr[0] = 0x81;
+    addr[1] = (uint8_t)len;
+    return 2;
+  }
+  addr[0] = 0x82;
+  addr[1] = (uint8_t)(len >> 8);
+  addr[2] = (uint8_t)(len & 0xff);
+  return 3;
+}
+
+
+/**
+ * Function to encode a GOOSE PDU string element, its tag, length and value
+ */
+static size_t put_str(uint8_t tag, const char *str, uint8_t *addr)
+{
+  /* Declare local variables */
+  size_t len = strlen(str);                       /* Length of the string */
+  size_t offset = 0;                              /* Offset into the buffer */
+
+  addr[offset++] = tag;
+  offset += put_len(len, addr + offset);
+  memcpy(addr + offset, str, len);
+  return offset + len;
+}
+
+
+/**
+ * Function to encode a GOOSE PDU unsigned integer element, as the generic 
+ * encoder does with num_bytes_for_ui32() and ui32_to_bytes()
+ */
+static size_t put_ui32(uint8_t tag, uint32_t num, uint8_t *addr)
+{
+  /* Declare local variables */
+  uint8_t len = 1;                              /* Number of value octets */
+  uint8_t i = 0;                                               /* Loop index */
+
+  while (len < 4 && (num >> (8 * len)) != 0)
+  {
+    len++;
+  }
+  addr[0] = tag;
+  addr[1] = len;
+  for (i = 0; i < len; i++)
+  {
+    addr[2 + i] = (uint8_t)(num >> (8 * (len - 1 - i)));
+  }
+
+  return 2 + (size_t)len;
+}
+
+
+/**
+ * Function to return the number of octets of a dataset entry, the tag, 
+ * length and value
+ *
+ * @param entry	pointer to the entry
+ * @param longest	non-zero for the largest encoding of a variable entry, 
+ * 		else the smallest
+ */
+static size_t entry_len(const gen_entry_t *entry, int longest)
+{
+  if (entry->type->len)
+  {
+    return 2 + (size_t)entry->type->len;
+  }
+
+  return 2 + (size_t)(longest ? entry->type->max_len : 1);
+}
+
+
+/**
+ * Function to return the number of octets of the fixed length entries from 
+ * an entry up to the next variable length entry
+ */
+static size_t run_len(const gen_cb_t *cb, size_t first)
+{
+  /* Declare local variables */
+  size_t len = 0;                                  /* Octets of the run */
+  size_t i = 0;                                             /* Entry index */
+
+  for (i = first; i < cb->count && cb->entry[i].type->len; i++)
+  {
+    len += entry_len(&(cb->entry[i]), 0);
+  }
+
+  return len;
+}
+
+
+/**
+ * Function to read a control block description
+ *
+ * @param path	path of the description
+ * @param cb	pointer to the description to populate
+ * @return int	0 on success, else -1
+ */
+static int read_cb(const char *path, gen_cb_t *cb)
+{
+  /* Declare local variables */
+  FILE *in = NULL;                                     /* Description file */
+  char line[GEN_MAX_LINE];                                  /* Current line */
+  char *key = NULL;                                    /* Keyword of a line */
+  char *arg = NULL;                                   /* Argument of a line */
+  char *member = NULL;                  /* Member name of a dataset entry */
+  char *end = NULL;                          /* End of a parsed number */
+  int line_num = 0;                                /* Number of the line */
+  size_t i = 0;                                               /* Loop index */
+
+  in = fopen(path, "r");
+  if (NULL == in)
+  {
+    fprintf(stderr, "[!] could not open %s (%s)\n", path, strerror(errno));
+    return -1;
+  }
+  memset(cb, 0, sizeof(gen_cb_t));
+
+  while (NULL != fgets(line, sizeof(line), in))
+  {
+    line_num++;
+    line[strcspn(line, "#\r\n")] = '\0';
+    key = strtok(line, " \t");
+    if (NULL == key)
+    {
+      continue;
+    }
+    arg = strtok(NULL, " \t");
+    if (NULL == arg)
+    {
+      fprintf(stderr, "[!] %s:%d: %s without a value\n", path, line_num, key);
+      goto fail;
+    }
+
+    if (0 == strcmp(key, "name"))
+    {
+      if (!is_ident(arg) || strlen(arg) >= GEN_MAX_NAME)
+      {
+        fprintf(stderr, "[!] %s:%d: name %s is not a C identifier\n", path, 
+         line_num, arg);
+        goto fail;
+      }
+      strcpy(cb->name, arg);
+    }
+    else if (0 == strcmp(key, "gocbref") || 0 == strcmp(key, "datset") 
+     || 0 == strcmp(key, "goid"))
+    {
+      if (strlen(arg) > GEN_MAX_STR)
+      {
+        fprintf(stderr, "[!] %s:%d: %s is longer than %d characters\n", 
+         path, line_num, key, GEN_MAX_STR);
+        goto fail;
+      }
+      if (0 == strcmp(key, "gocbref"))
+      {
+        strcpy(cb->gocbref, arg);
+      }
+      else if (0 == strcmp(key, "datset"))
+      {
+        strcpy(cb->datset, arg);
+      }
+      else
+      {
+        strcpy(cb->goid, arg);
+      }
+    }
+    else if (0 == strcmp(key, "confrev"))
+    {
+      errno = 0;
+      cb->confrev = (uint32_t)strtoul(arg, &end, 0);
+      if (0 != errno || '\0' != *end)
+      {
+        fprintf(stderr, "[!] %s:%d: bad confrev %s\n", path, line_num, arg);
+        goto fail;
+      }
+    }
+    else if (0 == strcmp(key, "entry"))
+    {
+      member = strtok(NULL, " \t");
+      if (NULL == member || !is_ident(member) 
+       || strlen(member) >= GEN_MAX_NAME - 8)
+      {
+        fprintf(stderr, "[!] %s:%d: entry needs a type and a C identifier\n", 
+         path, line_num);
+        goto fail;
+      }
+      if (GEN_MAX_ENTRIES == cb->count)
+      {
+        fprintf(stderr, "[!] %s:%d: more than %d entries\n", path, line_num, 
+         GEN_MAX_ENTRIES);
+        goto fail;
+      }
+      for (i = 0; i < sizeof(TYPES) / sizeof(TYPES[0]); i++)
+      {
+        if (0 == strcmp(arg, TYPES[i].name))
+        {
+          cb->entry[cb->count].type = &TYPES[i];
+        }
+      }
+      if (NULL == cb->entry[cb->count].type)
+      {
+        fprintf(stderr, "[!] %s:%d: unknown type %s\n", path, line_num, arg);
+        goto fail;
+      }
+      for (i = 0; i < cb->count; i++)
+      {
+        if (0 == strcmp(member, cb->entry[i].member))
+        {
+          fprintf(stderr, "[!] %s:%d: entry %s repeated\n", path, line_num, 
+           member);
+          goto fail;
+        }
+      }
+      strcpy(cb->entry[cb->count++].member, member);
+    }
+    else
+    {
+      fprintf(stderr, "[!] %s:%d: unknown keyword %s\n", path, line_num, key);
+      goto fail;
+    }
+  }
+  fclose(in);
+
+  if ('\0' == cb->name[0] || '\0' == cb->gocbref[0] || '\0' == cb->datset[0]
+   || 0 == cb->count)
+  {
+    fprintf(stderr, "[!] %s: name, gocbref, datset and an entry are "
+     "required\n", path);
+    return -1;
+  }
+  for (i = 0; cb->name[i]; i++)
+  {
+    cb->upper[i] = (char)toupper((unsigned char)cb->name[i]);
+  }
+
+  /* Done */
+  return 0;
+
+fail:
+  fclose(in);
+  return -1;
+}
+
+
+/**
+ * Function to write a constant array of bytes
+ */
+static void emit_bytes(FILE *out, const char *upper, const char *name, 
+ const char *comment, const uint8_t *bytes, size_t len)
+{
+  /* Declare local variables */
+  size_t i = 0;                                               /* Loop index */
+
+  fprintf(out, "/** %s\n */\nstatic const uint8_t %s_%s[] = {", comment, 
+   upper, name);
+  for (i = 0; i < len; i++)
+  {
+    fprintf(out, "%s0x%02x%s", (0 == i % 12) ? "\n  " : "", bytes[i], 
+     (i + 1 < len) ? ", " : "\n");
+  }
+  fprintf(out, "};\n\n");
+}
+
+
+/**
+ * Function to write the stores of a dataset entry at offset k from p
+ */
+static void emit_put(FILE *out, const gen_entry_t *entry, size_t k)
+{
+  /* Declare local variables */
+  const char *type = entry->type->name;                  /* Type of entry */
+  const char *m = entry->member;                            /* Member name */
+
+  fprintf(out, "  p[%zu] = 0x%02x;  /* %s */\n", k, entry->type->tag, m);
+  if (0 == entry->type->len)
+  {
+    fprintf(out, "  p[%zu] = ber_int_to_bytes((int64_t)data->%s, p + %zu);\n",
+     k + 1, m, k + 2);
+    return;
+  }
+  fprintf(out, "  p[%zu] = 0x%02x;\n", k + 1, entry->type->len);
+  if (0 == strcmp(type, "boolean"))
+  {
+    fprintf(out, "  p[%zu] = (uint8_t)(0 != data->%s);\n", k + 2, m);
+  }
+  else if (0 == strcmp(type, "int8"))
+  {
+    fprintf(out, "  p[%zu] = (uint8_t)data->%s;\n", k + 2, m);
+  }
+  else if (0 == strcmp(type, "dbpos"))
+  {
+    fprintf(out, "  p[%zu] = 0x06;\n", k + 2);
+    fprintf(out, "  p[%zu] = (uint8_t)(data->%s << 6);\n", k + 3, m);
+  }
+  else if (0 == strcmp(type, "quality"))
+  {
+    fprintf(out, "  p[%zu] = 0x03;\n", k + 2);
+    fprintf(out, "  p[%zu] = (uint8_t)(data->%s >> 5);\n", k + 3, m);
+    fprintf(out, "  p[%zu] = (uint8_t)(data->%s << 3);\n", k + 4, m);
+  }
+  else if (0 == strcmp(type, "float32"))
+  {
+    fprintf(out, "  memcpy(&bits, &(data->%s), 4);\n", m);
+    fprintf(out, "  p[%zu] = 0x08;\n", k + 2);
+    fprintf(out, "  p[%zu] = (uint8_t)(bits >> 24);\n", k + 3);
+    fprintf(out, "  p[%zu] = (uint8_t)(bits >> 16);\n", k + 4);
+    fprintf(out, "  p[%zu] = (uint8_t)(bits >> 8);\n", k + 5);
+    fprintf(out, "  p[%zu] = (uint8_t)bits;\n", k + 6);
+  }
+  else if (0 == strcmp(type, "utctime"))
+  {
+    fprintf(out, "  utc_time_encode(data->%s, data->%s_quality, p + %zu);\n", 
+     m, m, k + 2);
+  }
+}
+
+
+/**
+ * Function to write the checks and loads of a dataset entry at offset k 
+ * from p
+ */
+static void emit_get(FILE *out, const gen_entry_t *entry, size_t k)
+{
+  /* Declare local variables */
+  const char *type = entry->type->name;                  /* Type of entry */
+  const char *m = entry->member;                            /* Member name */
+
+  if (0 == entry->type->len)
+  {
+    fprintf(out, "  if (end - p < 3 || 0x%02x != p[0] || p[1] < 1 "
+     "|| p[1] > %u || end - p < 2 + p[1]\n", entry->type->tag, 
+     entry->type->max_len);
+    fprintf(out, "   || 0 != bytes_to_%s(p + 2, p[1], &(data->%s)))\n", 
+     ('i' == type[0]) ? "i32" : "ui32", m);
+    fprintf(out, "  {\n    return -1;\n  }\n");
+    fprintf(out, "  p += 2 + p[1];\n");
+    return;
+  }
+  fprintf(out, "  bad |= (p[%zu] ^ 0x%02x) | (p[%zu] ^ 0x%02x);  /* %s */\n",
+   k, entry->type->tag, k + 1, entry->type->len, m);
+  if (0 == strcmp(type, "boolean"))
+  {
+    fprintf(out, "  data->%s = (0 != p[%zu]);\n", m, k + 2);
+  }
+  else if (0 == strcmp(type, "int8"))
+  {
+    fprintf(out, "  data->%s = (int8_t)p[%zu];\n", m, k + 2);
+  }
+  else if (0 == strcmp(type, "dbpos"))
+  {
+    fprintf(out, "  bad |= p[%zu] ^ 0x06;\n", k + 2);
+    fprintf(out, "  data->%s = (uint8_t)(p[%zu] >> 6);\n", m, k + 3);
+  }
+  else if (0 == strcmp(type, "quality"))
+  {
+    fprintf(out, "  bad |= p[%zu] ^ 0x03;\n", k + 2);
+    fprintf(out, "  data->%s = (uint16_t)(((p[%zu] << 8) | p[%zu]) >> 3);\n", 
+     m, k + 3, k + 4);
+  }
+  else if (0 == strcmp(type, "float32"))
+  {
+    fprintf(out, "  bad |= p[%zu] ^ 0x08;\n", k + 2);
+    fprintf(out, "  bits = ((uint32_t)p[%zu] << 24) | ((uint32_t)p[%zu] << 16)"
+     " | ((uint32_t)p[%zu] << 8) | p[%zu];\n", k + 3, k + 4, k + 5, k + 6);
+    fprintf(out, "  memcpy(&(data->%s), &bits, 4);\n", m);
+  }
+  else if (0 == strcmp(type, "utctime"))
+  {
+    fprintf(out, "  data->%s = utc_time_decode(p + %zu, "
+     "&(data->%s_quality));\n", m, k + 2, m);
+  }
+}
+
+
+/**
+ * Function to write the header of the generated code
+ */
+static void emit_header(FILE *out, const gen_cb_t *cb, const char *path)
+{
+  /* Declare local variables */
+  size_t i = 0;                                               /* Loop index */
+
+  fprintf(out, "/* Generated by goose_gen %s from %s, do not edit */\n", VER, 
+   path);
+  fprintf(out, "#ifndef _%s_H_\n#define _%s_H_\n\n", cb->upper, cb->upper);
+  fprintf(out, "#include \"goose.h\"\n\n#include <stddef.h>\n"
+   "#include <stdint.h>\n\n\n");
+  fprintf(out, "/** Number of dataset entries of %s\n */\n"
+   "#define %s_ENTRIES %zu\n\n\n", cb->gocbref, cb->upper, cb->count);
+
+  fprintf(out, "/** Dataset %s\n */\ntypedef struct _%s_data_t_ {\n", 
+   cb->datset, cb->name);
+  for (i = 0; i < cb->count; i++)
+  {
+    fprintf(out, "  %-9s%s;  /* %s */\n", cb->entry[i].type->ctype, 
+     cb->entry[i].member, cb->entry[i].type->name);
+    if (0 == strcmp("utctime", cb->entry[i].type->name))
+    {
+      fprintf(out, "  %-9s%s_quality;  /* TimeQuality of %s */\n", "uint8_t", 
+       cb->entry[i].member, cb->entry[i].member);
+    }
+  }
+  fprintf(out, "} %s_data_t;\n\n\n", cb->name);
+
+  fprintf(out, "/** Codec of %s, set as the codec of a frame whose dataset "
+   "points to a\n * %s_data_t\n */\nextern const goose_codec_t %s_codec;\n\n\n",
+   cb->gocbref, cb->name, cb->name);
+
+  fprintf(out, "/*\n * Function Prototypes\n */\n\n");
+  fprintf(out, "/**\n * Function to encode a GOOSE frame of %s, as "
+   "encode_goose_frame(), from the\n * %s_data_t the dataset of the frame "
+   "points to. gocbRef, datSet, goID,\n * confRev and numDatSetEntries are "
+   "those of the description.\n *\n"
+   " * @param goose_frame	- pointer to the GOOSE frame struct to be encoded\n"
+   " * @param encoded_data	- pointer to the buffer to store the ASN.1 encoded "
+   "bytes\n"
+   " * @param encoded_len	- pointer to memory to hold the length of the "
+   "encoded\n * 			bytes\n */\n"
+   "void %s_encode(const goose_frame_t *goose_frame, uint8_t *encoded_data, "
+   "\n  uint16_t *encoded_len);\n\n", cb->gocbref, cb->name, cb->name);
+  fprintf(out, "/**\n * Function to encode the dataset entries of %s, the "
+   "contents of allData,\n * for the generic encoder.\n *\n"
+   " * @param data	- pointer to the dataset\n"
+   " * @param all_data	- pointer to the buffer to store the entries\n"
+   " * @return size_t	- number of bytes encoded\n */\n"
+   "size_t %s_encode_data(const %s_data_t *data, uint8_t *all_data);\n\n", 
+   cb->datset, cb->name, cb->name);
+  fprintf(out, "/**\n * Function to decode the dataset entries of a received "
+   "GOOSE frame of %s.\n *\n"
+   " * @param view	- pointer to the view of the frame\n"
+   " * @param data	- pointer to the dataset to populate\n"
+   " * @return int	- 0 on success, else -1 if allData does not have the "
+   "layout of\n * 		the description\n */\n"
+   "int %s_decode(const goose_view_t *view, %s_data_t *data);\n\n", 
+   cb->gocbref, cb->name, cb->name);
+  fprintf(out, "#endif /* _%s_H_ */\n", cb->upper);
+}
+
+
+/**
+ * Function to write the generated encoder and decoder
+ *
+ * @return int	0 on success, else -1 if the frame does not fit
+ */
+static int emit_source(FILE *out, const gen_cb_t *cb, const char *path, 
+ const char *base)
+{
+  /* Declare local variables */
+  uint8_t gocbref[GEN_MAX_STR + 8];         /* gocbRef and the tag of TAL */
+  uint8_t datset[2 * GEN_MAX_STR + 16];    /* datSet, goID and tag of t */
+  uint8_t confrev[16];             /* confRev and the tag of ndsCom */
+  uint8_t entries[16];       /* numDatSetEntries and the tag of allData */
+  uint8_t len_bytes[4];                          /* Scratch length field */
+  size_t gocbref_len = 0;                          /* Octets of gocbref */
+  size_t datset_len = 0;                            /* Octets of datset */
+  size_t confrev_len = 0;                          /* Octets of confrev */
+  size_t entries_len = 0;                          /* Octets of entries */
+  size_t data_min = 0;                  /* Smallest allData contents */
+  size_t data_max = 0;                   /* Largest allData contents */
+  size_t fixed = 0;           /* Octets of the PDU that are always there */
+  size_t pdu_max = 0;                           /* Largest PDU contents */
+  size_t frame_max = 0;                                  /* Largest frame */
+  size_t k = 0;                                    /* Offset from p */
+  size_t i = 0;                                               /* Loop index */
+  int variable = 0;                    /* Non-zero if any entry is variable */
+  int floats = 0;                          /* Non-zero if any entry is float */
+
+  /* Constant parts of the PDU, around the fields of the frame */
+  gocbref_len = put_str(0x80, cb->gocbref, gocbref);
+  gocbref[gocbref_len++] = 0x81;
+  datset_len = put_str(0x82, cb->datset, datset);
+  if ('\0' != cb->goid[0])
+  {
+    datset_len += put_str(0x83, cb->goid, datset + datset_len);
+  }
+  datset[datset_len++] = 0x84;
+  datset[datset_len++] = GEN_UTC_LEN;
+  confrev_len = put_ui32(0x88, cb->confrev, confrev);
+  confrev[confrev_len++] = 0x89;
+  confrev[confrev_len++] = 0x01;
+  entries_len = put_ui32(0x8a, (uint32_t)cb->count, entries);
+  entries[entries_len++] = 0xab;
+
+  for (i = 0; i < cb->count; i++)
+  {
+    data_min += entry_len(&(cb->entry[i]), 0);
+    data_max += entry_len(&(cb->entry[i]), 1);
+    variable |= (0 == cb->entry[i].type->len);
+    floats |= (0 == strcmp("float32", cb->entry[i].type->name));
+  }
+  fixed = gocbref_len + 1 + datset_len + GEN_UTC_LEN + 2 + 2 + 3 
+   + confrev_len + 1 + entries_len;
+  pdu_max = fixed + 3 * GEN_UI32_LEN + put_len(data_max, len_bytes) 
+   + data_max;
+  frame_max = GEN_HDR_LEN + 1 + put_len(pdu_max, len_bytes) + pdu_max;
+  if (frame_max > GEN_MAX_FRAME)
+  {
+    fprintf(stderr, "[!] %s: frames of up to %zu bytes do not fit in %d\n", 
+     path, frame_max, GEN_MAX_FRAME);
+    return -1;
+  }
+
+  fprintf(out, "/* Generated by goose_gen %s from %s, do not edit */\n\n", 
+   VER, path);
+  fprintf(out, "#include \"%s.h\"\n#include \"utctime.h\"\n"
+   "#include \"utils.h\"\n\n#include <string.h>\n\n\n", base);
+  emit_bytes(out, cb->upper, "GOCBREF", "gocbRef, followed by the tag of "
+   "timeAllowedtoLive", gocbref, gocbref_len);
+  emit_bytes(out, cb->upper, "DATSET", "datSet and goID, followed by the tag "
+   "and length of t", datset, datset_len);
+  emit_bytes(out, cb->upper, "CONFREV", "confRev, followed by the tag and "
+   "length of ndsCom", confrev, confrev_len);
+  emit_bytes(out, cb->upper, "NUMDATSET", "numDatSetEntries, followed by the tag "
+   "of allData", entries, entries_len);
+  fprintf(out, "/** Octets of the PDU other than timeAllowedtoLive, stNum, "
+   "sqNum and allData\n */\n#define %s_PDU_LEN %zu\n\n", cb->upper, 
+   fixed);
+  fprintf(out, "/** Octets of allData with the shortest variable length "
+   "entries\n */\n#define %s_DATA_LEN %zu\n\n\n", cb->upper, data_min);
+
+  /* Entries */
+  fprintf(out, "/**\n * Function to encode the dataset entries, returning "
+   "the number of bytes\n */\n");
+  fprintf(out, "static inline size_t %s_put(const %s_data_t *data, "
+   "uint8_t *p)\n{\n", cb->name, cb->name);
+  fprintf(out, "  /* Declare local variables */\n");
+  fprintf(out, "  uint8_t *start = p;                /* Start of allData "
+   "*/\n");
+  if (floats)
+  {
+    fprintf(out, "  uint32_t bits = 0;           /* Bits of a float32 */\n");
+  }
+  fprintf(out, "\n");
+  for (i = 0, k = 0; i < cb->count; i++)
+  {
+    if (0 == cb->entry[i].type->len && 0 != k)
+    {
+      fprintf(out, "  p += %zu;\n", k);
+      k = 0;
+    }
+    emit_put(out, &(cb->entry[i]), k);
+    if (0 == cb->entry[i].type->len)
+    {
+      fprintf(out, "  p += 2 + p[1];\n");
+    }
+    else
+    {
+      k += entry_len(&(cb->entry[i]), 0);
+    }
+  }
+  if (0 != k)
+  {
+    fprintf(out, "\n  return (size_t)(p - start) + %zu;\n}\n\n\n", k);
+  }
+  else
+  {
+    fprintf(out, "\n  return (size_t)(p - start);\n}\n\n\n");
+  }
+
+  /* Frame */
+  fprintf(out, "/**\n * Function to encode a frame, see %s_encode(), with t "
+   "stamped from the\n * realtime clock if now is non-zero\n */\n", cb->name);
+  fprintf(out, "static void %s_encode_now(const goose_frame_t *goose_frame, "
+   "\n  uint8_t *encoded_data, uint16_t *encoded_len, int now)\n{\n", cb->name);
+  fprintf(out, "  /* Check parameters */\n  if (NULL == goose_frame || NULL "
+   "== goose_frame->dataset || NULL == encoded_data)\n  {\n"
+   "    *encoded_len = 0;\n    return;\n  }\n\n");
+  fprintf(out, "  /* Declare local variables */\n"
+   "  const %s_data_t *data = goose_frame->dataset;          /* Dataset */\n"
+   "  const goose_pdu_t *pdu = &(goose_frame->goose_pdu);       /* PDU */\n"
+   "  uint8_t *p = encoded_data;                      /* Next byte */\n"
+   "  uint8_t *hdr = NULL;                           /* GOOSE header */\n"
+   "  size_t data_len = %s_DATA_LEN;           /* allData contents */\n"
+   "  size_t pdu_len = 0;                            /* PDU contents */\n"
+   "  size_t len = 0;                              /* GOOSE length */\n\n", 
+   cb->name, cb->upper);
+  if (variable)
+  {
+    fprintf(out, "  /* Lengths of the variable length entries */\n");
+    for (i = 0; i < cb->count; i++)
+    {
+      if (0 == cb->entry[i].type->len)
+      {
+        fprintf(out, "  data_len += ber_int_size((int64_t)data->%s) - 1;\n", 
+         cb->entry[i].member);
+      }
+    }
+    fprintf(out, "\n");
+  }
+  fprintf(out, "  pdu_len = %s_PDU_LEN + num_bytes_for_ui32(pdu->timeAllowed"
+   "toLive) \n   + num_bytes_for_ui32(pdu->stNum) + num_bytes_for_ui32(pdu->"
+   "sqNum) \n   + ber_len_size(data_len) + data_len;\n\n", cb->upper);
+  fprintf(out, "  /* Ethernet and GOOSE headers */\n"
+   "  p += encode_eth_header(goose_frame, p);\n  hdr = p;\n"
+   "  memcpy(p, &(goose_frame->goose_header), GOOSE_HDR_LEN);\n"
+   "  p += GOOSE_HDR_LEN;\n  *p++ = GOOSE_PREAMBLE;\n"
+   "  p += ber_len_to_bytes(pdu_len, p);\n\n");
+  fprintf(out, "  /* gocbRef, timeAllowedtoLive, datSet, goID and t */\n"
+   "  memcpy(p, %s_GOCBREF, sizeof(%s_GOCBREF));\n"
+   "  p += sizeof(%s_GOCBREF);\n"
+   "  *p = num_bytes_for_ui32(pdu->timeAllowedtoLive);\n"
+   "  p += 1 + ui32_to_bytes(pdu->timeAllowedtoLive, p + 1);\n"
+   "  memcpy(p, %s_DATSET, sizeof(%s_DATSET));\n"
+   "  p += sizeof(%s_DATSET);\n"
+   "  if (now)\n  {\n    utc_time_now(pdu->t->time_quality, p);\n  }\n"
+   "  else\n  {\n    timevalq_to_bytes(pdu->t, p);\n  }\n"
+   "  p += UTC_TIME_LEN;\n\n", cb->upper, cb->upper, cb->upper, cb->upper, 
+   cb->upper, cb->upper);
+  fprintf(out, "  /* stNum, sqNum, test, confRev, ndsCom and "
+   "numDatSetEntries */\n"
+   "  p[0] = 0x85;\n  p[1] = num_bytes_for_ui32(pdu->stNum);\n"
+   "  p += 2 + ui32_to_bytes(pdu->stNum, p + 2);\n"
+   "  p[0] = 0x86;\n  p[1] = num_bytes_for_ui32(pdu->sqNum);\n"
+   "  p += 2 + ui32_to_bytes(pdu->sqNum, p + 2);\n"
+   "  p[0] = 0x87;\n  p[1] = 0x01;\n  p[2] = pdu->test;\n  p += 3;\n"
+   "  memcpy(p, %s_CONFREV, sizeof(%s_CONFREV));\n"
+   "  p += sizeof(%s_CONFREV);\n  *p++ = pdu->ndsCom;\n"
+   "  memcpy(p, %s_NUMDATSET, sizeof(%s_NUMDATSET));\n"
+   "  p += sizeof(%s_NUMDATSET);\n\n", cb->upper, cb->upper, cb->upper, 
+   cb->upper, cb->upper, cb->upper);
+  fprintf(out, "  /* allData */\n  p += ber_len_to_bytes(data_len, p);\n"
+   "  p += %s_put(data, p);\n\n", cb->name);
+  fprintf(out, "  /* Update the GOOSE header length, counted from the start "
+   "of APPID */\n  len = (size_t)(p - hdr);\n"
+   "  hdr[2] = (uint8_t)(len >> 8);\n  hdr[3] = (uint8_t)(len & 0xff);\n"
+   "  *encoded_len = (uint16_t)(p - encoded_data);\n}\n\n\n");
+
+  fprintf(out, "void %s_encode(const goose_frame_t *goose_frame, "
+   "uint8_t *encoded_data, \n  uint16_t *encoded_len)\n{\n"
+   "  %s_encode_now(goose_frame, encoded_data, encoded_len, 0);\n}\n\n\n", 
+   cb->name, cb->name);
+  fprintf(out, "size_t %s_encode_data(const %s_data_t *data, "
+   "uint8_t *all_data)\n{\n"
+   "  /* Check parameters */\n  if (NULL == data || NULL == all_data)\n"
+   "  {\n    return 0;\n  }\n\n  return %s_put(data, all_data);\n}\n\n\n", 
+   cb->name, cb->name, cb->name);
+
+  /* Decoder */
+  fprintf(out, "int %s_decode(const goose_view_t *view, %s_data_t *data)\n{\n",
+   cb->name, cb->name);
+  fprintf(out, "  /* Check parameters */\n  if (NULL == view || NULL == data "
+   "|| NULL == view->allData \n   || %s_ENTRIES != view->numDatSetEntries)\n"
+   "  {\n    return -1;\n  }\n\n", cb->upper);
+  fprintf(out, "  /* Declare local variables */\n"
+   "  const uint8_t *p = view->allData;            /* Next entry */\n"
+   "  const uint8_t *end = p + view->allDataLen;    /* End of allData */\n"
+   "  uint8_t bad = 0;            /* Non-zero if a tag or length differs */\n");
+  if (floats)
+  {
+    fprintf(out, "  uint32_t bits = 0;           /* Bits of a float32 */\n");
+  }
+  if (!variable)
+  {
+    fprintf(out, "\n  if (%s_DATA_LEN != view->allDataLen)\n  {\n"
+     "    return -1;\n  }\n", cb->upper);
+  }
+  fprintf(out, "\n");
+  for (i = 0, k = 0; i < cb->count; i++)
+  {
+    if (0 == cb->entry[i].type->len)
+    {
+      if (0 != k)
+      {
+        fprintf(out, "  p += %zu;\n", k);
+        k = 0;
+      }
+      emit_get(out, &(cb->entry[i]), k);
+      continue;
+    }
+    if (variable && 0 == k)
+    {
+      fprintf(out, "  if (end - p < %zu)\n  {\n    return -1;\n  }\n", 
+       run_len(cb, i));
+    }
+    emit_get(out, &(cb->entry[i]), k);
+    k += entry_len(&(cb->entry[i]), 0);
+  }
+  if (0 != k)
+  {
+    fprintf(out, "  p += %zu;\n", k);
+  }
+  fprintf(out, "\n  /* Done */\n  return (0 == bad && p == end) ? 0 : -1;"
+   "\n}\n\n\n");
+
+  fprintf(out, "/**\n * Function to decode allData for the codec\n */\n"
+   "static int %s_decode_any(const goose_view_t *view, void *data)\n{\n"
+   "  return %s_decode(view, (%s_data_t *)data);\n}\n\n\n", cb->name, 
+   cb->name, cb->name);
+  fprintf(out, "const goose_codec_t %s_codec = {\n  \"%s\",\n  %s_ENTRIES,\n"
+   "  sizeof(%s_data_t),\n  %s_encode_now,\n  %s_decode_any\n};\n", cb->name, 
+   cb->name, cb->upper, cb->name, cb->name, cb->name);
+
+  /* Done */
+  return 0;
+}
+
+
+int main(int argc, char *argv[]) 
+{
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  const char *prefix = NULL;      /* Path of the generated files, less .c/.h */
+  const char *base = NULL;         /* Name of the generated header, less .h */
+  char path[4096];                                  /* Path of an output */
+  static gen_cb_t cb;                            /* Control block description */
+  FILE *out = NULL;                                       /* Generated file */
+  int ret = 0;                                        /* Result of writing */
+
+  /* Check paramaters */
+  while (-1 != (opt = getopt(argc, argv, "o:")))
+  {
+    switch (opt)
+    {
+      case 'o':
+        prefix = optarg;
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  if (argc != optind + 1) 
+  {
+    print_usage();
+    return -1;
+  }
+
+  if (0 != read_cb(argv[optind], &cb))
+  {
+    return -1;
+  }
+  if (NULL == prefix)
+  {
+    prefix = cb.name;
+  }
+  base = strrchr(prefix, '/');
+  base = (NULL == base) ? prefix : base + 1;
+  if (strlen(prefix) + 3 > sizeof(path))
+  {
+    fprintf(stderr, "[!] output path %s is too long\n", prefix);
+    return -1;
+  }
+
+  /* Write the source first, it checks that the frame fits */
+  snprintf(path, sizeof(path), "%s.c", prefix);
+  out = fopen(path, "w");
+  if (NULL == out)
+  {
+    fprintf(stderr, "[!] could not create %s (%s)\n", path, strerror(errno));
+    return -1;
+  }
+  ret = emit_source(out, &cb, argv[optind], base);
+  if (0 != fclose(out) || 0 != ret)
+  {
+    remove(path);
+    return -1;
+  }
+
+  snprintf(path, sizeof(path), "%s.h", prefix);
+  out = fopen(path, "w");
+  if (NULL == out)
+  {
+    fprintf(stderr, "[!] could not create %s (%s)\n", path, strerror(errno));
+    return -1;
+  }
+  emit_header(out, &cb, argv[optind]);
+  if (0 != fclose(out))
+  {
+    remove(path);
+    return -1;
+  }
+
+  /* Done */
+  fprintf(stdout, "[+] %s: %zu entries, %s.c and %s.h\n", cb.name, cb.count, 
+   prefix, prefix);
+  return 0;
+}
+
+
+void print_usage(void) 
+{
+  fprintf(stdout, "goose_gen, version %s\n\n", VER);
+  fprintf(stdout, "usage: goose_gen [-o prefix] description\n\n");
+  fprintf(stdout, "  -o prefix : write prefix.c and prefix.h, default the name "
+   "of the control block\n");
+  fprintf(stdout, "  description : control block description, see "
+   "schema/gcb_example.gcb\n");
+  fflush(stdout);
+  return;
+}
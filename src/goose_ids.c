@@ -0,0 +1,378 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "capindex.h"
+#include "config.h"
+#include "goose.h"
+#include "ids.h"
+#include "log.h"
+#include "subscriber.h"
+#include "transport.h"
+#include "types.h"
+#include "utils.h"
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+/*
+ * Constants
+ */
+
+/** 
+ * Version of goose_ids utility
+ */
+static const char VER[]="0.1a";
+
+/**
+ * Default number of streams tracked
+ */
+#define IDS_STREAMS 4096
+
+
+
+/*
+ * Global variables
+ */
+
+/**
+ * Transport received from, so that the signal handler can break the receive
+ */
+static transport_t TP;
+
+/**
+ * Flag set by the signal handler to stop
+ */
+static volatile sig_atomic_t STOP = 0;
+
+
+
+/*
+ * Function prototypes
+ */
+
+/**
+ * Function to display the command usage to stdout
+ */
+void print_usage(void);
+
+/**
+ * Function to stop checking when interrupted or the duration elapses
+ *
+ * @param sig int for the signal number
+ */
+void signal_handler(int sig);
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to check every frame of a capture as it was received, as fast 
+ * as they can be dispatched, to compare with the line rate
+ *
+ * @param path	path of the capture
+ * @param table	pointer to the dispatch table with the IDS stage
+ * @param ns	pointer to hold the time taken, in ns
+ * @param wire	pointer to hold the bytes on the wire of the frames
+ * @return int	0 on success, else -1
+ */
+static int ids_replay(const char *path, dispatch_table_t *table, 
+ uint64_t *ns, uint64_t *wire)
+{
+  /* Declare local variables */
+  capture_t cap;                                       /* Capture checked */
+  capture_frame_t frame;                              /* Frame of capture */
+  struct pcap_pkthdr header;                       /* Header of each frame */
+  uint64_t offset = 0;                          /* Offset of next record */
+  int ret = 0;                                  /* Result of the last read */
+
+  if (0 != capture_open(&cap, path))
+  {
+    return -1;
+  }
+
+  /* The capture time of each frame stands in for its receive time */
+  offset = cap.start;
+  *wire = 0;
+  *ns = now_ns();
+  while (!STOP && 1 == (ret = capture_next(&cap, &offset, &frame)))
+  {
+    header.caplen = frame.caplen;
+    header.len = frame.len;
+    header.ts.tv_sec = (time_t)(frame.ns / 1000000000ULL);
+    header.ts.tv_usec = (suseconds_t)(frame.ns % 1000000000ULL);
+    dispatch_frame((u_char *)table, &header, frame.data);
+    *wire += (uint64_t)frame.len + 24;
+  }
+  *ns = now_ns() - *ns;
+  if (ret < 0)
+  {
+    fprintf(stderr, "[!] %s is corrupt, checked up to the corrupt record\n", 
+     path);
+  }
+
+  /* Done */
+  capture_close(&cap);
+  return (ret < 0) ? -1 : 0;
+}
+
+
+int main(int argc, char *argv[]) 
+{
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  const transport_ops_t *ops = &TRANSPORT_PCAP;         /* Transport used */
+  const config_t *config = NULL;              /* Streams expected, or NULL */
+  struct sigaction signal_action;                     /* Sigaction structure */
+  ids_t ids;                                /* Intrusion detection engine */
+  ids_stage_t stage;                           /* IDS stage of the dispatch */
+  dispatch_table_t table;                   /* Handlers of the frames */
+  size_t max_streams = IDS_STREAMS;              /* Streams tracked */
+  unsigned int duration = 0;                 /* Seconds to check, 0 forever */
+  int learn = -1;               /* Seconds each stream learns, -1 default */
+  uint64_t ns = 0;                          /* Time to check a capture */
+  uint64_t wire = 0;                      /* Bytes of a capture, at 1G */
+  uint64_t drops = 0;          /* Frames dropped before they were checked */
+  int verbosity = LOG_LEVEL_WARN;         /* Level of the records printed */
+  int ret = 0;                                  /* Result of the checking */
+  int i = 0;                                          /* Alert kind index */
+  const char *config_path = NULL;           /* Path of configuration image */
+  const char *path = NULL;                   /* Capture to check, or NULL */
+  const char *iface = NULL;                    /* Name of network interface */
+
+  /* Check paramaters */
+  while (-1 != (opt = getopt(argc, argv, "c:d:l:n:r:t:v")))
+  {
+    switch (opt)
+    {
+      case 'c':
+        config_path = optarg;
+        break;
+      case 'd':
+        duration = (unsigned int)atoi(optarg);
+        break;
+      case 'l':
+        learn = atoi(optarg);
+        if (learn < 0)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'n':
+        max_streams = (size_t)atoi(optarg);
+        break;
+      case 'r':
+        path = optarg;
+        break;
+      case 't':
+        ops = transport_find(optarg);
+        if (NULL == ops)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'v':
+        verbosity += (verbosity < LOG_LEVEL_TRACE);
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  if ((NULL != path && argc != optind) 
+   || (NULL == path && argc - optind != 1) || 0 == max_streams) 
+  {
+    print_usage();
+    return -1;
+  }
+  iface = (NULL != path) ? path : argv[optind];
+
+  /* Stop on interrupt, or when the duration elapses */
+  memset(&signal_action, 0, sizeof(struct sigaction));
+  signal_action.sa_handler = &signal_handler;
+  if (-1 == sigaction(SIGINT, &signal_action, (struct sigaction *)NULL) 
+   || -1 == sigaction(SIGALRM, &signal_action, (struct sigaction *)NULL))
+  {
+    fprintf(stderr, "[!] unable to register signal handler\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (NULL != config_path)
+  {
+    config = config_map(config_path);
+    if (NULL == config)
+    {
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (0 != ids_init(&ids, max_streams, config))
+  {
+    exit(EXIT_FAILURE);
+  }
+  if (learn >= 0)
+  {
+    ids.learn_windows = (uint32_t)learn;
+  }
+
+  /* Alerts are written to the log ring, the writer thread prints them */
+  if (0 != log_start(stdout, (log_level_t)verbosity))
+  {
+    exit(EXIT_FAILURE);
+  }
+  memset(&stage, 0, sizeof(ids_stage_t));
+  memset(&table, 0, sizeof(dispatch_table_t));
+  stage.ids = &ids;
+  stage.ts_scale = (NULL != path) ? 1 : 1000;
+  dispatch_register(&table, ETHER_GOOSE, ids_dispatch, &stage);
+
+  if (NULL != path)
+  {
+    ret = ids_replay(path, &table, &ns, &wire);
+  }
+  else
+  {
+    if (0 != transport_open(&TP, ops, iface))
+    {
+      log_stop();
+      exit(EXIT_FAILURE);
+    }
+    fprintf(stdout, "[-] checking GOOSE on %s over %s, %s\n", iface, 
+     ops->name, (NULL != config) ? "streams as configured" 
+     : "streams learned");
+    fflush(stdout);
+    if (duration)
+    {
+      alarm(duration);
+    }
+    ret = (subscribe_transport(&TP, 0, -1, &table) < 0) ? -1 : 0;
+    transport_drops(&TP, &drops);
+    transport_close(&TP);
+  }
+
+  /* Summary of the alerts */
+  log_stop();
+  fprintf(stdout, "[=] %llu frames of %zu streams, %llu malformed, %llu of "
+   "untracked streams, %llu frames or states missed\n", 
+   (unsigned long long)ids.frames, ids.used, 
+   (unsigned long long)ids.malformed, (unsigned long long)ids.untracked, 
+   (unsigned long long)ids.lost);
+  if (NULL == path)
+  {
+    fprintf(stdout, "[=] %llu frames dropped before they were checked\n", 
+     (unsigned long long)drops);
+  }
+  else
+  {
+    fprintf(stdout, "[=] checked in %.3f s, %.1f ns/frame, %.2f Mframes/s, "
+     "%.2f times the 1 Gb/s line rate\n", (double)ns / 1e9, 
+     ids.frames ? (double)ns / (double)ids.frames : 0.0, 
+     ns ? (double)ids.frames * 1000.0 / (double)ns : 0.0, 
+     ns ? (double)wire * 8.0 / (double)ns : 0.0);
+  }
+  for (i = 0; i < IDS_ALERT_COUNT; i++)
+  {
+    if (ids.alerts[i])
+    {
+      fprintf(stdout, "    %-26s %llu\n", IDS_ALERT_NAMES[i], 
+       (unsigned long long)ids.alerts[i]);
+    }
+  }
+  fprintf(stdout, "[=] %llu alerts not logged, over %d per stream per "
+   "second, %llu log records dropped\n", 
+   (unsigned long long)ids.suppressed, IDS_MAX_ALERTS, 
+   (unsigned long long)log_dropped());
+
+  /* Done */
+  ids_free(&ids);
+  if (NULL != config)
+  {
+    config_unmap(config);
+  }
+  fflush(stdout);
+  return ret;
+}
+
+
+void print_usage(void) 
+{
+  fprintf(stdout, "goose_ids, version %s\n\n", VER);
+  fprintf(stdout, "usage: goose_ids [-c config] [-d secs] [-l secs] "
+   "[-n streams] [-t transport] [-v] iface\n");
+  fprintf(stdout, "       goose_ids [-c config] [-l secs] [-n streams] [-v] "
+   "-r capture\n\n");
+  fprintf(stdout, "  -c config : expect the streams subscribed to in a "
+   "goose_scl image\n");
+  fprintf(stdout, "  -d secs : seconds to check for, default until "
+   "interrupted\n");
+  fprintf(stdout, "  -l secs : seconds each stream learns its rate and TAL "
+   "for, default %d\n", IDS_LEARN_WINDOWS);
+  fprintf(stdout, "  -n streams : streams tracked, default %d\n", 
+   IDS_STREAMS);
+  fprintf(stdout, "  -r capture : check a pcap or pcapng capture as fast as "
+   "possible\n");
+  fprintf(stdout, "  -t transport : pcap (default), packet or loopback\n");
+  fprintf(stdout, "  -v : also print each stream as it is learned\n");
+  fprintf(stdout, "  iface : network interface to check\n");
+  fflush(stdout);
+  return;
+}
+
+
+void signal_handler(int sig)
+{
+  (void)sig;
+  STOP = 1;
+  transport_break(&TP);
+}
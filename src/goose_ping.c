@@ -29,10 +29,18 @@
  * $Author$
  */
 
+#include "config.h"
+#include "diff.h"
+#include "gcb_example.h"
+#include "gmac.h"
 #include "goose.h"
+#include "log.h"
 #include "utils.h"
 #include "publisher.h"
+#include "replay.h"
+#include "stats.h"
 #include "subscriber.h"
+#include "transport.h"
 
 #include <errno.h>
 #include <semaphore.h>
@@ -43,6 +51,8 @@
 #include <string.h>
 #include <pcap.h>
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
 #include <arpa/inet.h>
 
 // DEBUG
@@ -102,10 +112,58 @@ static const int TIMEOUT=5000;
 #define NUM_TRIGGERS 10
 
 /**
- * Array of time values for send and receive times.
+ * The number of input triggers per configuration in the security benchmark, 
+ * which follows the test pass criteria, and the size of the time arrays
  */
-static struct timeval SEND_TIMES[NUM_TRIGGERS];
-static struct timeval RECV_TIMES[NUM_TRIGGERS];
+#define MAX_TRIGGERS 1000
+
+/**
+ * Arrays of monotonic send and receive times, and of the time taken to sign 
+ * and verify each frame, in nanoseconds
+ */
+static uint64_t SEND_TIMES[MAX_TRIGGERS];
+static uint64_t RECV_TIMES[MAX_TRIGGERS];
+static uint64_t SIGN_TIMES[MAX_TRIGGERS];
+static uint64_t VERIFY_TIMES[MAX_TRIGGERS];
+
+/**
+ * Time to wait for each frame to be received in the security benchmark before 
+ * it is counted as lost, in nanoseconds
+ */
+#define PONG_WAIT_NS 100000000ULL
+
+/**
+ * The number of bursts to publish per transmit path in the transmit benchmark
+ */
+#define NUM_BURSTS 100
+
+/**
+ * Retransmission curve of the jitter test. The state changes every 
+ * STATE_PERIOD_MS, the frame is repeated RETRANS_MIN_MS after the change 
+ * and the interval doubles up to the heartbeat interval RETRANS_MAX_MS.
+ */
+#define STATE_PERIOD_MS 2000ULL
+#define RETRANS_MIN_MS 1ULL
+#define RETRANS_MAX_MS 500ULL
+
+/**
+ * Delay before the first deadline of the jitter test, so that the first 
+ * frame is not late
+ */
+#define START_DELAY_NS 10000000ULL
+
+/**
+ * Frames published per batch, and time to wait for each batch to be 
+ * received, in the pipeline benchmark
+ */
+#define PIPE_BATCH 32
+#define PIPE_WAIT_MS 100
+
+/**
+ * Name of the ring the pipeline benchmark uses over the loopback transport 
+ * when no interface is given
+ */
+static char LOOP_RING[] = "goose_ping";
 
 /**
  * Count of number of GOOSE frames sent and received, used to track the send 
@@ -114,6 +172,47 @@ static struct timeval RECV_TIMES[NUM_TRIGGERS];
 static unsigned int num_sent = 0;
 static unsigned int num_recv = 0;
 
+/**
+ * Index of the interface in the shared memory metrics, or -1 if the metrics 
+ * are not enabled
+ */
+static int METRICS_IFACE = -1;
+
+/**
+ * Count of number of received GOOSE frames whose protected checksum failed 
+ * verification
+ */
+static unsigned int num_auth_fail = 0;
+
+/**
+ * Count of number of received GOOSE frames rejected as replayed, before their 
+ * protected checksum is verified
+ */
+static unsigned int num_replayed = 0;
+
+/**
+ * Security context shared by the publisher and subscriber, and a pointer to it 
+ * which is NULL when frames are not authenticated
+ */
+static goose_sec_t SEC;
+static goose_sec_t *SEC_PTR = NULL;
+
+/**
+ * AES-GMAC implementation used, the fastest the CPU supports unless -P
+ */
+static gmac_impl_t GMAC_SEL = GMAC_IMPL_AUTO;
+
+/**
+ * Replay window of the authenticated streams received, the ping test does not 
+ * synchronise clocks so timestamps are only checked within a state
+ */
+static replay_table_t REPLAY;
+
+/**
+ * Maximum length of the authentication key specified on the command line
+ */
+#define MAX_KEY_LEN 64
+
 
 
 /*
@@ -151,6 +250,19 @@ void goose_pong_handler(u_char *args, const struct pcap_pkthdr *header,
  */
 //int goose_ping(void *pcap, void *goose_frame, void *stNum);
 
+/**
+ * Function to benchmark the transmit paths by publishing bursts of GOOSE 
+ * frames, first with pcap_inject and then through an io_uring transmit ring 
+ * with a single submission per burst, and printing the cost per frame.
+ *
+ * @param goose_frame_ptr	pointer to the GOOSE frame to publish
+ * @param pcap_ptr	pointer to the packet capture handle to inject on
+ * @param iface	name of the network interface to open the io_uring ring on
+ * @param burst	number of frames to publish per burst
+ */
+void tx_bench(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr, 
+ const char *iface, int burst);
+
 /**
  * Function to print the time difference between the send and receive times 
  * for the frames
@@ -200,6 +312,80 @@ typedef struct _recv_args_t
   u_char *user;         /* Pointer to user argument */
 } recv_args_t;
 
+
+/**
+ * Function to benchmark the overhead of the security mechanisms. The 
+ * ping-pong test is run for each authentication algorithm, none, HMAC-SHA256 
+ * and AES-GMAC, with datasets of increasing size, publishing each frame once 
+ * the previous frame has been received. The round trip time, and the time 
+ * taken to sign and verify each frame, are printed as percentiles. The hash 
+ * and MAC are first checked against their known answers, and nothing is 
+ * timed if any differ.
+ *
+ * @param goose_frame_ptr	pointer to the GOOSE frame to publish
+ * @param pcap_ptr	pointer to the packet capture handle to inject on
+ * @param args	pointer to the arguments for the subscriber thread
+ * @return int	- 0 on success, else -1 if a known answer test failed or 
+ * 		the subscriber could not be started
+ */
+int sec_bench(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr, 
+ recv_args_t *args);
+
+/**
+ * Function to measure publish jitter by publishing on the retransmission 
+ * curve for a number of seconds, each frame on an absolute deadline, and 
+ * printing how late each frame was encoded, handed to pcap_inject and, 
+ * where the kernel supports software transmit timestamps, sent by the 
+ * kernel. The lateness is also added to the shared memory metrics of the 
+ * stream if they are enabled.
+ *
+ * @param goose_frame_ptr	pointer to the GOOSE frame to publish
+ * @param pcap_ptr	pointer to the packet capture handle to inject on
+ * @param secs	number of seconds to publish for
+ */
+void jitter_test(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr, 
+ unsigned int secs);
+
+/**
+ * Function to benchmark the whole pipeline, publishing batches of frames 
+ * through a transport, receiving them through a second transport on the 
+ * same interface, and decoding them through a dispatch table. Over the 
+ * loopback transport this needs no privileges and measures the cost of the 
+ * stack without the kernel.
+ *
+ * @param goose_frame_ptr	pointer to the GOOSE frame to publish
+ * @param ops	pointer to the transport to use
+ * @param iface	name of the interface, or of the loopback ring
+ * @param frames	number of frames to publish
+ */
+void pipeline_bench(goose_frame_t *goose_frame_ptr, const transport_ops_t *ops, 
+ const char *iface, int frames);
+
+/**
+ * Function to benchmark the encoder and decoder generated by goose_gen from 
+ * schema/gcb_example.gcb against the generic encoder and dataset decoder, 
+ * after checking that both encode the same bytes, then the lazy decode of 
+ * retransmissions against decoding every frame in full, and the dataset 
+ * diff of a state change.
+ *
+ * @param goose_frame_ptr	pointer to the GOOSE frame of the control block
+ * @param frames	number of frames to encode and decode
+ */
+void codec_bench(goose_frame_t *goose_frame_ptr, int frames);
+
+
+/**
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
 /** 
  * The GOOSE messaging transfer time is specified in PArt 5 of the IEC 61850 
  * technical specification. The transfer time is the sum of the publishing 
@@ -246,12 +432,139 @@ typedef struct _recv_args_t
 */
 int main(int argc, char *argv[]) 
 {
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  int burst = 0;           /* Transmit benchmark burst size, 0 for ping-pong */
+  int bench_sec = 0;            /* Non-zero to run the security benchmark */
+  int vid = -1;              /* 802.1Q VLAN identifier, or -1 for untagged */
+  uint8_t key[MAX_KEY_LEN];                   /* HMAC-SHA256 key, if any */
+  size_t key_len = 0;                      /* Number of bytes in the key */
+  sec_alg_t alg = SEC_HMAC_SHA256;         /* Authentication algorithm */
+  int verbosity = LOG_LEVEL_WARN;         /* Level of the records printed */
+  int metrics = 0;            /* Non-zero to publish shared memory metrics */
+  int unprotected = 0;     /* Non-zero to accept unprotected frames with -k */
+  int jitter_sec = 0;           /* Seconds to run the jitter test, if any */
+  int pipeline = 0;         /* Frames of the pipeline benchmark, if any */
+  int codec = 0;               /* Frames of the codec benchmark, if any */
+  const transport_ops_t *ops = &TRANSPORT_LOOPBACK;  /* Pipeline transport */
+  const char *config_path = NULL;      /* Configuration image, if any */
+  char *iface = NULL;                          /* Name of network interface */
+
   /* Check paramaters */
-  if (argc != 2) 
+  while (-1 != (opt = getopt(argc, argv, "a:b:c:G:k:L:mPST:t:uvV:")))
+  {
+    switch (opt)
+    {
+      case 'm':
+        metrics = 1;
+        break;
+      case 'u':
+        unprotected = 1;
+        break;
+      case 'v':
+        verbosity += (verbosity < LOG_LEVEL_TRACE);
+        break;
+      case 'P':
+        GMAC_SEL = GMAC_IMPL_PORTABLE;
+        gmac_set_impl(GMAC_SEL);
+        break;
+      case 'S':
+        bench_sec = 1;
+        break;
+      case 'c':
+        config_path = optarg;
+        break;
+      case 'G':
+        codec = atoi(optarg);
+        if (codec <= 0)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'L':
+        pipeline = atoi(optarg);
+        if (pipeline <= 0)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 't':
+        ops = transport_find(optarg);
+        if (NULL == ops)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'T':
+        jitter_sec = atoi(optarg);
+        if (jitter_sec <= 0)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'a':
+        if (0 == strcmp(optarg, "hmac"))
+        {
+          alg = SEC_HMAC_SHA256;
+        }
+        else if (0 == strcmp(optarg, "gmac"))
+        {
+          alg = SEC_AES_GMAC;
+        }
+        else
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'k':
+        key_len = hex_to_bytes(optarg, key, MAX_KEY_LEN);
+        if (0 == key_len)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'V':
+        vid = atoi(optarg);
+        if (vid < 0 || vid > 0x0fff)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'b':
+        burst = atoi(optarg);
+        if (burst <= 0)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  /* The pipeline benchmark needs no interface over the loopback transport */
+  if ((codec || (pipeline && &TRANSPORT_LOOPBACK == ops)) && argc == optind)
+  {
+    iface = LOOP_RING;
+  }
+  else if (argc - optind != 1) 
   {
     print_usage();
     return -1;
   }
+  else
+  {
+    iface = argv[optind];
+  }
 
   /* Declare local variables */
   pthread_t recv_thread;                /* Thread struct to receiving thread */
@@ -262,6 +575,8 @@ int main(int argc, char *argv[])
   int i = 0;          /* Loop index and temporary variable for return values */
   recv_args_t args = {0};    /* Arguments struct used to pass data to thread */
   goose_frame_t goose_frame;      /* The GOOSE frame to write to the network */
+  const config_t *config = NULL;              /* Mapped configuration image */
+  uint64_t map_start = 0;                  /* Time the image was mapped at */
   uint8_t dmac[6] = { 0x8, 0x93, 0x01, 0x3e, 0x10, 0x73 };       /* Dest MAC */
   uint8_t smac[6] = { 0x8, 0x93, 0x01, 0x3e, 0x10, 0x73 };        /* Src MAC */
   uint8_t gocbref[] = "GE_N60CTRL/LLN0$GO$gcb03"; /* Control block reference */
@@ -273,7 +588,12 @@ int main(int argc, char *argv[])
     .timeval.tv_usec = 0,
     .time_quality = 0
   };
-  struct timeval tv = {0};           /* Temporary variable to hold send time */
+
+  /* Per-frame output goes through the log ring, off the timed paths */
+  if (0 != log_start(stdout, (log_level_t)verbosity))
+  {
+    exit(EXIT_FAILURE);
+  }
 
   /* Initialise sigaction structure */
   memset(&signal_action, 0, sizeof(struct sigaction));
@@ -301,13 +621,40 @@ int main(int argc, char *argv[])
   }
 
   /* Prepare the GOOSE message */
+  memset(&goose_frame, 0, sizeof(goose_frame_t));
   set_dest_mac(&goose_frame, (const uint8_t *)&dmac);
   set_src_mac(&goose_frame, (const uint8_t *)&smac);
   goose_frame.eth_hdr.ether_type = htons(ETHER_GOOSE);
+  if (vid >= 0)
+  {
+    set_vlan(&goose_frame, (uint16_t)vid, GOOSE_DEFAULT_PCP);
+  }
+
+  /* Authenticate frames if a key was specified */
+  if (key_len > 0)
+  {
+    if (0 != ((SEC_AES_GMAC == alg) 
+     ? sec_init_aes_gmac(&SEC, key, key_len)
+     : sec_init_hmac_sha256(&SEC, key, key_len, 0)))
+    {
+      fprintf(stderr, "[!] could not initialise security context\n");
+      exit(EXIT_FAILURE);
+    }
+    if (SEC_AES_GMAC == alg)
+    {
+      fprintf(stdout, "[-] AES-GMAC using %s implementation\n", 
+       gmac_impl_name());
+    }
+    memset(key, 0, MAX_KEY_LEN);
+    SEC.unprotected = unprotected;
+    SEC_PTR = &SEC;
+    goose_frame.sec = SEC_PTR;
+  }
+  replay_init(&REPLAY, 1, REPLAY_NO_CLOCK);
 
   /* Initialise GOOSE Header */
   goose_frame.goose_header.appid = htons(0x0);
-  goose_frame.goose_header.len = htons(0x6B); /* TODO: Calculate this */
+  goose_frame.goose_header.len = htons(0x0);  /* Calculated by the encoder */
   goose_frame.goose_header.res1 = htons(0x0);
   goose_frame.goose_header.res2 = htons(0x0);
 
@@ -326,31 +673,122 @@ int main(int argc, char *argv[])
   goose_frame.goose_pdu.allData = 0;                   /* allData */
   goose_frame.goose_pdu.security = 0;                  /* security (optional) */
 
+  /* Publish the first control block of a configuration image compiled by 
+   * goose_scl in place of the built-in one */
+  if (NULL != config_path)
+  {
+    map_start = now_ns();
+    config = config_map(config_path);
+    if (NULL == config || 0 == config->num_pubs)
+    {
+      fprintf(stderr, "[!] no control block to publish in %s\n", config_path);
+      exit(EXIT_FAILURE);
+    }
+    config_frame(config, config_pub(config, 0), &goose_frame);
+    fprintf(stdout, "[-] %s: IED %s mapped and %s set up in %llu us\n", 
+     config_path, config->ied, (const char *)goose_frame.goose_pdu.gocbref, 
+     (unsigned long long)((now_ns() - map_start) / 1000));
+    goose_frame.goose_pdu.numDatSetEntries = 0;   /* No dataset is published */
+  }
+
+  /* Count frames in shared memory for goose_stat, publisher and subscriber 
+   * share the interface */
+  if (metrics)
+  {
+    if (0 != metrics_init(METRICS_SHM_NAME))
+    {
+      exit(EXIT_FAILURE);
+    }
+    METRICS_IFACE = metrics_iface(iface);
+    goose_frame.metrics = metrics_stream(METRICS_IFACE, 
+     ntohs(goose_frame.goose_header.appid), goose_frame.goose_pdu.gocbref, 
+     strlen((const char *)goose_frame.goose_pdu.gocbref));
+  }
+
+
+  /* Run the codec benchmark, which needs no interface */
+  if (codec > 0)
+  {
+    codec_bench(&goose_frame, codec);
+    log_stop();
+    metrics_fini();
+    sec_clear(&SEC);
+    replay_free(&REPLAY);
+    fflush(stdout);
+    exit(EXIT_SUCCESS);
+  }
+
+  /* Run the pipeline benchmark, which opens its own transports */
+  if (pipeline > 0)
+  {
+    pipeline_bench(&goose_frame, ops, iface, pipeline);
+    log_stop();
+    metrics_fini();
+    sec_clear(&SEC);
+    replay_free(&REPLAY);
+    fflush(stdout);
+    exit(EXIT_SUCCESS);
+  }
+
   /* Open the network interface specified for capture */
   errbuf[0] = '\0'; /* NULL terminate the buffer */
 
   /* BUFSIZ is defined in pcap.h */
-  pcap = pcap_open_live(argv[1], BUFSIZ, PROMISC, TIMEOUT, (char *)&errbuf);
+  pcap = pcap_open_live(iface, BUFSIZ, PROMISC, TIMEOUT, (char *)&errbuf);
   if (NULL == pcap) /* Check if packet capture handle was obtained */
   {
-    fprintf(stderr, "[!] could not open pcap (%s - %s)\n", argv[1], errbuf);
+    fprintf(stderr, "[!] could not open pcap (%s - %s)\n", iface, errbuf);
     fflush(stderr);
     exit(EXIT_FAILURE);
   } 
   else if (strlen(errbuf) > 0) /* Check if any warning were raised */
   {
     fprintf(stderr, "[!] warning when opening pcap (%s - %s)\n", 
-     argv[1], errbuf);
+     iface, errbuf);
+  }
+
+  /* Run the transmit benchmark instead of the ping-pong test */
+  if (burst > 0)
+  {
+    tx_bench(&goose_frame, pcap, iface, burst);
+    log_stop();
+    pcap_close(pcap);
+    fflush(stdout);
+    exit(EXIT_SUCCESS);
+  }
+
+  /* Run the jitter test instead of the ping-pong test */
+  if (jitter_sec > 0)
+  {
+    jitter_test(&goose_frame, pcap, (unsigned int)jitter_sec);
+    log_stop();
+    metrics_fini();
+    sec_clear(&SEC);
+    pcap_close(pcap);
+    fflush(stdout);
+    exit(EXIT_SUCCESS);
   }
 
   /* Set-up arguments to pass to receiver thread */
-  args.iface = argv[1];                              /* Pointer to interface */
+  args.iface = iface;                                /* Pointer to interface */
   memcpy(&(args.from), &smac, 6 * sizeof(uint8_t));      /* Set hardware MAC */
   args.count = NUM_TRIGGERS;         /* Count of number of frames to receive */
   //args.handler = dummy_goose_handler;       /* GOOSE handler in subscriber.h */
   args.handler = goose_pong_handler;       /* GOOSE handler in subscriber.h */
   args.user = NULL;                             /* Pointer to user arguments */
 
+  /* Run the security benchmark instead of the ping-pong test */
+  if (bench_sec)
+  {
+    i = sec_bench(&goose_frame, pcap, &args);
+    log_stop();
+    sec_clear(&SEC);
+    replay_free(&REPLAY);
+    pcap_close(pcap);
+    fflush(stdout);
+    exit(i ? EXIT_FAILURE : EXIT_SUCCESS);
+  }
+
   /* Start the receiving (subscriber) thread */
   /* DEBUG */ printf("[-] creating subscriber thread\n");
   thread_return = pthread_create(&recv_thread, (pthread_attr_t *)NULL, 
@@ -376,21 +814,14 @@ int main(int argc, char *argv[])
   for(i = 0; i < NUM_TRIGGERS; i++ )
   {
     /* Get send time */
-    if (gettimeofday(&tv, NULL)) 
-    {
-      HANDLE_ERRNO(errno, "main.gettimeofday"); /* Print error and continue */
-    }
-    else
-    {
-      memcpy(&SEND_TIMES[num_sent++], &tv, sizeof(struct timeval));
-    }
+    SEND_TIMES[num_sent++] = now_ns();
 
     /* Increment sequence number like a valid GOOSE frame */
     goose_frame.goose_pdu.sqNum += 1; /* sqNum */
 
     /* Publish GOOSE frames */
     publish( &goose_frame, pcap );
-    /* DEBUG */ printf("[.] published (%u)\n", num_sent);
+    LOG_EVENT(LOG_EV_PUBLISHED, num_sent);
   }
   /* DEBUG */ printf("[+] finished publishing\n");
   /* Wait for all threads or timeout to occur before main continues */
@@ -402,7 +833,19 @@ int main(int argc, char *argv[])
   }
 
   /* DEBUG */ printf("[+] finished run\n");
+  log_stop();
+  metrics_fini();
   print_times();
+  if (num_auth_fail)
+  {
+    fprintf(stdout, "[!] %u frames failed authentication\n", num_auth_fail);
+  }
+  if (num_replayed)
+  {
+    fprintf(stdout, "[!] %u frames rejected as replayed\n", num_replayed);
+  }
+  sec_clear(&SEC);
+  replay_free(&REPLAY);
  
   /* Close the network interface */ 
   pcap_close(pcap);
@@ -438,6 +881,7 @@ void *goose_pong(void *args)
   char errbuf[PCAP_ERRBUF_SIZE] = {0};                   /* PCAP error buffer */
   recv_args_t *recv_args = (recv_args_t *)args;   /* Cast void* to recv_args* */
   pcap_t *pcap = NULL;                    /* Pointer to packet capture handle */
+  struct pcap_stat ps;                        /* Statistics of the capture */
 
   /* Initialise error buffer */
   errbuf[0] = '\0'; /* Null terminate error buffer */
@@ -466,6 +910,14 @@ void *goose_pong(void *args)
   /* DEBUG */ printf("[-] starting subscriber\n");
   read_result = subscribe(recv_args->from, pcap, recv_args->count,
    recv_args->handler);
+  if (0 == pcap_stats(pcap, &ps))
+  {
+    metrics_rx_drops(METRICS_IFACE, ps.ps_drop);
+    if (ps.ps_drop)
+    {
+      fprintf(stdout, "[!] %u frames dropped by the kernel\n", ps.ps_drop);
+    }
+  }
   if (read_result == 0) 
   {
     fprintf(stdout, "[+] done processing %d frames\n", recv_args->count);
@@ -503,11 +955,11 @@ void dummy_goose_handler(u_char *args, const struct pcap_pkthdr *header,
   if (NULL == args || NULL == header || NULL == packet)
   {
     /* Output failure */
-    printf("!");
+    LOG_EVENT(LOG_EV_INVALID_PARAMS, 0);
   }
 
   /* Pretend that frame is processed correctly and output success */
-  printf(".");
+  LOG_EVENT(LOG_EV_HANDLED, 0);
   return;
 }
 
@@ -516,35 +968,33 @@ void goose_pong_handler(u_char *args, const struct pcap_pkthdr *header,
  const u_char *packet) 
 {
   /* Check parameters */
-  if (NULL == header || NULL == packet)
+  if (NULL == header || NULL == packet || 0 == header->len)
   {
-    fprintf(stderr, "[!] invalid parameters\n"); 
-    fflush(stderr);
+    LOG_EVENT(LOG_EV_INVALID_PARAMS, 0);
     return;
   }
 
   /* Declare local variables */
-  int len = 0;             /* Variable to hold number of bytes read off wire */
   struct ether_header *eth_hdr = NULL;         /* Pointer to ethernet header */
-  uint16_t *res1 = 0;                     /* Pointer to the Reserver 1 field */
-  struct timeval tv = {0};           /* Temporary variable to hold send time */
-
-  /* Initialise variables */
-  len = header->len; /* Get number of bytes */
-  if (0 == len) 
+  const uint8_t *payload = NULL;    /* Pointer to payload after any 802.1Q tag */
+  uint16_t ethertype = 0;             /* Ethertype of the (untagged) payload */
+  uint64_t verify_start = 0;          /* Time verification of frame started */
+  uint64_t verify_end = 0;           /* Time verification of frame finished */
+  int auth = 0;                           /* Result of authenticating frame */
+  goose_view_t view;                          /* View of the decoded frame */
+  metrics_stream_t *stream = NULL;               /* Counters of the stream */
+
+  /* Get ethernet frame, VLAN encapsulated frames are unwrapped in place */
+  eth_hdr = (struct ether_header *)packet;
+  payload = get_ether_payload(packet, header->caplen, &ethertype, NULL);
+  if (NULL == payload)
   {
-    fprintf(stderr, "[!] frame length zero\n"); 
-    fflush(stderr);
     return;
   }
 
-  /* Get ethernet frame */
-  eth_hdr = (struct ether_header *)packet;
-
   /* Determine type of ethernet frame */
-  switch (ntohs(eth_hdr->ether_type)) 
+  switch (ethertype) 
   {
-    /* Process VLAN encapsulated frame */
     /* Process GOOSE frame */
     case 0x88b8:
       /* Check if the subscriber MAC matches */
@@ -553,56 +1003,840 @@ void goose_pong_handler(u_char *args, const struct pcap_pkthdr *header,
         break;
       }
 
-      /* Check if a protected checksum is present */
-      res1 = get_res1((goose_frame_t *)packet);
-      if (0 != res1)
+      /* Check the protected checksum, we use the most significant bit of 
+         the reserved 1 field to indicate that a protected checksum is 
+         present */
+      verify_start = now_ns();
+      auth = authenticate_goose_frame(SEC_PTR, &REPLAY, packet, 
+       header->caplen);
+      switch (auth)
       {
-        /* We using the most significant bit of the reserved 1 field to 
-           indicate that a protected checksum is present */
-        if (0x80 == (0x80 | (*res1))) 
-        {
-          /* Check if the protected checksum is correct */
-          if (0 != verify_protected_checksum((goose_frame_t *)packet))
-          {
-            /* TODO: maybe log error, but we just working on timing of checks */
-          }
-        }
+        case -3:
+          num_replayed++;
+          LOG_EVENT(LOG_EV_REPLAYED, 0);
+          break;
+        case -2:
+        case -1:
+          /* Count failures, but we just working on timing of checks */
+          num_auth_fail++;
+          LOG_EVENT(LOG_EV_AUTH_FAILED, (int64_t)auth);
+          break;
+        default:
+          break;
       }
 
       /* OK - ready for processing so get recv time */
-      if (gettimeofday(&tv, NULL)) 
+      verify_end = now_ns();
+
+      /* Count the frame against its stream, the frame is only decoded for 
+       * this when metrics are enabled */
+      if (METRICS_IFACE >= 0)
       {
-        HANDLE_ERRNO(errno, "goose_pong_handler.gettimeofday"); /* Print error and continue */
+        if (0 == decode_goose_header(packet, header->caplen, &view))
+        {
+          stream = metrics_stream(METRICS_IFACE, view.appid, view.gocbref, 
+           view.gocbrefLen);
+          metrics_rx(stream, header->caplen, view.stNum, view.sqNum, 
+           view.timeAllowedtoLive, verify_end);
+        }
+        else
+        {
+          metrics_rx_error(METRICS_IFACE);
+        }
+        metrics_auth(stream, auth);
+        if (num_recv < num_sent && num_recv < MAX_TRIGGERS)
+        {
+          metrics_latency(stream, verify_end - SEND_TIMES[num_recv]);
+        }
       }
-      else
+
+      if (num_recv < MAX_TRIGGERS)
       {
-        memcpy(&RECV_TIMES[num_recv++], &tv, sizeof(struct timeval));
+        RECV_TIMES[num_recv] = verify_end;
+        VERIFY_TIMES[num_recv] = verify_end - verify_start;
       }
-
-      /* DEBUG */ printf("[.] received (%u)\n", num_recv);
-       
+      __atomic_store_n(&num_recv, num_recv + 1, __ATOMIC_RELEASE);
+      LOG_EVENT(LOG_EV_RECEIVED, num_recv);
       break;
     /* Ignore all other frames */
     default:
       break;
   }
 
-  fflush(stdout);
   return; /* Done handling frame */
 }
 
 
+/**
+ * Function to return the elapsed time in nanoseconds between two monotonic 
+ * clock readings
+ */
+static uint64_t elapsed_ns(const struct timespec *start, 
+ const struct timespec *end)
+{
+  return (uint64_t)((end->tv_sec - start->tv_sec) * 1000000000L 
+   + (end->tv_nsec - start->tv_nsec));
+}
+
+
+void tx_bench(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr, 
+ const char *iface, int burst)
+{
+  /* Declare local variables */
+  int i = 0;                                       /* Frame index in burst */
+  int r = 0;                                       /* Burst index in run */
+  int path = 0;                   /* Transmit path, 0 = pcap, 1 = io_uring */
+  uring_tx_t *tx = NULL;                           /* io_uring transmit ring */
+  struct timespec start = {0};                  /* Start time of the burst */
+  struct timespec end = {0};                      /* End time of the burst */
+  uint64_t ns = 0;                              /* Duration of the burst */
+  uint64_t min_ns = 0;                            /* Fastest burst duration */
+  uint64_t max_ns = 0;                            /* Slowest burst duration */
+  uint64_t sum_ns = 0;                       /* Sum of all burst durations */
+  uint64_t allocs = 0;              /* Heap allocations made by the bursts */
+  static const char *PATH_NAME[2] = { "pcap_inject", "io_uring" };
+
+  /* Create the frame pool up front, so the bursts measure the steady state */
+  if (NULL == pool_default())
+  {
+    fprintf(stderr, "[!] could not create frame pool\n");
+    return;
+  }
+
+  /* The io_uring ring is sized to hold a whole burst of registered buffers */
+  tx = uring_tx_open(iface, (unsigned int)burst);
+  if (NULL == tx)
+  {
+    fprintf(stderr, "[!] io_uring transmit unavailable, pcap only\n");
+  }
+
+  fprintf(stdout, "[-] %d bursts of %d frames\n", NUM_BURSTS, burst);
+  for (path = 0; path < 2; path++)
+  {
+    if (1 == path && NULL == tx)
+    {
+      break;
+    }
+
+    min_ns = UINT64_MAX;
+    max_ns = 0;
+    sum_ns = 0;
+    allocs = __atomic_load_n(&MALLOC_COUNT, __ATOMIC_RELAXED);
+    for (r = 0; r < NUM_BURSTS; r++)
+    {
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for (i = 0; i < burst; i++)
+      {
+        goose_frame_ptr->goose_pdu.sqNum += 1;
+        if (0 == path)
+        {
+          publish(goose_frame_ptr, pcap_ptr);
+        }
+        else
+        {
+          publish_uring(goose_frame_ptr, tx);
+        }
+      }
+      if (1 == path)
+      {
+        /* One io_uring_enter per burst, wait so both paths are synchronous */
+        uring_tx_submit(tx, 1);
+      }
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      ns = elapsed_ns(&start, &end);
+      sum_ns += ns;
+      min_ns = (ns < min_ns) ? ns : min_ns;
+      max_ns = (ns > max_ns) ? ns : max_ns;
+    }
+    allocs = __atomic_load_n(&MALLOC_COUNT, __ATOMIC_RELAXED) - allocs;
+
+    fprintf(stdout, "%-12s burst min/avg/max: %llu/%llu/%llu us, "
+     "%llu ns/frame, %llu heap allocations\n", PATH_NAME[path], 
+     (unsigned long long)(min_ns / 1000), 
+     (unsigned long long)(sum_ns / NUM_BURSTS / 1000),
+     (unsigned long long)(max_ns / 1000),
+     (unsigned long long)(sum_ns / ((uint64_t)NUM_BURSTS * burst)),
+     (unsigned long long)allocs);
+  }
+
+  if (tx)
+  {
+    if (uring_tx_errors(tx))
+    {
+      fprintf(stderr, "[!] io_uring transmit errors (%llu)\n", 
+       (unsigned long long)uring_tx_errors(tx));
+    }
+    uring_tx_close(tx);
+  }
+  fflush(stdout);
+}
+
+
+/**
+ * Function to build a dataset of alternating boolean and quality entries, the 
+ * typical layout of a protection GOOSE dataset
+ *
+ * @param buf	pointer to the buffer to hold the BER encoded entries
+ * @param entries	number of dataset entries
+ * @return uint16_t	number of bytes of BER encoded entries
+ */
+static uint16_t build_dataset(uint8_t *buf, unsigned int entries)
+{
+  /* Declare local variables */
+  static const uint8_t BOOL_ENTRY[] = { 0x83, 0x01, 0x00 };  /* FALSE */
+  static const uint8_t QUAL_ENTRY[] = { 0x84, 0x03, 0x03, 0x00, 0x00 }; /* good */
+  uint16_t len = 0;                            /* Number of bytes encoded */
+  unsigned int i = 0;                                          /* Loop index */
+
+  for (i = 0; i < entries; i++)
+  {
+    if (0 == (i % 2))
+    {
+      memcpy(buf + len, BOOL_ENTRY, sizeof(BOOL_ENTRY));
+      len += sizeof(BOOL_ENTRY);
+    }
+    else
+    {
+      memcpy(buf + len, QUAL_ENTRY, sizeof(QUAL_ENTRY));
+      len += sizeof(QUAL_ENTRY);
+    }
+  }
+
+  return len;
+}
+
+
+int sec_bench(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr, 
+ recv_args_t *args)
+{
+  /* Declare local variables */
+  static const sec_alg_t ALGS[] = { SEC_NONE, SEC_HMAC_SHA256, SEC_AES_GMAC };
+  static const char *ALG_NAME[] = { "none", "hmac-sha256", "aes-gmac" };
+  static const gmac_impl_t IMPLS[] = { GMAC_IMPL_PORTABLE, GMAC_IMPL_AESNI };
+  static const unsigned int ENTRIES[] = { 2, 16, 64, 256 };
+  static const uint8_t BENCH_KEY[32] = {
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 
+    0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f,
+    0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 
+    0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f
+  };                                  /* Fixed key, timing is key agnostic */
+  static uint8_t all_data[MAX_FRAME_SIZE];       /* Encoded dataset entries */
+  static uint64_t rtt[MAX_TRIGGERS];               /* Round trip times */
+  uint8_t frame[MAX_FRAME_SIZE];        /* Encoded frame, to report size */
+  uint16_t frame_len = 0;                 /* Length of the encoded frame */
+  pthread_t recv_thread;                /* Thread struct to receiving thread */
+  percentiles_t pct;                            /* Summary of a distribution */
+  size_t a = 0;                                      /* Algorithm index */
+  size_t e = 0;                                    /* Dataset size index */
+  unsigned int i = 0;                                   /* Trigger index */
+  unsigned int lost = 0;               /* Frames not received in time */
+  uint64_t deadline = 0;            /* Time to give up waiting for a frame */
+  int ret = 0;                   /* Variable to hold thread return codes */
+
+  /* Check the primitives before timing them, with each AES-GMAC 
+   * implementation the CPU supports */
+  for (a = 0; a < sizeof(IMPLS) / sizeof(IMPLS[0]); a++)
+  {
+    if (0 != gmac_set_impl(IMPLS[a]))
+    {
+      continue;
+    }
+    if (0 != sec_self_test())
+    {
+      fprintf(stderr, "[!] known answer tests failed, aes-gmac using %s\n", 
+       gmac_impl_name());
+      ret = -1;
+      continue;
+    }
+    fprintf(stdout, "[+] known answer tests passed, aes-gmac using %s\n", 
+     gmac_impl_name());
+  }
+  gmac_set_impl(GMAC_SEL);
+  if (ret)
+  {
+    return -1;
+  }
+
+  fprintf(stdout, "[-] security benchmark, %d frames per configuration, "
+   "times in ns, aes-gmac using %s\n", MAX_TRIGGERS, gmac_impl_name());
+
+  args->count = MAX_TRIGGERS;
+  for (a = 0; a < sizeof(ALGS) / sizeof(ALGS[0]); a++)
+  {
+    /* Set up the security context for the algorithm */
+    sec_clear(&SEC);
+    SEC_PTR = NULL;
+    if (SEC_HMAC_SHA256 == ALGS[a])
+    {
+      sec_init_hmac_sha256(&SEC, BENCH_KEY, sizeof(BENCH_KEY), 0);
+      SEC_PTR = &SEC;
+    }
+    else if (SEC_AES_GMAC == ALGS[a])
+    {
+      if (0 != sec_init_aes_gmac(&SEC, BENCH_KEY, 16))
+      {
+        fprintf(stderr, "[!] could not initialise security context\n");
+        continue;
+      }
+      SEC_PTR = &SEC;
+    }
+    SEC.timed = 1;
+    goose_frame_ptr->sec = SEC_PTR;
+
+    for (e = 0; e < sizeof(ENTRIES) / sizeof(ENTRIES[0]); e++)
+    {
+      /* Set up the dataset */
+      goose_frame_ptr->goose_pdu.allData = all_data;
+      goose_frame_ptr->goose_pdu.allDataLen = build_dataset(all_data, 
+       ENTRIES[e]);
+      goose_frame_ptr->goose_pdu.numDatSetEntries = ENTRIES[e];
+      encode_goose_frame(goose_frame_ptr, frame, &frame_len);
+
+      /* Start the subscriber for this configuration */
+      num_sent = 0;
+      __atomic_store_n(&num_recv, 0, __ATOMIC_RELEASE);
+      num_auth_fail = 0;
+      num_replayed = 0;
+      lost = 0;
+      ret = pthread_create(&recv_thread, (pthread_attr_t *)NULL, &goose_pong,
+       (void *)args);
+      if (ret)
+      {
+        fprintf(stderr, "[!] could not create thread (%d:%s)\n", ret, 
+         strerror(ret));
+        return -1;
+      }
+      sem_wait(&SUB_MUTEX);
+
+      /* Ping, then wait for the pong before the next ping */
+      for (i = 0; i < MAX_TRIGGERS; i++)
+      {
+        goose_frame_ptr->goose_pdu.sqNum += 1;
+        SEND_TIMES[i] = now_ns();
+        publish(goose_frame_ptr, pcap_ptr);
+        SIGN_TIMES[i] = SEC_PTR ? SEC.sign_ns : 0;
+        num_sent++;
+
+        deadline = now_ns() + PONG_WAIT_NS;
+        while (__atomic_load_n(&num_recv, __ATOMIC_ACQUIRE) <= i 
+         && now_ns() < deadline)
+        {
+          sched_yield();
+        }
+        if (__atomic_load_n(&num_recv, __ATOMIC_ACQUIRE) <= i)
+        {
+          break; /* Pairing of send and receive times is lost from here */
+        }
+      }
+
+      /* Keep the subscriber fed until it has counted its frames */
+      while (__atomic_load_n(&num_recv, __ATOMIC_ACQUIRE) < MAX_TRIGGERS)
+      {
+        lost++;
+        goose_frame_ptr->goose_pdu.sqNum += 1;
+        publish(goose_frame_ptr, pcap_ptr);
+        usleep(1000);
+      }
+      pthread_join(recv_thread, NULL);
+
+      /* Summarise this configuration */
+      fprintf(stdout, "[=] %s, %u entries, %u byte frames", ALG_NAME[a], 
+       ENTRIES[e], (unsigned int)(frame_len + (SEC_PTR ? 2 + SEC.value_len 
+       : 0)));
+      if (lost || num_auth_fail || num_replayed)
+      {
+        fprintf(stdout, ", %u lost, %u failed authentication, %u replayed", 
+         lost, num_auth_fail, num_replayed);
+      }
+      fprintf(stdout, "\n");
+
+      for (i = 0; i < num_sent && i < MAX_TRIGGERS; i++)
+      {
+        rtt[i] = RECV_TIMES[i] - SEND_TIMES[i];
+      }
+      compute_percentiles(rtt, i, &pct);
+      print_percentiles(stdout, "    rtt", &pct, 1);
+      if (SEC_PTR)
+      {
+        compute_percentiles(SIGN_TIMES, i, &pct);
+        print_percentiles(stdout, "    sign", &pct, 1);
+        compute_percentiles(VERIFY_TIMES, i, &pct);
+        print_percentiles(stdout, "    verify", &pct, 1);
+      }
+      fflush(stdout);
+    }
+  }
+
+  goose_frame_ptr->sec = NULL;
+  goose_frame_ptr->goose_pdu.allData = NULL;
+  goose_frame_ptr->goose_pdu.allDataLen = 0;
+  goose_frame_ptr->goose_pdu.numDatSetEntries = 0;
+
+  return 0;
+}
+
+
+/**
+ * Function to sleep until the absolute deadline on the monotonic clock
+ *
+ * @param deadline	deadline in ns
+ */
+static void wait_until(uint64_t deadline)
+{
+  /* Declare local variables */
+  struct timespec ts;                           /* Time to sleep until */
+
+  ts.tv_sec = (time_t)(deadline / 1000000000ULL);
+  ts.tv_nsec = (long)(deadline % 1000000000ULL);
+  while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL))
+  {
+    /* Resume the sleep if interrupted */
+  }
+}
+
+
+/**
+ * Function to return the retransmission interval following an interval, 
+ * double the interval up to the heartbeat interval
+ *
+ * @param interval	interval in ns
+ */
+static uint64_t next_interval(uint64_t interval)
+{
+  return (2 * interval < RETRANS_MAX_MS * 1000000ULL) 
+   ? 2 * interval : RETRANS_MAX_MS * 1000000ULL;
+}
+
+
+void jitter_test(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr, 
+ unsigned int secs)
+{
+  /* Declare local variables */
+  tx_stamp_t stamp;                     /* Kernel transmit timestamp state */
+  publish_timing_t timing;                     /* Times of the last frame */
+  percentiles_t pct;                            /* Summary of a distribution */
+  uint64_t *encode_late = NULL;             /* Encoded time after deadline */
+  uint64_t *send_late = NULL;          /* Inject returned after deadline */
+  uint64_t *wire_late = NULL;           /* Kernel sent after the deadline */
+  uint64_t period = STATE_PERIOD_MS * 1000000ULL; /* State change period */
+  uint64_t offset = 0;           /* Deadline relative to the state change */
+  uint64_t interval = 0;                /* Interval to the next frame */
+  uint64_t start = 0;                    /* Monotonic time of frame zero */
+  uint64_t deadline = 0;                  /* Deadline of the current frame */
+  size_t per_period = 0;            /* Frames per state change period */
+  size_t frames = 0;                         /* Number of frames to publish */
+  size_t sent = 0;                            /* Number of frames published */
+  size_t stamped = 0;          /* Number of frames with a kernel timestamp */
+  size_t errors = 0;                      /* Number of frames not published */
+  size_t overruns = 0;          /* Frames sent after the next deadline */
+  unsigned int p = 0;                                 /* State change index */
+
+  /* Count the frames of one period to size the sample arrays */
+  for (offset = 0, interval = RETRANS_MIN_MS * 1000000ULL; offset < period; 
+   offset += interval, interval = next_interval(interval))
+  {
+    per_period++;
+  }
+  frames = per_period * (((uint64_t)secs * 1000 + STATE_PERIOD_MS - 1) 
+   / STATE_PERIOD_MS);
+  MALLOC(encode_late, uint64_t, frames * sizeof(uint64_t));
+  MALLOC(send_late, uint64_t, frames * sizeof(uint64_t));
+  MALLOC(wire_late, uint64_t, frames * sizeof(uint64_t));
+
+  if (0 != tx_stamp_enable(&stamp, pcap_ptr))
+  {
+    fprintf(stdout, "[!] kernel transmit timestamps unavailable, reporting "
+     "inject times only\n");
+  }
+  fprintf(stdout, "[-] publishing %zu frames over %u s, state change every "
+   "%llu ms, retransmission %llu to %llu ms\n", frames, secs, 
+   (unsigned long long)STATE_PERIOD_MS, (unsigned long long)RETRANS_MIN_MS, 
+   (unsigned long long)RETRANS_MAX_MS);
+
+  /* Publish on absolute deadlines computed from the state change, so that a 
+   * late frame does not delay the frames after it */
+  start = now_ns() + START_DELAY_NS;
+  for (p = 0; sent + errors < frames; p++)
+  {
+    goose_frame_ptr->goose_pdu.stNum++;
+    goose_frame_ptr->goose_pdu.sqNum = 0;
+    gettimeofday(&(goose_frame_ptr->goose_pdu.t->timeval), NULL);
+    for (offset = 0, interval = RETRANS_MIN_MS * 1000000ULL; 
+     offset < period && sent + errors < frames; offset += interval, 
+     interval = next_interval(interval))
+    {
+      /* Each frame lives until twice the interval to the next */
+      goose_frame_ptr->goose_pdu.timeAllowedtoLive = 
+       (uint32_t)(2 * interval / 1000000ULL);
+      deadline = start + p * period + offset;
+      wait_until(deadline);
+      if (0 != publish_at(goose_frame_ptr, pcap_ptr, deadline, &stamp, 
+       &timing))
+      {
+        errors++;
+        continue;
+      }
+      goose_frame_ptr->goose_pdu.sqNum++;
+      encode_late[sent] = (timing.encoded > deadline) 
+       ? timing.encoded - deadline : 0;
+      send_late[sent] = (timing.sent > deadline) 
+       ? timing.sent - deadline : 0;
+      overruns += (send_late[sent] >= ((interval < period - offset) 
+       ? interval : period - offset));
+      sent++;
+      if (timing.wire)
+      {
+        wire_late[stamped++] = (timing.wire > deadline) 
+         ? timing.wire - deadline : 0;
+      }
+    }
+  }
+
+  /* Report the timing of the frames */
+  fprintf(stdout, "[+] published %zu frames, %zu errors, %zu sent after "
+   "the next deadline\n", sent, errors, overruns);
+  fprintf(stdout, "[=] lateness after deadline in ns\n");
+  compute_percentiles(encode_late, sent, &pct);
+  print_percentiles(stdout, "    encoded", &pct, 1);
+  compute_percentiles(send_late, sent, &pct);
+  print_percentiles(stdout, "    sent", &pct, 1);
+  if (stamped)
+  {
+    compute_percentiles(wire_late, stamped, &pct);
+    print_percentiles(stdout, "    wire", &pct, 1);
+  }
+  if (stamp.fd >= 0 && stamped < sent)
+  {
+    fprintf(stdout, "[!] %zu frames without a kernel transmit timestamp\n", 
+     sent - stamped);
+  }
+
+  /* Done */
+  FREE(encode_late);
+  FREE(send_late);
+  FREE(wire_late);
+}
+
+
+/** Counters of the frames received by the pipeline benchmark
+ */
+typedef struct _pipe_stats_t_ {
+  uint64_t frames;                      /* Frames decoded */
+  uint64_t bytes;                       /* Bytes of the frames decoded */
+  uint64_t out_of_order;         /* Frames not following the last sqNum */
+  uint64_t malformed;                   /* Frames that did not decode */
+  uint32_t next_sqnum;                  /* sqNum expected next */
+} pipe_stats_t;
+
+
+/**
+ * Function to handle a GOOSE frame of the pipeline benchmark, decoding it 
+ * and checking that it follows the frame before
+ */
+static void pipeline_goose(void *user, const struct pcap_pkthdr *header, 
+ const u_char *packet, const uint8_t *payload)
+{
+  /* Declare local variables */
+  pipe_stats_t *stats = (pipe_stats_t *)user;     /* Counters of the run */
+  goose_view_t view;                             /* Decoded frame */
+
+  (void)payload;
+  if (0 != decode_goose_frame(packet, header->caplen, &view))
+  {
+    stats->malformed++;
+    return;
+  }
+  stats->out_of_order += (view.sqNum != stats->next_sqnum);
+  stats->next_sqnum = view.sqNum + 1;
+  stats->frames++;
+  stats->bytes += header->caplen;
+}
+
+
+void pipeline_bench(goose_frame_t *goose_frame_ptr, const transport_ops_t *ops, 
+ const char *iface, int frames)
+{
+  /* Declare local variables */
+  static goose_frame_t batch[PIPE_BATCH];        /* Frames of one batch */
+  goose_frame_t *ptrs[PIPE_BATCH];          /* Pointers to the batch */
+  transport_t tx;                                   /* Sending transport */
+  transport_t rx;                                 /* Receiving transport */
+  dispatch_table_t table;                      /* Handlers of the frames */
+  pipe_stats_t stats;                               /* Counters of the run */
+  struct timespec start = {0};                    /* Start time of the run */
+  struct timespec end = {0};                        /* End time of the run */
+  uint64_t ns = 0;                                /* Duration of the run */
+  uint64_t allocs = 0;                /* Heap allocations made by the run */
+  uint32_t sqnum = goose_frame_ptr->goose_pdu.sqNum;    /* Next sqNum sent */
+  int sent = 0;                                /* Number of frames sent */
+  int errors = 0;                        /* Number of batches not sent */
+  int n = 0;                                 /* Frames of this batch */
+  int i = 0;                                              /* Frame index */
+
+  /* Create the frame pool and open the receiver first, so that the run 
+   * measures the steady state and sees every frame */
+  if (NULL == pool_default())
+  {
+    fprintf(stderr, "[!] could not create frame pool\n");
+    return;
+  }
+  if (0 != transport_open(&rx, ops, iface))
+  {
+    fprintf(stderr, "[!] could not open %s transport on %s\n", ops->name, 
+     iface);
+    return;
+  }
+  if (0 != transport_open(&tx, ops, iface))
+  {
+    fprintf(stderr, "[!] could not open %s transport on %s\n", ops->name, 
+     iface);
+    transport_close(&rx);
+    return;
+  }
+
+  memset(&table, 0, sizeof(dispatch_table_t));
+  memset(&stats, 0, sizeof(pipe_stats_t));
+  dispatch_register(&table, ETHER_GOOSE, pipeline_goose, &stats);
+  stats.next_sqnum = sqnum;
+  for (i = 0; i < PIPE_BATCH; i++)
+  {
+    batch[i] = *goose_frame_ptr;
+    ptrs[i] = &batch[i];
+  }
+
+  fprintf(stdout, "[-] %d frames in batches of %d over the %s transport "
+   "(%s)\n", frames, PIPE_BATCH, ops->name, iface);
+  allocs = __atomic_load_n(&MALLOC_COUNT, __ATOMIC_RELAXED);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (sent = 0; sent < frames; sent += n)
+  {
+    n = (frames - sent < PIPE_BATCH) ? frames - sent : PIPE_BATCH;
+    for (i = 0; i < n; i++)
+    {
+      batch[i].goose_pdu.sqNum = sqnum++;
+    }
+    if (publish_transport(ptrs, n, &tx) < 0)
+    {
+      errors++;
+      continue;
+    }
+    subscribe_transport(&rx, n, PIPE_WAIT_MS, &table);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  allocs = __atomic_load_n(&MALLOC_COUNT, __ATOMIC_RELAXED) - allocs;
+  ns = elapsed_ns(&start, &end);
+
+  fprintf(stdout, "[+] %d frames sent, %llu received, %llu out of order, "
+   "%llu malformed, %d batches not sent\n", frames, 
+   (unsigned long long)stats.frames, (unsigned long long)stats.out_of_order, 
+   (unsigned long long)stats.malformed, errors);
+  fprintf(stdout, "[=] %llu ns/frame, %.2f Mframes/s, %.1f MB/s, %llu heap "
+   "allocations\n", (unsigned long long)(ns / (uint64_t)frames), 
+   (double)frames * 1000.0 / (double)ns, 
+   (double)stats.bytes * 1000.0 / (double)ns, (unsigned long long)allocs);
+
+  /* Done */
+  transport_close(&tx);
+  transport_close(&rx);
+}
+
+
+void codec_bench(goose_frame_t *goose_frame_ptr, int frames)
+{
+  /* Declare local variables */
+  static gcb_example_data_t data;                 /* Dataset published */
+  static gcb_example_data_t decoded;                /* Dataset received */
+  static uint8_t all_data[MAX_FRAME_SIZE];     /* allData of the generic */
+  static uint8_t generic[MAX_FRAME_SIZE];   /* Frame of the generic encoder */
+  static uint8_t generated[MAX_FRAME_SIZE];         /* Frame of the codec */
+  static uint8_t scratch[MAX_FRAME_SIZE];         /* Arena of the entries */
+  static goose_lazy_t lazy;                /* Streams of the lazy decoder */
+  static diff_state_t diff;                /* Previous state of the diff */
+  static uint8_t next_data[MAX_FRAME_SIZE];   /* allData of the next state */
+  uint64_t changed[DIFF_MASK_WORDS];          /* Entries changed by a state */
+  size_t next_len = 0;                      /* Bytes of the next allData */
+  goose_frame_t frame = *goose_frame_ptr;      /* Frame for the generic */
+  goose_frame_t coded = *goose_frame_ptr;        /* Frame for the codec */
+  goose_view_t view;                            /* View of a frame */
+  arena_t arena;                                 /* Arena of the entries */
+  data_entry_t *entries = NULL;                  /* Decoded entries */
+  size_t count = 0;                        /* Number of decoded entries */
+  uint16_t generic_len = 0;                 /* Length of the generic frame */
+  uint16_t generated_len = 0;                  /* Length of the codec frame */
+  struct timespec start = {0};                   /* Start time of a run */
+  struct timespec end = {0};                       /* End time of a run */
+  uint64_t ns[7] = {0};          /* Time of each run, encode then decode */
+  volatile uint64_t sink = 0;  /* Sum of results, so none is optimised away */
+  int i = 0;                                              /* Frame index */
+
+  /* A bay with the breaker closed and load flowing */
+  data.XCBR1_Pos_stVal = 2;
+  data.XCBR1_Pos_t = 1700000000500000000ULL;
+  data.XCBR1_Pos_t_quality = 0x0a;
+  data.XSWI1_Pos_stVal = 2;
+  data.XSWI2_Pos_stVal = 2;
+  data.XSWI3_Pos_stVal = 1;
+  data.CILO1_EnaOpn_stVal = 1;
+  data.MMXU1_A_phsA_mag = 412.5f;
+  data.MMXU1_A_phsB_mag = 409.75f;
+  data.MMXU1_A_phsC_mag = 415.0f;
+  data.MMXU1_TotW_mag = 4.8e6f;
+  data.MMXU1_TotW_q = 0x1000;
+  data.XCBR1_BlkOpn_ctlNum = -3;
+  data.XCBR1_OpCnt_stVal = 1234;
+  data.MMTR1_SupWh_actVal = 0x90000000;
+
+  /* The generic encoder takes the control block from the frame and the 
+   * entries, as the application would encode them, from allData */
+  frame.goose_pdu.numDatSetEntries = GCB_EXAMPLE_ENTRIES;
+  frame.goose_pdu.allData = all_data;
+  frame.goose_pdu.allDataLen = (uint16_t)gcb_example_encode_data(&data, 
+   all_data);
+  coded.codec = &gcb_example_codec;
+  coded.dataset = &data;
+
+  encode_goose_frame(&frame, generic, &generic_len);
+  encode_goose_frame(&coded, generated, &generated_len);
+  if (0 == generated_len || generic_len != generated_len 
+   || 0 != memcmp(generic, generated, generic_len))
+  {
+    fprintf(stderr, "[!] generated encoder differs from the generic encoder, "
+     "is schema/gcb_example.gcb the control block of goose_ping?\n");
+    return;
+  }
+  if (0 != decode_goose_frame(generated, generated_len, &view) 
+   || 0 != gcb_example_decode(&view, &decoded) 
+   || 0 != memcmp(&data, &decoded, sizeof(data)))
+  {
+    fprintf(stderr, "[!] generated decoder does not return the dataset\n");
+    return;
+  }
+  fprintf(stdout, "[-] %d frames of %u bytes with %u dataset entries\n", 
+   frames, generated_len, GCB_EXAMPLE_ENTRIES);
+
+  /* Encode, the generic encoder also encoding the entries as it would have 
+   * to for each new value */
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < frames; i++)
+  {
+    data.XCBR1_OpCnt_stVal = i;
+    frame.goose_pdu.sqNum = (uint32_t)i;
+    frame.goose_pdu.allDataLen = (uint16_t)gcb_example_encode_data(&data, 
+     all_data);
+    encode_goose_frame(&frame, generic, &generic_len);
+    sink += generic_len;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns[0] = elapsed_ns(&start, &end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < frames; i++)
+  {
+    data.XCBR1_OpCnt_stVal = i;
+    coded.goose_pdu.sqNum = (uint32_t)i;
+    encode_goose_frame(&coded, generated, &generated_len);
+    sink += generated_len;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns[1] = elapsed_ns(&start, &end);
+
+  /* Decode the entries of the last frame, the generic decoder into entries 
+   * that the application would then have to convert */
+  decode_goose_frame(generated, generated_len, &view);
+  arena_init(&arena, scratch, sizeof(scratch));
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < frames; i++)
+  {
+    arena_reset(&arena);
+    if (0 == decode_goose_dataset(&view, &arena, &entries, &count))
+    {
+      sink += count + entries[count - 1].len;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns[2] = elapsed_ns(&start, &end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < frames; i++)
+  {
+    if (0 == gcb_example_decode(&view, &decoded))
+    {
+      sink += (uint64_t)decoded.XCBR1_OpCnt_stVal;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns[3] = elapsed_ns(&start, &end);
+
+  /* Receive retransmissions of the last frame, decoding each in full with 
+   * its entries, then lazily, which only decodes the first */
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < frames; i++)
+  {
+    arena_reset(&arena);
+    if (0 == decode_goose_frame(generated, generated_len, &view) 
+     && 0 == decode_goose_dataset(&view, &arena, &entries, &count))
+    {
+      sink += view.sqNum + count;
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns[4] = elapsed_ns(&start, &end);
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < frames; i++)
+  {
+    arena_reset(&arena);
+    if (1 == goose_decode_lazy(&lazy, generated, generated_len, &view) 
+     && 0 == decode_goose_dataset(&view, &arena, &entries, &count))
+    {
+      sink += count;
+    }
+    sink += view.sqNum;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns[5] = elapsed_ns(&start, &end);
+
+  /* Alternate two states that differ in one measurement, as a gateway 
+   * receiving them would find the entries to process */
+  frame.goose_pdu.allDataLen = (uint16_t)gcb_example_encode_data(&data, 
+   all_data);
+  data.MMXU1_A_phsB_mag += 1.0f;
+  next_len = gcb_example_encode_data(&data, next_data);
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < frames; i++)
+  {
+    if (0 == diff_update(&diff, (i & 1) ? next_data : all_data, 
+     (i & 1) ? next_len : frame.goose_pdu.allDataLen, changed, &count))
+    {
+      sink += changed[0];
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns[6] = elapsed_ns(&start, &end);
+
+  fprintf(stdout, "[=] encode: generic %.1f ns/frame, generated %.1f "
+   "ns/frame\n", (double)ns[0] / frames, (double)ns[1] / frames);
+  fprintf(stdout, "[=] decode allData: generic %.1f ns/frame, generated %.1f "
+   "ns/frame\n", (double)ns[2] / frames, (double)ns[3] / frames);
+  fprintf(stdout, "[=] receive retransmissions: full %.1f ns/frame, lazy "
+   "%.1f ns/frame, %llu of %llu decoded in full\n", (double)ns[4] / frames, 
+   (double)ns[5] / frames, (unsigned long long)lazy.changes, 
+   (unsigned long long)lazy.frames);
+  fprintf(stdout, "[=] dataset diff (%s): %.1f ns/state, %d of %zu entries "
+   "changed\n", diff_impl_name(), (double)ns[6] / frames, 
+   __builtin_popcountll(changed[0]), count);
+}
+
+
 void print_times(void)
 {
   int i = 0;                 /* Temporary variable as loop index */
-  struct timeval s_tv = {0}; /* Temporary variable to hold send time */
-  struct timeval r_tv = {0}; /* Temporary variable to hold receive time */
 
   for(i = 0; i < NUM_TRIGGERS; i++ )
   {
-    memcpy(&r_tv, &RECV_TIMES[i], sizeof(struct timeval));
-    memcpy(&s_tv, &SEND_TIMES[i], sizeof(struct timeval));
-    printf("%u - rtt: %ld us\n", i+1, ((r_tv.tv_sec - s_tv.tv_sec)*1000000L + r_tv.tv_usec) - s_tv.tv_usec); 
+    printf("%u - rtt: %llu us\n", i+1, 
+     (unsigned long long)((RECV_TIMES[i] - SEND_TIMES[i]) / 1000)); 
   }
 }
 
@@ -610,7 +1844,42 @@ void print_times(void)
 void print_usage(void) 
 {
   fprintf(stdout, "goose_ping, version %s\n\n", VER);
-  fprintf(stdout, "usage: goose_ping iface\n\n");
+  fprintf(stdout, "usage: goose_ping [-a alg] [-b burst] [-c image] [-k key] "
+   "[-m] [-P] [-S] [-T secs]\n                  [-u] [-v] [-V vid] iface\n");
+  fprintf(stdout, "       goose_ping -L frames [-t transport] [iface]\n");
+  fprintf(stdout, "       goose_ping -G frames\n\n");
+  fprintf(stdout, "  -a alg : authentication algorithm for -k, hmac "
+   "(default) or gmac\n");
+  fprintf(stdout, "  -b burst : benchmark pcap_inject against io_uring "
+   "transmit with bursts of frames\n");
+  fprintf(stdout, "  -c image : publish the first control block of a "
+   "configuration image compiled\n       by goose_scl\n");
+  fprintf(stdout, "  -G frames : benchmark the encoder and decoder generated "
+   "from\n       schema/gcb_example.gcb against the generic ones, and the "
+   "lazy decode of\n       retransmissions\n");
+  fprintf(stdout, "  -k key : authenticate frames using the hexadecimal "
+   "key, 16 or 32 bytes for gmac\n");
+  fprintf(stdout, "  -L frames : benchmark encode, transport, decode and "
+   "dispatch of frames, with no\n       privileges or interface over the "
+   "in-process loopback transport\n");
+  fprintf(stdout, "  -m : count frames in shared memory %s for goose_stat\n", 
+   METRICS_SHM_NAME);
+  fprintf(stdout, "  -P : use the portable aes-gmac implementation, rather "
+   "than aes-ni\n");
+  fprintf(stdout, "  -S : check sha256, hmac and gmac against known answers, "
+   "then benchmark sign,\n       verify and round trip time for no "
+   "authentication, hmac and gmac over a\n       range of dataset sizes\n");
+  fprintf(stdout, "  -T secs : publish on the retransmission curve for secs "
+   "seconds and print the\n       lateness of each frame after its "
+   "scheduled time\n");
+  fprintf(stdout, "  -t transport : transport of -L, loopback (default), "
+   "or packet or pcap on iface\n");
+  fprintf(stdout, "  -u : with -k also accept frames without a protected "
+   "checksum, from publishers\n       that do not authenticate\n");
+  fprintf(stdout, "  -v : print more per-frame records, once for each frame "
+   "sent and received,\n       twice for the bytes of each frame injected\n");
+  fprintf(stdout, "  -V vid : publish 802.1Q tagged frames on VLAN vid with "
+   "priority %u\n", GOOSE_DEFAULT_PCP);
   fprintf(stdout, "  iface : network interface to use\n");
   fflush(stdout);
   return;
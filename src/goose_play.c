@@ -0,0 +1,408 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "capindex.h"
+#include "playback.h"
+#include "stats.h"
+#include "transport.h"
+#include "types.h"
+#include "utils.h"
+
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+
+
+/*
+ * Constants
+ */
+
+/** 
+ * Version of goose_play utility
+ */
+static const char VER[]="0.1a";
+
+/**
+ * Maximum number of frames whose timing is kept for the error report
+ */
+#define MAX_TIMED_FRAMES (1 << 20)
+
+
+
+/*
+ * Global variables
+ */
+
+/**
+ * Playback, so that the signal handler can stop it
+ */
+static playback_t PLAYBACK;
+
+
+
+/*
+ * Function prototypes
+ */
+
+/**
+ * Function to display the command usage to stdout
+ */
+void print_usage(void);
+
+/**
+ * Function to stop the playback when interrupted
+ *
+ * @param sig int for the signal number
+ */
+void signal_handler(int sig);
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to parse an address such as 01-0C-CD-01-00-03
+ *
+ * @return int	0 on success, else -1
+ */
+static int parse_mac(const char *str, uint8_t *mac)
+{
+  /* Declare local variables */
+  unsigned int octet[6];                               /* Parsed octets */
+  int i = 0;                                                /* Octet index */
+
+  if (6 != sscanf(str, "%2x%*[-:]%2x%*[-:]%2x%*[-:]%2x%*[-:]%2x%*[-:]%2x", 
+   &octet[0], &octet[1], &octet[2], &octet[3], &octet[4], &octet[5]))
+  {
+    return -1;
+  }
+  for (i = 0; i < 6; i++)
+  {
+    mac[i] = (uint8_t)octet[i];
+  }
+
+  return 0;
+}
+
+
+/**
+ * Function to find the record to start playing from, a time after the first 
+ * frame, through the index of the capture if it is current, else by reading 
+ * the capture up to it
+ *
+ * @param cap	pointer to the capture
+ * @param path	path of the capture
+ * @param from_ns	time after the first frame
+ * @param first_ns	pointer to hold the receive time of the first frame
+ * @return uint64_t	offset of the record, 0 if there is none
+ */
+static uint64_t seek_from(const capture_t *cap, const char *path, 
+  uint64_t from_ns, uint64_t *first_ns)
+{
+  /* Declare local variables */
+  char idx_path[4096];                                /* Path of the index */
+  const capindex_t *idx = NULL;                         /* Mapped index */
+  capture_frame_t frame;                                    /* Frame read */
+  uint64_t offset = cap->start;                     /* Offset of a record */
+  uint64_t next = 0;                            /* Offset after the frame */
+
+  if (1 != capture_next(cap, &offset, &frame))
+  {
+    return 0;
+  }
+  *first_ns = frame.ns;
+  if (0 == from_ns)
+  {
+    return frame.offset;
+  }
+  from_ns += frame.ns;
+
+  if (sizeof(idx_path) > (size_t)snprintf(idx_path, sizeof(idx_path), 
+    "%s%s", path, CAPINDEX_SUFFIX))
+  {
+    idx = capindex_map(idx_path);
+  }
+  if (capindex_current(idx, cap) && 0 != capindex_seek(idx, from_ns))
+  {
+    offset = capindex_seek(idx, from_ns);
+  }
+  capindex_unmap(idx);
+
+  next = offset;
+  while (1 == capture_next(cap, &next, &frame))
+  {
+    if (frame.ns >= from_ns)
+    {
+      return frame.offset;
+    }
+  }
+
+  /* Done */
+  return 0;
+}
+
+
+int main(int argc, char *argv[]) 
+{
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  const transport_ops_t *ops = &TRANSPORT_PCAP;         /* Transport used */
+  transport_t tp;                                      /* Open transport */
+  capture_t cap;                                      /* Capture played */
+  struct sigaction signal_action;                     /* Sigaction structure */
+  struct sched_param param;                         /* Scheduling priority */
+  percentiles_t pct;                            /* Summary of a distribution */
+  char *end = NULL;                              /* End of a parsed number */
+  double speed = 1.0;                      /* Speed factor, 0 for fastest */
+  double from_sec = 0;                 /* Seconds into the capture to start */
+  double for_sec = 0;                      /* Seconds of capture, 0 for all */
+  uint64_t first_ns = 0;                /* Receive time of the first frame */
+  long batch_us = -1;                   /* Batch window, or -1 for default */
+  unsigned int spin_us = 0;               /* Time to spin before deadlines */
+  int prio = 0;                     /* SCHED_FIFO priority, 0 to not change */
+  int ret = 0;                                   /* Result of the playback */
+  const char *path = NULL;                             /* Path of capture */
+  const char *iface = NULL;                    /* Name of network interface */
+
+  playback_init(&PLAYBACK, NULL);
+
+  /* Check paramaters */
+  while (-1 != (opt = getopt(argc, argv, "a:b:d:f:l:m:P:s:t:w:")))
+  {
+    switch (opt)
+    {
+      case 'a':
+        PLAYBACK.appid = (int32_t)strtol(optarg, &end, 0);
+        if ('\0' != *end || PLAYBACK.appid < 0 || PLAYBACK.appid > 0xffff)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'b':
+        batch_us = atol(optarg);
+        break;
+      case 'd':
+        if (0 != parse_mac(optarg, PLAYBACK.dmac))
+        {
+          print_usage();
+          return -1;
+        }
+        PLAYBACK.set_dmac = 1;
+        break;
+      case 'f':
+        from_sec = atof(optarg);
+        break;
+      case 'l':
+        for_sec = atof(optarg);
+        break;
+      case 'm':
+        if (0 != parse_mac(optarg, PLAYBACK.smac))
+        {
+          print_usage();
+          return -1;
+        }
+        PLAYBACK.set_smac = 1;
+        break;
+      case 'P':
+        prio = atoi(optarg);
+        if (prio < 1 || prio > 99)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 's':
+        speed = atof(optarg);
+        break;
+      case 't':
+        ops = transport_find(optarg);
+        if (NULL == ops)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'w':
+        spin_us = (unsigned int)atoi(optarg);
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  if (argc - optind != 2 || speed < 0 || from_sec < 0 || for_sec < 0) 
+  {
+    print_usage();
+    return -1;
+  }
+  path = argv[optind];
+  iface = argv[optind + 1];
+
+  memset(&signal_action, 0, sizeof(struct sigaction));
+  signal_action.sa_handler = &signal_handler;
+  if (-1 == sigaction(SIGINT, &signal_action, (struct sigaction *)NULL))
+  {
+    fprintf(stderr, "[!] unable to register signal handler\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Run ahead of other tasks, and keep the pages resident */
+  if (prio > 0)
+  {
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = prio;
+    if (-1 == sched_setscheduler(0, SCHED_FIFO, &param))
+    {
+      perror("[!] sched_setscheduler");
+    }
+    if (-1 == mlockall(MCL_CURRENT | MCL_FUTURE))
+    {
+      perror("[!] mlockall");
+    }
+  }
+
+  if (0 != capture_open(&cap, path))
+  {
+    exit(EXIT_FAILURE);
+  }
+  PLAYBACK.cap = &cap;
+  PLAYBACK.offset = seek_from(&cap, path, (uint64_t)(from_sec * 1e9), 
+   &first_ns);
+  if (0 == PLAYBACK.offset)
+  {
+    fprintf(stderr, "[!] no frames to play in %s\n", path);
+    capture_close(&cap);
+    exit(EXIT_FAILURE);
+  }
+  if (for_sec > 0)
+  {
+    PLAYBACK.until_ns = first_ns + (uint64_t)((from_sec + for_sec) * 1e9);
+  }
+  PLAYBACK.speed = speed;
+  PLAYBACK.batch_ns = (batch_us < 0) ? PLAYBACK_BATCH_NS 
+   : (uint64_t)batch_us * 1000;
+  PLAYBACK.spin_ns = (uint64_t)spin_us * 1000;
+
+  /* Allocate the timings up front, nothing is allocated while playing */
+  MALLOC(PLAYBACK.error, uint64_t, MAX_TIMED_FRAMES * sizeof(uint64_t));
+  PLAYBACK.max_error = MAX_TIMED_FRAMES;
+  if (NULL == PLAYBACK.error || 0 != transport_open(&tp, ops, iface))
+  {
+    FREE(PLAYBACK.error);
+    capture_close(&cap);
+    exit(EXIT_FAILURE);
+  }
+
+  if (speed > 0)
+  {
+    fprintf(stdout, "[-] playing %s on %s over %s at %.2fx, frames due "
+     "within %llu us sent together\n", path, iface, ops->name, speed, 
+     (unsigned long long)PLAYBACK.batch_ns / 1000);
+  }
+  else
+  {
+    fprintf(stdout, "[-] playing %s on %s over %s as fast as possible\n", 
+     path, iface, ops->name);
+  }
+  fflush(stdout);
+  ret = playback_run(&PLAYBACK, &tp);
+  if (0 != ret)
+  {
+    fprintf(stderr, "[!] %s is corrupt, played up to the corrupt record\n", 
+     path);
+  }
+
+  /* Report the timing of the frames */
+  fprintf(stdout, "[+] played %llu frames, %llu bytes, in %llu batches in "
+   "%.3f s, %llu errors, %llu too long to send\n", 
+   (unsigned long long)PLAYBACK.frames, (unsigned long long)PLAYBACK.bytes, 
+   (unsigned long long)PLAYBACK.batches, (double)PLAYBACK.duration / 1e9, 
+   (unsigned long long)PLAYBACK.errors, (unsigned long long)PLAYBACK.skipped);
+  if (PLAYBACK.timed)
+  {
+    fprintf(stdout, "[=] timing error from the original times in ns, %llu "
+     "frames sent early in a batch\n", (unsigned long long)PLAYBACK.early);
+    compute_percentiles(PLAYBACK.error, PLAYBACK.timed, &pct);
+    print_percentiles(stdout, "    error", &pct, 1);
+  }
+
+  /* Done */
+  transport_close(&tp);
+  FREE(PLAYBACK.error);
+  capture_close(&cap);
+  fflush(stdout);
+  return ret;
+}
+
+
+void print_usage(void) 
+{
+  fprintf(stdout, "goose_play, version %s\n\n", VER);
+  fprintf(stdout, "usage: goose_play [-a appid] [-b us] [-d dmac] [-f secs] "
+   "[-l secs] [-m smac]\n");
+  fprintf(stdout, "                  [-P prio] [-s speed] [-t transport] "
+   "[-w us] capture iface\n\n");
+  fprintf(stdout, "  -a appid : rewrite the APPID of GOOSE and SV frames\n");
+  fprintf(stdout, "  -b us : send frames due within us of each other "
+   "together, default %llu\n", PLAYBACK_BATCH_NS / 1000);
+  fprintf(stdout, "  -d dmac : rewrite the destination address, e.g. "
+   "01-0C-CD-01-00-01\n");
+  fprintf(stdout, "  -f secs : start secs into the capture\n");
+  fprintf(stdout, "  -l secs : play secs of the capture, default to the "
+   "end\n");
+  fprintf(stdout, "  -m smac : rewrite the source address\n");
+  fprintf(stdout, "  -P prio : run with SCHED_FIFO priority prio\n");
+  fprintf(stdout, "  -s speed : speed factor, default 1, 0 for as fast as "
+   "possible\n");
+  fprintf(stdout, "  -t transport : pcap (default), packet or loopback\n");
+  fprintf(stdout, "  -w us : spin for the last us before each deadline\n");
+  fprintf(stdout, "  capture : pcap or pcapng file\n");
+  fprintf(stdout, "  iface : network interface to play on\n");
+  fflush(stdout);
+  return;
+}
+
+
+void signal_handler(int sig)
+{
+  (void)sig;
+  PLAYBACK.stop = 1;
+}
@@ -0,0 +1,360 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "goose.h"
+#include "prp.h"
+#include "publisher.h"
+#include "subscriber.h"
+#include "types.h"
+#include "utils.h"
+
+#include <pcap.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+
+
+/*
+ * Constants
+ */
+
+/** 
+ * Version of goose_prp utility
+ */
+static const char VER[]="0.1a";
+
+
+
+/*
+ * Global variables
+ */
+
+/**
+ * Packet capture handle of each LAN, and the transport it is received 
+ * through, so that the signal handler can break the loop
+ */
+static pcap_t *LAN[2] = { NULL, NULL };
+static transport_t TP[2];
+
+/**
+ * Flag set by the signal handler to stop publishing
+ */
+static volatile sig_atomic_t STOP = 0;
+
+
+/** Sequence of the GOOSE frames passed on by the duplicate discard, which 
+ * assumes a single publisher
+ */
+typedef struct _prp_count_t_ {
+  uint64_t frames;       /* GOOSE frames passed on */
+  uint64_t gaps;         /* Frames whose sqNum skips ahead */
+  uint64_t repeats;      /* Frames whose sqNum is not new, i.e. duplicates */
+  uint64_t other;        /* Frames that are not GOOSE */
+  uint32_t sqNum;        /* sqNum of the last frame */
+} prp_count_t;
+
+
+
+/*
+ * Function prototypes
+ */
+
+/**
+ * Function to display the command usage to stdout
+ */
+void print_usage(void);
+
+/**
+ * Function to stop publishing or subscribing when interrupted or the 
+ * duration elapses
+ *
+ * @param sig int for the signal number
+ */
+void signal_handler(int sig);
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Packet handler callback function to count the GOOSE frames passed on by 
+ * the duplicate discard, checking that each sqNum is seen once
+ *
+ * @param args	pointer to the counters
+ * @param header	pointer to the packet capture header
+ * @param packet	pointer to bytes containing the actual frame
+ */
+static void prp_count_handler(u_char *args, const struct pcap_pkthdr *header, 
+ const u_char *packet)
+{
+  /* Declare local variables */
+  prp_count_t *count = (prp_count_t *)args;                    /* Counters */
+  goose_view_t view;                          /* View of the decoded frame */
+
+  if (0 != decode_goose_header(packet, header->caplen, &view))
+  {
+    count->other++;
+    return;
+  }
+
+  if (count->frames > 0)
+  {
+    count->gaps += (view.sqNum > count->sqNum + 1);
+    count->repeats += (view.sqNum <= count->sqNum);
+  }
+  count->sqNum = view.sqNum;
+  count->frames++;
+}
+
+
+/**
+ * Function to publish GOOSE frames on both LANs at a fixed interval
+ *
+ * @param frames	number of frames to publish
+ * @param interval_us	interval between frames in us
+ * @return int	0 on success, else -1
+ */
+static int prp_publish(unsigned int frames, unsigned int interval_us)
+{
+  /* Declare local variables */
+  goose_frame_t goose_frame;      /* The GOOSE frame to write to the network */
+  uint8_t dmac[6] = { 0x01, 0x0c, 0xcd, 0x01, 0x00, 0x01 };    /* Dest MAC */
+  uint8_t smac[6] = { 0x8, 0x93, 0x01, 0x3e, 0x10, 0x73 };        /* Src MAC */
+  uint8_t gocbref[] = "GE_N60CTRL/LLN0$GO$gcb03"; /* Control block reference */
+  uint8_t datSet[] = "GE_N60CTRL/LLN0$GOOSE3";                   /* Data set */
+  uint8_t goid[] = "GE_N60_GOOSE1";                              /* GOOSE Id */
+  timevalq_t t;                                       /* Timestamp structure */
+  struct timespec deadline;                     /* Deadline of next frame */
+  uint16_t seq = 0;                              /* PRP sequence number */
+  unsigned int sent = 0;                          /* Frames published */
+  unsigned int failed = 0;           /* Frames not sent on either LAN */
+
+  /* Prepare the GOOSE message */
+  memset(&t, 0, sizeof(timevalq_t));
+  gettimeofday(&t.timeval, NULL);                /* The one state change */
+  t.time_quality = TIME_CLOCK_NOT_SYNCED | TIME_ACCURACY_UNSPECIFIED;
+  memset(&goose_frame, 0, sizeof(goose_frame_t));
+  set_dest_mac(&goose_frame, (const uint8_t *)&dmac);
+  set_src_mac(&goose_frame, (const uint8_t *)&smac);
+  goose_frame.eth_hdr.ether_type = htons(ETHER_GOOSE);
+  goose_frame.goose_header.appid = htons(0x1);
+  goose_frame.goose_pdu.gocbref = (uint8_t *)&gocbref; /* gocbref */
+  goose_frame.goose_pdu.timeAllowedtoLive = 2000;      /* timeAllowedtoLive */
+  goose_frame.goose_pdu.datSet = (uint8_t *)&datSet;   /* datSet */
+  goose_frame.goose_pdu.goID = (uint8_t *)&goid;       /* goID (optional) */
+  goose_frame.goose_pdu.t = &t;                        /* t */
+  goose_frame.goose_pdu.confRev = 1;                   /* confRev */
+
+  fprintf(stdout, "[-] publishing %u frames every %u us on both LANs\n", 
+   frames, interval_us);
+  fflush(stdout);
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  for (sent = 0; sent < frames && !STOP; sent++)
+  {
+    failed += (0 != publish_prp(&goose_frame, LAN[0], LAN[1], &seq));
+    goose_frame.goose_pdu.sqNum += 1;
+
+    deadline.tv_nsec += (long)interval_us * 1000;
+    while (deadline.tv_nsec >= 1000000000L)
+    {
+      deadline.tv_nsec -= 1000000000L;
+      deadline.tv_sec++;
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+  }
+
+  fprintf(stdout, "[=] %u frames published, %u not sent on either LAN\n", 
+   sent, failed);
+  return failed ? -1 : 0;
+}
+
+
+int main(int argc, char *argv[]) 
+{
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  int publisher = 0;                       /* Non-zero to publish frames */
+  unsigned int frames = 1000;                 /* Number of frames to publish */
+  unsigned int interval_us = 1000;               /* Interval between frames */
+  unsigned int nodes = 64;               /* Maximum number of source nodes */
+  unsigned int duration = 0;             /* Seconds to subscribe, 0 forever */
+  struct sigaction signal_action;                     /* Sigaction structure */
+  char errbuf[PCAP_ERRBUF_SIZE] = {0};                  /* PCAP error buffer */
+  prp_table_t table;                                  /* Duplicate table */
+  prp_count_t count;                       /* Counters of passed frames */
+  int ret = 0;                                  /* Return value of the run */
+  int i = 0;                                                /* LAN index */
+
+  /* Check paramaters */
+  while (-1 != (opt = getopt(argc, argv, "c:d:i:n:p")))
+  {
+    switch (opt)
+    {
+      case 'c':
+        frames = (unsigned int)atoi(optarg);
+        break;
+      case 'd':
+        duration = (unsigned int)atoi(optarg);
+        break;
+      case 'i':
+        interval_us = (unsigned int)atoi(optarg);
+        break;
+      case 'n':
+        nodes = (unsigned int)atoi(optarg);
+        if (0 == nodes)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'p':
+        publisher = 1;
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  if (argc - optind != 2) 
+  {
+    print_usage();
+    return -1;
+  }
+
+  /* Stop on interrupt, or when the duration elapses */
+  memset(&signal_action, 0, sizeof(struct sigaction));
+  signal_action.sa_handler = &signal_handler;
+  if (-1 == sigaction(SIGINT, &signal_action, (struct sigaction *)NULL) 
+   || -1 == sigaction(SIGALRM, &signal_action, (struct sigaction *)NULL))
+  {
+    fprintf(stderr, "[!] unable to register signal handler\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Open the network interface of each LAN */
+  for (i = 0; i < 2; i++)
+  {
+    LAN[i] = pcap_open_live(argv[optind + i], BUFSIZ, 1, 100, 
+     (char *)&errbuf);
+    if (NULL == LAN[i])
+    {
+      fprintf(stderr, "[!] could not open pcap (%s - %s)\n", 
+       argv[optind + i], errbuf);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if (publisher)
+  {
+    ret = prp_publish(frames, interval_us);
+  }
+  else
+  {
+    for (i = 0; i < 2; i++)
+    {
+      if (-1 == pcap_setnonblock(LAN[i], 1, errbuf))
+      {
+        fprintf(stderr, "[!] could not set non-blocking (%s)\n", errbuf);
+        exit(EXIT_FAILURE);
+      }
+      transport_pcap_attach(&TP[i], LAN[i]);
+    }
+    prp_init(&table, nodes);
+    memset(&count, 0, sizeof(prp_count_t));
+    fprintf(stdout, "[-] subscribing on LAN A %s and LAN B %s\n", 
+     argv[optind], argv[optind + 1]);
+    fflush(stdout);
+    if (duration)
+    {
+      alarm(duration);
+    }
+    subscribe_prp(&TP[0], &TP[1], 0, &table, prp_count_handler, 
+     (u_char *)&count);
+
+    fprintf(stdout, "[=] %llu frames on LAN A, %llu on LAN B, %llu passed on, "
+     "%llu duplicates discarded\n", (unsigned long long)table.lan[0], 
+     (unsigned long long)table.lan[1], (unsigned long long)table.accepted, 
+     (unsigned long long)table.duplicates);
+    fprintf(stdout, "    %llu on the wrong LAN, %llu without trailer, "
+     "%llu from untracked nodes\n", (unsigned long long)table.wrong_lan, 
+     (unsigned long long)table.no_rct, (unsigned long long)table.untracked);
+    fprintf(stdout, "    %llu GOOSE frames, %llu sqNum gaps, %llu sqNum "
+     "repeats, %llu other frames\n", (unsigned long long)count.frames, 
+     (unsigned long long)count.gaps, (unsigned long long)count.repeats, 
+     (unsigned long long)count.other);
+    prp_free(&table);
+  }
+
+  /* Done */
+  pcap_close(LAN[0]);
+  pcap_close(LAN[1]);
+  fflush(stdout);
+  return ret;
+}
+
+
+void print_usage(void) 
+{
+  fprintf(stdout, "goose_prp, version %s\n\n", VER);
+  fprintf(stdout, "usage: goose_prp -p [-c count] [-i interval] lan_a "
+   "lan_b\n");
+  fprintf(stdout, "       goose_prp [-d secs] [-n nodes] lan_a lan_b\n\n");
+  fprintf(stdout, "  -c count : number of frames to publish, default 1000\n");
+  fprintf(stdout, "  -d secs : seconds to subscribe for, default until "
+   "interrupted\n");
+  fprintf(stdout, "  -i interval : us between published frames, default "
+   "1000\n");
+  fprintf(stdout, "  -n nodes : maximum number of source nodes, default 64\n");
+  fprintf(stdout, "  -p : publish on both LANs, else subscribe to both and "
+   "discard duplicates\n");
+  fprintf(stdout, "  lan_a lan_b : network interfaces of the two LANs\n");
+  fflush(stdout);
+  return;
+}
+
+
+void signal_handler(int sig)
+{
+  (void)sig;
+  STOP = 1;
+  transport_break(&TP[0]);
+  transport_break(&TP[1]);
+}
@@ -0,0 +1,450 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "capindex.h"
+#include "goose.h"
+#include "log.h"
+#include "recorder.h"
+#include "subscriber.h"
+#include "types.h"
+#include "utils.h"
+
+#include <pcap.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+
+
+/*
+ * Constants
+ */
+
+/** 
+ * Version of goose_rec utility
+ */
+static const char VER[]="0.1a";
+
+/**
+ * Kernel capture buffer, deep enough to ride out a segment rotation at line 
+ * rate
+ */
+#define REC_PCAP_BUFFER (64 << 20)
+
+/**
+ * Number of distinct frames of the benchmark, with stNum changing every 
+ * REC_BENCH_STATE frames as a bay would
+ */
+#define REC_BENCH_FRAMES 256
+#define REC_BENCH_STATE 32
+
+/**
+ * Number of dataset entries of the benchmark frames
+ */
+#define REC_BENCH_ENTRIES 32
+
+
+
+/*
+ * Global variables
+ */
+
+/**
+ * Packet capture handle, so that the signal handler can break the loop
+ */
+static pcap_t *PCAP = NULL;
+
+/**
+ * Flag set by the signal handler to stop the benchmark
+ */
+static volatile sig_atomic_t STOP = 0;
+
+
+
+/*
+ * Function prototypes
+ */
+
+/**
+ * Function to display the command usage to stdout
+ */
+void print_usage(void);
+
+/**
+ * Function to stop recording when interrupted or the duration elapses
+ *
+ * @param sig int for the signal number
+ */
+void signal_handler(int sig);
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return the realtime clock in nanoseconds
+ */
+static uint64_t realtime_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to index a segment when the recorder closes it, see goose_find
+ *
+ * @param user	unused
+ * @param path	path of the segment
+ */
+static void rec_index(void *user, const char *path)
+{
+  (void)user;
+  if (0 != capindex_build(path, NULL))
+  {
+    fprintf(stderr, "[!] could not index %s\n", path);
+  }
+}
+
+
+/**
+ * Function to open an interface for recording, with nanosecond timestamps 
+ * where the capture supports them
+ *
+ * @param iface	name of the interface
+ * @param ts_scale	pointer to hold the ns per unit of ts.tv_usec
+ * @return pcap_t *	capture handle, else NULL
+ */
+static pcap_t *rec_open(const char *iface, uint32_t *ts_scale)
+{
+  /* Declare local variables */
+  char errbuf[PCAP_ERRBUF_SIZE] = {0};                  /* PCAP error buffer */
+  pcap_t *pcap = NULL;                                  /* Capture handle */
+
+  pcap = pcap_create(iface, errbuf);
+  if (NULL == pcap)
+  {
+    fprintf(stderr, "[!] could not open pcap (%s - %s)\n", iface, errbuf);
+    return NULL;
+  }
+  pcap_set_snaplen(pcap, RECORDER_SNAPLEN);
+  pcap_set_promisc(pcap, 1);
+  pcap_set_timeout(pcap, 10);
+  pcap_set_buffer_size(pcap, REC_PCAP_BUFFER);
+  *ts_scale = (0 == pcap_set_tstamp_precision(pcap, 
+   PCAP_TSTAMP_PRECISION_NANO)) ? 1 : 1000;
+  if (pcap_activate(pcap) < 0)
+  {
+    fprintf(stderr, "[!] could not open pcap (%s - %s)\n", iface, 
+     pcap_geterr(pcap));
+    pcap_close(pcap);
+    return NULL;
+  }
+
+  /* Only GOOSE frames reach the recorder */
+  if (0 != goose_filter(pcap))
+  {
+    pcap_close(pcap);
+    return NULL;
+  }
+
+  /* Done */
+  return pcap;
+}
+
+
+/**
+ * Function to record and decode frames of a synthetic stream as fast as 
+ * they can be dispatched, to compare with the line rate
+ *
+ * @param table	pointer to the dispatch table with the recorder stage
+ * @param frames	number of frames to record
+ */
+static void rec_bench(dispatch_table_t *table, int frames)
+{
+  /* Declare local variables */
+  static uint8_t encoded[REC_BENCH_FRAMES][MAX_FRAME_SIZE];     /* Frames */
+  static uint16_t lens[REC_BENCH_FRAMES];            /* Bytes of each frame */
+  static uint8_t all_data[REC_BENCH_ENTRIES * 3];   /* Dataset, booleans */
+  uint8_t dmac[6] = { 0x01, 0x0c, 0xcd, 0x01, 0x00, 0x01 };     /* Dest MAC */
+  uint8_t gocbref[] = "BAY1CTRL/LLN0$GO$gcb01";  /* Control block reference */
+  uint8_t datSet[] = "BAY1CTRL/LLN0$TRIPS";                      /* Data set */
+  uint8_t goid[] = "BAY1_TRIPS";                                 /* GOOSE Id */
+  timevalq_t t = { .timeval = { 0, 0 }, .time_quality = 0 };   /* Timestamp */
+  goose_frame_t goose_frame;                    /* Frame being encoded */
+  struct pcap_pkthdr header;                       /* Header of each frame */
+  struct timespec start = {0};                       /* Start of the run */
+  struct timespec end = {0};                           /* End of the run */
+  uint64_t ns = 0;                                 /* Duration of the run */
+  uint64_t wire = 0;                          /* Bytes on the wire, at 1G */
+  int i = 0;                                              /* Frame index */
+
+  /* A stream of trips with its heartbeats */
+  memset(&goose_frame, 0, sizeof(goose_frame_t));
+  set_dest_mac(&goose_frame, dmac);
+  goose_frame.eth_hdr.ether_type = htons(ETHER_GOOSE);
+  goose_frame.goose_header.appid = htons(0x3001);
+  goose_frame.goose_pdu.gocbref = gocbref;
+  goose_frame.goose_pdu.datSet = datSet;
+  goose_frame.goose_pdu.goID = goid;
+  goose_frame.goose_pdu.t = &t;
+  goose_frame.goose_pdu.timeAllowedtoLive = 2000;
+  goose_frame.goose_pdu.confRev = 1;
+  goose_frame.goose_pdu.numDatSetEntries = REC_BENCH_ENTRIES;
+  goose_frame.goose_pdu.allData = all_data;
+  goose_frame.goose_pdu.allDataLen = sizeof(all_data);
+  gettimeofday(&t.timeval, NULL);
+  for (i = 0; i < REC_BENCH_ENTRIES; i++)
+  {
+    all_data[3 * i] = 0x83;
+    all_data[3 * i + 1] = 1;
+  }
+  for (i = 0; i < REC_BENCH_FRAMES; i++)
+  {
+    goose_frame.goose_pdu.stNum = (uint32_t)(1 + i / REC_BENCH_STATE);
+    goose_frame.goose_pdu.sqNum = (uint32_t)(i % REC_BENCH_STATE);
+    all_data[3 * ((i / REC_BENCH_STATE) % REC_BENCH_ENTRIES) + 2] ^= 1;
+    encode_goose_frame(&goose_frame, encoded[i], &lens[i]);
+  }
+
+  /* Each frame is recorded and decoded, the time stamp taken as the 
+   * capture would have */
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < frames && !STOP; i++)
+  {
+    header.caplen = header.len = lens[i % REC_BENCH_FRAMES];
+    ns = realtime_ns();
+    header.ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    header.ts.tv_usec = (suseconds_t)(ns % 1000000000ULL);
+    dispatch_frame((u_char *)table, &header, encoded[i % REC_BENCH_FRAMES]);
+    wire += (uint64_t)header.len + 24;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  ns = (uint64_t)(end.tv_sec - start.tv_sec) * 1000000000ULL 
+   + (uint64_t)end.tv_nsec - (uint64_t)start.tv_nsec;
+
+  fprintf(stdout, "[=] %d frames of %u bytes recorded and decoded, %.1f "
+   "ns/frame, %.2f Mframes/s\n", i, lens[0], (double)ns / i, 
+   (double)i * 1000.0 / (double)ns);
+  fprintf(stdout, "[=] %.2f times the 1 Gb/s line rate of these frames\n", 
+   (double)wire * 8.0 / (double)ns);
+}
+
+
+int main(int argc, char *argv[]) 
+{
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  const char *prefix = NULL;                        /* Prefix of the segments */
+  size_t seg_mb = 0;                        /* Segment size in MiB, 0 default */
+  unsigned int seg_sec = 0;               /* Seconds a segment covers, or 0 */
+  unsigned int keep = 0;                   /* Segments kept, 0 to keep all */
+  unsigned int duration = 0;               /* Seconds to record, 0 forever */
+  int bench = 0;                     /* Frames of the benchmark, if any */
+  int index = 0;                       /* Non-zero to index each segment */
+  int verbosity = LOG_LEVEL_WARN;         /* Level of the records printed */
+  struct sigaction signal_action;                     /* Sigaction structure */
+  struct pcap_stat ps;                              /* Capture statistics */
+  recorder_t rec;                                       /* Flight recorder */
+  record_stage_t stage;                   /* Recorder stage of the dispatch */
+  dispatch_table_t table;                   /* Handlers of the frames */
+  const char *iface = NULL;                    /* Name of network interface */
+
+  /* Check paramaters */
+  while (-1 != (opt = getopt(argc, argv, "B:d:k:o:s:t:vx")))
+  {
+    switch (opt)
+    {
+      case 'B':
+        bench = atoi(optarg);
+        if (bench <= 0)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'd':
+        duration = (unsigned int)atoi(optarg);
+        break;
+      case 'k':
+        keep = (unsigned int)atoi(optarg);
+        break;
+      case 'o':
+        prefix = optarg;
+        break;
+      case 's':
+        seg_mb = (size_t)atoi(optarg);
+        break;
+      case 't':
+        seg_sec = (unsigned int)atoi(optarg);
+        break;
+      case 'v':
+        verbosity += (verbosity < LOG_LEVEL_TRACE);
+        break;
+      case 'x':
+        index = 1;
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  if (NULL == prefix || (bench && argc != optind) 
+   || (!bench && argc - optind != 1)) 
+  {
+    print_usage();
+    return -1;
+  }
+  iface = bench ? "bench" : argv[optind];
+
+  /* Stop on interrupt, or when the duration elapses */
+  memset(&signal_action, 0, sizeof(struct sigaction));
+  signal_action.sa_handler = &signal_handler;
+  if (-1 == sigaction(SIGINT, &signal_action, (struct sigaction *)NULL) 
+   || -1 == sigaction(SIGALRM, &signal_action, (struct sigaction *)NULL))
+  {
+    fprintf(stderr, "[!] unable to register signal handler\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Frames are recorded, then passed on to the live decoder */
+  if (0 != log_start(stdout, (log_level_t)verbosity))
+  {
+    exit(EXIT_FAILURE);
+  }
+  memset(&stage, 0, sizeof(record_stage_t));
+  memset(&table, 0, sizeof(dispatch_table_t));
+  stage.rec = &rec;
+  stage.ts_scale = bench ? 1 : 1000;
+  stage.next = goose_dispatch_print;
+  dispatch_register(&table, ETHER_GOOSE, record_dispatch, &stage);
+
+  if (!bench)
+  {
+    PCAP = rec_open(iface, &stage.ts_scale);
+    if (NULL == PCAP)
+    {
+      log_stop();
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (0 != recorder_open(&rec, prefix, iface, seg_mb << 20, seg_sec, keep))
+  {
+    log_stop();
+    exit(EXIT_FAILURE);
+  }
+  if (index)
+  {
+    rec.on_close = rec_index;
+  }
+
+  if (bench)
+  {
+    rec_bench(&table, bench);
+  }
+  else
+  {
+    fprintf(stdout, "[-] recording GOOSE on %s to %s-*.pcapng, %s "
+     "timestamps\n", iface, prefix, (1 == stage.ts_scale) ? "ns" : "us");
+    fflush(stdout);
+    if (duration)
+    {
+      alarm(duration);
+    }
+    subscribe_dispatch(PCAP, 0, &table);
+    if (0 == pcap_stats(PCAP, &ps))
+    {
+      fprintf(stdout, "[=] %u frames received by the capture, %u dropped "
+       "by the kernel\n", ps.ps_recv, ps.ps_drop);
+    }
+    pcap_close(PCAP);
+  }
+
+  /* Done */
+  recorder_close(&rec);
+  log_stop();
+  fprintf(stdout, "[=] %llu frames, %llu bytes in %llu segments, %llu "
+   "frames lost\n", (unsigned long long)rec.frames, 
+   (unsigned long long)rec.bytes, (unsigned long long)rec.segments, 
+   (unsigned long long)rec.errors);
+  fflush(stdout);
+  return 0;
+}
+
+
+void print_usage(void) 
+{
+  fprintf(stdout, "goose_rec, version %s\n\n", VER);
+  fprintf(stdout, "usage: goose_rec -o prefix [-d secs] [-k segments] "
+   "[-s MiB] [-t secs] [-v] [-x] iface\n");
+  fprintf(stdout, "       goose_rec -o prefix -B frames [-k segments] "
+   "[-s MiB] [-x]\n\n");
+  fprintf(stdout, "  -B frames : benchmark recording and decoding a "
+   "synthetic stream\n");
+  fprintf(stdout, "  -d secs : seconds to record for, default until "
+   "interrupted\n");
+  fprintf(stdout, "  -k segments : keep the latest segments only, default "
+   "all\n");
+  fprintf(stdout, "  -o prefix : record to prefix-NNNNNN.pcapng\n");
+  fprintf(stdout, "  -s MiB : size of each segment, default %lu\n", 
+   RECORDER_SEG_SIZE >> 20);
+  fprintf(stdout, "  -t secs : also start a new segment every secs "
+   "seconds\n");
+  fprintf(stdout, "  -v : print the frames decoded, the dataset on each "
+   "state change\n");
+  fprintf(stdout, "  -x : index each segment as it is closed, for "
+   "goose_find\n");
+  fprintf(stdout, "  iface : network interface to record\n");
+  fflush(stdout);
+  return;
+}
+
+
+void signal_handler(int sig)
+{
+  (void)sig;
+  STOP = 1;
+  if (PCAP)
+  {
+    pcap_breakloop(PCAP);
+  }
+}
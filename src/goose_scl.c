@@ -0,0 +1,1033 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "config.h"
+#include "types.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+
+/*
+ * Constants
+ */
+
+/** 
+ * Version of goose_scl utility
+ */
+static const char VER[]="0.1a";
+
+/**
+ * Maximum length of an SCL name, e.g. an IED name or ldInst, including the 
+ * '\0', and of a reference built from names
+ */
+#define SCL_MAX_NAME CONFIG_NAME_LEN
+#define SCL_MAX_REF 130
+
+/**
+ * Maximum number of each item read from an SCL file
+ */
+#define SCL_MAX_ITEMS 2048
+
+/**
+ * Maximum number of attributes of an element
+ */
+#define SCL_MAX_ATTRS 32
+
+/**
+ * Size of the string table of an image
+ */
+#define SCL_MAX_STRINGS (1 << 20)
+
+
+
+/*
+ * Types
+ */
+
+/** Element of an SCL file, parsed in place so that names, attributes and 
+ * text point into the file
+ */
+typedef struct _xml_tag_t_ {
+  char *name;                       /* Element name */
+  int end;                          /* Non-zero for an end tag */
+  int empty;                        /* Non-zero for an empty element */
+  size_t num_attrs;                 /* Number of attributes */
+  char *attr[SCL_MAX_ATTRS];        /* Attribute names */
+  char *value[SCL_MAX_ATTRS];       /* Attribute values */
+  char *text;                       /* Text ahead of the tag, trimmed */
+} xml_tag_t;
+
+
+/** GSE address of a control block, from the Communication section
+ */
+typedef struct _scl_addr_t_ {
+  char ied[SCL_MAX_NAME];       /* iedName of the ConnectedAP */
+  char ld[SCL_MAX_NAME];        /* ldInst */
+  char cb[SCL_MAX_NAME];        /* cbName */
+  config_cb_t cb_cfg;           /* Address, APPID, VLAN and times */
+} scl_addr_t;
+
+
+/** GSEControl of a logical device
+ */
+typedef struct _scl_ctl_t_ {
+  char ied[SCL_MAX_NAME];       /* IED name */
+  char ld[SCL_MAX_NAME];        /* ldInst */
+  char name[SCL_MAX_NAME];      /* Control block name */
+  char datset[SCL_MAX_NAME];    /* Dataset name */
+  char goid[SCL_MAX_REF];       /* appID, the goID */
+  uint32_t confrev;             /* confRev */
+} scl_ctl_t;
+
+
+/** DataSet of a logical device
+ */
+typedef struct _scl_dataset_t_ {
+  char ied[SCL_MAX_NAME];       /* IED name */
+  char ld[SCL_MAX_NAME];        /* ldInst */
+  char name[SCL_MAX_NAME];      /* Dataset name */
+  uint32_t count;               /* Number of FCDAs */
+} scl_dataset_t;
+
+
+/** Control block the configured IED subscribes to, from an ExtRef or from 
+ * an IEDName of the control block
+ */
+typedef struct _scl_ref_t_ {
+  char ied[SCL_MAX_NAME];       /* IED name */
+  char ld[SCL_MAX_NAME];        /* ldInst */
+  char cb[SCL_MAX_NAME];        /* Control block name */
+} scl_ref_t;
+
+
+/** Items of an SCL file relevant to GOOSE, and the parse state
+ */
+typedef struct _scl_t_ {
+  const char *target;                   /* IED to configure */
+  int found;                            /* Non-zero if the IED is in the file */
+  scl_addr_t addr[SCL_MAX_ITEMS];       /* GSE addresses */
+  size_t num_addrs;
+  scl_ctl_t ctl[SCL_MAX_ITEMS];         /* GSEControls */
+  size_t num_ctls;
+  scl_dataset_t ds[SCL_MAX_ITEMS];      /* DataSets */
+  size_t num_ds;
+  scl_ref_t ref[SCL_MAX_ITEMS];         /* Subscriptions of the target */
+  size_t num_refs;
+  char ap_ied[SCL_MAX_NAME];            /* iedName of the ConnectedAP */
+  char ied[SCL_MAX_NAME];               /* Name of the current IED */
+  char ld[SCL_MAX_NAME];                /* Current ldInst */
+  char p_type[SCL_MAX_NAME];            /* Type of the current P */
+  scl_addr_t *cur_addr;                 /* Current GSE, if any */
+  scl_ctl_t *cur_ctl;                   /* Current GSEControl, if any */
+  scl_dataset_t *cur_ds;                /* Current DataSet, if any */
+} scl_t;
+
+
+
+/*
+ * Global variables
+ */
+
+/**
+ * Items of the SCL file, too large for the stack
+ */
+static scl_t SCL;
+
+/**
+ * String table of the image being built
+ */
+static char STRINGS[SCL_MAX_STRINGS];
+static uint32_t STRINGS_LEN = 0;
+
+
+
+/*
+ * Function prototypes
+ */
+
+/**
+ * Function to display the command usage to stdout
+ */
+void print_usage(void);
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to replace the predefined XML entities of a string in place
+ */
+static void xml_unescape(char *str)
+{
+  /* Declare local variables */
+  static const char *ENTITY[] = { "&amp;", "&lt;", "&gt;", "&quot;", "&apos;" };
+  static const char CHAR[] = { '&', '<', '>', '"', '\'' };
+  char *out = str;                                  /* Next character out */
+  size_t i = 0;                                              /* Entity index */
+
+  while (*str)
+  {
+    if ('&' == *str)
+    {
+      for (i = 0; i < sizeof(CHAR); i++)
+      {
+        if (0 == strncmp(str, ENTITY[i], strlen(ENTITY[i])))
+        {
+          break;
+        }
+      }
+      if (i < sizeof(CHAR))
+      {
+        *out++ = CHAR[i];
+        str += strlen(ENTITY[i]);
+        continue;
+      }
+    }
+    *out++ = *str++;
+  }
+  *out = '\0';
+}
+
+
+/**
+ * Function to parse the next tag of an XML document in place, skipping 
+ * comments, declarations and CDATA
+ *
+ * @param p	pointer to the document after the previous tag
+ * @param tag	pointer to the tag to populate
+ * @return char *	pointer after the tag, else NULL at the end of the 
+ * 		document or if the tag is malformed, when tag->name is not NULL
+ */
+static char *xml_next(char *p, xml_tag_t *tag)
+{
+  /* Declare local variables */
+  char *lt = NULL;                                      /* Start of the tag */
+  char *end = NULL;                                   /* End of the text */
+  char quote = 0;                         /* Quote of an attribute value */
+  char c = 0;                        /* Character replaced by a terminator */
+
+  memset(tag, 0, sizeof(xml_tag_t));
+  tag->text = p;
+  for (;;)
+  {
+    lt = strchr(p, '<');
+    if (NULL == lt)
+    {
+      return NULL;
+    }
+    if (0 == strncmp(lt, "<!--", 4) || 0 == strncmp(lt, "<?", 2) 
+     || 0 == strncmp(lt, "<![CDATA[", 9) || 0 == strncmp(lt, "<!", 2))
+    {
+      p = strstr(lt, (0 == strncmp(lt, "<!--", 4)) ? "-->" 
+       : ('?' == lt[1] ? "?>" : ('[' == lt[2] ? "]]>" : ">")));
+      if (NULL == p)
+      {
+        return NULL;
+      }
+      p += ('-' == *p || ']' == *p) ? 3 : ('?' == *p ? 2 : 1);
+      tag->text = p;
+      continue;
+    }
+    break;
+  }
+
+  /* Text ahead of the tag, trimmed */
+  for (end = lt; end > tag->text && strchr(" \t\r\n", end[-1]); end--)
+  {
+  }
+  while (tag->text < end && strchr(" \t\r\n", *tag->text))
+  {
+    tag->text++;
+  }
+  p = lt + 1;
+  *end = '\0';
+  xml_unescape(tag->text);
+
+  /* Name */
+  if ('/' == *p)
+  {
+    tag->end = 1;
+    p++;
+  }
+  tag->name = p;
+  p += strcspn(p, " \t\r\n/>");
+  if ('\0' == *p)
+  {
+    return NULL;
+  }
+  c = *p;
+  *p = '\0';
+  if (p == tag->name)
+  {
+    return NULL;
+  }
+
+  /* Attributes */
+  for (;;)
+  {
+    if (!strchr(" \t\r\n", c))
+    {
+      p++;
+    }
+    else
+    {
+      p += 1 + strspn(p + 1, " \t\r\n");
+      c = *p;
+      if ('/' == c || '>' == c)
+      {
+        p++;
+      }
+    }
+    if ('>' == c)
+    {
+      return p;
+    }
+    if ('/' == c)
+    {
+      tag->empty = 1;
+      return ('>' == *p) ? p + 1 : NULL;
+    }
+    if ('\0' == c || tag->end || SCL_MAX_ATTRS == tag->num_attrs)
+    {
+      return NULL;
+    }
+
+    /* name="value" */
+    tag->attr[tag->num_attrs] = p;
+    p += strcspn(p, " \t\r\n=");
+    end = p;
+    p += strspn(p, " \t\r\n");
+    if ('=' != *p)
+    {
+      return NULL;
+    }
+    *end = '\0';
+    p += 1 + strspn(p + 1, " \t\r\n");
+    quote = *p;
+    if ('"' != quote && '\'' != quote)
+    {
+      return NULL;
+    }
+    tag->value[tag->num_attrs] = ++p;
+    p = strchr(p, quote);
+    if (NULL == p)
+    {
+      return NULL;
+    }
+    *p = '\0';
+    xml_unescape(tag->value[tag->num_attrs++]);
+    c = *++p;
+    if (!strchr(" \t\r\n/>", c))
+    {
+      return NULL;
+    }
+  }
+}
+
+
+/**
+ * Function to return the value of an attribute of a tag, or "" if it is 
+ * absent
+ */
+static const char *xml_attr(const xml_tag_t *tag, const char *name)
+{
+  /* Declare local variables */
+  size_t i = 0;                                           /* Attribute index */
+
+  for (i = 0; i < tag->num_attrs; i++)
+  {
+    if (0 == strcmp(tag->attr[i], name))
+    {
+      return tag->value[i];
+    }
+  }
+
+  return "";
+}
+
+
+/**
+ * Function to copy a name, truncated to SCL_MAX_NAME - 1 characters
+ */
+static void copy_name(char *dst, const char *src)
+{
+  snprintf(dst, SCL_MAX_NAME, "%s", src);
+}
+
+
+/**
+ * Function to parse an address such as 01-0C-CD-01-00-03
+ *
+ * @return int	0 on success, else -1
+ */
+static int parse_mac(const char *str, uint8_t *mac)
+{
+  /* Declare local variables */
+  unsigned int octet[6];                               /* Parsed octets */
+  int i = 0;                                                /* Octet index */
+
+  if (6 != sscanf(str, "%2x%*[-:]%2x%*[-:]%2x%*[-:]%2x%*[-:]%2x%*[-:]%2x", 
+   &octet[0], &octet[1], &octet[2], &octet[3], &octet[4], &octet[5]))
+  {
+    return -1;
+  }
+  for (i = 0; i < 6; i++)
+  {
+    mac[i] = (uint8_t)octet[i];
+  }
+
+  return 0;
+}
+
+
+/**
+ * Function to add a subscription of the configured IED
+ */
+static int add_ref(scl_t *scl, const char *ied, const char *ld, 
+ const char *cb)
+{
+  if (SCL_MAX_ITEMS == scl->num_refs)
+  {
+    fprintf(stderr, "[!] more than %d subscriptions\n", SCL_MAX_ITEMS);
+    return -1;
+  }
+  copy_name(scl->ref[scl->num_refs].ied, ied);
+  copy_name(scl->ref[scl->num_refs].ld, ld);
+  copy_name(scl->ref[scl->num_refs].cb, cb);
+  scl->num_refs++;
+  return 0;
+}
+
+
+/**
+ * Function to handle a start tag of the SCL file
+ *
+ * @return int	0 on success, else -1
+ */
+static int scl_start(scl_t *scl, const xml_tag_t *tag)
+{
+  /* Declare local variables */
+  const char *name = tag->name;                          /* Element name */
+  const char *src_ld = NULL;                /* srcLDInst of an ExtRef */
+
+  if (0 == strcmp(name, "ConnectedAP"))
+  {
+    copy_name(scl->ap_ied, xml_attr(tag, "iedName"));
+  }
+  else if (0 == strcmp(name, "GSE"))
+  {
+    if (SCL_MAX_ITEMS == scl->num_addrs)
+    {
+      fprintf(stderr, "[!] more than %d GSE addresses\n", SCL_MAX_ITEMS);
+      return -1;
+    }
+    scl->cur_addr = &(scl->addr[scl->num_addrs++]);
+    copy_name(scl->cur_addr->ied, scl->ap_ied);
+    copy_name(scl->cur_addr->ld, xml_attr(tag, "ldInst"));
+    copy_name(scl->cur_addr->cb, xml_attr(tag, "cbName"));
+  }
+  else if (0 == strcmp(name, "P"))
+  {
+    copy_name(scl->p_type, xml_attr(tag, "type"));
+  }
+  else if (0 == strcmp(name, "IED"))
+  {
+    copy_name(scl->ied, xml_attr(tag, "name"));
+    scl->found |= (0 == strcmp(scl->ied, scl->target));
+  }
+  else if (0 == strcmp(name, "LDevice"))
+  {
+    copy_name(scl->ld, xml_attr(tag, "inst"));
+  }
+  else if (0 == strcmp(name, "DataSet"))
+  {
+    if (SCL_MAX_ITEMS == scl->num_ds)
+    {
+      fprintf(stderr, "[!] more than %d datasets\n", SCL_MAX_ITEMS);
+      return -1;
+    }
+    scl->cur_ds = &(scl->ds[scl->num_ds++]);
+    copy_name(scl->cur_ds->ied, scl->ied);
+    copy_name(scl->cur_ds->ld, scl->ld);
+    copy_name(scl->cur_ds->name, xml_attr(tag, "name"));
+  }
+  else if (0 == strcmp(name, "FCDA") && NULL != scl->cur_ds)
+  {
+    scl->cur_ds->count++;
+  }
+  else if (0 == strcmp(name, "GSEControl") 
+   && 0 != strcmp(xml_attr(tag, "type"), "GSSE"))
+  {
+    if (SCL_MAX_ITEMS == scl->num_ctls)
+    {
+      fprintf(stderr, "[!] more than %d control blocks\n", SCL_MAX_ITEMS);
+      return -1;
+    }
+    scl->cur_ctl = &(scl->ctl[scl->num_ctls++]);
+    copy_name(scl->cur_ctl->ied, scl->ied);
+    copy_name(scl->cur_ctl->ld, scl->ld);
+    copy_name(scl->cur_ctl->name, xml_attr(tag, "name"));
+    copy_name(scl->cur_ctl->datset, xml_attr(tag, "datSet"));
+    snprintf(scl->cur_ctl->goid, SCL_MAX_REF, "%s", xml_attr(tag, "appID"));
+    scl->cur_ctl->confrev = (uint32_t)strtoul(xml_attr(tag, "confRev"), 
+     NULL, 10);
+  }
+  else if (0 == strcmp(name, "ExtRef") && 0 == strcmp(scl->ied, scl->target)
+   && '\0' != xml_attr(tag, "srcCBName")[0]
+   && (0 == strcmp(xml_attr(tag, "serviceType"), "GOOSE") 
+    || '\0' == xml_attr(tag, "serviceType")[0]))
+  {
+    src_ld = xml_attr(tag, "srcLDInst");
+    return add_ref(scl, xml_attr(tag, "iedName"), 
+     ('\0' != src_ld[0]) ? src_ld : xml_attr(tag, "ldInst"), 
+     xml_attr(tag, "srcCBName"));
+  }
+
+  return 0;
+}
+
+
+/**
+ * Function to handle an end tag of the SCL file, with the text of the 
+ * element
+ *
+ * @return int	0 on success, else -1
+ */
+static int scl_end(scl_t *scl, const xml_tag_t *tag)
+{
+  /* Declare local variables */
+  const char *name = tag->name;                          /* Element name */
+  config_cb_t *cb = NULL;                      /* Address being read */
+
+  if (NULL != scl->cur_addr)
+  {
+    cb = &(scl->cur_addr->cb_cfg);
+    if (0 == strcmp(name, "P") && 0 == strcmp(scl->p_type, "MAC-Address"))
+    {
+      if (0 != parse_mac(tag->text, cb->mac))
+      {
+        fprintf(stderr, "[!] bad MAC-Address %s\n", tag->text);
+        return -1;
+      }
+    }
+    else if (0 == strcmp(name, "P") && 0 == strcmp(scl->p_type, "APPID"))
+    {
+      cb->appid = (uint16_t)strtoul(tag->text, NULL, 16);
+    }
+    else if (0 == strcmp(name, "P") && 0 == strcmp(scl->p_type, "VLAN-ID"))
+    {
+      cb->vid = (uint16_t)(strtoul(tag->text, NULL, 16) & 0x0fff);
+      cb->tagged = 1;
+    }
+    else if (0 == strcmp(name, "P") 
+     && 0 == strcmp(scl->p_type, "VLAN-PRIORITY"))
+    {
+      cb->pcp = (uint8_t)(strtoul(tag->text, NULL, 10) & 0x7);
+      cb->tagged = 1;
+    }
+    else if (0 == strcmp(name, "MinTime"))
+    {
+      cb->min_time = (uint32_t)strtoul(tag->text, NULL, 10);
+    }
+    else if (0 == strcmp(name, "MaxTime"))
+    {
+      cb->max_time = (uint32_t)strtoul(tag->text, NULL, 10);
+    }
+  }
+
+  if (0 == strcmp(name, "GSE"))
+  {
+    scl->cur_addr = NULL;
+  }
+  else if (0 == strcmp(name, "DataSet"))
+  {
+    scl->cur_ds = NULL;
+  }
+  else if (0 == strcmp(name, "GSEControl"))
+  {
+    scl->cur_ctl = NULL;
+  }
+  else if (0 == strcmp(name, "IEDName") && NULL != scl->cur_ctl 
+   && 0 == strcmp(tag->text, scl->target))
+  {
+    return add_ref(scl, scl->cur_ctl->ied, scl->cur_ctl->ld, 
+     scl->cur_ctl->name);
+  }
+  else if (0 == strcmp(name, "LDevice"))
+  {
+    scl->ld[0] = '\0';
+  }
+  else if (0 == strcmp(name, "IED"))
+  {
+    scl->ied[0] = '\0';
+  }
+
+  return 0;
+}
+
+
+/**
+ * Function to read the GOOSE configuration of an SCL file
+ *
+ * @param path	path of the SCL file
+ * @param scl	pointer to the items to populate
+ * @return int	0 on success, else -1
+ */
+static int read_scl(const char *path, scl_t *scl)
+{
+  /* Declare local variables */
+  FILE *in = NULL;                                            /* SCL file */
+  char *doc = NULL;                                /* Contents of the file */
+  long size = 0;                                      /* Size of the file */
+  char *p = NULL;                                        /* Parse position */
+  char *next = NULL;                               /* Position after a tag */
+  xml_tag_t tag;                                            /* Current tag */
+  int depth = 0;                                      /* Element nesting */
+  int ret = 0;                                         /* Result of a tag */
+
+  in = fopen(path, "rb");
+  if (NULL == in)
+  {
+    fprintf(stderr, "[!] could not open %s (%s)\n", path, strerror(errno));
+    return -1;
+  }
+  if (0 != fseek(in, 0, SEEK_END) || (size = ftell(in)) < 0 
+   || 0 != fseek(in, 0, SEEK_SET))
+  {
+    fprintf(stderr, "[!] could not read %s\n", path);
+    fclose(in);
+    return -1;
+  }
+  MALLOC(doc, char, (size_t)size + 1);
+  if (NULL == doc || (size_t)size != fread(doc, 1, (size_t)size, in))
+  {
+    fprintf(stderr, "[!] could not read %s\n", path);
+    FREE(doc);
+    fclose(in);
+    return -1;
+  }
+  fclose(in);
+  doc[size] = '\0';
+
+  for (p = doc; NULL != (next = xml_next(p, &tag)); p = next)
+  {
+    if (tag.end)
+    {
+      ret = scl_end(scl, &tag);
+      depth--;
+    }
+    else
+    {
+      ret = scl_start(scl, &tag);
+      if (0 == ret && tag.empty)
+      {
+        tag.text = (char *)"";
+        ret = scl_end(scl, &tag);
+      }
+      depth += !tag.empty;
+    }
+    if (0 != ret || depth < 0)
+    {
+      break;
+    }
+  }
+  if (NULL == next && (NULL != tag.name || 0 != depth))
+  {
+    fprintf(stderr, "[!] %s: malformed XML near offset %ld\n", path, 
+     (long)(p - doc));
+    ret = -1;
+  }
+  FREE(doc);
+
+  /* Done */
+  return ret;
+}
+
+
+/**
+ * Function to add a '\0' terminated string to the string table
+ *
+ * @return uint32_t	offset of the string, CONFIG_EMPTY if the table is full
+ */
+static uint32_t add_string(const char *str)
+{
+  /* Declare local variables */
+  size_t len = strlen(str) + 1;                  /* Bytes of the string */
+  uint32_t offset = STRINGS_LEN;                  /* Offset of the string */
+
+  if (len > SCL_MAX_STRINGS - STRINGS_LEN)
+  {
+    return CONFIG_EMPTY;
+  }
+  memcpy(STRINGS + STRINGS_LEN, str, len);
+  STRINGS_LEN += (uint32_t)len;
+  return offset;
+}
+
+
+/**
+ * Function to complete a control block of the image from its GSEControl, 
+ * the GSE address and the dataset
+ *
+ * @return int	0 on success, else -1 if the control block has no address or 
+ * 		the string table is full
+ */
+static int build_cb(const scl_t *scl, const scl_ctl_t *ctl, config_cb_t *cb)
+{
+  /* Declare local variables */
+  char ref[SCL_MAX_REF * 2];                 /* gocbRef or datSet reference */
+  size_t i = 0;                                               /* Loop index */
+
+  memset(cb, 0, sizeof(config_cb_t));
+  for (i = 0; i < scl->num_addrs; i++)
+  {
+    if (0 == strcmp(scl->addr[i].ied, ctl->ied) 
+     && 0 == strcmp(scl->addr[i].ld, ctl->ld) 
+     && 0 == strcmp(scl->addr[i].cb, ctl->name))
+    {
+      *cb = scl->addr[i].cb_cfg;
+      break;
+    }
+  }
+  if (i == scl->num_addrs)
+  {
+    fprintf(stderr, "[!] no GSE address for %s%s/LLN0$GO$%s, skipped\n", 
+     ctl->ied, ctl->ld, ctl->name);
+    return -1;
+  }
+  for (i = 0; i < scl->num_ds; i++)
+  {
+    if (0 == strcmp(scl->ds[i].ied, ctl->ied) 
+     && 0 == strcmp(scl->ds[i].ld, ctl->ld) 
+     && 0 == strcmp(scl->ds[i].name, ctl->datset))
+    {
+      cb->numDatSetEntries = scl->ds[i].count;
+      break;
+    }
+  }
+  cb->confRev = ctl->confrev;
+
+  cb->ied = add_string(ctl->ied);
+  snprintf(ref, sizeof(ref), "%s%s/LLN0$GO$%s", ctl->ied, ctl->ld, ctl->name);
+  cb->gocbref = add_string(ref);
+  cb->goID = ('\0' != ctl->goid[0]) ? add_string(ctl->goid) : cb->gocbref;
+  snprintf(ref, sizeof(ref), "%s%s/LLN0$%s", ctl->ied, ctl->ld, ctl->datset);
+  cb->datSet = add_string(ref);
+  if (CONFIG_EMPTY == cb->ied || CONFIG_EMPTY == cb->gocbref 
+   || CONFIG_EMPTY == cb->goID || CONFIG_EMPTY == cb->datSet)
+  {
+    fprintf(stderr, "[!] string table is full\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+
+/**
+ * Function to compile the configuration of the target IED into an image
+ *
+ * @param scl	pointer to the items of the SCL file
+ * @param path	path of the image to write
+ * @return int	0 on success, else -1
+ */
+static int write_image(const scl_t *scl, const char *path)
+{
+  /* Declare local variables */
+  static config_cb_t pubs[SCL_MAX_ITEMS];         /* Published control blocks */
+  static config_cb_t subs[SCL_MAX_ITEMS];        /* Subscribed control blocks */
+  static uint32_t slot[4 * SCL_MAX_ITEMS];           /* Subscription table */
+  static const uint8_t PAD[8] = {0};                /* Alignment of arrays */
+  config_t config;                                       /* Image header */
+  char tmp[4096];                              /* Image before the rename */
+  FILE *out = NULL;                                            /* Image */
+  const scl_ctl_t *ctl = NULL;                     /* Current control block */
+  const char *ref = NULL;                        /* gocbRef of a subscription */
+  size_t i = 0;                                    /* Control block index */
+  size_t j = 0;                                       /* Reference index */
+  uint32_t h = 0;                                            /* Slot index */
+  int ok = 1;                                /* Zero if a write failed */
+
+  memset(&config, 0, sizeof(config_t));
+  config.magic = CONFIG_MAGIC;
+  config.version = CONFIG_VERSION;
+  copy_name(config.ied, scl->target);
+  STRINGS_LEN = 0;
+  add_string("");
+
+  /* Control blocks of the IED, then those it subscribes to, once each */
+  for (i = 0; i < scl->num_ctls; i++)
+  {
+    ctl = &(scl->ctl[i]);
+    if (0 == strcmp(ctl->ied, scl->target))
+    {
+      config.num_pubs += (0 == build_cb(scl, ctl, &pubs[config.num_pubs]));
+      continue;
+    }
+    for (j = 0; j < scl->num_refs; j++)
+    {
+      if (0 == strcmp(scl->ref[j].ied, ctl->ied) 
+       && 0 == strcmp(scl->ref[j].ld, ctl->ld) 
+       && 0 == strcmp(scl->ref[j].cb, ctl->name))
+      {
+        config.num_subs += (0 == build_cb(scl, ctl, &subs[config.num_subs]));
+        break;
+      }
+    }
+  }
+
+  /* Hash the subscriptions by APPID and gocbRef, at most half full */
+  config.hash_len = 1;
+  while (config.hash_len < 2 * config.num_subs + 1)
+  {
+    config.hash_len <<= 1;
+  }
+  memset(slot, 0xff, config.hash_len * sizeof(uint32_t));
+  for (i = 0; i < config.num_subs; i++)
+  {
+    ref = STRINGS + subs[i].gocbref;
+    h = config_hash(subs[i].appid, (const uint8_t *)ref, strlen(ref)) 
+     & (config.hash_len - 1);
+    while (CONFIG_EMPTY != slot[h])
+    {
+      h = (h + 1) & (config.hash_len - 1);
+    }
+    slot[h] = (uint32_t)i;
+  }
+
+  /* Lay out the image, each array on an 8 byte boundary */
+  config.pubs = (uint32_t)((sizeof(config_t) + 7) & ~(size_t)7);
+  config.subs = config.pubs + config.num_pubs * (uint32_t)sizeof(config_cb_t);
+  config.hash = config.subs + config.num_subs * (uint32_t)sizeof(config_cb_t);
+  config.strings = config.hash + config.hash_len * (uint32_t)sizeof(uint32_t);
+  config.strings_len = STRINGS_LEN;
+  config.size = config.strings + config.strings_len;
+
+  /* Write beside the image and rename, so that a running IED mapping the 
+   * previous image keeps it */
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  out = fopen(tmp, "wb");
+  if (NULL == out)
+  {
+    fprintf(stderr, "[!] could not create %s (%s)\n", tmp, strerror(errno));
+    return -1;
+  }
+  ok &= (1 == fwrite(&config, sizeof(config_t), 1, out));
+  ok &= (config.pubs - sizeof(config_t) 
+   == fwrite(PAD, 1, config.pubs - sizeof(config_t), out));
+  ok &= (config.num_pubs 
+   == fwrite(pubs, sizeof(config_cb_t), config.num_pubs, out));
+  ok &= (config.num_subs 
+   == fwrite(subs, sizeof(config_cb_t), config.num_subs, out));
+  ok &= (config.hash_len == fwrite(slot, sizeof(uint32_t), config.hash_len, 
+   out));
+  ok &= (STRINGS_LEN == fwrite(STRINGS, 1, STRINGS_LEN, out));
+  ok &= (0 == fclose(out));
+  if (!ok || 0 != rename(tmp, path))
+  {
+    fprintf(stderr, "[!] could not write %s (%s)\n", path, strerror(errno));
+    remove(tmp);
+    return -1;
+  }
+
+  fprintf(stdout, "[+] %s: %u control blocks published, %u subscribed, "
+   "%llu bytes in %s\n", scl->target, config.num_pubs, config.num_subs, 
+   (unsigned long long)config.size, path);
+  return 0;
+}
+
+
+/**
+ * Function to print a control block of an image
+ */
+static void print_cb(const config_t *config, const config_cb_t *cb)
+{
+  fprintf(stdout, "  %s appid 0x%04x mac %02x:%02x:%02x:%02x:%02x:%02x", 
+   config_str(config, cb->gocbref), cb->appid, cb->mac[0], cb->mac[1], 
+   cb->mac[2], cb->mac[3], cb->mac[4], cb->mac[5]);
+  if (cb->tagged)
+  {
+    fprintf(stdout, " vlan %u pcp %u", cb->vid, cb->pcp);
+  }
+  fprintf(stdout, "\n    datSet %s goID %s confRev %u entries %u min %u ms "
+   "max %u ms\n", config_str(config, cb->datSet), 
+   config_str(config, cb->goID), cb->confRev, cb->numDatSetEntries, 
+   cb->min_time, cb->max_time);
+}
+
+
+/**
+ * Function to map an image and print its control blocks, timing the mapping 
+ * and checking that every subscription is found in the hash table
+ *
+ * @return int	0 on success, else -1
+ */
+static int dump_image(const char *path)
+{
+  /* Declare local variables */
+  const config_t *config = NULL;                           /* Mapped image */
+  const config_cb_t *cb = NULL;                          /* Control block */
+  const char *ref = NULL;                                /* gocbRef of cb */
+  uint64_t start = now_ns();                           /* Time of mapping */
+  uint32_t i = 0;                                    /* Control block index */
+  int ret = 0;                                                 /* Result */
+
+  config = config_map(path);
+  if (NULL == config)
+  {
+    return -1;
+  }
+  fprintf(stdout, "[-] %s: IED %s mapped in %llu us\n", path, config->ied, 
+   (unsigned long long)((now_ns() - start) / 1000));
+
+  fprintf(stdout, "[-] %u control blocks published\n", config->num_pubs);
+  for (i = 0; i < config->num_pubs; i++)
+  {
+    print_cb(config, config_pub(config, i));
+  }
+  fprintf(stdout, "[-] %u control blocks subscribed to\n", config->num_subs);
+  for (i = 0; i < config->num_subs; i++)
+  {
+    cb = config_sub(config, i);
+    print_cb(config, cb);
+    ref = config_str(config, cb->gocbref);
+    if (cb != config_find_sub(config, cb->appid, (const uint8_t *)ref, 
+     strlen(ref)))
+    {
+      fprintf(stderr, "[!] %s is not in the subscription table\n", ref);
+      ret = -1;
+    }
+  }
+
+  /* Done */
+  config_unmap(config);
+  return ret;
+}
+
+
+int main(int argc, char *argv[]) 
+{
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  const char *image = NULL;                          /* Path of the image */
+  int dump = 0;                             /* Non-zero to print an image */
+  char path[SCL_MAX_NAME + 8];                   /* Default image path */
+
+  /* Check paramaters */
+  while (-1 != (opt = getopt(argc, argv, "di:o:")))
+  {
+    switch (opt)
+    {
+      case 'd':
+        dump = 1;
+        break;
+      case 'i':
+        SCL.target = optarg;
+        break;
+      case 'o':
+        image = optarg;
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  if (argc != optind + 1 || (!dump && NULL == SCL.target)) 
+  {
+    print_usage();
+    return -1;
+  }
+  if (dump)
+  {
+    return dump_image(argv[optind]);
+  }
+  if (strlen(SCL.target) >= SCL_MAX_NAME)
+  {
+    fprintf(stderr, "[!] IED name %s is too long\n", SCL.target);
+    return -1;
+  }
+
+  if (0 != read_scl(argv[optind], &SCL))
+  {
+    return -1;
+  }
+  if (!SCL.found)
+  {
+    fprintf(stderr, "[!] IED %s is not in %s\n", SCL.target, argv[optind]);
+    return -1;
+  }
+  if (NULL == image)
+  {
+    snprintf(path, sizeof(path), "%s.cfg", SCL.target);
+    image = path;
+  }
+
+  /* Done */
+  return write_image(&SCL, image);
+}
+
+
+void print_usage(void) 
+{
+  fprintf(stdout, "goose_scl, version %s\n\n", VER);
+  fprintf(stdout, "usage: goose_scl -i ied [-o image] scl\n");
+  fprintf(stdout, "       goose_scl -d image\n\n");
+  fprintf(stdout, "  -d : print the control blocks of a configuration image\n");
+  fprintf(stdout, "  -i ied : IED to compile the GOOSE configuration of\n");
+  fprintf(stdout, "  -o image : configuration image to write, default "
+   "ied.cfg\n");
+  fprintf(stdout, "  scl : SCL file, an SCD or the CID of the IED\n");
+  fflush(stdout);
+  return;
+}
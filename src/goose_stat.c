@@ -0,0 +1,377 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "metrics.h"
+#include "types.h"
+#include "utils.h"
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+
+/*
+ * Constants
+ */
+
+/** 
+ * Version of goose_stat utility
+ */
+static const char VER[]="0.1a";
+
+
+
+/*
+ * Global variables
+ */
+
+/**
+ * Flag set by the signal handler to stop watching
+ */
+static volatile sig_atomic_t STOP = 0;
+
+/**
+ * Counters of the previous snapshot, for the rates
+ */
+static uint64_t PREV_IFACE_TX[METRICS_MAX_IFACES];
+static uint64_t PREV_IFACE_RX[METRICS_MAX_IFACES];
+static uint64_t PREV_STREAM_RX[METRICS_MAX_STREAMS];
+
+
+
+/*
+ * Function prototypes
+ */
+
+/**
+ * Function to display the command usage to stdout
+ */
+void print_usage(void);
+
+/**
+ * Function to stop watching when interrupted
+ *
+ * @param sig int for the signal number
+ */
+void signal_handler(int sig);
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to read a counter of the segment whole
+ */
+static uint64_t get(const uint64_t *counter)
+{
+  return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+
+/**
+ * Function to return the monotonic clock in nanoseconds, the clock used by 
+ * the processes updating the segment
+ */
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to return the time below which a fraction of a histogram falls, 
+ * as the upper bound of the bucket, in us
+ *
+ * @param hist	pointer to the METRICS_HIST_BUCKETS buckets
+ * @param fraction	fraction of the times, e.g. 0.99
+ * @return double	time in us, or 0 if the histogram is empty
+ */
+static double percentile_us(const uint64_t *hist, double fraction)
+{
+  /* Declare local variables */
+  uint64_t count[METRICS_HIST_BUCKETS];        /* Snapshot of the buckets */
+  uint64_t total = 0;                          /* Number of times counted */
+  uint64_t sum = 0;                          /* Cumulative number of times */
+  unsigned int i = 0;                                     /* Bucket index */
+
+  for (i = 0; i < METRICS_HIST_BUCKETS; i++)
+  {
+    count[i] = get(&hist[i]);
+    total += count[i];
+  }
+  if (0 == total)
+  {
+    return 0.0;
+  }
+
+  for (i = 0; i < METRICS_HIST_BUCKETS; i++)
+  {
+    sum += count[i];
+    if ((double)sum >= fraction * (double)total)
+    {
+      break;
+    }
+  }
+  i = (i < METRICS_HIST_BUCKETS) ? i : METRICS_HIST_BUCKETS - 1;
+
+  return (double)(2ULL << i) / 1000.0;
+}
+
+
+/**
+ * Function to print a snapshot of the segment, with rates since the last 
+ * snapshot if an interval is given
+ *
+ * @param metrics	pointer to the segment
+ * @param interval	seconds since the last snapshot, 0 for none
+ */
+static void print_metrics(const metrics_t *metrics, unsigned int interval)
+{
+  /* Declare local variables */
+  const metrics_iface_t *iface = NULL;                /* Interface printed */
+  const metrics_stream_t *stream = NULL;                 /* Stream printed */
+  uint64_t now = now_ns();                               /* Current time */
+  uint64_t last = 0;                      /* Last frame of the stream */
+  uint64_t tx = 0;                                       /* Frames sent */
+  uint64_t rx = 0;                                   /* Frames received */
+  size_t i = 0;                                       /* Slot index */
+  int header = 0;            /* Non-zero once the jitter header is printed */
+
+  fprintf(stdout, "[=] metrics of pid %llu\n", 
+   (unsigned long long)metrics->pid);
+  fprintf(stdout, "%-16s %12s %14s %9s %12s %14s %9s %9s", "iface", 
+   "tx frames", "tx bytes", "tx errors", "rx frames", "rx bytes", 
+   "decode err", "rx drops");
+  fprintf(stdout, interval ? " %10s %10s\n" : "\n", "tx/s", "rx/s");
+  for (i = 0; i < METRICS_MAX_IFACES; i++)
+  {
+    iface = &metrics->iface[i];
+    if (METRICS_SLOT_READY != __atomic_load_n(&iface->state, 
+     __ATOMIC_ACQUIRE))
+    {
+      continue;
+    }
+    tx = get(&iface->tx_frames);
+    rx = get(&iface->rx_frames);
+    fprintf(stdout, "%-16.*s %12llu %14llu %9llu %12llu %14llu %9llu %9llu", 
+     METRICS_IFACE_LEN, iface->name, (unsigned long long)tx, 
+     (unsigned long long)get(&iface->tx_bytes), 
+     (unsigned long long)get(&iface->tx_errors), (unsigned long long)rx, 
+     (unsigned long long)get(&iface->rx_bytes), 
+     (unsigned long long)get(&iface->decode_errors), 
+     (unsigned long long)get(&iface->rx_drops));
+    if (interval)
+    {
+      fprintf(stdout, " %10llu %10llu", 
+       (unsigned long long)((tx - PREV_IFACE_TX[i]) / interval), 
+       (unsigned long long)((rx - PREV_IFACE_RX[i]) / interval));
+    }
+    fprintf(stdout, "\n");
+    PREV_IFACE_TX[i] = tx;
+    PREV_IFACE_RX[i] = rx;
+  }
+
+  fprintf(stdout, "\n%-6s %-32s %10s %10s %6s %6s %6s %6s %6s %9s %9s %s", 
+   "appid", "gocbref", "tx", "rx", "gaps", "auth", "replay", "tal", "stNum", 
+   "p50 us", "p99 us", "state");
+  fprintf(stdout, interval ? " %10s\n" : "\n", "rx/s");
+  for (i = 0; i < METRICS_MAX_STREAMS; i++)
+  {
+    stream = &metrics->stream[i];
+    if (METRICS_SLOT_READY != __atomic_load_n(&stream->state, 
+     __ATOMIC_ACQUIRE))
+    {
+      continue;
+    }
+    rx = get(&stream->rx_frames);
+    last = get(&stream->last_rx_ns);
+    fprintf(stdout, "0x%04x %-32.*s %10llu %10llu %6llu %6llu %6llu %6llu "
+     "%6llu %9.1f %9.1f %s", stream->appid, (int)stream->ref_len, stream->ref, 
+     (unsigned long long)get(&stream->tx_frames), (unsigned long long)rx, 
+     (unsigned long long)get(&stream->gaps), 
+     (unsigned long long)get(&stream->auth_failures), 
+     (unsigned long long)get(&stream->replayed), 
+     (unsigned long long)get(&stream->tal_expiries), 
+     (unsigned long long)get(&stream->stnum_changes), 
+     percentile_us(stream->latency, 0.5), 
+     percentile_us(stream->latency, 0.99), 
+     (0 == last) ? "-" : (now - last > get(&stream->tal_ms) * 1000000ULL) 
+     ? "expired" : "live");
+    if (interval)
+    {
+      fprintf(stdout, " %10llu", 
+       (unsigned long long)((rx - PREV_STREAM_RX[i]) / interval));
+    }
+    fprintf(stdout, "\n");
+    PREV_STREAM_RX[i] = rx;
+  }
+
+  /* Lateness of frames published on a schedule, only for streams that have 
+   * published any */
+  header = 0;
+  for (i = 0; i < METRICS_MAX_STREAMS; i++)
+  {
+    stream = &metrics->stream[i];
+    if (METRICS_SLOT_READY != __atomic_load_n(&stream->state, 
+     __ATOMIC_ACQUIRE) || 0 == percentile_us(stream->tx_late, 1.0))
+    {
+      continue;
+    }
+    if (!header)
+    {
+      fprintf(stdout, "\n%-6s %-32s %9s %9s %9s %9s %9s %9s\n", "appid", 
+       "gocbref", "sent p50", "sent p99", "sent max", "wire p50", 
+       "wire p99", "wire max");
+      header = 1;
+    }
+    fprintf(stdout, "0x%04x %-32.*s %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n", 
+     stream->appid, (int)stream->ref_len, stream->ref, 
+     percentile_us(stream->tx_late, 0.5), 
+     percentile_us(stream->tx_late, 0.99), 
+     percentile_us(stream->tx_late, 1.0), 
+     percentile_us(stream->tx_wire, 0.5), 
+     percentile_us(stream->tx_wire, 0.99), 
+     percentile_us(stream->tx_wire, 1.0));
+  }
+  fflush(stdout);
+}
+
+
+int main(int argc, char *argv[]) 
+{
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  unsigned int interval = 0;       /* Seconds between snapshots, 0 for one */
+  int remove = 0;                         /* Non-zero to remove the segment */
+  const char *name = METRICS_SHM_NAME;             /* Name of the segment */
+  const metrics_t *metrics = NULL;                  /* Mapped segment */
+  struct sigaction signal_action;                     /* Sigaction structure */
+
+  /* Check paramaters */
+  while (-1 != (opt = getopt(argc, argv, "i:n:r")))
+  {
+    switch (opt)
+    {
+      case 'i':
+        interval = (unsigned int)atoi(optarg);
+        break;
+      case 'n':
+        name = optarg;
+        break;
+      case 'r':
+        remove = 1;
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  if (argc != optind) 
+  {
+    print_usage();
+    return -1;
+  }
+
+  if (remove)
+  {
+    if (-1 == shm_unlink(name))
+    {
+      fprintf(stderr, "[!] could not remove %s\n", name);
+      return -1;
+    }
+    return 0;
+  }
+
+  /* The segment is mapped read-only, nothing here touches the data path */
+  metrics = metrics_map(name);
+  if (NULL == metrics)
+  {
+    fprintf(stderr, "[!] no metrics in %s, is a publisher running with "
+     "-m?\n", name);
+    return -1;
+  }
+
+  memset(&signal_action, 0, sizeof(struct sigaction));
+  signal_action.sa_handler = &signal_handler;
+  if (-1 == sigaction(SIGINT, &signal_action, (struct sigaction *)NULL))
+  {
+    fprintf(stderr, "[!] unable to register signal handler\n");
+    exit(EXIT_FAILURE);
+  }
+
+  print_metrics(metrics, 0);
+  while (interval && !STOP)
+  {
+    sleep(interval);
+    if (!STOP)
+    {
+      fprintf(stdout, "\n");
+      print_metrics(metrics, interval);
+    }
+  }
+
+  /* Done */
+  metrics_unmap(metrics);
+  return 0;
+}
+
+
+void print_usage(void) 
+{
+  fprintf(stdout, "goose_stat, version %s\n\n", VER);
+  fprintf(stdout, "usage: goose_stat [-i secs] [-n name] [-r]\n\n");
+  fprintf(stdout, "  -i secs : print the counters and rates every secs "
+   "seconds until interrupted\n");
+  fprintf(stdout, "  -n name : shared memory segment, default %s\n", 
+   METRICS_SHM_NAME);
+  fprintf(stdout, "  -r : remove the shared memory segment\n");
+  fflush(stdout);
+  return;
+}
+
+
+void signal_handler(int sig)
+{
+  (void)sig;
+  STOP = 1;
+}
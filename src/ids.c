@@ -0,0 +1,467 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "ids.h"
+#include "log.h"
+#include "types.h"
+#include "utils.h"
+
+#include <string.h>
+
+
+/*
+ * Constants
+ */
+
+/** Names of the kinds of alert, indexed by ids_alert_t */
+const char *const IDS_ALERT_NAMES[IDS_ALERT_COUNT] = {
+  "unexpected stream",
+  "source address",
+  "confRev",
+  "stNum went back",
+  "sqNum went back",
+  "new state not at sqNum 0",
+  "publisher restart",
+  "t changed within a state",
+  "t went back",
+  "TAL out of range",
+  "TAL expired",
+  "rate spike"
+};
+
+
+/**
+ * Macro to raise an alert of a stream, logged as the event of its kind 
+ * unless the stream has already logged IDS_MAX_ALERTS in this window. A 
+ * rate spike, raised once per window, is always logged, as the frames of a 
+ * flood raise the others first.
+ *
+ * @param KIND	ids_alert_t of the alert
+ */
+#define IDS_ALERT(IDS, STREAM, KIND, ...) \
+do \
+{ \
+  (IDS)->alerts[(KIND)]++; \
+  alerts++; \
+  if ((STREAM)->alerts < IDS_MAX_ALERTS || IDS_ALERT_RATE == (KIND)) \
+  { \
+    (STREAM)->alerts++; \
+    LOG_EVENT((log_event_t)(LOG_EV_IDS_UNKNOWN + (KIND)), (STREAM)->id, \
+     (STREAM)->appid, __VA_ARGS__); \
+  } \
+  else \
+  { \
+    (IDS)->suppressed++; \
+  } \
+} \
+while (0)
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return an address as the low 48 bits of an integer, to log it
+ */
+static uint64_t ids_mac(const uint8_t *mac)
+{
+  return ((uint64_t)mac[0] << 40) | ((uint64_t)mac[1] << 32) 
+   | ((uint64_t)mac[2] << 24) | ((uint64_t)mac[3] << 16) 
+   | ((uint64_t)mac[4] << 8) | mac[5];
+}
+
+
+/**
+ * Function to return a UtcTime as seconds and the binary fraction, in units 
+ * of 2^-24 s, so that times compare as integers
+ */
+static uint64_t ids_time(const uint8_t *t)
+{
+  return ((uint64_t)t[0] << 48) | ((uint64_t)t[1] << 40) 
+   | ((uint64_t)t[2] << 32) | ((uint64_t)t[3] << 24) 
+   | ((uint64_t)t[4] << 16) | ((uint64_t)t[5] << 8) | t[6];
+}
+
+
+/**
+ * Function to find the slot of a stream, or the empty slot it would take. 
+ * The table always has empty slots, so the probe terminates.
+ */
+static ids_stream_t *ids_find(const ids_t *ids, const goose_view_t *view)
+{
+  /* Declare local variables */
+  ids_stream_t *slot = NULL;                         /* Slot being probed */
+  size_t i = 0;                                      /* Index of the slot */
+
+  i = config_hash(view->appid, view->gocbref, view->gocbrefLen) & ids->mask;
+  for (;;)
+  {
+    slot = &ids->streams[i];
+    if (!slot->used || (slot->appid == view->appid 
+     && slot->ref_len == view->gocbrefLen 
+     && 0 == memcmp(slot->ref, view->gocbref, view->gocbrefLen)))
+    {
+      return slot;
+    }
+    i = (i + 1) & ids->mask;
+  }
+}
+
+
+/**
+ * Function to start tracking a stream from its first frame, expected as 
+ * configured, else as the frame is
+ *
+ * @return int	non-zero if the stream is expected
+ */
+static int ids_add(ids_t *ids, ids_stream_t *slot, const goose_view_t *view, 
+ const uint8_t *smac, uint64_t ns)
+{
+  /* Declare local variables */
+  const config_cb_t *cb = NULL;             /* Control block configured */
+
+  memset(slot, 0, sizeof(ids_stream_t));
+  slot->used = 1;
+  slot->id = (uint32_t)ids->used++;
+  slot->appid = view->appid;
+  slot->ref_len = (uint8_t)view->gocbrefLen;
+  memcpy(slot->ref, view->gocbref, view->gocbrefLen);
+  memcpy(slot->smac, smac, 6);
+  slot->confRev = view->confRev;
+  slot->numDatSetEntries = view->numDatSetEntries;
+  slot->stNum = view->stNum;
+  slot->sqNum = view->sqNum;
+  slot->t = ids_time(view->t);
+  slot->tal_ms = view->timeAllowedtoLive;
+  slot->tal_max = view->timeAllowedtoLive;
+  slot->learn = ids->learn_windows;
+  slot->last_ns = ns;
+  slot->window_ns = ns;
+
+  /* A configured stream is held to its configuration from the first frame, 
+   * and its TAL to twice MinTime to twice MaxTime when they are set */
+  if (NULL != ids->config)
+  {
+    cb = config_find_sub(ids->config, view->appid, view->gocbref, 
+     view->gocbrefLen);
+    if (NULL != cb)
+    {
+      slot->confRev = cb->confRev;
+      slot->numDatSetEntries = cb->numDatSetEntries;
+      if (cb->min_time && cb->max_time)
+      {
+        slot->tal_min = 2 * cb->min_time;
+        slot->tal_max = 2 * cb->max_time;
+      }
+    }
+  }
+
+  LOG_EVENT(LOG_EV_IDS_STREAM, slot->id, slot->appid, ids_mac(smac), 
+   slot->confRev, slot->numDatSetEntries);
+  LOG_TEXT(LOG_EV_IDS_GOCBREF, slot->ref, slot->ref_len);
+
+  /* Done */
+  if (0 == ids->learn_until)
+  {
+    ids->learn_until = ns + (uint64_t)ids->learn_windows * IDS_WINDOW_NS;
+  }
+  return (NULL != ids->config) ? (NULL != cb) : (ns <= ids->learn_until);
+}
+
+
+/**
+ * Function to count a frame from the learned source address whose stNum or 
+ * sqNum went back, as one more of a run that follows on from each other as 
+ * a restarted publisher's would, else as the first of a new run
+ *
+ * @return uint32_t	number of frames of the run
+ */
+static uint32_t ids_resync(ids_stream_t *s, const goose_view_t *view, 
+ uint64_t t)
+{
+  if (s->resync_frames && ((view->stNum == s->resync_stNum 
+   && (int32_t)(view->sqNum - s->resync_sqNum) > 0 && t == s->resync_t) 
+   || ((int32_t)(view->stNum - s->resync_stNum) > 0 && t > s->resync_t)))
+  {
+    s->resync_frames++;
+  }
+  else
+  {
+    s->resync_frames = 1;
+  }
+  s->resync_stNum = view->stNum;
+  s->resync_sqNum = view->sqNum;
+  s->resync_t = t;
+
+  /* Done */
+  return s->resync_frames;
+}
+
+
+int ids_init(ids_t *ids, size_t max_streams, const config_t *config)
+{
+  /* Check parameters */
+  if (NULL == ids || 0 == max_streams)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  size_t slots = 2;                                    /* Number of slots */
+
+  while (slots < 2 * max_streams)
+  {
+    slots <<= 1;
+  }
+
+  memset(ids, 0, sizeof(ids_t));
+  MALLOC(ids->streams, ids_stream_t, slots * sizeof(ids_stream_t));
+  memset(ids->streams, 0, slots * sizeof(ids_stream_t));
+  ids->mask = slots - 1;
+  ids->max_streams = max_streams;
+  ids->config = config;
+  ids->learn_windows = IDS_LEARN_WINDOWS;
+  ids->rate_factor = IDS_RATE_FACTOR;
+  ids->rate_min = IDS_RATE_MIN;
+  ids->tal_grace_ms = IDS_TAL_GRACE_MS;
+  ids->resync_frames = IDS_RESYNC_FRAMES;
+
+  /* Done */
+  return 0;
+}
+
+
+void ids_free(ids_t *ids)
+{
+  /* Check parameters */
+  if (NULL == ids)
+  {
+    return;
+  }
+
+  FREE(ids->streams);
+  memset(ids, 0, sizeof(ids_t));
+}
+
+
+int ids_check(ids_t *ids, const uint8_t *packet, size_t caplen, uint64_t ns)
+{
+  /* Check parameters */
+  if (NULL == ids || NULL == ids->streams || NULL == packet)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  goose_view_t view;                                      /* Decoded frame */
+  ids_stream_t *s = NULL;                             /* Stream of the frame */
+  uint64_t t = 0;                                         /* t of the frame */
+  uint32_t limit = 0;                        /* Most frames of a window */
+  int fresh = 0;                          /* Non-zero for a stream's first */
+  int accept = 1;                    /* Non-zero if the state is followed */
+  int genuine = 1;          /* Non-zero if from the learned source address */
+  int expired = 0;           /* Non-zero if the TAL of the stream expired */
+  ids_alert_t back = IDS_ALERT_COUNT;     /* Kind of going back, if any */
+  uint32_t prev = 0;              /* stNum or sqNum the frame went back from */
+  uint32_t run = 0;                  /* Frames of the run gone back */
+  int alerts = 0;                                /* Alerts of the frame */
+
+  ids->frames++;
+  if (0 != decode_goose_frame(packet, caplen, &view) 
+   || view.gocbrefLen > IDS_MAX_REF_LEN)
+  {
+    ids->malformed++;
+    LOG_EVENT(LOG_EV_GOOSE_MALFORMED, caplen);
+    return -1;
+  }
+  t = ids_time(view.t);
+
+  /* First frame of a stream, which is all that is known of it unless it 
+   * is configured */
+  s = ids_find(ids, &view);
+  if (!s->used)
+  {
+    if (ids->used >= ids->max_streams)
+    {
+      ids->untracked++;
+      return 0;
+    }
+    fresh = 1;
+    if (!ids_add(ids, s, &view, packet + 6, ns))
+    {
+      IDS_ALERT(ids, s, IDS_ALERT_UNKNOWN, ids_mac(packet + 6));
+    }
+  }
+
+  /* Count the frames of the window, learning the rate from whole windows */
+  if (ns - s->window_ns >= IDS_WINDOW_NS)
+  {
+    if (s->learn)
+    {
+      s->rate_max = (s->window_frames > s->rate_max) 
+       ? s->window_frames : s->rate_max;
+      s->learn--;
+    }
+    s->window_ns = ns;
+    s->window_frames = 0;
+    s->alerts = 0;
+  }
+  s->window_frames++;
+  limit = ids->rate_factor * s->rate_max;
+  limit = (limit > ids->rate_min) ? limit : ids->rate_min;
+  if (!s->learn && s->window_frames == limit + 1)
+  {
+    IDS_ALERT(ids, s, IDS_ALERT_RATE, s->window_frames, s->rate_max);
+  }
+
+  /* Identity of the publisher and of its configuration, the state of a 
+   * stream is only followed from the address it was learned from */
+  if (0 != memcmp(s->smac, packet + 6, 6))
+  {
+    IDS_ALERT(ids, s, IDS_ALERT_SRC_MAC, ids_mac(packet + 6), 
+     ids_mac(s->smac));
+    genuine = 0;
+    accept = 0;
+  }
+  if (view.confRev != s->confRev 
+   || view.numDatSetEntries != s->numDatSetEntries)
+  {
+    IDS_ALERT(ids, s, IDS_ALERT_CONFREV, view.confRev, 
+     view.numDatSetEntries, s->confRev, s->numDatSetEntries);
+  }
+
+  /* TAL within half the lowest configured to twice the highest learned, 
+   * as a stream may not change state while it learns, and the frame before 
+   * the TAL of the previous frame expired, give or take the grace */
+  if (0 == view.timeAllowedtoLive || (!s->learn 
+   && (view.timeAllowedtoLive < s->tal_min / 2 
+    || view.timeAllowedtoLive > 2 * s->tal_max)))
+  {
+    IDS_ALERT(ids, s, IDS_ALERT_TAL, view.timeAllowedtoLive, s->tal_min / 2, 
+     2 * s->tal_max);
+  }
+  else if (s->learn)
+  {
+    s->tal_max = (view.timeAllowedtoLive > s->tal_max) 
+     ? view.timeAllowedtoLive : s->tal_max;
+  }
+  if (!fresh && ns - s->last_ns 
+   > (uint64_t)(s->tal_ms + ids->tal_grace_ms) * 1000000ULL)
+  {
+    IDS_ALERT(ids, s, IDS_ALERT_TAL_EXPIRED, (ns - s->last_ns) / 1000000ULL, 
+     s->tal_ms);
+    expired = 1;
+  }
+
+  /* stNum and sqNum as a publisher moves them, with the serial arithmetic 
+   * of their roll over, and t changing with stNum only */
+  if (fresh)
+  {
+    /* Nothing to compare with */
+  }
+  else if (view.stNum == s->stNum)
+  {
+    if (t != s->t)
+    {
+      IDS_ALERT(ids, s, IDS_ALERT_TIME_CHANGED, view.stNum, view.sqNum);
+    }
+    if ((int32_t)(view.sqNum - s->sqNum) > 0)
+    {
+      ids->lost += view.sqNum - s->sqNum - 1;
+    }
+    else if (!(1 == view.sqNum && UINT32_MAX == s->sqNum))
+    {
+      back = IDS_ALERT_SQNUM_BACK;
+      prev = s->sqNum;
+    }
+  }
+  else if (1 == view.stNum && 0 == view.sqNum && t > s->t)
+  {
+    IDS_ALERT(ids, s, IDS_ALERT_RESTART, view.stNum, s->stNum);
+  }
+  else if ((int32_t)(view.stNum - s->stNum) > 0)
+  {
+    ids->lost += view.stNum - s->stNum - 1;
+    if (0 != view.sqNum)
+    {
+      IDS_ALERT(ids, s, IDS_ALERT_STATE_SQNUM, view.stNum, view.sqNum);
+    }
+    if (t <= s->t)
+    {
+      IDS_ALERT(ids, s, IDS_ALERT_TIME_BACK, view.stNum, 
+       ((s->t - t) * 1000) >> 24);
+    }
+  }
+  else
+  {
+    back = IDS_ALERT_STNUM_BACK;
+    prev = s->stNum;
+  }
+
+  /* A frame going back is alerted and ignored, unless its stream has gone 
+   * silent or it is the last of a run from the learned source address that 
+   * a restarted publisher would send, when the stream resynchronises to it 
+   * with one alert. The rest of a run is not alerted again */
+  if (IDS_ALERT_COUNT != back)
+  {
+    run = genuine ? ids_resync(s, &view, t) : 0;
+    if (genuine && (expired || run >= ids->resync_frames))
+    {
+      IDS_ALERT(ids, s, IDS_ALERT_RESTART, view.stNum, s->stNum);
+    }
+    else
+    {
+      if (run <= 1)
+      {
+        IDS_ALERT(ids, s, back, view.stNum, view.sqNum, prev);
+      }
+      accept = 0;
+    }
+  }
+
+  /* Follow the state of the genuine publisher only, and the silence of 
+   * the stream whoever sends */
+  if (accept)
+  {
+    s->resync_frames = 0;
+    s->stNum = view.stNum;
+    s->sqNum = view.sqNum;
+    s->t = t;
+    s->tal_ms = view.timeAllowedtoLive;
+  }
+  s->last_ns = ns;
+
+  /* Done */
+  return alerts;
+}
@@ -0,0 +1,466 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "log.h"
+#include "types.h"
+#include "utils.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+
+/*
+ * Constants
+ */
+
+/** Definitions of the events, indexed by log_event_t */
+const log_event_def_t LOG_EVENTS[LOG_EV_COUNT] = {
+  { LOG_LEVEL_ERROR, 0, "invalid parameters" },
+  { LOG_LEVEL_DEBUG, 0, "published (%llu)" },
+  { LOG_LEVEL_TRACE, 0, "injected %llu bytes" },
+  { LOG_LEVEL_DEBUG, 0, "received (%llu)" },
+  { LOG_LEVEL_TRACE, 0, "frame handled" },
+  { LOG_LEVEL_WARN, 0, "frame failed authentication (%lld)" },
+  { LOG_LEVEL_WARN, 0, "frame rejected as replayed" },
+  { LOG_LEVEL_INFO, 0, "GOOSE dst: %012llx src: %012llx vlan: %llu "
+   "priority: %llu type: 0x%04llx" },
+  { LOG_LEVEL_INFO, 0, "\tappid: 0x%04llx len: %llu res1: 0x%04llx "
+   "res2: 0x%04llx" },
+  { LOG_LEVEL_INFO, 1, "\tgocbref: %.*s" },
+  { LOG_LEVEL_INFO, 1, "\tdatSet: %.*s" },
+  { LOG_LEVEL_INFO, 1, "\tgoID: %.*s" },
+  { LOG_LEVEL_INFO, 0, "\ttatL: %llu t: %llu.%09llu q: 0x%02llx" },
+  { LOG_LEVEL_INFO, 0, "\tstNum: %llu sqNum: %llu test: %llu confRev: %llu "
+   "ndsCom: %llu numEntries: %llu" },
+  { LOG_LEVEL_INFO, 0, "\tstNum: %llu sqNum: %llu unchanged" },
+  { LOG_LEVEL_INFO, 0, "\t\ttag: 0x%02llx len: %llu" },
+  { LOG_LEVEL_WARN, 0, "malformed GOOSE frame (%llu bytes)" },
+  { LOG_LEVEL_INFO, 0, "ids: stream %llu appid 0x%04llx from %012llx "
+   "confRev %llu numEntries %llu" },
+  { LOG_LEVEL_INFO, 1, "\tgocbref: %.*s" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx from %012llx is not "
+   "expected" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx from %012llx, "
+   "learned %012llx" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx confRev %llu "
+   "numEntries %llu, expected %llu and %llu" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx stNum %llu sqNum "
+   "%llu older than stNum %llu" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx stNum %llu sqNum "
+   "%llu not after sqNum %llu" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx new stNum %llu "
+   "starts at sqNum %llu" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx restarted at stNum "
+   "%llu from stNum %llu" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx stNum %llu sqNum "
+   "%llu t changed within the state" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx stNum %llu t %llu "
+   "ms before the previous state" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx TAL %llu ms outside "
+   "%llu to %llu ms" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx silent for %llu ms, "
+   "TAL %llu ms" },
+  { LOG_LEVEL_WARN, 0, "ids: stream %llu appid 0x%04llx %llu frames in a "
+   "window, learned %llu" }
+};
+
+/** Prefix of the formatted records of each level, as the tools print */
+static const char *LOG_PREFIX[] = { "[!]", "[!]", "[-]", "[.]", "[.]" };
+
+
+
+/*
+ * Global variables
+ */
+
+/** Records written by one thread, the owner advances head and the writer 
+ * thread advances tail, each on its own cache line
+ */
+typedef struct _log_ring_t_ {
+  uint64_t head __attribute__((aligned(64)));  /* Records written */
+  uint64_t tail __attribute__((aligned(64)));  /* Records formatted */
+  log_record_t rec[LOG_RING_LEN] __attribute__((aligned(64)));
+} log_ring_t;
+
+volatile int LOG_LEVEL = LOG_LEVEL_NONE;
+
+static log_ring_t *RINGS[LOG_MAX_THREADS];     /* Ring of each thread */
+static unsigned int NUM_RINGS = 0;             /* Number of rings */
+static pthread_mutex_t RINGS_LOCK = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int LOG_GEN = 0;   /* Incremented each time logging starts */
+static uint64_t DROPPED = 0;                   /* Records dropped */
+static pthread_t WRITER;                       /* Writer thread */
+static int RUNNING = 0;                  /* Non-zero while logging */
+static FILE *OUT = NULL;                       /* Stream written to */
+static uint64_t START_NS = 0;              /* Time logging started */
+
+static __thread log_ring_t *RING = NULL;       /* Ring of this thread */
+static __thread unsigned int RING_GEN = 0;     /* LOG_GEN of RING */
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t log_now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to return the ring of the calling thread, registering a ring the 
+ * first time the thread writes a record, else NULL if no ring is available
+ */
+static log_ring_t *log_ring(void)
+{
+  /* Declare local variables */
+  unsigned int gen = __atomic_load_n(&LOG_GEN, __ATOMIC_ACQUIRE);
+
+  if (RING_GEN == gen)
+  {
+    return RING;
+  }
+
+  pthread_mutex_lock(&RINGS_LOCK);
+  RING = NULL;
+  if (RUNNING && NUM_RINGS < LOG_MAX_THREADS 
+   && 0 == posix_memalign((void **)&RING, 64, sizeof(log_ring_t)))
+  {
+    __atomic_fetch_add(&MALLOC_COUNT, 1, __ATOMIC_RELAXED);
+    RING->head = 0;
+    RING->tail = 0;
+    RINGS[NUM_RINGS] = RING;
+    __atomic_store_n(&NUM_RINGS, NUM_RINGS + 1, __ATOMIC_RELEASE);
+  }
+  RING_GEN = gen;
+  pthread_mutex_unlock(&RINGS_LOCK);
+
+  return RING;
+}
+
+
+/**
+ * Function to take the next slot of the ring of the calling thread, with 
+ * room for the number of slots of the record after it, else NULL if the 
+ * record is to be dropped
+ */
+static log_record_t *log_slot(log_event_t event, size_t slots)
+{
+  /* Declare local variables */
+  log_ring_t *ring = NULL;                       /* Ring of this thread */
+  log_record_t *rec = NULL;                        /* Slot of the record */
+
+  if ((unsigned int)event >= LOG_EV_COUNT)
+  {
+    return NULL;
+  }
+
+  ring = log_ring();
+  if (NULL == ring || ring->head 
+   - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) + slots > LOG_RING_LEN)
+  {
+    __atomic_fetch_add(&DROPPED, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+
+  rec = &ring->rec[ring->head & (LOG_RING_LEN - 1)];
+  rec->ts = log_now_ns();
+  rec->event = (uint16_t)event;
+  rec->cont = 0;
+  return rec;
+}
+
+
+void log_write(log_event_t event, const uint64_t *args, size_t nargs)
+{
+  /* Declare local variables */
+  log_record_t *rec = log_slot(event, 1);          /* Slot of the record */
+
+  if (NULL == rec)
+  {
+    return;
+  }
+
+  nargs = (nargs > LOG_MAX_ARGS) ? LOG_MAX_ARGS : nargs;
+  rec->len = (uint8_t)nargs;
+  memcpy(rec->u.arg, args, nargs * sizeof(uint64_t));
+
+  /* Publish the record to the writer thread */
+  __atomic_store_n(&RING->head, RING->head + 1, __ATOMIC_RELEASE);
+}
+
+
+void log_write_text(log_event_t event, const void *text, size_t len)
+{
+  /* Declare local variables */
+  log_record_t *rec = NULL;                          /* Slot of the record */
+  size_t cont = 0;                   /* Slots of text following the record */
+  size_t n = 0;                                  /* Characters of the slot */
+  size_t done = 0;                                /* Characters written */
+  size_t i = 0;                                                /* Slot index */
+
+  len = (NULL == text) ? 0 : (len > LOG_MAX_TEXT) ? LOG_MAX_TEXT : len;
+  if (len > LOG_SLOT_TEXT)
+  {
+    cont = (len - LOG_SLOT_TEXT + sizeof(log_record_t) - 1) 
+     / sizeof(log_record_t);
+  }
+  rec = log_slot(event, 1 + cont);
+  if (NULL == rec)
+  {
+    return;
+  }
+
+  rec->len = (uint8_t)len;
+  rec->cont = (uint8_t)cont;
+  done = (len > LOG_SLOT_TEXT) ? LOG_SLOT_TEXT : len;
+  memcpy(rec->u.text, text, done);
+
+  /* The rest of the text takes the whole of the following slots */
+  for (i = 1; i <= cont; i++)
+  {
+    n = len - done;
+    n = (n > sizeof(log_record_t)) ? sizeof(log_record_t) : n;
+    memcpy(&RING->rec[(RING->head + i) & (LOG_RING_LEN - 1)], 
+     (const char *)text + done, n);
+    done += n;
+  }
+
+  /* Publish the record to the writer thread */
+  __atomic_store_n(&RING->head, RING->head + 1 + cont, __ATOMIC_RELEASE);
+}
+
+
+/**
+ * Function to format the oldest record of a ring to the output stream
+ *
+ * @return size_t	- number of slots of the record
+ */
+static size_t log_format(const log_ring_t *ring, const log_record_t *rec)
+{
+  /* Declare local variables */
+  const log_event_def_t *def = &LOG_EVENTS[rec->event];   /* Definition */
+  uint64_t ts = (rec->ts > START_NS) ? rec->ts - START_NS : 0;
+  unsigned long long a[LOG_MAX_ARGS] = {0};      /* Arguments, zero padded */
+  char text[LOG_MAX_TEXT];                   /* Text gathered from slots */
+  size_t n = 0;                                  /* Characters of a slot */
+  size_t len = 0;                                  /* Characters of text */
+  size_t i = 0;                                  /* Argument or slot index */
+
+  fprintf(OUT, "%s %llu.%06llu ", LOG_PREFIX[def->level], 
+   (unsigned long long)(ts / 1000000000ULL), 
+   (unsigned long long)((ts % 1000000000ULL) / 1000));
+  if (def->text)
+  {
+    len = (rec->len > LOG_SLOT_TEXT) ? LOG_SLOT_TEXT : rec->len;
+    memcpy(text, rec->u.text, len);
+    for (i = 1; i <= rec->cont; i++)
+    {
+      n = rec->len - len;
+      n = (n > sizeof(log_record_t)) ? sizeof(log_record_t) : n;
+      memcpy(text + len, &ring->rec[(ring->tail + i) & (LOG_RING_LEN - 1)], n);
+      len += n;
+    }
+    fprintf(OUT, def->format, (int)len, text);
+  }
+  else
+  {
+    for (i = 0; i < rec->len; i++)
+    {
+      a[i] = (unsigned long long)rec->u.arg[i];
+    }
+    fprintf(OUT, def->format, a[0], a[1], a[2], a[3], a[4], a[5]);
+  }
+  fputc('\n', OUT);
+  return 1 + rec->cont;
+}
+
+
+/**
+ * Function to format every record in the rings, oldest first across the 
+ * threads, and flush them as one batch
+ *
+ * @return size_t	- number of records formatted
+ */
+static size_t log_drain(void)
+{
+  /* Declare local variables */
+  unsigned int num = __atomic_load_n(&NUM_RINGS, __ATOMIC_ACQUIRE);
+  log_ring_t *ring = NULL;                  /* Ring of the oldest record */
+  const log_record_t *rec = NULL;                    /* Oldest record */
+  const log_record_t *next = NULL;        /* Next record of a ring */
+  size_t count = 0;                          /* Number of records formatted */
+  unsigned int i = 0;                                       /* Ring index */
+
+  for (;;)
+  {
+    /* Merge the rings on the timestamp of their next record */
+    ring = NULL;
+    rec = NULL;
+    for (i = 0; i < num; i++)
+    {
+      if (RINGS[i]->tail == __atomic_load_n(&RINGS[i]->head, 
+       __ATOMIC_ACQUIRE))
+      {
+        continue;
+      }
+      next = &RINGS[i]->rec[RINGS[i]->tail & (LOG_RING_LEN - 1)];
+      if (NULL == rec || next->ts < rec->ts)
+      {
+        ring = RINGS[i];
+        rec = next;
+      }
+    }
+    if (NULL == ring)
+    {
+      break;
+    }
+
+    __atomic_store_n(&ring->tail, ring->tail + log_format(ring, rec), 
+     __ATOMIC_RELEASE);
+    count++;
+  }
+
+  if (count)
+  {
+    fflush(OUT);
+  }
+  return count;
+}
+
+
+/**
+ * Function run by the writer thread, draining the rings until logging stops
+ */
+static void *log_writer(void *args)
+{
+  /* Declare local variables */
+  struct timespec wait = { 0, LOG_FLUSH_US * 1000L };  /* Idle interval */
+
+  (void)args;
+  while (__atomic_load_n(&RUNNING, __ATOMIC_ACQUIRE))
+  {
+    if (0 == log_drain())
+    {
+      nanosleep(&wait, NULL);
+    }
+  }
+  log_drain();
+
+  return NULL;
+}
+
+
+int log_start(FILE *out, log_level_t level)
+{
+  /* Check parameters */
+  if (NULL == out)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  if (__atomic_load_n(&RUNNING, __ATOMIC_ACQUIRE))
+  {
+    fprintf(stderr, "ERROR: logging already started\n");
+    return -1;
+  }
+
+  OUT = out;
+  START_NS = log_now_ns();
+  pthread_mutex_lock(&RINGS_LOCK);
+  NUM_RINGS = 0;
+  __atomic_store_n(&RUNNING, 1, __ATOMIC_RELEASE);
+  __atomic_store_n(&LOG_GEN, LOG_GEN + 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&RINGS_LOCK);
+
+  if (0 != pthread_create(&WRITER, NULL, log_writer, NULL))
+  {
+    fprintf(stderr, "ERROR: could not create log writer thread\n");
+    __atomic_store_n(&RUNNING, 0, __ATOMIC_RELEASE);
+    return -1;
+  }
+  LOG_LEVEL = level;
+
+  /* Done */
+  return 0;
+}
+
+
+void log_stop(void)
+{
+  /* Declare local variables */
+  unsigned int i = 0;                                       /* Ring index */
+
+  if (!__atomic_load_n(&RUNNING, __ATOMIC_ACQUIRE))
+  {
+    return;
+  }
+
+  LOG_LEVEL = LOG_LEVEL_NONE;
+  __atomic_store_n(&RUNNING, 0, __ATOMIC_RELEASE);
+  pthread_join(WRITER, NULL);
+
+  /* Threads writing afterwards register a new ring when logging restarts */
+  pthread_mutex_lock(&RINGS_LOCK);
+  for (i = 0; i < NUM_RINGS; i++)
+  {
+    FREE(RINGS[i]);
+    RINGS[i] = NULL;
+  }
+  NUM_RINGS = 0;
+  __atomic_store_n(&LOG_GEN, LOG_GEN + 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&RINGS_LOCK);
+}
+
+
+void log_set_level(log_level_t level)
+{
+  if (__atomic_load_n(&RUNNING, __ATOMIC_ACQUIRE))
+  {
+    LOG_LEVEL = level;
+  }
+}
+
+
+uint64_t log_dropped(void)
+{
+  return __atomic_load_n(&DROPPED, __ATOMIC_RELAXED);
+}
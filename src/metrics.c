@@ -0,0 +1,481 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "metrics.h"
+#include "probes.h"
+#include "types.h"
+#include "utils.h"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/*
+ * Global variables
+ */
+
+/** Metrics segment of this process, NULL until metrics_init() */
+static metrics_t *METRICS = NULL;
+
+
+
+/*
+ * Function definitions
+ */
+
+int metrics_init(const char *name)
+{
+  /* Check parameters */
+  if (NULL == name)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  int fd = -1;                          /* Descriptor of the segment */
+  metrics_t *metrics = NULL;                 /* Mapping of the segment */
+
+  if (NULL != METRICS)
+  {
+    return 0;
+  }
+
+  fd = shm_open(name, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP);
+  if (-1 == fd)
+  {
+    fprintf(stderr, "ERROR: could not open shared memory %s\n", name);
+    return -1;
+  }
+  if (-1 == ftruncate(fd, (off_t)sizeof(metrics_t)))
+  {
+    fprintf(stderr, "ERROR: could not size shared memory %s\n", name);
+    close(fd);
+    return -1;
+  }
+  metrics = (metrics_t *)mmap(NULL, sizeof(metrics_t), 
+   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (MAP_FAILED == (void *)metrics)
+  {
+    fprintf(stderr, "ERROR: could not map shared memory %s\n", name);
+    return -1;
+  }
+
+  /* Counters of an earlier run of the same layout carry on, anything else 
+   * is cleared */
+  if (METRICS_MAGIC != metrics->magic || METRICS_VERSION != metrics->version)
+  {
+    memset(metrics, 0, sizeof(metrics_t));
+    metrics->version = METRICS_VERSION;
+    __atomic_store_n(&metrics->magic, METRICS_MAGIC, __ATOMIC_RELEASE);
+  }
+  metrics->pid = (uint64_t)getpid();
+  METRICS = metrics;
+
+  /* Done */
+  return 0;
+}
+
+
+void metrics_fini(void)
+{
+  if (NULL != METRICS)
+  {
+    munmap(METRICS, sizeof(metrics_t));
+    METRICS = NULL;
+  }
+}
+
+
+const metrics_t *metrics_map(const char *name)
+{
+  /* Check parameters */
+  if (NULL == name)
+  {
+    return NULL;
+  }
+
+  /* Declare local variables */
+  int fd = -1;                          /* Descriptor of the segment */
+  struct stat st;                            /* Status of the segment */
+  const metrics_t *metrics = NULL;           /* Mapping of the segment */
+
+  fd = shm_open(name, O_RDONLY, 0);
+  if (-1 == fd)
+  {
+    return NULL;
+  }
+  if (-1 == fstat(fd, &st) || (size_t)st.st_size < sizeof(metrics_t))
+  {
+    close(fd);
+    return NULL;
+  }
+  metrics = (const metrics_t *)mmap(NULL, sizeof(metrics_t), PROT_READ, 
+   MAP_SHARED, fd, 0);
+  close(fd);
+  if (MAP_FAILED == (const void *)metrics)
+  {
+    return NULL;
+  }
+
+  if (METRICS_MAGIC != __atomic_load_n(&metrics->magic, __ATOMIC_ACQUIRE) 
+   || METRICS_VERSION != metrics->version)
+  {
+    munmap((void *)metrics, sizeof(metrics_t));
+    return NULL;
+  }
+
+  /* Done */
+  return metrics;
+}
+
+
+void metrics_unmap(const metrics_t *metrics)
+{
+  if (NULL != metrics)
+  {
+    munmap((void *)metrics, sizeof(metrics_t));
+  }
+}
+
+
+/**
+ * Function to claim a slot if it is free, else to wait until the thread or 
+ * process claiming it has made it ready, so that its key can be compared
+ *
+ * @param state	pointer to the state of the slot
+ * @param claim	non-zero to claim the slot if it is free
+ * @return uint32_t	METRICS_SLOT_CLAIMED if the caller claimed the slot, 
+ * 			METRICS_SLOT_READY if another has, else 
+ * 			METRICS_SLOT_FREE if it is free and is not claimed or 
+ * 			its claimer gave up
+ */
+static uint32_t metrics_claim(uint32_t *state, int claim)
+{
+  /* Declare local variables */
+  uint32_t now = __atomic_load_n(state, __ATOMIC_ACQUIRE);  /* Slot state */
+  int spins = 0;                             /* Times yielded to a claimer */
+
+  if (METRICS_SLOT_FREE == now)
+  {
+    if (!claim)
+    {
+      return METRICS_SLOT_FREE;
+    }
+    if (__atomic_compare_exchange_n(state, &now, METRICS_SLOT_CLAIMED, 0, 
+     __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+    {
+      return METRICS_SLOT_CLAIMED;
+    }
+  }
+
+  /* Lost the race, or found the slot being claimed */
+  while (METRICS_SLOT_CLAIMED == now && spins++ < METRICS_CLAIM_SPINS)
+  {
+    sched_yield();
+    now = __atomic_load_n(state, __ATOMIC_ACQUIRE);
+  }
+
+  return (METRICS_SLOT_READY == now) ? METRICS_SLOT_READY : METRICS_SLOT_FREE;
+}
+
+
+int metrics_iface(const char *name)
+{
+  /* Check parameters */
+  if (NULL == METRICS || NULL == name)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  metrics_iface_t *iface = NULL;                     /* Slot being probed */
+  int i = 0;                                          /* Interface index */
+
+  for (i = 0; i < METRICS_MAX_IFACES; i++)
+  {
+    iface = &METRICS->iface[i];
+    switch (metrics_claim(&iface->state, 1))
+    {
+      case METRICS_SLOT_CLAIMED:
+        strncpy(iface->name, name, METRICS_IFACE_LEN - 1);
+        __atomic_store_n(&iface->state, METRICS_SLOT_READY, __ATOMIC_RELEASE);
+        return i;
+      case METRICS_SLOT_READY:
+        if (0 == strncmp(iface->name, name, METRICS_IFACE_LEN - 1))
+        {
+          return i;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  return -1;
+}
+
+
+/**
+ * Function to find the slot of a stream, claiming the free slot it would 
+ * take if claim is non-zero
+ */
+static metrics_stream_t *metrics_find(int iface, uint16_t appid, 
+ const uint8_t *ref, size_t ref_len, int claim)
+{
+  /* Declare local variables */
+  metrics_stream_t *slot = NULL;                   /* Slot being probed */
+  uint32_t hash = 2166136261u;                    /* FNV-1a of the key */
+  size_t i = 0;                                    /* Index of the slot */
+  size_t n = 0;                                /* Number of slots probed */
+
+  hash = (hash ^ (appid >> 8)) * 16777619u;
+  hash = (hash ^ (appid & 0xff)) * 16777619u;
+  for (i = 0; i < ref_len; i++)
+  {
+    hash = (hash ^ ref[i]) * 16777619u;
+  }
+
+  i = hash & (METRICS_MAX_STREAMS - 1);
+  for (n = 0; n < METRICS_MAX_STREAMS; n++)
+  {
+    slot = &METRICS->stream[i];
+    switch (metrics_claim(&slot->state, claim))
+    {
+      case METRICS_SLOT_CLAIMED:
+        slot->appid = appid;
+        slot->iface = (uint16_t)iface;
+        slot->ref_len = (uint8_t)ref_len;
+        memcpy(slot->ref, ref, ref_len);
+        __atomic_store_n(&slot->state, METRICS_SLOT_READY, __ATOMIC_RELEASE);
+        return slot;
+      case METRICS_SLOT_READY:
+        if (slot->appid == appid && slot->iface == (uint16_t)iface 
+         && slot->ref_len == ref_len && 0 == memcmp(slot->ref, ref, ref_len))
+        {
+          return slot;
+        }
+        break;
+      default:
+        if (!claim)
+        {
+          return NULL;
+        }
+        break;
+    }
+    i = (i + 1) & (METRICS_MAX_STREAMS - 1);
+  }
+
+  return NULL;
+}
+
+
+metrics_stream_t *metrics_stream(int iface, uint16_t appid, 
+ const uint8_t *ref, size_t ref_len)
+{
+  /* Check parameters */
+  if (NULL == METRICS || iface < 0 || iface >= METRICS_MAX_IFACES 
+   || (NULL == ref && ref_len > 0))
+  {
+    return NULL;
+  }
+
+  /* Declare local variables */
+  metrics_stream_t *stream = NULL;                /* Slot of the stream */
+
+  ref_len = (ref_len > METRICS_MAX_REF_LEN) ? METRICS_MAX_REF_LEN : ref_len;
+  stream = metrics_find(iface, appid, ref, ref_len, 1);
+
+  return stream;
+}
+
+
+/**
+ * Function to count a time in the bucket of a histogram holding it
+ *
+ * @param hist	pointer to the METRICS_HIST_BUCKETS buckets
+ * @param ns	time in ns
+ */
+static void metrics_hist_add(uint64_t *hist, uint64_t ns)
+{
+  /* Declare local variables */
+  unsigned int bucket = 63 - (unsigned int)__builtin_clzll(ns | 1);
+
+  bucket = (bucket < METRICS_HIST_BUCKETS) ? bucket : METRICS_HIST_BUCKETS - 1;
+  METRICS_ADD(hist[bucket], 1);
+}
+
+
+void metrics_tx(metrics_stream_t *stream, size_t bytes, int ok)
+{
+  /* Check parameters */
+  if (NULL == stream || NULL == METRICS)
+  {
+    return;
+  }
+
+  /* Declare local variables */
+  metrics_iface_t *iface = &METRICS->iface[stream->iface];    /* Interface */
+
+  if (ok)
+  {
+    METRICS_ADD(stream->tx_frames, 1);
+    METRICS_ADD(iface->tx_frames, 1);
+    METRICS_ADD(iface->tx_bytes, bytes);
+  }
+  else
+  {
+    METRICS_ADD(iface->tx_errors, 1);
+  }
+}
+
+
+void metrics_jitter(metrics_stream_t *stream, uint64_t deadline, 
+ uint64_t sent_ns, uint64_t wire_ns)
+{
+  /* Check parameters */
+  if (NULL == stream)
+  {
+    return;
+  }
+
+  metrics_hist_add(stream->tx_late, (sent_ns > deadline) 
+   ? sent_ns - deadline : 0);
+  if (wire_ns)
+  {
+    metrics_hist_add(stream->tx_wire, (wire_ns > deadline) 
+     ? wire_ns - deadline : 0);
+  }
+}
+
+
+void metrics_rx(metrics_stream_t *stream, size_t bytes, uint32_t stnum, 
+ uint32_t sqnum, uint32_t tal_ms, uint64_t now_ns)
+{
+  /* Check parameters */
+  if (NULL == stream || NULL == METRICS)
+  {
+    return;
+  }
+
+  /* Declare local variables */
+  metrics_iface_t *iface = &METRICS->iface[stream->iface];    /* Interface */
+  uint64_t last_ns = __atomic_load_n(&stream->last_rx_ns, __ATOMIC_RELAXED);
+  uint32_t last_st = 0;                      /* stNum of the last frame */
+  uint32_t last_sq = 0;                      /* sqNum of the last frame */
+
+  METRICS_ADD(iface->rx_frames, 1);
+  METRICS_ADD(iface->rx_bytes, bytes);
+  if (last_ns > 0)
+  {
+    if ((now_ns - last_ns) 
+     > __atomic_load_n(&stream->tal_ms, __ATOMIC_RELAXED) * 1000000ULL)
+    {
+      METRICS_ADD(stream->tal_expiries, 1);
+      GOOSE_PROBE(tal_expired, stream->appid, (now_ns - last_ns) / 1000000, 
+       stream->tal_ms);
+    }
+    last_st = (uint32_t)__atomic_load_n(&stream->last_stnum, __ATOMIC_RELAXED);
+    last_sq = (uint32_t)__atomic_load_n(&stream->last_sqnum, __ATOMIC_RELAXED);
+    METRICS_ADD(stream->stnum_changes, last_st != stnum);
+
+    /* Frames missed, with the serial arithmetic of the roll over, a 
+     * sequence going back is a restart or a replay and not a gap */
+    if (last_st == stnum && (int32_t)(sqnum - last_sq) > 1)
+    {
+      METRICS_ADD(stream->gaps, sqnum - last_sq - 1);
+    }
+    else if ((int32_t)(stnum - last_st) > 0)
+    {
+      METRICS_ADD(stream->gaps, (stnum - last_st - 1) + sqnum);
+    }
+  }
+  __atomic_store_n(&stream->last_stnum, stnum, __ATOMIC_RELAXED);
+  __atomic_store_n(&stream->last_sqnum, sqnum, __ATOMIC_RELAXED);
+  __atomic_store_n(&stream->tal_ms, tal_ms, __ATOMIC_RELAXED);
+  __atomic_store_n(&stream->last_rx_ns, now_ns, __ATOMIC_RELAXED);
+  METRICS_ADD(stream->rx_frames, 1);
+}
+
+
+void metrics_rx_error(int iface)
+{
+  if (NULL != METRICS && iface >= 0 && iface < METRICS_MAX_IFACES)
+  {
+    METRICS_ADD(METRICS->iface[iface].decode_errors, 1);
+  }
+}
+
+
+void metrics_rx_drops(int iface, uint64_t drops)
+{
+  if (NULL != METRICS && iface >= 0 && iface < METRICS_MAX_IFACES)
+  {
+    __atomic_store_n(&METRICS->iface[iface].rx_drops, drops, 
+     __ATOMIC_RELAXED);
+  }
+}
+
+
+void metrics_auth(metrics_stream_t *stream, int result)
+{
+  /* Check parameters */
+  if (NULL == stream)
+  {
+    return;
+  }
+
+  if (-3 == result)
+  {
+    METRICS_ADD(stream->replayed, 1);
+  }
+  else if (-1 == result || -2 == result)
+  {
+    METRICS_ADD(stream->auth_failures, 1);
+  }
+}
+
+
+void metrics_latency(metrics_stream_t *stream, uint64_t ns)
+{
+  /* Check parameters */
+  if (NULL == stream)
+  {
+    return;
+  }
+
+  metrics_hist_add(stream->latency, ns);
+}
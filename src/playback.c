@@ -0,0 +1,236 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "playback.h"
+#include "goose.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+
+/*
+ * Function Definitions
+ */
+
+/**
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to sleep until an absolute deadline on the monotonic clock, 
+ * spinning for the last part of the wait when the playback asks to
+ */
+static void wait_until(const playback_t *pb, uint64_t deadline)
+{
+  /* Declare local variables */
+  struct timespec ts;                                /* Time to sleep until */
+  uint64_t wake = (deadline > pb->spin_ns) ? deadline - pb->spin_ns : 0;
+
+  ts.tv_sec = (time_t)(wake / 1000000000ULL);
+  ts.tv_nsec = (long)(wake % 1000000000ULL);
+  while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) 
+   && !pb->stop)
+  {
+    /* Resume the sleep if interrupted by anything other than a stop */
+  }
+
+  while (pb->spin_ns && now_ns() < deadline)
+  {
+    /* Spin for the remainder of the wait */
+  }
+}
+
+
+/**
+ * Function to copy a frame to be sent, rewriting its addresses and APPID
+ *
+ * @return int	0 on success, else -1 if the frame is too long to send
+ */
+static int playback_copy(const playback_t *pb, const capture_frame_t *frame, 
+  uint8_t *buf)
+{
+  /* Declare local variables */
+  uint8_t *payload = NULL;                 /* GOOSE or SV header, if any */
+  uint16_t ethertype = 0;                       /* Ethertype of the frame */
+
+  if (frame->caplen > MAX_FRAME_SIZE || frame->caplen < ETHER_HDR_LEN)
+  {
+    return -1;
+  }
+  memcpy(buf, frame->data, frame->caplen);
+  if (pb->set_dmac)
+  {
+    memcpy(buf, pb->dmac, 6);
+  }
+  if (pb->set_smac)
+  {
+    memcpy(buf + 6, pb->smac, 6);
+  }
+  if (pb->appid >= 0)
+  {
+    payload = (uint8_t *)get_ether_payload(buf, frame->caplen, &ethertype, 
+     NULL);
+    if (NULL != payload && (ETHER_GOOSE == ethertype || ETHER_SMV == ethertype)
+     && payload + 2 <= buf + frame->caplen)
+    {
+      payload[0] = (uint8_t)(pb->appid >> 8);
+      payload[1] = (uint8_t)pb->appid;
+    }
+  }
+
+  return 0;
+}
+
+
+void playback_init(playback_t *pb, const capture_t *cap)
+{
+  memset(pb, 0, sizeof(playback_t));
+  pb->cap = cap;
+  pb->speed = 1.0;
+  pb->batch_ns = PLAYBACK_BATCH_NS;
+  pb->appid = -1;
+}
+
+
+int playback_run(playback_t *pb, transport_t *tp)
+{
+  /* Check parameters */
+  if (NULL == pb || NULL == pb->cap || NULL == tp)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  uint8_t buf[TRANSPORT_BATCH_MAX][MAX_FRAME_SIZE];     /* Frames of a batch */
+  uint8_t *frames[TRANSPORT_BATCH_MAX];               /* Pointers to frames */
+  size_t lens[TRANSPORT_BATCH_MAX];                  /* Bytes of each frame */
+  uint64_t due[TRANSPORT_BATCH_MAX];              /* Deadline of each frame */
+  capture_frame_t frame;                             /* Next frame to send */
+  uint64_t offset = pb->offset ? pb->offset : pb->cap->start;  /* Next record */
+  uint64_t first_ns = 0;                  /* Receive time of the first frame */
+  uint64_t start = 0;                     /* Deadline of the first frame */
+  uint64_t deadline = 0;                         /* Deadline of next frame */
+  uint64_t done = 0;                            /* Time a batch was sent */
+  uint64_t horizon = 0;                  /* Latest deadline of the batch */
+  int count = 0;                                   /* Frames of the batch */
+  int sent = 0;                               /* Frames of the batch sent */
+  int rc = 0;                                    /* Result of each read */
+  int i = 0;                                              /* Frame index */
+
+  for (i = 0; i < TRANSPORT_BATCH_MAX; i++)
+  {
+    frames[i] = buf[i];
+  }
+  memset(&frame, 0, sizeof(capture_frame_t));
+  rc = capture_next(pb->cap, &offset, &frame);
+  first_ns = frame.ns;
+  start = now_ns() + PLAYBACK_START_NS;
+
+  while (1 == rc && !pb->stop)
+  {
+    /* Gather the frames due within the window of the first, or of now if 
+     * the first is late so that the playback catches up, the next read 
+     * ahead so that it starts the next batch */
+    count = 0;
+    deadline = start;
+    if (pb->speed > 0 && frame.ns > first_ns)
+    {
+      deadline += (uint64_t)((double)(frame.ns - first_ns) / pb->speed);
+    }
+    due[0] = deadline;
+    done = now_ns();
+    horizon = ((deadline > done) ? deadline : done) + pb->batch_ns;
+    do
+    {
+      if (0 != pb->until_ns && frame.ns > pb->until_ns)
+      {
+        rc = 0;
+        break;
+      }
+      if (0 == playback_copy(pb, &frame, buf[count]))
+      {
+        lens[count] = frame.caplen;
+        due[count++] = deadline;
+      }
+      else
+      {
+        pb->skipped++;
+      }
+      rc = capture_next(pb->cap, &offset, &frame);
+      deadline = start;
+      if (pb->speed > 0 && frame.ns > first_ns)
+      {
+        deadline += (uint64_t)((double)(frame.ns - first_ns) / pb->speed);
+      }
+    } while (1 == rc && count < TRANSPORT_BATCH_MAX 
+     && deadline <= horizon);
+    if (0 == count)
+    {
+      continue;
+    }
+
+    /* Send on the deadline of the first frame, at once if it has passed */
+    if (pb->speed > 0)
+    {
+      wait_until(pb, due[0]);
+    }
+    sent = transport_send_batch(tp, frames, lens, count);
+    done = now_ns();
+    sent = (sent < 0) ? 0 : sent;
+    pb->batches++;
+    pb->frames += (uint64_t)sent;
+    pb->errors += (uint64_t)(count - sent);
+    for (i = 0; i < count; i++)
+    {
+      pb->bytes += (i < sent) ? lens[i] : 0;
+      pb->early += (done < due[i]);
+      if (pb->speed > 0 && NULL != pb->error && pb->timed < pb->max_error)
+      {
+        pb->error[pb->timed++] = (done < due[i]) ? due[i] - done 
+         : done - due[i];
+      }
+    }
+  }
+  done = now_ns();
+  pb->duration = (done > start) ? done - start : 0;
+
+  /* Done */
+  return (-1 == rc) ? -1 : 0;
+}
@@ -0,0 +1,313 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "pool.h"
+#include "types.h"
+#include "utils.h"
+
+#include <pthread.h>
+#include <string.h>
+
+
+/*
+ * Global variables
+ */
+
+/** Buffers cached by a thread, for one pool at a time
+ */
+typedef struct _pool_cache_t_ {
+  frame_pool_t *pool;           /* Pool the buffers belong to, or NULL */
+  uint32_t len;                 /* Number of buffers cached */
+  uint32_t idx[POOL_CACHE_LEN]; /* Indices of the cached buffers */
+} pool_cache_t;
+
+static __thread pool_cache_t CACHE;
+
+/** Default pool */
+static frame_pool_t DEFAULT_POOL;
+static frame_pool_t *DEFAULT_POOL_PTR = NULL;
+static pthread_once_t DEFAULT_POOL_ONCE = PTHREAD_ONCE_INIT;
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to pop a buffer index off the shared free list
+ */
+static uint32_t pool_pop(frame_pool_t *pool)
+{
+  /* Declare local variables */
+  uint64_t old = __atomic_load_n(&pool->head, __ATOMIC_ACQUIRE);
+  uint64_t new = 0;                                 /* Replacement head */
+  uint32_t idx = 0;                                   /* Index popped */
+
+  do
+  {
+    idx = (uint32_t)old;
+    if (POOL_NIL == idx)
+    {
+      return POOL_NIL;
+    }
+    new = (((old >> 32) + 1) << 32) 
+     | __atomic_load_n(&pool->next[idx], __ATOMIC_RELAXED);
+  }
+  while (!__atomic_compare_exchange_n(&pool->head, &old, new, 1, 
+   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+  return idx;
+}
+
+
+/**
+ * Function to push a buffer index onto the shared free list
+ */
+static void pool_push(frame_pool_t *pool, uint32_t idx)
+{
+  /* Declare local variables */
+  uint64_t old = __atomic_load_n(&pool->head, __ATOMIC_RELAXED);
+  uint64_t new = 0;                                 /* Replacement head */
+
+  do
+  {
+    __atomic_store_n(&pool->next[idx], (uint32_t)old, __ATOMIC_RELAXED);
+    new = (((old >> 32) + 1) << 32) | idx;
+  }
+  while (!__atomic_compare_exchange_n(&pool->head, &old, new, 1, 
+   __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+
+int pool_init(frame_pool_t *pool, uint32_t count)
+{
+  /* Check parameters */
+  if (NULL == pool || 0 == count || POOL_NIL == count)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  uint32_t i = 0;                                         /* Buffer index */
+
+  memset(pool, 0, sizeof(frame_pool_t));
+  if (0 != posix_memalign((void **)&pool->base, POOL_ALIGN, 
+   (size_t)count * POOL_BUF_SIZE))
+  {
+    fprintf(stderr, "ERROR: unable to allocate memory\n");
+    return -1;
+  }
+  __atomic_fetch_add(&MALLOC_COUNT, 1, __ATOMIC_RELAXED);
+  MALLOC(pool->next, uint32_t, (size_t)count * sizeof(uint32_t));
+
+  /* Link every buffer onto the free list, lowest address first */
+  for (i = 0; i < count; i++)
+  {
+    pool->next[i] = (i + 1 < count) ? i + 1 : POOL_NIL;
+  }
+  pool->count = count;
+  pool->head = 0;
+
+  /* Done */
+  return 0;
+}
+
+
+void pool_destroy(frame_pool_t *pool)
+{
+  /* Check parameters */
+  if (NULL == pool)
+  {
+    return;
+  }
+
+  if (CACHE.pool == pool)
+  {
+    CACHE.pool = NULL;
+    CACHE.len = 0;
+  }
+  FREE(pool->base);
+  FREE(pool->next);
+  memset(pool, 0, sizeof(frame_pool_t));
+}
+
+
+/**
+ * Function to initialise the default pool, called once
+ */
+static void pool_default_init(void)
+{
+  if (0 == pool_init(&DEFAULT_POOL, POOL_DEFAULT_COUNT))
+  {
+    DEFAULT_POOL_PTR = &DEFAULT_POOL;
+  }
+}
+
+
+frame_pool_t *pool_default(void)
+{
+  pthread_once(&DEFAULT_POOL_ONCE, pool_default_init);
+  return DEFAULT_POOL_PTR;
+}
+
+
+uint8_t *pool_get(frame_pool_t *pool)
+{
+  /* Check parameters */
+  if (NULL == pool || NULL == pool->base)
+  {
+    return NULL;
+  }
+
+  /* Declare local variables */
+  uint32_t idx = POOL_NIL;                        /* Index of the buffer */
+
+  /* Adopt the pool if the cache of this thread is free */
+  if (NULL == CACHE.pool || (CACHE.pool != pool && 0 == CACHE.len))
+  {
+    CACHE.pool = pool;
+  }
+
+  if (CACHE.pool == pool)
+  {
+    /* Refill half the cache from the shared free list */
+    while (0 == CACHE.len || CACHE.len < POOL_CACHE_LEN / 2)
+    {
+      idx = pool_pop(pool);
+      if (POOL_NIL == idx)
+      {
+        break;
+      }
+      CACHE.idx[CACHE.len++] = idx;
+    }
+    idx = (CACHE.len > 0) ? CACHE.idx[--CACHE.len] : POOL_NIL;
+  }
+  else
+  {
+    idx = pool_pop(pool);
+  }
+
+  if (POOL_NIL == idx)
+  {
+    __atomic_fetch_add(&pool->exhausted, 1, __ATOMIC_RELAXED);
+    return NULL;
+  }
+  return pool->base + (size_t)idx * POOL_BUF_SIZE;
+}
+
+
+void pool_put(frame_pool_t *pool, uint8_t *buf)
+{
+  /* Check parameters */
+  if (NULL == pool || NULL == buf || buf < pool->base 
+   || buf >= pool->base + (size_t)pool->count * POOL_BUF_SIZE 
+   || 0 != (size_t)(buf - pool->base) % POOL_BUF_SIZE)
+  {
+    return;
+  }
+
+  /* Declare local variables */
+  uint32_t idx = (uint32_t)((size_t)(buf - pool->base) / POOL_BUF_SIZE);
+
+  if (CACHE.pool != pool)
+  {
+    pool_push(pool, idx);
+    return;
+  }
+
+  /* Return half the cache to the shared free list when it is full */
+  if (POOL_CACHE_LEN == CACHE.len)
+  {
+    while (CACHE.len > POOL_CACHE_LEN / 2)
+    {
+      pool_push(pool, CACHE.idx[--CACHE.len]);
+    }
+  }
+  CACHE.idx[CACHE.len++] = idx;
+}
+
+
+void pool_flush_cache(void)
+{
+  while (NULL != CACHE.pool && CACHE.len > 0)
+  {
+    pool_push(CACHE.pool, CACHE.idx[--CACHE.len]);
+  }
+  CACHE.pool = NULL;
+}
+
+
+void arena_init(arena_t *arena, void *buf, size_t size)
+{
+  /* Check parameters */
+  if (NULL == arena)
+  {
+    return;
+  }
+
+  arena->base = (uint8_t *)buf;
+  arena->size = (NULL == buf) ? 0 : size;
+  arena->used = 0;
+}
+
+
+void *arena_alloc(arena_t *arena, size_t size, size_t align)
+{
+  /* Check parameters */
+  if (NULL == arena || 0 == align || 0 != (align & (align - 1)))
+  {
+    return NULL;
+  }
+
+  /* Declare local variables */
+  size_t offset = 0;                      /* Aligned offset of allocation */
+
+  offset = ((uintptr_t)(arena->base + arena->used) + (align - 1)) 
+   & ~(uintptr_t)(align - 1);
+  offset -= (uintptr_t)arena->base;
+  if (offset > arena->size || size > arena->size - offset)
+  {
+    return NULL;
+  }
+
+  arena->used = offset + size;
+  return arena->base + offset;
+}
+
+
+void arena_reset(arena_t *arena)
+{
+  if (NULL != arena)
+  {
+    arena->used = 0;
+  }
+}
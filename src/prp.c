@@ -0,0 +1,243 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "goose.h"
+#include "prp.h"
+#include "types.h"
+#include "utils.h"
+
+#include <string.h>
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return the length of the ethernet header of a frame, which is 
+ * not part of the LSDU, including any 802.1Q tag
+ */
+static size_t prp_hdr_len(const uint8_t *frame)
+{
+  return (((frame[12] << 8) | frame[13]) == GOOSE_TPID) 
+   ? ETHER_HDR_LEN + VLAN_TAG_LEN : ETHER_HDR_LEN;
+}
+
+
+size_t prp_append_rct(uint8_t *frame, size_t len, uint16_t seq, uint8_t lan)
+{
+  /* Check parameters */
+  if (NULL == frame || len < ETHER_HDR_LEN + VLAN_TAG_LEN)
+  {
+    return 0;
+  }
+
+  /* Declare local variables */
+  size_t lsdu = 0;                      /* LSDU size, including the trailer */
+  uint8_t *rct = NULL;                              /* Pointer to trailer */
+
+  /* Pad so that the trailer is the last thing in a minimum size frame */
+  if (len + PRP_RCT_LEN < PRP_MIN_FRAME_LEN)
+  {
+    memset(frame + len, 0, PRP_MIN_FRAME_LEN - PRP_RCT_LEN - len);
+    len = PRP_MIN_FRAME_LEN - PRP_RCT_LEN;
+  }
+  lsdu = len + PRP_RCT_LEN - prp_hdr_len(frame);
+  if (lsdu > 0x0fff)
+  {
+    return 0;
+  }
+
+  rct = frame + len;
+  rct[0] = (uint8_t)(seq >> 8);
+  rct[1] = (uint8_t)(seq & 0xff);
+  rct[2] = (uint8_t)((lan << 4) | (lsdu >> 8));
+  rct[3] = (uint8_t)(lsdu & 0xff);
+  rct[4] = (uint8_t)(PRP_SUFFIX >> 8);
+  rct[5] = (uint8_t)(PRP_SUFFIX & 0xff);
+
+  /* Done */
+  return len + PRP_RCT_LEN;
+}
+
+
+void prp_set_lan(uint8_t *frame, size_t len, uint8_t lan)
+{
+  /* Check parameters */
+  if (NULL == frame || len < PRP_MIN_FRAME_LEN)
+  {
+    return;
+  }
+
+  frame[len - 4] = (uint8_t)((lan << 4) | (frame[len - 4] & 0x0f));
+}
+
+
+int prp_get_rct(const uint8_t *packet, size_t caplen, uint16_t *seq, 
+ uint8_t *lan)
+{
+  /* Check parameters */
+  if (NULL == packet || NULL == seq || NULL == lan 
+   || caplen < PRP_MIN_FRAME_LEN)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  const uint8_t *rct = packet + caplen - PRP_RCT_LEN;  /* Pointer to trailer */
+
+  if ((((rct[4] << 8) | rct[5]) != PRP_SUFFIX) 
+   || ((size_t)(((rct[2] & 0x0f) << 8) | rct[3]) 
+   != caplen - prp_hdr_len(packet)))
+  {
+    return -1;
+  }
+
+  *seq = (uint16_t)((rct[0] << 8) | rct[1]);
+  *lan = (uint8_t)(rct[2] >> 4);
+
+  /* Done */
+  return 0;
+}
+
+
+int prp_init(prp_table_t *table, size_t max_nodes)
+{
+  /* Check parameters */
+  if (NULL == table || 0 == max_nodes)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  size_t slots = 2;                                    /* Number of slots */
+
+  while (slots < 2 * max_nodes)
+  {
+    slots <<= 1;
+  }
+
+  memset(table, 0, sizeof(prp_table_t));
+  MALLOC(table->nodes, prp_node_t, slots * sizeof(prp_node_t));
+  memset(table->nodes, 0, slots * sizeof(prp_node_t));
+  table->mask = slots - 1;
+  table->max_nodes = max_nodes;
+
+  /* Done */
+  return 0;
+}
+
+
+void prp_free(prp_table_t *table)
+{
+  /* Check parameters */
+  if (NULL == table)
+  {
+    return;
+  }
+
+  FREE(table->nodes);
+  table->nodes = NULL;
+  table->mask = 0;
+  table->count = 0;
+}
+
+
+prp_verdict_t prp_discard(prp_table_t *table, const uint8_t *packet, 
+ size_t caplen, uint8_t lan, size_t *len)
+{
+  /* Declare local variables */
+  prp_node_t *node = NULL;                        /* Slot of the source */
+  uint64_t mac = 0;                           /* Source MAC, in 48 bits */
+  uint64_t dup = 0;                      /* 1 if the frame is a duplicate */
+  uint16_t seq = 0;                        /* Sequence number of the frame */
+  uint8_t rct_lan = 0;                       /* LAN named in the trailer */
+  int16_t ahead = 0;           /* Sequence numbers ahead of the newest frame */
+  size_t i = 0;                                      /* Index of the slot */
+
+  *len = caplen;
+  if (0 != prp_get_rct(packet, caplen, &seq, &rct_lan))
+  {
+    table->no_rct++;
+    return PRP_NO_RCT;
+  }
+  *len = caplen - PRP_RCT_LEN;
+  table->lan[PRP_LAN_B == lan]++;
+  table->wrong_lan += (rct_lan != lan);
+
+  /* Find the source, a multiplicative hash spreads the vendor prefix */
+  mac = ((uint64_t)packet[6] << 40) | ((uint64_t)packet[7] << 32) 
+   | ((uint64_t)packet[8] << 24) | ((uint64_t)packet[9] << 16) 
+   | ((uint64_t)packet[10] << 8) | packet[11];
+  i = (size_t)((mac * 0x9e3779b97f4a7c15ULL) >> 32) & table->mask;
+  while (table->nodes[i].key && (table->nodes[i].key >> 16) != mac)
+  {
+    i = (i + 1) & table->mask;
+  }
+  node = &table->nodes[i];
+
+  if (0 == node->key)
+  {
+    if (table->count == table->max_nodes || 0 == mac)
+    {
+      table->untracked++;
+      table->accepted++;
+      return PRP_ACCEPT;
+    }
+    table->count++;
+    node->key = (mac << 16) | seq;
+    node->window = 1;
+    table->accepted++;
+    return PRP_ACCEPT;
+  }
+
+  /* Slide the window forward to a newer frame, or resynchronise on a frame 
+   * too far behind, which is a restarted source rather than a late copy */
+  ahead = (int16_t)(seq - (uint16_t)node->key);
+  if (ahead > 0 || ahead <= -PRP_WINDOW)
+  {
+    node->window = (ahead > 0 && ahead < PRP_WINDOW) 
+     ? (node->window << ahead) | 1 : 1;
+    node->key = (mac << 16) | seq;
+    table->accepted++;
+    return PRP_ACCEPT;
+  }
+
+  /* Within the window, the bit says if the other copy was seen */
+  dup = (node->window >> -ahead) & 1;
+  node->window |= 1ULL << -ahead;
+  table->duplicates += dup;
+  table->accepted += dup ^ 1;
+
+  /* Done */
+  return dup ? PRP_DUPLICATE : PRP_ACCEPT;
+}
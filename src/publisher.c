@@ -30,11 +30,25 @@
  */
 
 #include "goose.h"
+#include "log.h"
+#include "pool.h"
+#include "probes.h"
+#include "prp.h"
 #include "publisher.h"
+#include "sv.h"
+#include "transport.h"
 #include "types.h"
+#include "uring.h"
 #include "utils.h"
 
 #include <pcap.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <sys/socket.h>
 
 
 
@@ -44,18 +58,143 @@
  * Constants
  */
 
+/**
+ * Time to wait for the kernel transmit timestamp of a frame, in ms
+ */
+#define TX_STAMP_WAIT_MS 1
+
 
 
 
 /**
- * Function to publish a GOOSE frame to a packet capture descriptor.
- * The timestamp on the frame is updated prior to publishing.
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t mono_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to read the transmit timestamps queued on the error queue of a 
+ * socket, returning the last one on the monotonic clock
  *
- * @param goose_frame_t	pointer to a GOOSE frame type struct
- * @param pcap_t	pointer to packet capture descriptor
- * @return int	-1 on error, else 0
+ * @param fd	socket with timestamping enabled
+ * @return uint64_t	monotonic time of the last timestamp in ns, else 0 if 
+ * 			none was queued
  */
-int publish(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr) {
+static uint64_t tx_stamp_read(int fd)
+{
+  /* Declare local variables */
+  char control[CMSG_SPACE(sizeof(struct scm_timestamping)) 
+   + CMSG_SPACE(sizeof(struct sock_extended_err) + 64)]; /* Ancillary data */
+  struct msghdr msg;                              /* Message read */
+  struct cmsghdr *cmsg = NULL;                    /* Ancillary data item */
+  struct scm_timestamping tss;                    /* Kernel timestamps */
+  struct timespec real;                           /* Realtime clock */
+  struct timespec mono;                           /* Monotonic clock */
+  uint64_t stamp = 0;                  /* Realtime of the last stamp in ns */
+
+  /* The stamps carry no payload (SOF_TIMESTAMPING_OPT_TSONLY), only the 
+   * ancillary data is read */
+  for (;;)
+  {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+    {
+      break;
+    }
+    for (cmsg = CMSG_FIRSTHDR(&msg); NULL != cmsg; 
+     cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+      if (SOL_SOCKET == cmsg->cmsg_level 
+       && SCM_TIMESTAMPING == cmsg->cmsg_type)
+      {
+        memcpy(&tss, CMSG_DATA(cmsg), sizeof(tss));
+        stamp = (uint64_t)tss.ts[0].tv_sec * 1000000000ULL 
+         + (uint64_t)tss.ts[0].tv_nsec;
+      }
+    }
+  }
+  if (0 == stamp)
+  {
+    return 0;
+  }
+
+  /* Software stamps are on the realtime clock, move the stamp to the 
+   * monotonic clock using the offset between the two now */
+  clock_gettime(CLOCK_REALTIME, &real);
+  clock_gettime(CLOCK_MONOTONIC, &mono);
+  return stamp - ((uint64_t)real.tv_sec * 1000000000ULL 
+   + (uint64_t)real.tv_nsec) + ((uint64_t)mono.tv_sec * 1000000000ULL 
+   + (uint64_t)mono.tv_nsec);
+}
+
+
+/**
+ * Function to wait for the transmit timestamp of the frame just sent. The 
+ * stamp is taken when the driver is handed the frame, which is normally 
+ * before the send call returns, but a queueing discipline can delay it.
+ *
+ * @param stamp	pointer to the timestamping state
+ * @return uint64_t	monotonic time of the stamp in ns, else 0 if it did 
+ * 			not arrive within TX_STAMP_WAIT_MS
+ */
+static uint64_t tx_stamp_wait(tx_stamp_t *stamp)
+{
+  /* Declare local variables */
+  struct pollfd pfd = { .fd = stamp->fd, .events = 0, .revents = 0 };
+  uint64_t wire = 0;                               /* Time of the stamp */
+
+  /* The error queue is signalled by POLLERR, which need not be requested */
+  if (1 == poll(&pfd, 1, TX_STAMP_WAIT_MS) && (pfd.revents & POLLERR))
+  {
+    wire = tx_stamp_read(stamp->fd);
+  }
+  stamp->pending = (0 == wire);
+
+  return wire;
+}
+
+
+int tx_stamp_enable(tx_stamp_t *stamp, pcap_t *pcap_ptr)
+{
+  /* Check parameters */
+  if (NULL == stamp || NULL == pcap_ptr)
+  {
+    fprintf(stderr, "ERROR: interface not initialised\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  int flags = SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE 
+   | SOF_TIMESTAMPING_OPT_TSONLY;                  /* Timestamps requested */
+
+  stamp->fd = pcap_get_selectable_fd(pcap_ptr);
+  stamp->pending = 0;
+  if (stamp->fd < 0 || 0 != setsockopt(stamp->fd, SOL_SOCKET, 
+   SO_TIMESTAMPING, &flags, sizeof(flags)))
+  {
+    stamp->fd = -1;
+    return -1;
+  }
+
+  /* Done */
+  return 0;
+}
+
+
+/**
+ * Function to publish a GOOSE frame, see publish_at(), with t stamped from 
+ * the realtime clock if now is non-zero
+ */
+static int publish_frame(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr, 
+ uint64_t deadline, tx_stamp_t *stamp, publish_timing_t *timing, int now) {
   /* Check paramaters */
   if (NULL == goose_frame_ptr) {
     fprintf(stderr, "ERROR: GOOSE frame not initialised\n");
@@ -69,30 +208,317 @@ int publish(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr) {
 
   /* Declare local variables */
   int bytes_published = -1;  /* Number of bytes written to network interface */
-  uint8_t buff[MAX_FRAME_SIZE] = {0};     /* Buffer to hold the encoded data */
+  frame_pool_t *pool = pool_default();           /* Pool of frame buffers */
+  uint8_t *buff = NULL;                   /* Buffer to hold the encoded data */
   uint16_t len = 0;                          /* Length of the encoded buffer */
+  publish_timing_t times = { deadline, 0, 0, 0 };   /* Times of this frame */
+  int timed = (0 != deadline || NULL != timing);  /* Non-zero to read clocks */
+  transport_t tp;                        /* Transport of the descriptor */
 
-  /* Update timestamp on frame */
-  gettimeofday(&(goose_frame_ptr->goose_pdu.t->timeval), NULL);
+  transport_pcap_attach(&tp, pcap_ptr);
+
+  GOOSE_PROBE(publish_start, ntohs(goose_frame_ptr->goose_header.appid), 
+   goose_frame_ptr->goose_pdu.stNum, goose_frame_ptr->goose_pdu.sqNum);
+
+  /* Discard a stamp that arrived after its frame was given up on, so that it 
+   * is not taken as the stamp of this frame */
+  if (NULL != stamp && stamp->fd >= 0 && stamp->pending) {
+    tx_stamp_read(stamp->fd);
+    stamp->pending = 0;
+  }
+
+  /* Take a cache-line aligned buffer from the pool, the encoder writes every 
+   * byte it sends so the buffer is not cleared */
+  buff = pool_get(pool);
+  if (NULL == buff) {
+    fprintf(stderr, "ERROR: no frame buffer available\n");
+    return -1;
+  }
 
   /* Encode the GOOSE frame for transmission */
-  encode_goose_frame(goose_frame_ptr, (uint8_t *)&buff, &len);
+  if (now) {
+    encode_goose_frame_now(goose_frame_ptr, buff, &len);
+  } else {
+    encode_goose_frame(goose_frame_ptr, buff, &len);
+  }
   if (len == 0) /* Check if the frame was encoded */
   { 
     fprintf( stderr, "ERROR: could not encode GOOSE frame\n" );
+    pool_put(pool, buff);
+    return -1;
+  }
+
+  /* Append the protected checksum if the frame is authenticated */
+  if (goose_frame_ptr->sec 
+   && 0 != sign_goose_frame(goose_frame_ptr->sec, buff, &len))
+  {
+    fprintf( stderr, "ERROR: could not sign GOOSE frame\n" );
+    pool_put(pool, buff);
     return -1;
   }
+  times.encoded = timed ? mono_ns() : 0;
 
-  bytes_published = pcap_inject(pcap_ptr, (const void *)&buff, (size_t)len);
+  /* The frame is copied by the time the send returns, so release the 
+   * buffer */
+  bytes_published = (0 == transport_send(&tp, buff, len)) ? (int)len : -1;
+  times.sent = timed ? mono_ns() : 0;
+  GOOSE_PROBE(publish, ntohs(goose_frame_ptr->goose_header.appid), 
+   goose_frame_ptr->goose_pdu.stNum, goose_frame_ptr->goose_pdu.sqNum, len, 
+   bytes_published);
+  pool_put(pool, buff);
+  metrics_tx(goose_frame_ptr->metrics, len, -1 != bytes_published);
   if (bytes_published == -1) {
     fprintf(stderr, "ERROR: could not inject frame\n");
     return -1;
-  }// else {
-    // TODO: Implement checking for verbosity level to output details
-    //hex_dump(buff, len);
-    //fprintf(stdout, "%d bytes published\n", bytes_published);
-  //}
+  }
+  LOG_EVENT(LOG_EV_INJECTED, bytes_published);
+
+  /* Record when the frame went out against when it was due */
+  if (NULL != stamp && stamp->fd >= 0) {
+    times.wire = tx_stamp_wait(stamp);
+  }
+  if (0 != deadline) {
+    metrics_jitter(goose_frame_ptr->metrics, deadline, times.sent, 
+     times.wire);
+  }
+  if (NULL != timing) {
+    *timing = times;
+  }
+
+  /* Done */
+  return 0;
+}
+
+
+/**
+ * Function to publish a GOOSE frame to a packet capture descriptor.
+ * The frame carries the t set by the caller, the time of the last state 
+ * change, so that retransmissions of a state are identical but for sqNum.
+ *
+ * @param goose_frame_t	pointer to a GOOSE frame type struct
+ * @param pcap_t	pointer to packet capture descriptor
+ * @return int	-1 on error, else 0
+ */
+int publish(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr) {
+  return publish_frame(goose_frame_ptr, pcap_ptr, 0, NULL, NULL, 0);
+}
+
+
+int publish_now(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr) {
+  return publish_frame(goose_frame_ptr, pcap_ptr, 0, NULL, NULL, 1);
+}
+
+
+int publish_at(goose_frame_t *goose_frame_ptr, pcap_t *pcap_ptr, 
+ uint64_t deadline, tx_stamp_t *stamp, publish_timing_t *timing) {
+  return publish_frame(goose_frame_ptr, pcap_ptr, deadline, stamp, timing, 0);
+}
+
+
+int publish_uring(goose_frame_t *goose_frame_ptr, uring_tx_t *tx) {
+  /* Check paramaters */
+  if (NULL == goose_frame_ptr) {
+    fprintf(stderr, "ERROR: GOOSE frame not initialised\n");
+    return -1;
+  }
+
+  if (NULL == tx) {
+    fprintf(stderr, "ERROR: transmit ring not initialised\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  uint8_t *buff = NULL;       /* Registered buffer to hold the encoded data */
+  uint16_t len = 0;                          /* Length of the encoded buffer */
+  int ret = 0;                             /* Result of queuing the frame */
+
+  /* Get a registered frame buffer, this may reap completed frames */
+  buff = uring_tx_frame(tx);
+  if (NULL == buff) {
+    fprintf(stderr, "ERROR: no transmit buffer available\n");
+    return -1;
+  }
+
+  /* Encode the GOOSE frame straight into the registered buffer */
+  encode_goose_frame(goose_frame_ptr, buff, &len);
+  if (len == 0) /* Check if the frame was encoded */
+  { 
+    fprintf( stderr, "ERROR: could not encode GOOSE frame\n" );
+    uring_tx_release(tx, buff);            /* Return the unused buffer */
+    return -1;
+  }
+
+  /* Append the protected checksum if the frame is authenticated */
+  if (goose_frame_ptr->sec 
+   && 0 != sign_goose_frame(goose_frame_ptr->sec, buff, &len))
+  {
+    fprintf( stderr, "ERROR: could not sign GOOSE frame\n" );
+    uring_tx_release(tx, buff);            /* Return the unused buffer */
+    return -1;
+  }
+
+  /* Queue for the next submission */
+  ret = uring_tx_queue(tx, buff, len);
+  metrics_tx(goose_frame_ptr->metrics, len, 0 == ret);
+  return ret;
+}
+
+
+int publish_sv(const sv_frame_t *sv_frame_ptr, uint8_t *encoded_data, 
+ uint16_t len, pcap_t *pcap_ptr) {
+  /* Check paramaters */
+  if (NULL == sv_frame_ptr || NULL == encoded_data || 0 == len) {
+    fprintf(stderr, "ERROR: sampled values frame not initialised\n");
+    return -1;
+  }
+
+  if (NULL == pcap_ptr) {
+    fprintf(stderr, "ERROR: interface not initialised\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  transport_t tp;                        /* Transport of the descriptor */
+
+  /* Update the samples in place */
+  patch_sv_frame(sv_frame_ptr, encoded_data);
+
+  transport_pcap_attach(&tp, pcap_ptr);
+  if (0 != transport_send(&tp, encoded_data, len)) {
+    fprintf(stderr, "ERROR: could not inject frame\n");
+    return -1;
+  }
 
   /* Done */
   return 0;
 }
+
+
+int publish_prp(goose_frame_t *goose_frame_ptr, pcap_t *lan_a, pcap_t *lan_b, 
+ uint16_t *seq) {
+  /* Check paramaters */
+  if (NULL == goose_frame_ptr || NULL == seq) {
+    fprintf(stderr, "ERROR: GOOSE frame not initialised\n");
+    return -1;
+  }
+
+  if (NULL == lan_a || NULL == lan_b) {
+    fprintf(stderr, "ERROR: interface not initialised\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  frame_pool_t *pool = pool_default();           /* Pool of frame buffers */
+  uint8_t *buff = NULL;                   /* Buffer to hold the encoded data */
+  uint16_t len = 0;                          /* Length of the encoded buffer */
+  size_t prp_len = 0;                     /* Length including the trailer */
+  int sent = 0;                       /* Number of LANs the frame is sent on */
+  transport_t tp[2];                        /* Transport of each LAN */
+
+  transport_pcap_attach(&tp[0], lan_a);
+  transport_pcap_attach(&tp[1], lan_b);
+
+  buff = pool_get(pool);
+  if (NULL == buff) {
+    fprintf(stderr, "ERROR: no frame buffer available\n");
+    return -1;
+  }
+
+  /* Encode and sign the frame once for both LANs */
+  encode_goose_frame(goose_frame_ptr, buff, &len);
+  if (0 == len || (goose_frame_ptr->sec 
+   && 0 != sign_goose_frame(goose_frame_ptr->sec, buff, &len))) {
+    fprintf(stderr, "ERROR: could not encode GOOSE frame\n");
+    pool_put(pool, buff);
+    return -1;
+  }
+
+  prp_len = prp_append_rct(buff, len, *seq, PRP_LAN_A);
+  if (0 == prp_len) {
+    fprintf(stderr, "ERROR: frame too long for redundancy trailer\n");
+    pool_put(pool, buff);
+    return -1;
+  }
+  (*seq)++;
+
+  /* A failure on one LAN is what the other LAN is there for, so only 
+   * report an error if the frame did not leave on either */
+  sent += (0 == transport_send(&tp[0], buff, prp_len));
+  prp_set_lan(buff, prp_len, PRP_LAN_B);
+  sent += (0 == transport_send(&tp[1], buff, prp_len));
+  pool_put(pool, buff);
+  metrics_tx(goose_frame_ptr->metrics, prp_len, sent > 0);
+  if (0 == sent) {
+    fprintf(stderr, "ERROR: could not inject frame on either LAN\n");
+    return -1;
+  }
+
+  /* Done */
+  return 0;
+}
+
+
+int publish_transport(goose_frame_t *const *goose_frames, int count, 
+ transport_t *tp) {
+  /* Check paramaters */
+  if (NULL == goose_frames || count < 0 || count > TRANSPORT_BATCH_MAX) {
+    fprintf(stderr, "ERROR: GOOSE frames not initialised\n");
+    return -1;
+  }
+
+  if (NULL == tp) {
+    fprintf(stderr, "ERROR: transport not initialised\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  frame_pool_t *pool = pool_default();           /* Pool of frame buffers */
+  uint8_t *buff[TRANSPORT_BATCH_MAX];    /* Buffers holding the encoded data */
+  size_t lens[TRANSPORT_BATCH_MAX];         /* Lengths of the encoded data */
+  goose_frame_t *frame = NULL;                       /* Frame being encoded */
+  uint16_t len = 0;                          /* Length of the encoded buffer */
+  int encoded = 0;                          /* Number of frames encoded */
+  int sent = 0;                                /* Number of frames sent */
+  int i = 0;                                              /* Frame index */
+
+  for (encoded = 0; encoded < count; encoded++) {
+    frame = goose_frames[encoded];
+    buff[encoded] = pool_get(pool);
+    if (NULL == buff[encoded]) {
+      fprintf(stderr, "ERROR: no frame buffer available\n");
+      break;
+    }
+    GOOSE_PROBE(publish_start, ntohs(frame->goose_header.appid), 
+     frame->goose_pdu.stNum, frame->goose_pdu.sqNum);
+    encode_goose_frame(frame, buff[encoded], &len);
+    if (0 == len || (frame->sec 
+     && 0 != sign_goose_frame(frame->sec, buff[encoded], &len))) {
+      fprintf(stderr, "ERROR: could not encode GOOSE frame\n");
+      pool_put(pool, buff[encoded]);
+      break;
+    }
+    lens[encoded] = len;
+  }
+
+  /* Send what was encoded, the buffers are copied by the time the batch 
+   * returns */
+  sent = (encoded > 0) ? transport_send_batch(tp, buff, lens, encoded) : 0;
+  for (i = 0; i < encoded; i++) {
+    frame = goose_frames[i];
+    pool_put(pool, buff[i]);
+    metrics_tx(frame->metrics, lens[i], i < sent);
+    GOOSE_PROBE(publish, ntohs(frame->goose_header.appid), 
+     frame->goose_pdu.stNum, frame->goose_pdu.sqNum, lens[i], 
+     (i < sent) ? (int)lens[i] : -1);
+    if (i < sent) {
+      LOG_EVENT(LOG_EV_INJECTED, lens[i]);
+    }
+  }
+  if (sent < 0 || (count > 0 && 0 == sent)) {
+    fprintf(stderr, "ERROR: could not send frames\n");
+    return -1;
+  }
+
+  /* Done */
+  return sent;
+}
@@ -0,0 +1,563 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "capindex.h"
+#include "recorder.h"
+#include "types.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/*
+ * Constants
+ */
+
+/** Number of segments the capture thread may hand to the worker before it 
+ * waits for the worker to close them
+ */
+#define RECORDER_RETIRED 4
+
+/** State of the next segment, opened ahead by the worker
+ */
+#define RECORDER_NEXT_NONE 0
+#define RECORDER_NEXT_READY 1
+#define RECORDER_NEXT_FAILED 2
+
+
+
+/*
+ * Types
+ */
+
+/** Segment handed between the capture thread and the worker
+ */
+typedef struct _recorder_seg_t_ {
+  unsigned int seq;                 /* Sequence number of the segment */
+  int fd;                           /* Descriptor of the segment */
+  uint8_t *map;                     /* Mapping of the segment */
+  size_t used;                      /* Bytes written to the segment */
+} recorder_seg_t;
+
+
+/** State of the worker of a recorder, every field is guarded by the lock
+ */
+typedef struct _recorder_worker_t_ {
+  pthread_t thread;                 /* Worker thread */
+  pthread_mutex_t lock;             /* Guards the fields below */
+  pthread_cond_t cond;              /* Signalled on any change of them */
+  int stop;                         /* Non-zero to stop once idle */
+  int state;                        /* RECORDER_NEXT_NONE, _READY or _FAILED */
+  unsigned int next_seq;            /* Sequence number to open next */
+  recorder_seg_t next;              /* Segment opened ahead, when ready */
+  recorder_seg_t retired[RECORDER_RETIRED];  /* Segments to close */
+  unsigned int head;                /* Segments handed to the worker */
+  unsigned int tail;                /* Segments closed by the worker */
+} recorder_worker_t;
+
+
+
+/*
+ * Function Definitions
+ */
+
+/**
+ * Function to round a length up to the 32 bit boundary of pcapng blocks
+ */
+static inline size_t pcapng_pad(size_t len)
+{
+  return (len + 3) & ~(size_t)3;
+}
+
+
+/**
+ * Function to store a 32 bit value in host order, the byte order of the 
+ * section
+ */
+static inline uint8_t *put32(uint8_t *ptr, uint32_t value)
+{
+  memcpy(ptr, &value, 4);
+  return ptr + 4;
+}
+
+
+/**
+ * Function to store a 16 bit value in host order
+ */
+static inline uint8_t *put16(uint8_t *ptr, uint16_t value)
+{
+  memcpy(ptr, &value, 2);
+  return ptr + 2;
+}
+
+
+/**
+ * Function to write the section header and interface description blocks 
+ * that start each segment
+ *
+ * @return size_t	number of bytes written
+ */
+static size_t pcapng_header(const recorder_t *rec, uint8_t *buf)
+{
+  /* Declare local variables */
+  uint8_t *ptr = buf;                                   /* Next byte out */
+  size_t name_len = strlen(rec->iface);        /* Length of if_name */
+  uint32_t idb_len = 0;                           /* Bytes of the IDB */
+
+  /* Section header, of unknown length as the segment is still written */
+  ptr = put32(ptr, PCAPNG_SHB);
+  ptr = put32(ptr, 28);
+  ptr = put32(ptr, PCAPNG_MAGIC);
+  ptr = put16(ptr, 1);
+  ptr = put16(ptr, 0);
+  ptr = put32(ptr, 0xffffffff);
+  ptr = put32(ptr, 0xffffffff);
+  ptr = put32(ptr, 28);
+
+  /* Ethernet interface with if_name and if_tsresol of 10^-9 s */
+  idb_len = (uint32_t)(20 + 4 + pcapng_pad(name_len) + 8 + 4);
+  ptr = put32(ptr, PCAPNG_IDB);
+  ptr = put32(ptr, idb_len);
+  ptr = put16(ptr, 1);                                 /* LINKTYPE_ETHERNET */
+  ptr = put16(ptr, 0);
+  ptr = put32(ptr, RECORDER_SNAPLEN);
+  ptr = put16(ptr, 2);                                           /* if_name */
+  ptr = put16(ptr, (uint16_t)name_len);
+  memset(ptr, 0, pcapng_pad(name_len));
+  memcpy(ptr, rec->iface, name_len);
+  ptr += pcapng_pad(name_len);
+  ptr = put16(ptr, 9);                                        /* if_tsresol */
+  ptr = put16(ptr, 1);
+  ptr = put32(ptr, 9);
+  ptr = put32(ptr, 0);                                       /* opt_endofopt */
+  ptr = put32(ptr, idb_len);
+
+  /* Done */
+  return (size_t)(ptr - buf);
+}
+
+
+void recorder_path(const recorder_t *rec, unsigned int seq, char *path, 
+ size_t len)
+{
+  snprintf(path, len, "%s-%06u.pcapng", rec->prefix, seq);
+}
+
+
+/**
+ * Function to allocate, map and start a segment, deleting the oldest segment 
+ * kept. This and closing a segment are the system calls of a rotation, both 
+ * made on the worker once the first segment is open.
+ *
+ * @return int	0 on success, else -1
+ */
+static int recorder_segment(const recorder_t *rec, recorder_seg_t *seg, 
+ unsigned int seq)
+{
+  /* Declare local variables */
+  char path[RECORDER_PATH_LEN + 32];                 /* Path of the segment */
+  void *map = MAP_FAILED;                         /* Mapping of the segment */
+  int err = 0;                                  /* Result of the allocation */
+
+  recorder_path(rec, seq, path, sizeof(path));
+  seg->seq = seq;
+  seg->fd = open(path, O_CREAT | O_RDWR | O_TRUNC, 
+   S_IRUSR | S_IWUSR | S_IRGRP);
+  if (-1 == seg->fd)
+  {
+    fprintf(stderr, "ERROR: could not create segment %s (%s)\n", path, 
+     strerror(errno));
+    return -1;
+  }
+
+  /* Allocate the blocks now, so that a full disk fails here rather than as 
+   * a SIGBUS on a frame, and map them in so appending does not fault */
+  err = posix_fallocate(seg->fd, 0, (off_t)rec->seg_size);
+  if (EOPNOTSUPP == err || EINVAL == err)
+  {
+    err = (0 == ftruncate(seg->fd, (off_t)rec->seg_size)) ? 0 : errno;
+  }
+  if (0 == err)
+  {
+    map = mmap(NULL, rec->seg_size, PROT_READ | PROT_WRITE, 
+     MAP_SHARED | MAP_POPULATE, seg->fd, 0);
+    err = (MAP_FAILED == map) ? errno : 0;
+  }
+  if (0 != err)
+  {
+    fprintf(stderr, "ERROR: could not allocate segment %s (%s)\n", path, 
+     strerror(err));
+    close(seg->fd);
+    unlink(path);
+    seg->fd = -1;
+    return -1;
+  }
+  madvise(map, rec->seg_size, MADV_SEQUENTIAL);
+
+  seg->map = (uint8_t *)map;
+  seg->used = pcapng_header(rec, seg->map);
+
+  /* Done */
+  return 0;
+}
+
+
+/**
+ * Function to unmap a segment and cut it to the blocks written
+ */
+static void recorder_segment_close(const recorder_t *rec, recorder_seg_t *seg)
+{
+  /* Declare local variables */
+  char path[RECORDER_PATH_LEN + 32];                 /* Path of the segment */
+
+  if (NULL == seg->map)
+  {
+    return;
+  }
+  munmap(seg->map, rec->seg_size);
+  seg->map = NULL;
+  if (0 != ftruncate(seg->fd, (off_t)seg->used))
+  {
+    fprintf(stderr, "ERROR: could not truncate segment %u\n", seg->seq);
+  }
+  close(seg->fd);
+  seg->fd = -1;
+
+  if (NULL != rec->on_close)
+  {
+    recorder_path(rec, seg->seq, path, sizeof(path));
+    rec->on_close(rec->user, path);
+  }
+}
+
+
+/**
+ * Function to keep the latest segments only, with any index built beside 
+ * them, once a segment retired by a rotation is closed. The segment that 
+ * followed it counts as kept, the one opened ahead does not. Retired 
+ * segments are closed in order, so the oldest is closed, and indexed, by now.
+ *
+ * @param rec	pointer to the recorder
+ * @param seq	sequence number of the segment closed
+ */
+static void recorder_prune(const recorder_t *rec, unsigned int seq)
+{
+  /* Declare local variables */
+  char path[RECORDER_PATH_LEN + 32];                 /* Path of the segment */
+
+  if (rec->keep > 0 && seq + 1 >= rec->keep)
+  {
+    recorder_path(rec, seq + 1 - rec->keep, path, sizeof(path));
+    unlink(path);
+    strcat(path, CAPINDEX_SUFFIX);
+    unlink(path);
+  }
+}
+
+
+/**
+ * Function run by the worker of a recorder, opening the next segment as 
+ * soon as the last one opened is taken, which the capture thread may be 
+ * waiting for, then closing the segments handed to it in order and pruning
+ * the oldest
+ *
+ * @param arg	pointer to the recorder
+ * @return void *	NULL
+ */
+static void *recorder_work(void *arg)
+{
+  /* Declare local variables */
+  recorder_t *rec = (recorder_t *)arg;                     /* Recorder */
+  recorder_worker_t *w = (recorder_worker_t *)rec->worker;   /* Its state */
+  recorder_seg_t seg;                       /* Segment opened or closed */
+  unsigned int seq = 0;                     /* Sequence number to open */
+  int ret = 0;                                  /* Result of the open */
+
+  pthread_mutex_lock(&w->lock);
+  for (;;)
+  {
+    if (RECORDER_NEXT_NONE == w->state && !w->stop)
+    {
+      seq = w->next_seq;
+      pthread_mutex_unlock(&w->lock);
+      memset(&seg, 0, sizeof(recorder_seg_t));
+      ret = recorder_segment(rec, &seg, seq);
+      pthread_mutex_lock(&w->lock);
+      w->next = seg;
+      w->state = (0 == ret) ? RECORDER_NEXT_READY : RECORDER_NEXT_FAILED;
+      pthread_cond_broadcast(&w->cond);
+    }
+    else if (w->head != w->tail)
+    {
+      seg = w->retired[w->tail % RECORDER_RETIRED];
+      pthread_mutex_unlock(&w->lock);
+      recorder_segment_close(rec, &seg);
+      recorder_prune(rec, seg.seq);
+      pthread_mutex_lock(&w->lock);
+      w->tail++;
+      pthread_cond_broadcast(&w->cond);
+    }
+    else if (w->stop)
+    {
+      break;
+    }
+    else
+    {
+      pthread_cond_wait(&w->cond, &w->lock);
+    }
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  return NULL;
+}
+
+
+int recorder_open(recorder_t *rec, const char *prefix, const char *iface, 
+ size_t seg_size, unsigned int seg_sec, unsigned int keep)
+{
+  /* Check parameters */
+  if (NULL == rec || NULL == prefix || NULL == iface 
+   || strlen(prefix) >= RECORDER_PATH_LEN)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  recorder_worker_t *w = NULL;                        /* State of the worker */
+  recorder_seg_t seg;                                     /* First segment */
+
+  memset(rec, 0, sizeof(recorder_t));
+  strcpy(rec->prefix, prefix);
+  snprintf(rec->iface, RECORDER_IFACE_LEN, "%s", iface);
+  rec->seg_size = (0 == seg_size) ? RECORDER_SEG_SIZE : seg_size;
+  rec->seg_size = (rec->seg_size + 4095) & ~(size_t)4095;
+  rec->seg_ns = (uint64_t)seg_sec * 1000000000ULL;
+  rec->keep = keep;
+  rec->fd = -1;
+
+  /* The first segment is opened here, so that a bad path fails at once */
+  memset(&seg, 0, sizeof(recorder_seg_t));
+  if (0 != recorder_segment(rec, &seg, 0))
+  {
+    return -1;
+  }
+  rec->fd = seg.fd;
+  rec->map = seg.map;
+  rec->used = seg.used;
+  rec->segments = 1;
+
+  MALLOC(w, recorder_worker_t, sizeof(recorder_worker_t));
+  memset(w, 0, sizeof(recorder_worker_t));
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->cond, NULL);
+  w->state = RECORDER_NEXT_NONE;
+  w->next_seq = 1;
+  rec->worker = w;
+  if (0 != pthread_create(&w->thread, NULL, recorder_work, rec))
+  {
+    fprintf(stderr, "ERROR: could not create recorder thread\n");
+    rec->worker = NULL;
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+    FREE(w);
+    recorder_segment_close(rec, &seg);
+    rec->map = NULL;
+    rec->fd = -1;
+    return -1;
+  }
+
+  /* Done */
+  return 0;
+}
+
+
+int recorder_rotate(recorder_t *rec)
+{
+  /* Check parameters */
+  if (NULL == rec || NULL == rec->worker)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  recorder_worker_t *w = (recorder_worker_t *)rec->worker;  /* Its state */
+  recorder_seg_t *seg = NULL;                  /* Slot of the open segment */
+
+  /* Wait for the next segment, and for room to hand over the open one, 
+   * which only happens if the worker has fallen behind */
+  pthread_mutex_lock(&w->lock);
+  while (RECORDER_NEXT_NONE == w->state 
+   || (NULL != rec->map && w->head - w->tail >= RECORDER_RETIRED))
+  {
+    pthread_cond_wait(&w->cond, &w->lock);
+  }
+
+  /* Keep the open segment if the next could not be opened, and have the 
+   * worker try again for the next rotation */
+  if (RECORDER_NEXT_FAILED == w->state)
+  {
+    w->state = RECORDER_NEXT_NONE;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    return -1;
+  }
+
+  if (NULL != rec->map)
+  {
+    seg = &w->retired[w->head % RECORDER_RETIRED];
+    seg->seq = rec->seq;
+    seg->fd = rec->fd;
+    seg->map = rec->map;
+    seg->used = rec->used;
+    w->head++;
+  }
+  rec->seq = w->next.seq;
+  rec->fd = w->next.fd;
+  rec->map = w->next.map;
+  rec->used = w->next.used;
+  rec->seg_start = 0;
+  rec->segments++;
+  w->state = RECORDER_NEXT_NONE;
+  w->next_seq = rec->seq + 1;
+  pthread_cond_broadcast(&w->cond);
+  pthread_mutex_unlock(&w->lock);
+
+  /* Done */
+  return 0;
+}
+
+
+int recorder_write(recorder_t *rec, const uint8_t *frame, uint32_t caplen, 
+ uint32_t len, uint64_t ns)
+{
+  /* Declare local variables */
+  size_t block_len = PCAPNG_EPB_HDR_LEN + pcapng_pad(caplen) 
+   + PCAPNG_EPB_TRAILER_LEN;                          /* Bytes of the block */
+  uint8_t *ptr = NULL;                                    /* Next byte out */
+
+  /* Check parameters */
+  if (caplen > RECORDER_SNAPLEN || caplen > len)
+  {
+    rec->errors++;
+    return -1;
+  }
+
+  /* Rotate if the frame does not fit or the segment has covered its time, 
+   * and retry a failed rotation on each frame */
+  if (NULL == rec->map || rec->seg_size - rec->used < block_len 
+   || (0 != rec->seg_ns && 0 != rec->seg_start 
+    && ns - rec->seg_start >= rec->seg_ns))
+  {
+    if (0 != recorder_rotate(rec) || rec->seg_size - rec->used < block_len)
+    {
+      rec->errors++;
+      return -1;
+    }
+  }
+  if (0 == rec->seg_start)
+  {
+    rec->seg_start = ns;
+  }
+
+  /* Enhanced packet block on interface 0 */
+  ptr = rec->map + rec->used;
+  ptr = put32(ptr, PCAPNG_EPB);
+  ptr = put32(ptr, (uint32_t)block_len);
+  ptr = put32(ptr, 0);
+  ptr = put32(ptr, (uint32_t)(ns >> 32));
+  ptr = put32(ptr, (uint32_t)ns);
+  ptr = put32(ptr, caplen);
+  ptr = put32(ptr, len);
+  memcpy(ptr, frame, caplen);
+  ptr += caplen;
+  memset(ptr, 0, pcapng_pad(caplen) - caplen);
+  ptr += pcapng_pad(caplen) - caplen;
+  put32(ptr, (uint32_t)block_len);
+
+  rec->used += block_len;
+  rec->frames++;
+  rec->bytes += caplen;
+
+  /* Done */
+  return 0;
+}
+
+
+void recorder_close(recorder_t *rec)
+{
+  /* Check parameters */
+  if (NULL == rec || NULL == rec->worker)
+  {
+    return;
+  }
+
+  /* Declare local variables */
+  recorder_worker_t *w = (recorder_worker_t *)rec->worker;  /* Its state */
+  recorder_seg_t seg;                                  /* Open segment */
+  char path[RECORDER_PATH_LEN + 32];         /* Path of the next segment */
+
+  /* The worker closes the segments handed to it before it stops */
+  pthread_mutex_lock(&w->lock);
+  w->stop = 1;
+  pthread_cond_broadcast(&w->cond);
+  pthread_mutex_unlock(&w->lock);
+  pthread_join(w->thread, NULL);
+
+  /* The next segment was never written, it is deleted rather than closed */
+  if (RECORDER_NEXT_READY == w->state)
+  {
+    munmap(w->next.map, rec->seg_size);
+    close(w->next.fd);
+    recorder_path(rec, w->next.seq, path, sizeof(path));
+    unlink(path);
+  }
+
+  seg.seq = rec->seq;
+  seg.fd = rec->fd;
+  seg.map = rec->map;
+  seg.used = rec->used;
+  recorder_segment_close(rec, &seg);
+  rec->map = NULL;
+  rec->fd = -1;
+
+  pthread_cond_destroy(&w->cond);
+  pthread_mutex_destroy(&w->lock);
+  FREE(w);
+  rec->worker = NULL;
+}
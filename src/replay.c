@@ -0,0 +1,339 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "probes.h"
+#include "replay.h"
+#include "types.h"
+#include "utctime.h"
+#include "utils.h"
+
+#include <string.h>
+#include <time.h>
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to hash the key of a stream, FNV-1a over the APPID and gocbRef
+ */
+static size_t replay_hash(uint16_t appid, const uint8_t *ref, size_t len)
+{
+  /* Declare local variables */
+  uint32_t hash = 2166136261u;                          /* FNV offset basis */
+  size_t i = 0;                                               /* Loop index */
+
+  hash = (hash ^ (appid >> 8)) * 16777619u;
+  hash = (hash ^ (appid & 0xff)) * 16777619u;
+  for (i = 0; i < len; i++)
+  {
+    hash = (hash ^ ref[i]) * 16777619u;
+  }
+
+  return (size_t)hash;
+}
+
+
+/**
+ * Function to find the slot of a stream, or the empty slot it would take. 
+ * The table always has empty slots, so the probe terminates.
+ */
+static replay_stream_t *replay_find(const replay_table_t *table, 
+ const goose_view_t *view)
+{
+  /* Declare local variables */
+  replay_stream_t *slot = NULL;                      /* Slot being probed */
+  size_t i = 0;                                      /* Index of the slot */
+
+  i = replay_hash(view->appid, view->gocbref, view->gocbrefLen) & table->mask;
+  for (;;)
+  {
+    slot = &table->streams[i];
+    if (!slot->used || (slot->appid == view->appid 
+     && slot->ref_len == view->gocbrefLen 
+     && 0 == memcmp(slot->ref, view->gocbref, view->gocbrefLen)))
+    {
+      return slot;
+    }
+    i = (i + 1) & table->mask;
+  }
+}
+
+
+/**
+ * Function to return the UtcTime in ms since the epoch
+ */
+static int64_t utc_time_ms(const uint8_t *t)
+{
+  return (int64_t)(utc_time_decode(t, NULL) / 1000000);
+}
+
+
+/**
+ * Function to check the timestamp of a frame against the local clock, no 
+ * older than its timeAllowedtoLive and not ahead, allowing for the skew
+ */
+static int replay_fresh(const replay_table_t *table, const goose_view_t *view)
+{
+  /* Declare local variables */
+  struct timespec now;                                /* Local UTC clock */
+  int64_t age_ms = 0;                   /* Age of the state change in ms */
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  age_ms = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000 
+   - utc_time_ms(view->t);
+  return age_ms >= -(int64_t)table->max_skew_ms 
+   && age_ms <= (int64_t)view->timeAllowedtoLive + table->max_skew_ms;
+}
+
+
+/**
+ * Function to count an authenticated frame behind the window towards a 
+ * resync, as in ids_resync(): of the same state with a later sqNum, or of a 
+ * later state with a later timestamp, than the last frame behind
+ *
+ * @return uint32_t	number of consecutive frames behind, with this one
+ */
+static uint32_t replay_resync(replay_stream_t *stream, 
+ const goose_view_t *view, uint64_t seq)
+{
+  /* Declare local variables */
+  uint32_t st = (uint32_t)(stream->resync_seq >> 32);  /* stNum of the last */
+
+  if (stream->resync_frames && ((view->stNum == st 
+   && seq > stream->resync_seq && 0 == memcmp(view->t, stream->resync_t, 8)) 
+   || ((int32_t)(view->stNum - st) > 0 
+   && utc_time_ms(view->t) > utc_time_ms(stream->resync_t))))
+  {
+    stream->resync_frames++;
+  }
+  else
+  {
+    stream->resync_frames = 1;
+  }
+  stream->resync_seq = seq;
+  memcpy(stream->resync_t, view->t, 8);
+
+  /* Done */
+  return stream->resync_frames;
+}
+
+
+int replay_init(replay_table_t *table, size_t max_streams, 
+ int32_t max_skew_ms)
+{
+  /* Check parameters */
+  if (NULL == table || 0 == max_streams)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  size_t slots = 2;                                    /* Number of slots */
+
+  while (slots < 2 * max_streams)
+  {
+    slots <<= 1;
+  }
+
+  memset(table, 0, sizeof(replay_table_t));
+  MALLOC(table->streams, replay_stream_t, slots * sizeof(replay_stream_t));
+  memset(table->streams, 0, slots * sizeof(replay_stream_t));
+  table->mask = slots - 1;
+  table->max_streams = max_streams;
+  table->max_skew_ms = max_skew_ms;
+
+  /* Done */
+  return 0;
+}
+
+
+void replay_free(replay_table_t *table)
+{
+  /* Check parameters */
+  if (NULL == table)
+  {
+    return;
+  }
+
+  FREE(table->streams);
+  memset(table, 0, sizeof(replay_table_t));
+}
+
+
+replay_verdict_t replay_check(const replay_table_t *table, 
+ const goose_view_t *view, replay_stream_t **stream)
+{
+  /* Check parameters */
+  if (NULL == table || NULL == table->streams || NULL == view 
+   || NULL == view->gocbref || NULL == view->t || NULL == stream 
+   || view->gocbrefLen > REPLAY_MAX_REF_LEN)
+  {
+    return REPLAY_NO_STREAM;
+  }
+
+  /* Declare local variables */
+  replay_stream_t *slot = NULL;                 /* Slot of the stream */
+  uint64_t seq = ((uint64_t)view->stNum << 32) | view->sqNum;  /* Sequence */
+  uint64_t behind = 0;            /* Number of frames behind the newest */
+
+  *stream = NULL;
+
+  /* Check the timestamp of a new state against the local clock */
+  slot = replay_find(table, view);
+  if (REPLAY_NO_CLOCK != table->max_skew_ms 
+   && (!slot->used || view->stNum != (uint32_t)(slot->high >> 32)) 
+   && !replay_fresh(table, view))
+  {
+    return REPLAY_STALE;
+  }
+
+  /* First frame of a stream */
+  if (!slot->used)
+  {
+    return (table->used < table->max_streams) ? REPLAY_OK : REPLAY_NO_STREAM;
+  }
+  *stream = slot;
+
+  /* Newer frame, of this state or of a new state */
+  if (seq > slot->high)
+  {
+    if (view->stNum == (uint32_t)(slot->high >> 32))
+    {
+      return (0 == memcmp(view->t, slot->t, 8)) ? REPLAY_OK : REPLAY_STALE;
+    }
+    if ((REPLAY_NO_CLOCK != table->max_skew_ms 
+     && utc_time_ms(view->t) < utc_time_ms(slot->t)) 
+     || utc_time_ms(view->t) <= slot->floor_ms)
+    {
+      return REPLAY_STALE;
+    }
+    return REPLAY_OK;
+  }
+
+  /* Older frame, accepted once if it is within the window */
+  behind = slot->high - seq;
+  if (behind >= REPLAY_WINDOW)
+  {
+    /* Another state may be a restart of the publisher, its timestamp was 
+     * checked above when the clock is */
+    return (view->stNum != (uint32_t)(slot->high >> 32)) 
+     ? REPLAY_RESYNC : REPLAY_TOO_OLD;
+  }
+  if (slot->window & ((uint64_t)1 << behind))
+  {
+    return REPLAY_DUPLICATE;
+  }
+  return (0 == memcmp(view->t, slot->t, 8)) ? REPLAY_OK : REPLAY_STALE;
+}
+
+
+int replay_update(replay_table_t *table, replay_stream_t *stream, 
+ const goose_view_t *view)
+{
+  /* Check parameters */
+  if (NULL == table || NULL == table->streams || NULL == view 
+   || NULL == view->gocbref || NULL == view->t 
+   || view->gocbrefLen > REPLAY_MAX_REF_LEN)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  uint64_t seq = ((uint64_t)view->stNum << 32) | view->sqNum;  /* Sequence */
+  uint64_t shift = 0;              /* Number of positions the window moves */
+
+  /* Add the stream on its first authenticated frame */
+  if (NULL == stream)
+  {
+    if (table->used >= table->max_streams)
+    {
+      return -1;
+    }
+    stream = replay_find(table, view);
+    if (!stream->used)
+    {
+      stream->used = 1;
+      stream->appid = view->appid;
+      stream->ref_len = (uint8_t)view->gocbrefLen;
+      memcpy(stream->ref, view->gocbref, view->gocbrefLen);
+      stream->high = seq;
+      stream->window = 1;
+      memcpy(stream->t, view->t, 8);
+      table->used++;
+      GOOSE_PROBE(stream_add, view->appid, view->stNum, view->sqNum);
+      return 0;
+    }
+  }
+
+  /* Restart the window from a frame behind it, see replay_check() */
+  if (seq < stream->high && stream->high - seq >= REPLAY_WINDOW)
+  {
+    if (REPLAY_NO_CLOCK == table->max_skew_ms 
+     && replay_resync(stream, view, seq) < REPLAY_RESYNC_FRAMES)
+    {
+      return 1;
+    }
+    GOOSE_PROBE(state_change, view->appid, (uint32_t)(stream->high >> 32), 
+     view->stNum, view->sqNum);
+    stream->floor_ms = utc_time_ms(stream->t);
+    stream->high = seq;
+    stream->window = 1;
+    stream->resync_frames = 0;
+    memcpy(stream->t, view->t, 8);
+    return 0;
+  }
+  stream->resync_frames = 0;
+
+  /* Slide the window forward, or mark an older frame */
+  if (seq > stream->high)
+  {
+    if (view->stNum != (uint32_t)(stream->high >> 32))
+    {
+      GOOSE_PROBE(state_change, view->appid, (uint32_t)(stream->high >> 32), 
+       view->stNum, view->sqNum);
+    }
+    shift = seq - stream->high;
+    stream->window = (shift >= REPLAY_WINDOW) ? 1 
+     : ((stream->window << shift) | 1);
+    stream->high = seq;
+    memcpy(stream->t, view->t, 8);
+  }
+  else if (stream->high - seq < REPLAY_WINDOW)
+  {
+    stream->window |= (uint64_t)1 << (stream->high - seq);
+  }
+
+  /* Done */
+  return 0;
+}
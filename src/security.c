@@ -0,0 +1,479 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "gmac.h"
+#include "security.h"
+#include "sha256.h"
+#include "types.h"
+#include "utils.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/*
+ * Constants
+ */
+
+/** Inner and outer HMAC padding bytes (See: RFC2104)
+ */
+static const uint8_t HMAC_IPAD = 0x36;
+static const uint8_t HMAC_OPAD = 0x5c;
+
+
+/** Largest key or message of the known answer tests
+ */
+#define KAT_MAX_LEN 160
+
+
+/** SHA-256 known answer test (See: FIPS180-2 Appendix B)
+ */
+typedef struct _sha256_kat_t_ {
+  const char *text;    /* Message text */
+  const char *digest;  /* Hexadecimal digest */
+} sha256_kat_t;
+
+static const sha256_kat_t SHA256_KAT[] = {
+  { "abc", 
+    "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+  { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 
+    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" }
+};
+
+
+/** HMAC-SHA256 known answer test, the key and message are a hexadecimal 
+ * pattern repeated, or the message is text (See: RFC4231 Section 4)
+ */
+typedef struct _hmac_kat_t_ {
+  const char *key;     /* Hexadecimal key pattern */
+  size_t key_rep;      /* Number of times the key pattern repeats */
+  const char *text;    /* Message text, else NULL */
+  const char *msg;     /* Hexadecimal message pattern, if no text */
+  size_t msg_rep;      /* Number of times the message pattern repeats */
+  uint8_t mac_len;     /* Bytes of MAC carried, 0 for all */
+  const char *mac;     /* Hexadecimal MAC */
+} hmac_kat_t;
+
+static const hmac_kat_t HMAC_KAT[] = {
+  { "0b", 20, "Hi There", NULL, 0, 0, 
+    "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+  { "4a656665", 1, "what do ya want for nothing?", NULL, 0, 0, 
+    "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+  { "aa", 20, NULL, "dd", 50, 0, 
+    "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe" },
+  { "0102030405060708090a0b0c0d0e0f10111213141516171819", 1, NULL, "cd", 50, 
+    0, "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b" },
+  { "0c", 20, "Test With Truncation", NULL, 0, 16, 
+    "a3b6167473100ee06e0c796c2955552b" },
+  { "aa", 131, "Test Using Larger Than Block-Size Key - Hash Key First", NULL, 
+    0, 0, "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+  { "aa", 131, "This is a test using a larger than block-size key and a "
+    "larger than block-size data. The key needs to be hashed before being "
+    "used by the HMAC algorithm.", NULL, 0, 0, 
+    "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2" }
+};
+
+
+/** AES-GMAC known answer test, i.e. AES-GCM with no plaintext (See: The 
+ * Galois/Counter Mode of Operation Test Cases 1 and 13, IEEE802.1AE-2006 
+ * Annex C.1.1)
+ */
+typedef struct _gmac_kat_t_ {
+  const char *key;     /* Hexadecimal key */
+  const char *iv;      /* Hexadecimal IV */
+  const char *aad;     /* Hexadecimal additional authenticated data */
+  const char *tag;     /* Hexadecimal tag */
+} gmac_kat_t;
+
+static const char MACSEC_AAD[] = "d609b1f056637a0d46df998d88e5222ab2c28465"
+ "12153524c0895e8108000f101112131415161718191a1b1c1d1e1f202122232425262728"
+ "292a2b2c2d2e2f30313233340001";
+
+static const gmac_kat_t GMAC_KAT[] = {
+  { "00000000000000000000000000000000", "000000000000000000000000", "", 
+    "58e2fccefa7e3061367f1d57a4e7455a" },
+  { "0000000000000000000000000000000000000000000000000000000000000000", 
+    "000000000000000000000000", "", "530f8afbc74536b9a963b4f1c4cb738b" },
+  { "ad7a2bd03eac835a6f620fdcb506b345", "12153524c0895e81b2c28465", 
+    MACSEC_AAD, "f09478a9b09007d06f46e9b6a1da25dd" },
+  { "e3c08a8f06c6e3ad95a70557b23f75483ce33021a9c72b7025666204c69c0b72", 
+    "12153524c0895e81b2c28465", MACSEC_AAD, 
+    "2f0bc5af409e06d609ea8b7d0fa5ea50" }
+};
+
+
+/*
+ * Function definitions
+ */
+
+int const_time_memcmp(const void *first, const void *second, size_t len)
+{
+  /* Declare local variables */
+  const volatile uint8_t *a = (const volatile uint8_t *)first;
+  const volatile uint8_t *b = (const volatile uint8_t *)second;
+  uint8_t diff = 0;                   /* Accumulated difference of all bytes */
+  size_t i = 0;                                                /* Loop index */
+
+  for (i = 0; i < len; i++)
+  {
+    diff |= (uint8_t)(a[i] ^ b[i]);
+  }
+
+  /* Map any non-zero difference to 1 without a data dependent branch */
+  return (int)((diff + 0xffu) >> 8);
+}
+
+
+void hmac_sha256(const hmac_sha256_key_t *key, const uint8_t *msg, 
+ size_t len, uint8_t *mac)
+{
+  /* Declare local variables */
+  sha256_ctx_t ctx;                           /* Copy of precomputed state */
+  uint8_t inner[SHA256_DIGEST_LEN];                   /* Inner hash value */
+
+  /* H((K ^ ipad) || m), starting from the absorbed padded key */
+  ctx = key->inner;
+  sha256_update(&ctx, msg, len);
+  sha256_final(&ctx, inner);
+
+  /* H((K ^ opad) || inner) */
+  ctx = key->outer;
+  sha256_update(&ctx, inner, SHA256_DIGEST_LEN);
+  sha256_final(&ctx, mac);
+}
+
+
+/**
+ * Security hook to compute the, possibly truncated, HMAC-SHA256 of a message
+ */
+static int hmac_sha256_sign(goose_sec_t *sec, const uint8_t *msg, size_t len,
+ uint8_t *value)
+{
+  /* Declare local variables */
+  uint8_t mac[SHA256_DIGEST_LEN];                      /* Untruncated MAC */
+
+  hmac_sha256(&(sec->key.hmac), msg, len, mac);
+  memcpy(value, mac, sec->value_len);
+  return 0;
+}
+
+
+/**
+ * Security hook to check the, possibly truncated, HMAC-SHA256 of a message
+ */
+static int hmac_sha256_verify(const goose_sec_t *sec, const uint8_t *msg, 
+ size_t len, const uint8_t *value)
+{
+  /* Declare local variables */
+  uint8_t mac[SHA256_DIGEST_LEN];                      /* Untruncated MAC */
+
+  hmac_sha256(&(sec->key.hmac), msg, len, mac);
+  return const_time_memcmp(mac, value, sec->value_len);
+}
+
+
+int sec_init_hmac_sha256(goose_sec_t *sec, const uint8_t *key, 
+ size_t key_len, uint8_t mac_len)
+{
+  /* Check parameters */
+  if (NULL == sec || NULL == key || 0 == key_len)
+  {
+    return -1;
+  }
+
+  if (0 == mac_len)
+  {
+    mac_len = SHA256_DIGEST_LEN;
+  }
+  else if (mac_len < SEC_MIN_HMAC_LEN || mac_len > SHA256_DIGEST_LEN)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  uint8_t block[SHA256_BLOCK_LEN];                 /* Padded key block */
+  size_t i = 0;                                                /* Loop index */
+
+  /* Keys longer than a block are replaced by their hash */
+  memset(block, 0, SHA256_BLOCK_LEN);
+  if (key_len > SHA256_BLOCK_LEN)
+  {
+    sha256(key, key_len, block);
+  }
+  else
+  {
+    memcpy(block, key, key_len);
+  }
+
+  /* Absorb key XOR ipad */
+  for (i = 0; i < SHA256_BLOCK_LEN; i++)
+  {
+    block[i] ^= HMAC_IPAD;
+  }
+  sha256_init(&(sec->key.hmac.inner));
+  sha256_update(&(sec->key.hmac.inner), block, SHA256_BLOCK_LEN);
+
+  /* Absorb key XOR opad */
+  for (i = 0; i < SHA256_BLOCK_LEN; i++)
+  {
+    block[i] ^= (uint8_t)(HMAC_IPAD ^ HMAC_OPAD);
+  }
+  sha256_init(&(sec->key.hmac.outer));
+  sha256_update(&(sec->key.hmac.outer), block, SHA256_BLOCK_LEN);
+
+  /* Do not leave the key on the stack */
+  memset(block, 0, SHA256_BLOCK_LEN);
+  __asm__ __volatile__("" : : "r"(block) : "memory");
+
+  sec->alg = SEC_HMAC_SHA256;
+  sec->value_len = mac_len;
+  sec->sign = hmac_sha256_sign;
+  sec->verify = hmac_sha256_verify;
+  return 0;
+}
+
+
+/**
+ * Security hook to compute the AES-GMAC of a message, the value is the IV 
+ * followed by the tag
+ */
+static int aes_gmac_sign(goose_sec_t *sec, const uint8_t *msg, size_t len,
+ uint8_t *value)
+{
+  /* Declare local variables */
+  gmac_sec_key_t *k = &(sec->key.gmac);           /* GMAC key and IV state */
+  uint64_t invocation = k->invocation;          /* IV invocation field */
+  int i = 0;                                                   /* Loop index */
+
+  /* Never reuse an IV, the key must be changed before the counter wraps 
+   * round to where it started */
+  if (invocation + 1 == k->start)
+  {
+    return -1;
+  }
+  k->invocation++;
+
+  memcpy(value, k->salt, sizeof(k->salt));
+  for (i = 0; i < 8; i++)
+  {
+    value[4 + i] = (uint8_t)(invocation >> (56 - 8 * i));
+  }
+
+  gmac_compute(&(k->key), value, msg, len, value + GMAC_IV_LEN);
+  return 0;
+}
+
+
+/**
+ * Security hook to check the AES-GMAC of a message using the IV carried in 
+ * the value
+ */
+static int aes_gmac_verify(const goose_sec_t *sec, const uint8_t *msg, 
+ size_t len, const uint8_t *value)
+{
+  /* Declare local variables */
+  uint8_t tag[GMAC_BLOCK_LEN];                              /* Computed tag */
+
+  gmac_compute(&(sec->key.gmac.key), value, msg, len, tag);
+  return const_time_memcmp(tag, value + GMAC_IV_LEN, GMAC_BLOCK_LEN);
+}
+
+
+int sec_init_aes_gmac(goose_sec_t *sec, const uint8_t *key, size_t key_len)
+{
+  /* Check parameters */
+  if (NULL == sec || NULL == key)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  int fd = -1;                         /* File descriptor for random source */
+  uint8_t iv[GMAC_IV_LEN];                          /* Random first IV */
+  size_t got = 0;                         /* Random bytes read so far */
+  ssize_t n = 0;                                /* Bytes of one read */
+  int i = 0;                                                 /* Loop index */
+
+  if (0 != gmac_set_key(&(sec->key.gmac.key), key, key_len))
+  {
+    return -1;
+  }
+
+  /* Start from a random 96-bit IV, both the salt and the invocation field, 
+   * so that publishers sharing a key, or one restarting with it, only repeat 
+   * an IV by chance of 2^-96 per pair rather than from the first frame. There 
+   * is no safe fallback without a random source */
+  fd = open("/dev/urandom", O_RDONLY);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  while (got < sizeof(iv))
+  {
+    n = read(fd, iv + got, sizeof(iv) - got);
+    if (n <= 0)
+    {
+      close(fd);
+      return -1;
+    }
+    got += (size_t)n;
+  }
+  close(fd);
+
+  memcpy(sec->key.gmac.salt, iv, sizeof(sec->key.gmac.salt));
+  sec->key.gmac.invocation = 0;
+  for (i = 0; i < 8; i++)
+  {
+    sec->key.gmac.invocation = (sec->key.gmac.invocation << 8) | iv[4 + i];
+  }
+  sec->key.gmac.start = sec->key.gmac.invocation;
+  memset(iv, 0, sizeof(iv));
+
+  sec->alg = SEC_AES_GMAC;
+  sec->value_len = GMAC_IV_LEN + GMAC_BLOCK_LEN;
+  sec->sign = aes_gmac_sign;
+  sec->verify = aes_gmac_verify;
+  return 0;
+}
+
+
+void sec_clear(goose_sec_t *sec)
+{
+  /* Check parameters */
+  if (NULL == sec)
+  {
+    return;
+  }
+
+  memset(sec, 0, sizeof(goose_sec_t));
+  __asm__ __volatile__("" : : "r"(sec) : "memory");
+}
+
+
+/**
+ * Function to decode a hexadecimal pattern repeated a number of times
+ */
+static size_t kat_bytes(const char *hex, size_t rep, uint8_t *buf)
+{
+  /* Declare local variables */
+  size_t len = hex_to_bytes(hex, buf, KAT_MAX_LEN);   /* Bytes of pattern */
+  size_t i = 0;                                                /* Loop index */
+
+  if (0 == len || len * rep > KAT_MAX_LEN)
+  {
+    return 0;
+  }
+  for (i = 1; i < rep; i++)
+  {
+    memcpy(buf + i * len, buf, len);
+  }
+  return len * rep;
+}
+
+
+int sec_self_test(void)
+{
+  /* Declare local variables */
+  goose_sec_t sec;                             /* Context of the test key */
+  gmac_key_t gmac;                               /* GMAC test key schedule */
+  uint8_t iv[GMAC_IV_LEN];                                    /* Test IV */
+  uint8_t key[KAT_MAX_LEN];                                  /* Test key */
+  uint8_t msg[KAT_MAX_LEN];                              /* Test message */
+  uint8_t expect[SEC_MAX_VALUE_LEN];                   /* Expected value */
+  uint8_t value[SEC_MAX_VALUE_LEN];                    /* Computed value */
+  size_t key_len = 0;                                /* Bytes of test key */
+  size_t msg_len = 0;                            /* Bytes of test message */
+  size_t len = 0;                                  /* Bytes of the value */
+  size_t i = 0;                                                /* Loop index */
+  int failed = 0;                           /* Number of failed tests */
+  int ok = 0;                          /* Non-zero if the test passed */
+
+  for (i = 0; i < sizeof(SHA256_KAT) / sizeof(SHA256_KAT[0]); i++)
+  {
+    len = hex_to_bytes(SHA256_KAT[i].digest, expect, SEC_MAX_VALUE_LEN);
+    sha256((const uint8_t *)SHA256_KAT[i].text, strlen(SHA256_KAT[i].text), 
+     value);
+    if (SHA256_DIGEST_LEN != len || memcmp(value, expect, len))
+    {
+      fprintf(stderr, "ERROR: SHA-256 known answer test %zu failed\n", i + 1);
+      failed++;
+    }
+  }
+
+  for (i = 0; i < sizeof(HMAC_KAT) / sizeof(HMAC_KAT[0]); i++)
+  {
+    key_len = kat_bytes(HMAC_KAT[i].key, HMAC_KAT[i].key_rep, key);
+    if (HMAC_KAT[i].text)
+    {
+      msg_len = strlen(HMAC_KAT[i].text);
+      memcpy(msg, HMAC_KAT[i].text, msg_len);
+    }
+    else
+    {
+      msg_len = kat_bytes(HMAC_KAT[i].msg, HMAC_KAT[i].msg_rep, msg);
+    }
+    len = hex_to_bytes(HMAC_KAT[i].mac, expect, SEC_MAX_VALUE_LEN);
+    if (0 != sec_init_hmac_sha256(&sec, key, key_len, HMAC_KAT[i].mac_len) 
+     || sec.value_len != len || 0 != sec.sign(&sec, msg, msg_len, value) 
+     || memcmp(value, expect, len))
+    {
+      fprintf(stderr, "ERROR: HMAC-SHA256 RFC4231 test case %zu failed\n", 
+       i + 1);
+      failed++;
+    }
+    sec_clear(&sec);
+  }
+
+  for (i = 0; i < sizeof(GMAC_KAT) / sizeof(GMAC_KAT[0]); i++)
+  {
+    key_len = hex_to_bytes(GMAC_KAT[i].key, key, KAT_MAX_LEN);
+    msg_len = hex_to_bytes(GMAC_KAT[i].aad, msg, KAT_MAX_LEN);
+    len = hex_to_bytes(GMAC_KAT[i].tag, expect, SEC_MAX_VALUE_LEN);
+    hex_to_bytes(GMAC_KAT[i].iv, iv, GMAC_IV_LEN);
+    ok = (GMAC_BLOCK_LEN == len && 0 == gmac_set_key(&gmac, key, key_len));
+    if (ok)
+    {
+      gmac_compute(&gmac, iv, msg, msg_len, value);
+      ok = (0 == memcmp(value, expect, len));
+    }
+    if (!ok)
+    {
+      fprintf(stderr, "ERROR: AES-GMAC known answer test %zu failed (%s)\n", 
+       i + 1, gmac_impl_name());
+      failed++;
+    }
+    memset(&gmac, 0, sizeof(gmac_key_t));
+  }
+
+  return failed ? -1 : 0;
+}
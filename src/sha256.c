@@ -0,0 +1,259 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "sha256.h"
+
+#include <string.h>
+
+
+/*
+ * Constants
+ */
+
+/** SHA-256 round constants, the first 32 bits of the fractional parts of the 
+ * cube roots of the first 64 primes
+ */
+static const uint32_t K256[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+/** SHA-256 initial hash value
+ */
+static const uint32_t H256[8] = {
+  0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 
+  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+
+/*
+ * Macros
+ */
+
+#define ROTR(X, N) (((X) >> (N)) | ((X) << (32 - (N))))
+#define CH(X, Y, Z) (((X) & (Y)) ^ (~(X) & (Z)))
+#define MAJ(X, Y, Z) (((X) & (Y)) | ((Z) & ((X) | (Y))))
+#define BSIG0(X) (ROTR(X, 2) ^ ROTR(X, 13) ^ ROTR(X, 22))
+#define BSIG1(X) (ROTR(X, 6) ^ ROTR(X, 11) ^ ROTR(X, 25))
+#define SSIG0(X) (ROTR(X, 7) ^ ROTR(X, 18) ^ ((X) >> 3))
+#define SSIG1(X) (ROTR(X, 17) ^ ROTR(X, 19) ^ ((X) >> 10))
+
+/* One round, the working variables are rotated by renaming at the call site 
+ * rather than by moving values between registers */
+#define ROUND(A, B, C, D, E, F, G, H, I) \
+do \
+{ \
+  uint32_t t1 = (H) + BSIG1(E) + CH(E, F, G) + K256[I] + w[(I) & 15]; \
+  (D) += t1; \
+  (H) = t1 + BSIG0(A) + MAJ(A, B, C); \
+} \
+while (0)
+
+/* Extend the message schedule in place over a 16 word window */
+#define SCHEDULE(I) \
+ (w[(I) & 15] += SSIG1(w[((I) - 2) & 15]) + w[((I) - 7) & 15] \
+  + SSIG0(w[((I) - 15) & 15]))
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to compress a number of consecutive 64-byte blocks into the hash 
+ * state
+ *
+ * @param state	- pointer to the 8 word intermediate hash value
+ * @param data	- pointer to the message blocks
+ * @param blocks	- number of message blocks
+ */
+static void sha256_compress(uint32_t *state, const uint8_t *data, 
+ size_t blocks)
+{
+  /* Declare local variables */
+  uint32_t a, b, c, d, e, f, g, h;                   /* Working variables */
+  uint32_t w[16];                       /* Rolling message schedule window */
+  size_t i = 0;                                                /* Loop index */
+
+  while (blocks--)
+  {
+    for (i = 0; i < 16; i++)
+    {
+      w[i] = ((uint32_t)data[4*i] << 24) | ((uint32_t)data[4*i+1] << 16) 
+       | ((uint32_t)data[4*i+2] << 8) | (uint32_t)data[4*i+3];
+    }
+
+    a = state[0]; b = state[1]; c = state[2]; d = state[3];
+    e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+    for (i = 0; i < 64; i += 8)
+    {
+      if (i >= 16)
+      {
+        SCHEDULE(i);   SCHEDULE(i+1); SCHEDULE(i+2); SCHEDULE(i+3);
+        SCHEDULE(i+4); SCHEDULE(i+5); SCHEDULE(i+6); SCHEDULE(i+7);
+      }
+      ROUND(a, b, c, d, e, f, g, h, i);
+      ROUND(h, a, b, c, d, e, f, g, i+1);
+      ROUND(g, h, a, b, c, d, e, f, i+2);
+      ROUND(f, g, h, a, b, c, d, e, i+3);
+      ROUND(e, f, g, h, a, b, c, d, i+4);
+      ROUND(d, e, f, g, h, a, b, c, i+5);
+      ROUND(c, d, e, f, g, h, a, b, i+6);
+      ROUND(b, c, d, e, f, g, h, a, i+7);
+    }
+
+    state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    data += SHA256_BLOCK_LEN;
+  }
+}
+
+
+void sha256_init(sha256_ctx_t *ctx)
+{
+  /* Check parameters */
+  if (NULL == ctx)
+  {
+    return;
+  }
+
+  memcpy(ctx->state, H256, sizeof(H256));
+  ctx->count = 0;
+  ctx->buf_len = 0;
+}
+
+
+void sha256_update(sha256_ctx_t *ctx, const uint8_t *data, size_t len)
+{
+  /* Check parameters */
+  if (NULL == ctx || NULL == data || 0 == len)
+  {
+    return;
+  }
+
+  /* Declare local variables */
+  size_t fill = 0;                 /* Bytes needed to complete partial block */
+
+  ctx->count += len;
+
+  /* Complete any partial block first */
+  if (ctx->buf_len)
+  {
+    fill = SHA256_BLOCK_LEN - ctx->buf_len;
+    if (len < fill)
+    {
+      memcpy(ctx->buf + ctx->buf_len, data, len);
+      ctx->buf_len += len;
+      return;
+    }
+    memcpy(ctx->buf + ctx->buf_len, data, fill);
+    sha256_compress(ctx->state, ctx->buf, 1);
+    data += fill;
+    len -= fill;
+    ctx->buf_len = 0;
+  }
+
+  /* Compress whole blocks straight from the message */
+  if (len >= SHA256_BLOCK_LEN)
+  {
+    sha256_compress(ctx->state, data, len / SHA256_BLOCK_LEN);
+    data += len & ~(size_t)(SHA256_BLOCK_LEN - 1);
+    len &= (SHA256_BLOCK_LEN - 1);
+  }
+
+  /* Keep the tail for next time */
+  if (len)
+  {
+    memcpy(ctx->buf, data, len);
+    ctx->buf_len = len;
+  }
+}
+
+
+void sha256_final(sha256_ctx_t *ctx, uint8_t *digest)
+{
+  /* Check parameters */
+  if (NULL == ctx || NULL == digest)
+  {
+    return;
+  }
+
+  /* Declare local variables */
+  uint64_t bits = ctx->count << 3;          /* Message length in bits */
+  size_t i = 0;                                               /* Loop index */
+
+  /* Append the 1 bit and pad to 56 bytes into the block */
+  ctx->buf[ctx->buf_len++] = 0x80;
+  if (ctx->buf_len > SHA256_BLOCK_LEN - 8)
+  {
+    memset(ctx->buf + ctx->buf_len, 0, SHA256_BLOCK_LEN - ctx->buf_len);
+    sha256_compress(ctx->state, ctx->buf, 1);
+    ctx->buf_len = 0;
+  }
+  memset(ctx->buf + ctx->buf_len, 0, SHA256_BLOCK_LEN - 8 - ctx->buf_len);
+
+  /* Append the big-endian message length */
+  for (i = 0; i < 8; i++)
+  {
+    ctx->buf[SHA256_BLOCK_LEN - 1 - i] = (uint8_t)(bits >> (8 * i));
+  }
+  sha256_compress(ctx->state, ctx->buf, 1);
+
+  /* Output the big-endian digest */
+  for (i = 0; i < 8; i++)
+  {
+    digest[4*i]   = (uint8_t)(ctx->state[i] >> 24);
+    digest[4*i+1] = (uint8_t)(ctx->state[i] >> 16);
+    digest[4*i+2] = (uint8_t)(ctx->state[i] >> 8);
+    digest[4*i+3] = (uint8_t)(ctx->state[i]);
+  }
+}
+
+
+void sha256(const uint8_t *data, size_t len, uint8_t *digest)
+{
+  /* Declare local variables */
+  sha256_ctx_t ctx;                                         /* Hashing state */
+
+  sha256_init(&ctx);
+  sha256_update(&ctx, data, len);
+  sha256_final(&ctx, digest);
+}
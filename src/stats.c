@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to compare two uint64_t values for qsort
+ */
+static int compare_ui64(const void *first, const void *second)
+{
+  uint64_t a = *(const uint64_t *)first;
+  uint64_t b = *(const uint64_t *)second;
+
+  return (a > b) - (a < b);
+}
+
+
+/**
+ * Function to return the sample at the nearest rank of a sorted set
+ */
+static uint64_t nearest_rank(const uint64_t *sorted, size_t count, 
+ unsigned int per_mille)
+{
+  /* Declare local variables */
+  size_t rank = (count * per_mille + 999) / 1000;       /* 1-based rank */
+
+  if (0 == rank)
+  {
+    rank = 1;
+  }
+  return sorted[rank - 1];
+}
+
+
+void compute_percentiles(uint64_t *samples, size_t count, percentiles_t *pct)
+{
+  /* Check parameters */
+  if (NULL == pct)
+  {
+    return;
+  }
+
+  memset(pct, 0, sizeof(percentiles_t));
+  if (NULL == samples || 0 == count)
+  {
+    return;
+  }
+
+  /* Declare local variables */
+  size_t i = 0;                                                /* Loop index */
+  uint64_t sum = 0;                                     /* Sum of samples */
+
+  qsort(samples, count, sizeof(uint64_t), compare_ui64);
+  for (i = 0; i < count; i++)
+  {
+    sum += samples[i];
+  }
+
+  pct->count = count;
+  pct->min = samples[0];
+  pct->p50 = nearest_rank(samples, count, 500);
+  pct->p90 = nearest_rank(samples, count, 900);
+  pct->p99 = nearest_rank(samples, count, 990);
+  pct->p999 = nearest_rank(samples, count, 999);
+  pct->max = samples[count - 1];
+  pct->mean = sum / count;
+}
+
+
+void print_percentiles(FILE *stream, const char *label, 
+ const percentiles_t *pct, uint64_t scale)
+{
+  /* Check parameters */
+  if (NULL == stream || NULL == label || NULL == pct)
+  {
+    return;
+  }
+
+  if (0 == scale)
+  {
+    scale = 1;
+  }
+
+  fprintf(stream, "%-10s n=%-6zu min %-8llu p50 %-8llu p90 %-8llu "
+   "p99 %-8llu p99.9 %-8llu max %-8llu mean %llu\n", label, pct->count, 
+   (unsigned long long)(pct->min / scale), 
+   (unsigned long long)(pct->p50 / scale), 
+   (unsigned long long)(pct->p90 / scale), 
+   (unsigned long long)(pct->p99 / scale), 
+   (unsigned long long)(pct->p999 / scale), 
+   (unsigned long long)(pct->max / scale), 
+   (unsigned long long)(pct->mean / scale));
+}
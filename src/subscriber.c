@@ -29,29 +29,145 @@
  * $Author$
  */
 
+#include "diff.h"
 #include "goose.h"
+#include "ids.h"
+#include "log.h"
+#include "probes.h"
+#include "prp.h"
+#include "replay.h"
 #include "subscriber.h"
+#include "sv.h"
+#include "transport.h"
 #include "types.h"
+#include "utctime.h"
 #include "utils.h"
 
 #include <arpa/inet.h>
 #include <net/ethernet.h>
 #include <pcap.h>
+#include <poll.h>
+#include <sched.h>
 #include <string.h>
 
 
+/*
+ * Constants
+ */
+
+/** Longest wait for either LAN before checking for a break, in ms
+ */
+#define PRP_POLL_MS 100
+
+
+/** State of one LAN of a PRP subscription, passed to the capture handler
+ */
+typedef struct _prp_lan_t_ {
+  prp_table_t *table;       /* Duplicate table shared by both LANs */
+  uint8_t lan;              /* PRP_LAN_A or PRP_LAN_B */
+  pcap_handler handler;     /* Handler of the frames passed on */
+  u_char *user;             /* Argument passed to the handler */
+  int *passed;              /* Number of frames passed on by both LANs */
+} prp_lan_t;
+
+
+
+/*
+ * Global variables
+ */
+
+/** Streams printed by goose_handler_print() on this thread, so that the 
+ * dataset of a retransmission is not decoded again
+ */
+static __thread goose_lazy_t PRINT_LAZY;
+
+
+
 /*
  * Function definitions
  */
 
+int goose_decode_lazy(goose_lazy_t *lazy, const uint8_t *packet, 
+ size_t caplen, goose_view_t *view)
+{
+  /* Check parameters */
+  if (NULL == lazy || NULL == packet || NULL == view)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  lazy_stream_t *stream = NULL;              /* Stream of the frame, if any */
+  size_t i = 0;                                            /* Stream index */
+  uint64_t changed[DIFF_MASK_WORDS];        /* Entries changed by the state */
+  const uint64_t *mask = NULL;                  /* changed, if it was found */
+  size_t num_entries = 0;                     /* Entries of the new state */
+
+  if (0 != decode_goose_header(packet, caplen, view))
+  {
+    return -1;
+  }
+  lazy->frames++;
+
+  /* A subscriber has a handful of streams, a scan is cheaper than a lookup */
+  for (i = 0; i < lazy->count; i++)
+  {
+    stream = &(lazy->stream[i]);
+    if (stream->appid == view->appid && stream->ref_len == view->gocbrefLen 
+     && 0 == memcmp(stream->ref, view->gocbref, view->gocbrefLen))
+    {
+      if (stream->stNum == view->stNum)
+      {
+        return 0;
+      }
+      break;
+    }
+  }
+
+  /* New state, or new stream, so decode the rest and remember the state */
+  if (0 != decode_goose_body(view))
+  {
+    return -1;
+  }
+  lazy->changes++;
+  if (i == lazy->count && LAZY_MAX_STREAMS > lazy->count 
+   && REPLAY_MAX_REF_LEN >= view->gocbrefLen)
+  {
+    stream = &(lazy->stream[lazy->count++]);
+    stream->appid = view->appid;
+    stream->ref_len = (uint8_t)view->gocbrefLen;
+    memcpy(stream->ref, view->gocbref, view->gocbrefLen);
+  }
+  if (i < lazy->count)
+  {
+    stream->stNum = view->stNum;
+  }
+
+  /* Pass on the entries that changed, if the states are kept */
+  if (NULL != lazy->on_change)
+  {
+    num_entries = view->numDatSetEntries;
+    if (NULL != lazy->diff && i < lazy->count 
+     && 0 == diff_update(&(lazy->diff[i]), view->allData, view->allDataLen, 
+      changed, &num_entries))
+    {
+      mask = changed;
+    }
+    lazy->on_change(lazy->user, view, mask, num_entries);
+  }
+
+  /* Done */
+  return 1;
+}
+
+
 void goose_handler_print(u_char *args, const struct pcap_pkthdr *header, 
  const u_char *packet) 
 {
   /* Check parameters */
   if (NULL == header || NULL == packet)
   {
-    fprintf(stderr, "ERROR: invalid parameters\n"); 
-    fflush(stderr);
+    LOG_EVENT(LOG_EV_INVALID_PARAMS, 0);
     return;
   }
 
@@ -61,154 +177,268 @@ void goose_handler_print(u_char *args, const struct pcap_pkthdr *header,
   }
 
   /* Declare local variables */
-  int len = 0;             /* Variable to hold number of bytes read off wire */
-  struct ether_header *eth_hdr = NULL;         /* Pointer to ethernet header */
-  goose_header_t *goose_hdr = NULL;               /* Pointer to GOOSE header */
-  uint8_t *goose_pdu_ptr = NULL;               /* Pointer into the GOOSE PDU */
-  uint8_t *goose_pdu_elem_ptr = NULL;   /* Temp pointer to GOOSE PDU element */
-  uint8_t *len_ptr = NULL;         /* Pointer to length of GOOSE PDU element */
-  //uint8_t *val_ptr = NULL;          /* Pointer to value of GOOSE PDU element */
-  //uint8_t *tmp_val_ptr = NULL;    /* Temp Pointer to reversed bytes of value */
-
-  /* Initialise variables */
-  len = header->len; /* Get number of bytes */
-  if (0 == len) {
-    fprintf(stderr, "ERROR: frame length zero\n"); 
-    fflush(stderr);
+  const uint8_t *payload = NULL;    /* Pointer to payload after any 802.1Q tag */
+  uint16_t ethertype = 0;             /* Ethertype of the (untagged) payload */
+  uint16_t tci = 0;                 /* 802.1Q tag control information, or 0 */
+  goose_view_t view;                          /* View of the decoded frame */
+  const uint8_t *ptr = NULL;                 /* Pointer to the current entry */
+  const uint8_t *end = NULL;                               /* End of allData */
+  size_t len = 0;                             /* Length of the current entry */
+  uint8_t len_size = 0;              /* Number of octets in the length field */
+  uint64_t t = 0;                              /* UtcTime in ns since epoch */
+  uint8_t quality = 0;                           /* TimeQuality of the UtcTime */
+  int changed = 0;              /* Non-zero if the frame changes the state */
+
+  /* Nothing is formatted here, each part of the frame is one binary record 
+   * which the log writer thread formats off the receive path */
+  payload = get_ether_payload(packet, header->caplen, &ethertype, &tci);
+  if (NULL == payload || ETHER_GOOSE != ethertype)
+  {
+    return;
+  }
+  changed = goose_decode_lazy(&PRINT_LAZY, packet, header->caplen, &view);
+  if (changed < 0)
+  {
+    LOG_EVENT(LOG_EV_GOOSE_MALFORMED, header->caplen);
     return;
   }
 
-  /* Get ethernet frame */
-  eth_hdr = (struct ether_header *)packet; 
-
-  /* Determine type of ethernet frame */
-  switch (ntohs(eth_hdr->ether_type)) {
-    /* Process VLAN encapsulated frame */
-    /* Process GOOSE frame */
-    case 0x88b8:
-      fprintf(stdout, "-- GOOSE FRAME START --\n"); 
-
-      /* Print ethernet header */
-      fprintf(stdout, "Ethernet\n");
-      fprintf(stdout, "dst: "); print_mac(eth_hdr->ether_dhost);
-      fprintf(stdout, "\nsrc: "); print_mac(eth_hdr->ether_shost);
-      fprintf(stdout, "\ntype: 0x%04x\n", ntohs(eth_hdr->ether_type)); 
-
-      /* Print GOOSE header */
-      fprintf(stdout, "GOOSE\n");
-      goose_hdr = (goose_header_t *)(packet + sizeof(struct ether_header));
-      fprintf(stdout, "\tappid:\t\t0x%04x\n", ntohs(goose_hdr->appid)); 
-      fprintf(stdout, "\tlen:\t\t%hu\n", ntohs(goose_hdr->len)); 
-      fprintf(stdout, "\tres1:\t\t0x%04x\n", ntohs(goose_hdr->res1)); 
-      fprintf(stdout, "\tres2:\t\t0x%04x\n", ntohs(goose_hdr->res2)); 
-
-      /* Print GOOSE PDU */
-      fprintf(stdout, "\tgoosePDU\n");
-      goose_pdu_ptr = (((uint8_t *)goose_hdr) + sizeof(goose_header_t));
-
-      /* Get first GOOSE PDU element, note that the Magic 2 is because we want 
-       * to skip the preamble and the PDU length */
-      goose_pdu_elem_ptr = goose_pdu_ptr + 2;
-
-      /* Print gocbRef */
-      // TODO: Implement better handling for multi-byte lengths
-      len_ptr = goose_pdu_elem_ptr + 1; 
-      fprintf(stdout, "\t\tgocbref: "); 
-      print_goose_pdu_elem_str(goose_pdu_elem_ptr);
-      fprintf(stdout, "\n");
-      /* Magic 2 is 1 byte for tag and 1 byte for length */
-      goose_pdu_elem_ptr = goose_pdu_elem_ptr + (*len_ptr) + 2;
-
-      /* Print timeAllowedtoLive */
-      len_ptr = goose_pdu_elem_ptr + 1;
-      fprintf(stdout, "\t\ttatL: "); 
-      fprintf(stdout, "[to be implemented]");
-      fprintf(stdout, "\n");
-      goose_pdu_elem_ptr = goose_pdu_elem_ptr + (*len_ptr) + 2;
-
-      /* Print datSet */
-      len_ptr = goose_pdu_elem_ptr + 1;
-      fprintf(stdout, "\t\tdatSet: "); 
-      print_goose_pdu_elem_str(goose_pdu_elem_ptr);
-      fprintf(stdout, "\n");
-      goose_pdu_elem_ptr = goose_pdu_elem_ptr + (*len_ptr) + 2;
-
-      /* Print goID */
-      len_ptr = goose_pdu_elem_ptr + 1;
-      fprintf(stdout, "\t\tgoID: "); 
-      print_goose_pdu_elem_str(goose_pdu_elem_ptr);
-      fprintf(stdout, "\n");
-      goose_pdu_elem_ptr = goose_pdu_elem_ptr + (*len_ptr) + 2;
-
-      /* Print t */
-      len_ptr = goose_pdu_elem_ptr + 1;
-      fprintf(stdout, "\t\tt: "); 
-      fprintf(stdout, "[to be implemented]");
-      fprintf(stdout, "\n");
-      goose_pdu_elem_ptr = goose_pdu_elem_ptr + (*len_ptr) + 2;
-
-      /* Print stNum */
-      len_ptr = goose_pdu_elem_ptr + 1;
-      //fprintf(stdout, "\t\tstNum: %hu\n", ntohs(goose_pdu_elem_ptr+2)); 
-      fprintf(stdout, "\t\tstNum: ");
-      switch (*len_ptr)
-      {
-        case 1:
-          fprintf(stdout, "%hhu", (*(len_ptr+1)));
-          break;
-        default:
-          fprintf(stdout, "[undefined]");
-      }
-      fprintf(stdout, "\n");
-      goose_pdu_elem_ptr = goose_pdu_elem_ptr + (*len_ptr) + 2;
-
-      /* Print sqNum */
-      len_ptr = goose_pdu_elem_ptr + 1;
-      //fprintf(stdout, "\t\tsqNum: %hu\n", ntohs(goose_pdu_elem_ptr+2)); 
-      fprintf(stdout, "\t\tsqNum: ");
-      switch (*len_ptr)
-      {
-        case 1:
-          fprintf(stdout, "%hhu", (*(len_ptr+1)));
-          break;
-        default:
-          fprintf(stdout, "[undefined]");
-      }
-      fprintf(stdout, "\n");
-      goose_pdu_elem_ptr = goose_pdu_elem_ptr + (*len_ptr) + 2;
-
-      /* Print test */
-      len_ptr = goose_pdu_elem_ptr + 1;
-      fprintf(stdout, "test: %s\n", ((*goose_pdu_elem_ptr) ? "true" : "false")); 
-      goose_pdu_elem_ptr = goose_pdu_elem_ptr + (*len_ptr) + 2;
-
-      /* Print confRev */
-      len_ptr = goose_pdu_elem_ptr + 1;
-      fprintf(stdout, "\t\tconfrev: %d\n", goose_pdu_elem_ptr[2]); 
-      goose_pdu_elem_ptr = goose_pdu_elem_ptr + (*len_ptr) + 2;
-
-      /* Print ndsCom */
-      len_ptr = goose_pdu_elem_ptr + 1;
-      fprintf(stdout, "\t\tndsCom: %s\n", ((*goose_pdu_elem_ptr) ? "true" : "false")); 
-      goose_pdu_elem_ptr = goose_pdu_elem_ptr + (*len_ptr) + 2;
-
-      /* Print numDatSetEntries */
-      len_ptr = goose_pdu_elem_ptr + 1;
-      fprintf(stdout, "\t\tnumEntires: %d\n", goose_pdu_elem_ptr[2]); 
-      goose_pdu_elem_ptr = goose_pdu_elem_ptr + (*len_ptr) + 2;
-
-      fprintf(stdout, "-- GOOSE FRAME END --\n"); 
-      break;
-    /* Ignore all other frames */
-    default:
+  /* Print ethernet and GOOSE headers */
+  LOG_EVENT(LOG_EV_GOOSE_ETH, 
+   ((uint64_t)packet[0] << 40) | ((uint64_t)packet[1] << 32) 
+   | ((uint64_t)packet[2] << 24) | ((uint64_t)packet[3] << 16) 
+   | ((uint64_t)packet[4] << 8) | packet[5], 
+   ((uint64_t)packet[6] << 40) | ((uint64_t)packet[7] << 32) 
+   | ((uint64_t)packet[8] << 24) | ((uint64_t)packet[9] << 16) 
+   | ((uint64_t)packet[10] << 8) | packet[11], 
+   tci & 0x0fff, tci >> 13, ethertype);
+  LOG_EVENT(LOG_EV_GOOSE_HDR, view.appid, view.len, view.res1, 
+   (view.goose_hdr[6] << 8) | view.goose_hdr[7]);
+
+  /* Print GOOSE PDU */
+  LOG_TEXT(LOG_EV_GOOSE_GOCBREF, view.gocbref, view.gocbrefLen);
+  LOG_TEXT(LOG_EV_GOOSE_DATSET, view.datSet, view.datSetLen);
+  if (NULL != view.goID)
+  {
+    LOG_TEXT(LOG_EV_GOOSE_GOID, view.goID, view.goIDLen);
+  }
+  t = utc_time_decode(view.t, &quality);
+  LOG_EVENT(LOG_EV_GOOSE_TIME, view.timeAllowedtoLive, t / 1000000000ULL, 
+   t % 1000000000ULL, quality);
+  if (!changed)
+  {
+    LOG_EVENT(LOG_EV_GOOSE_REPEAT, view.stNum, view.sqNum);
+    return;
+  }
+  LOG_EVENT(LOG_EV_GOOSE_STATE, view.stNum, view.sqNum, view.test, 
+   view.confRev, view.ndsCom, view.numDatSetEntries);
+
+  /* Print allData, walking the entries in place as only the tag and length 
+   * of each is printed, so a dataset of any size is printed without an 
+   * entry array */
+  ptr = view.allData;
+  end = (NULL == ptr) ? NULL : ptr + view.allDataLen;
+  while (ptr < end)
+  {
+    len_size = ber_len_from_bytes(ptr + 1, (size_t)(end - ptr) - 1, &len);
+    if (0 == len_size || len > (size_t)(end - ptr) - 1 - len_size)
+    {
+      LOG_EVENT(LOG_EV_GOOSE_MALFORMED, header->caplen);
       break;
+    }
+    LOG_EVENT(LOG_EV_GOOSE_ENTRY, ptr[0], len);
+    ptr += 1 + len_size + len;
   }
 
-  fflush(stdout);
   return; /* Done handling frame */
 }
 
 
+int authenticate_goose_frame(const goose_sec_t *sec, replay_table_t *replay, 
+ const u_char *packet, size_t caplen)
+{
+  /* Declare local variables */
+  const uint8_t *goose_hdr = NULL;            /* Pointer to the GOOSE header */
+  uint16_t ethertype = 0;                 /* Ethertype of the received frame */
+  goose_view_t view;                               /* Decoded GOOSE frame */
+  replay_stream_t *stream = NULL;        /* Replay state of the frame stream */
+  replay_verdict_t verdict = REPLAY_OK;          /* Result of replay check */
+
+  /* Locate the GOOSE header, after any 802.1Q tag */
+  goose_hdr = get_ether_payload(packet, caplen, &ethertype, NULL);
+  if (NULL == goose_hdr || ETHER_GOOSE != ethertype 
+   || caplen < (size_t)(goose_hdr - packet) + GOOSE_HDR_LEN)
+  {
+    return -1;
+  }
+
+  /* Check if a protected checksum is present */
+  if (0 == (ntohs(((const goose_header_t *)goose_hdr)->res1) 
+   & GOOSE_RES1_PROTECTED))
+  {
+    return (NULL == sec || sec->unprotected) ? 1 : -2;
+  }
+
+  if (NULL == sec)
+  {
+    return -2;
+  }
+
+  /* Reject replayed frames before spending time on the checksum */
+  if (NULL != replay)
+  {
+    if (decode_goose_header(packet, caplen, &view))
+    {
+      return -1;
+    }
+    verdict = replay_check(replay, &view, &stream);
+    if (REPLAY_OK != verdict && REPLAY_RESYNC != verdict)
+    {
+      return -3;
+    }
+  }
+
+  /* Check if the protected checksum is correct */
+  if (0 != verify_protected_checksum(sec, goose_hdr, 
+   caplen - (size_t)(goose_hdr - packet)))
+  {
+    return -1;
+  }
+
+  /* Done, unless the frame only counts towards resynchronising its stream */
+  if (NULL != replay && 1 == replay_update(replay, stream, &view))
+  {
+    return -3;
+  }
+  return 0;
+}
+
+
+#ifdef GOOSE_PROBES
+/** Handler of a subscription and its user argument, so that the receive 
+ * probe fires before each frame is handled. It is only put in the path of 
+ * the frames while a tracer is attached to the probe.
+ */
+typedef struct _probe_ctx_t_ {
+  pcap_handler handler;         /* Handler of the subscription */
+  u_char *user;                 /* User argument of the handler */
+} probe_ctx_t;
+
+
+/**
+ * Packet handler callback function to fire the receive probe and pass the 
+ * frame to the handler of the subscription
+ */
+static void probe_frame(u_char *args, const struct pcap_pkthdr *header, 
+ const u_char *packet)
+{
+  /* Declare local variables */
+  probe_ctx_t *ctx = (probe_ctx_t *)args;            /* Subscription */
+
+  GOOSE_PROBE(receive, header->caplen);
+  ctx->handler(ctx->user, header, packet);
+}
+#endif
+
+
+/**
+ * Function to pass each frame of a batch to a packet handler, which takes a 
+ * pcap header
+ */
+static void transport_pass(const transport_frame_t *frames, int n, 
+ pcap_handler handler, u_char *user)
+{
+  /* Declare local variables */
+  struct pcap_pkthdr header;                /* Header passed to handlers */
+  int i = 0;                                              /* Frame index */
+
+  for (i = 0; i < n; i++)
+  {
+    header.ts = frames[i].ts;
+    header.caplen = frames[i].len;
+    header.len = frames[i].len;
+    handler(user, &header, frames[i].data);
+  }
+}
+
+
+/**
+ * Function to receive frames from a transport and pass each to a packet 
+ * handler, see subscribe_transport()
+ *
+ * @return int	number of frames handled, else -1
+ */
+static int transport_loop(transport_t *tp, int count, int timeout_ms, 
+ pcap_handler handler, u_char *user)
+{
+  /* Declare local variables */
+  transport_frame_t frames[TRANSPORT_BATCH_MAX];      /* Frames received */
+  int handled = 0;                           /* Number of frames handled */
+  int max = 0;                         /* Frames to receive in this batch */
+  int n = 0;                                 /* Frames of this batch */
+
+  while (0 == count || handled < count)
+  {
+    /* Do not take more frames than are wanted from the transport */
+    max = (0 == count || count - handled > TRANSPORT_BATCH_MAX) 
+     ? TRANSPORT_BATCH_MAX : count - handled;
+    n = transport_recv_batch(tp, frames, max, timeout_ms);
+    if (n < 0)
+    {
+      return -1;
+    }
+
+    /* With no time limit only a break ends the loop early */
+    if (0 == n)
+    {
+      if (timeout_ms >= 0 || __atomic_load_n(&tp->stop, __ATOMIC_RELAXED))
+      {
+        return handled;
+      }
+      continue;
+    }
+
+    transport_pass(frames, n, handler, user);
+    handled += n;
+  }
+
+  /* Done */
+  return handled;
+}
+
+
+/**
+ * Function to receive frames from a packet capture descriptor, through its 
+ * transport, and pass each to a packet handler, see subscribe()
+ *
+ * @return int	-1 on error, -2 on a break, else 0
+ */
+static int subscribe_pcap(pcap_t *pcap_ptr, int count, pcap_handler handler, 
+ u_char *user)
+{
+  /* Declare local variables */
+  transport_t tp;                        /* Transport of the descriptor */
+  int ret = 0; /* Variable to hold return value from function calls */
+
+  transport_pcap_attach(&tp, pcap_ptr);
+  ret = transport_loop(&tp, (count < 0) ? 0 : count, -1, handler, user);
+
+  /* Check return value, an error is reported by the transport */
+  if (-1 != ret && __atomic_load_n(&tp.stop, __ATOMIC_RELAXED)) {
+    /* pcap_breakloop called, or the capture file ended */
+    fprintf(stderr, "ERROR: pcap_loopbreak called\n");
+    ret = -2;
+  } else if (-1 != ret) {
+    ret = 0;
+  }
+  transport_close(&tp);
+
+  /* Done */
+  fflush(stderr);
+  return ret;
+}
+
+
 int subscribe(uint8_t *mac_ptr, pcap_t *pcap_ptr, int count, 
  pcap_handler goose_handler) 
 {
@@ -223,31 +453,320 @@ int subscribe(uint8_t *mac_ptr, pcap_t *pcap_ptr, int count,
     return -1;
   }
 
-  /* Clamp count value to zero */
-  if (count < 0)
+  /* Decode the GOOSE frame received */
+#ifdef GOOSE_PROBES
+  probe_ctx_t ctx = { goose_handler, (u_char *)mac_ptr };   /* Subscription */
+  if (GOOSE_PROBE_ENABLED(receive))
   {
-    count = 0;
+    return subscribe_pcap(pcap_ptr, count, probe_frame, (u_char *)&ctx);
+  }
+#endif
+  return subscribe_pcap(pcap_ptr, count, goose_handler, (u_char *)mac_ptr);
+}
+
+
+int dispatch_register(dispatch_table_t *table, uint16_t ethertype, 
+ ether_handler_t handler, void *user)
+{
+  /* Check parameters */
+  if (NULL == table || NULL == handler)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
   }
 
   /* Declare local variables */
-  int ret = 0; /* Variable to hold return value from function calls */
+  size_t i = 0;                                            /* Entry index */
 
-  /* Decode the GOOSE frame received */
-#if 0
-  /* DEBUG */ printf("waiting for packets\n");
-#endif
-  ret = pcap_loop(pcap_ptr, count, goose_handler, (u_char *)mac_ptr);
+  for (i = 0; i < table->count; i++)
+  {
+    if (table->entry[i].ethertype == ethertype)
+    {
+      break;
+    }
+  }
+  if (DISPATCH_MAX_ENTRIES == i)
+  {
+    fprintf(stderr, "ERROR: dispatch table full\n");
+    return -1;
+  }
 
-  /* Check return value */
-  if (-2  == ret) {
-    /* pcap_loopbreak called */
-    fprintf(stderr, "ERROR: pcap_loopbreak called\n");
-  } else if (-1  == ret) {
-    /* error while reading frame */
+  table->entry[i].ethertype = ethertype;
+  table->entry[i].handler = handler;
+  table->entry[i].user = user;
+  if (i == table->count)
+  {
+    table->count++;
+  }
+
+  /* Done */
+  return 0;
+}
+
+
+void dispatch_frame(u_char *args, const struct pcap_pkthdr *header, 
+ const u_char *packet)
+{
+  /* Check parameters */
+  if (NULL == args || NULL == header || NULL == packet)
+  {
+    return;
+  }
+
+  /* Declare local variables */
+  dispatch_table_t *table = (dispatch_table_t *)args;  /* Dispatch table */
+  const uint8_t *payload = NULL;    /* Pointer to payload after any 802.1Q tag */
+  uint16_t ethertype = 0;             /* Ethertype of the (untagged) payload */
+  size_t i = 0;                                            /* Entry index */
+
+  payload = get_ether_payload(packet, header->caplen, &ethertype, NULL);
+  if (NULL == payload)
+  {
+    table->unhandled++;
+    return;
+  }
+  GOOSE_PROBE(dispatch, ethertype, header->caplen);
+
+  /* The table is a handful of entries, a scan is cheaper than a lookup */
+  for (i = 0; i < table->count; i++)
+  {
+    if (table->entry[i].ethertype == ethertype)
+    {
+      table->entry[i].handler(table->entry[i].user, header, packet, payload);
+      return;
+    }
+  }
+  table->unhandled++;
+}
+
+
+void goose_dispatch_print(void *user, const struct pcap_pkthdr *header, 
+ const u_char *packet, const uint8_t *payload)
+{
+  (void)payload;
+  goose_handler_print((u_char *)user, header, packet);
+}
+
+
+void record_dispatch(void *user, const struct pcap_pkthdr *header, 
+ const u_char *packet, const uint8_t *payload)
+{
+  /* Declare local variables */
+  record_stage_t *stage = (record_stage_t *)user;        /* Recorder stage */
+
+  recorder_write(stage->rec, packet, header->caplen, header->len, 
+   (uint64_t)header->ts.tv_sec * 1000000000ULL 
+   + (uint64_t)header->ts.tv_usec * stage->ts_scale);
+  if (NULL != stage->next)
+  {
+    stage->next(stage->user, header, packet, payload);
+  }
+}
+
+
+void ids_dispatch(void *user, const struct pcap_pkthdr *header, 
+ const u_char *packet, const uint8_t *payload)
+{
+  /* Declare local variables */
+  ids_stage_t *stage = (ids_stage_t *)user;                   /* IDS stage */
+
+  ids_check(stage->ids, packet, header->caplen, 
+   (uint64_t)header->ts.tv_sec * 1000000000ULL 
+   + (uint64_t)header->ts.tv_usec * stage->ts_scale);
+  if (NULL != stage->next)
+  {
+    stage->next(stage->user, header, packet, payload);
+  }
+}
+
+
+int goose_filter(pcap_t *pcap_ptr)
+{
+  /* Check paramaters */
+  if (NULL == pcap_ptr) {
+    fprintf(stderr, "ERROR: interface not initialised\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  struct bpf_program prog;                           /* Compiled filter */
+  int ret = 0;                        /* Return value from function calls */
+
+  if (0 != pcap_compile(pcap_ptr, &prog, 
+   "ether proto 0x88b8 or (vlan and ether proto 0x88b8)", 1, 
+   PCAP_NETMASK_UNKNOWN))
+  {
     fprintf(stderr, "ERROR: %s\n", pcap_geterr(pcap_ptr));
+    return -1;
   }
+  ret = pcap_setfilter(pcap_ptr, &prog);
+  if (0 != ret)
+  {
+    fprintf(stderr, "ERROR: %s\n", pcap_geterr(pcap_ptr));
+  }
+  pcap_freecode(&prog);
 
   /* Done */
-  fflush(stderr);
   return ret;
 }
+
+
+void sv_dispatch_decode(void *user, const struct pcap_pkthdr *header, 
+ const u_char *packet, const uint8_t *payload)
+{
+  (void)payload;
+  decode_sv_frame(packet, header->caplen, (sv_sub_t *)user);
+}
+
+
+int subscribe_dispatch(pcap_t *pcap_ptr, int count, dispatch_table_t *table)
+{
+  /* Check paramaters */
+  if (NULL == pcap_ptr) {
+    fprintf(stderr, "ERROR: interface not initialised\n");
+    return -1;
+  }
+
+  if (NULL == table) {
+    fprintf(stderr, "ERROR: dispatch table not initialised\n");
+    return -1;
+  }
+
+  return subscribe_pcap(pcap_ptr, count, dispatch_frame, (u_char *)table);
+}
+
+
+/**
+ * Packet handler callback function to drop the second copy of a PRP frame 
+ * and pass the first, trimmed of its trailer, to the handler of the 
+ * subscription
+ */
+static void prp_frame(u_char *args, const struct pcap_pkthdr *header, 
+ const u_char *packet)
+{
+  /* Declare local variables */
+  prp_lan_t *ctx = (prp_lan_t *)args;                     /* LAN state */
+  struct pcap_pkthdr trimmed;               /* Header without the trailer */
+  size_t len = 0;                      /* Length without the trailer */
+
+  GOOSE_PROBE(receive, header->caplen);
+  if (PRP_DUPLICATE == prp_discard(ctx->table, packet, header->caplen, 
+   ctx->lan, &len))
+  {
+    return;
+  }
+
+  trimmed = *header;
+  trimmed.len -= (uint32_t)(header->caplen - len);
+  trimmed.caplen = (uint32_t)len;
+  (*ctx->passed)++;
+  ctx->handler(ctx->user, &trimmed, packet);
+}
+
+
+int subscribe_prp(transport_t *lan_a, transport_t *lan_b, int count, 
+ prp_table_t *table, pcap_handler handler, u_char *user)
+{
+  /* Check paramaters */
+  if (NULL == lan_a || NULL == lan_b) {
+    fprintf(stderr, "ERROR: interface not initialised\n");
+    return -1;
+  }
+
+  if (NULL == table || NULL == handler) {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  /* Clamp count value to zero */
+  if (count < 0)
+  {
+    count = 0;
+  }
+
+  /* Declare local variables */
+  transport_t *tp[2] = { lan_a, lan_b };        /* Transport of each LAN */
+  transport_frame_t frames[TRANSPORT_BATCH_MAX];      /* Frames received */
+  struct pollfd fds[2];                  /* Selectable descriptor of each */
+  prp_lan_t lan[2];                                 /* State of each LAN */
+  int spin = 0;           /* Non-zero if a LAN has no descriptor to poll */
+  int got = 0;                 /* Number of frames received by a round */
+  int passed = 0;                         /* Number of frames passed on */
+  int n = 0;                                 /* Frames of this batch */
+  int i = 0;                                                /* LAN index */
+
+  for (i = 0; i < 2; i++)
+  {
+    /* A descriptor that cannot be polled, -1, is ignored by poll, the LAN 
+     * is then read each round without sleeping */
+    fds[i].fd = transport_fd(tp[i]);
+    fds[i].events = POLLIN;
+    spin |= (fds[i].fd < 0);
+    lan[i].table = table;
+    lan[i].lan = (0 == i) ? PRP_LAN_A : PRP_LAN_B;
+    lan[i].handler = handler;
+    lan[i].user = user;
+    lan[i].passed = &passed;
+  }
+
+  while (0 == count || passed < count)
+  {
+    if (__atomic_load_n(&lan_a->stop, __ATOMIC_RELAXED) 
+     || __atomic_load_n(&lan_b->stop, __ATOMIC_RELAXED))
+    {
+      fprintf(stderr, "ERROR: transport_break called\n");
+      return -2;
+    }
+
+    /* Take a batch from each LAN in turn, so that the copies of a frame 
+     * meet within the duplicate window, and only wait once neither has 
+     * frames left. A break is seen within one poll interval. */
+    got = 0;
+    for (i = 0; i < 2; i++)
+    {
+      n = transport_recv_batch(tp[i], frames, TRANSPORT_BATCH_MAX, 0);
+      if (n < 0)
+      {
+        fprintf(stderr, "ERROR: reading LAN %c\n", 'A' + i);
+        return -1;
+      }
+      transport_pass(frames, n, prp_frame, (u_char *)&lan[i]);
+      got += n;
+    }
+    if (0 == got)
+    {
+      if (spin)
+      {
+        sched_yield();
+      }
+      else
+      {
+        poll(fds, 2, PRP_POLL_MS);
+      }
+    }
+  }
+
+  /* Done */
+  return 0;
+}
+
+
+int subscribe_transport(transport_t *tp, int count, int timeout_ms, 
+ dispatch_table_t *table)
+{
+  /* Check parameters */
+  if (NULL == tp || NULL == table)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  /* Clamp count value to zero */
+  if (count < 0)
+  {
+    count = 0;
+  }
+
+  return transport_loop(tp, count, timeout_ms, dispatch_frame, 
+   (u_char *)table);
+}
@@ -0,0 +1,682 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "sv.h"
+#include "types.h"
+#include "utils.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_SV_SIMD 1
+#include <immintrin.h>
+#endif
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to write a 32-bit value in network byte order
+ */
+static void put_ui32(uint8_t *addr, uint32_t val)
+{
+  addr[0] = (uint8_t)(val >> 24);
+  addr[1] = (uint8_t)(val >> 16);
+  addr[2] = (uint8_t)(val >> 8);
+  addr[3] = (uint8_t)val;
+}
+
+
+void encode_sv_frame(sv_frame_t *sv_frame, uint8_t *encoded_data, 
+  uint16_t *encoded_len)
+{
+  /* Check parameter */
+  if (NULL == sv_frame || NULL == encoded_data || NULL == sv_frame->svID 
+   || 0 == sv_frame->noASDU || sv_frame->noASDU > SV_MAX_ASDU)
+  {
+    *encoded_len = 0;
+    return;
+  }
+
+  /* Declare local variables */
+  uint8_t *buffer = encoded_data;      /* Buffer to contain the encoded data */
+  size_t offset = 0;                               /* Offset into the buffer */
+  size_t hdr_offset = 0;                 /* Offset of the sampled values header */
+  size_t id_len = strlen((const char *)sv_frame->svID);   /* svID length */
+  size_t ds_len = 0;                                      /* datSet length */
+  size_t asdu_len = 0;                          /* Length of each ASDU */
+  size_t seq_len = 0;                              /* Length of seqASDU */
+  size_t pdu_len = 0;                               /* Length of savPdu */
+  uint8_t i = 0;                                       /* ASDU index */
+
+  /* Work out the lengths up front, every ASDU has the same length */
+  asdu_len = 1 + ber_len_size(id_len) + id_len  /* svID */
+   + 4                                          /* smpCnt */
+   + 6                                          /* confRev */
+   + 3                                          /* smpSynch */
+   + 2 + SV_SEQDATA_LEN;                        /* seqData */
+  if (NULL != sv_frame->datSet)
+  {
+    ds_len = strlen((const char *)sv_frame->datSet);
+    asdu_len += 1 + ber_len_size(ds_len) + ds_len;
+  }
+  if (0 != sv_frame->smpRate)
+  {
+    asdu_len += 4;
+  }
+  seq_len = sv_frame->noASDU * (1 + ber_len_size(asdu_len) + asdu_len);
+  pdu_len = 3 + 1 + ber_len_size(seq_len) + seq_len;
+  if (ETHER_HDR_LEN + VLAN_TAG_LEN + GOOSE_HDR_LEN + 1 + ber_len_size(pdu_len)
+   + pdu_len > MAX_FRAME_SIZE)
+  {
+    *encoded_len = 0;
+    return;
+  }
+
+  /* Encode the ethernet header */
+  offset += encode_ether_vlan(&(sv_frame->eth_hdr), &(sv_frame->vlan), buffer);
+
+  /* Encode the header */
+  hdr_offset = offset;
+  memcpy(buffer+offset, &(sv_frame->sv_header), sizeof(goose_header_t));
+  offset += sizeof(goose_header_t);
+
+  /* Encode the savPdu */
+  buffer[offset++] = SV_PREAMBLE;
+  offset += ber_len_to_bytes(pdu_len, buffer+offset);
+  buffer[offset++] = 0x80; /* noASDU */
+  buffer[offset++] = 0x1;
+  buffer[offset++] = sv_frame->noASDU;
+  buffer[offset++] = 0xa2; /* seqASDU */
+  offset += ber_len_to_bytes(seq_len, buffer+offset);
+
+  for (i = 0; i < sv_frame->noASDU; i++)
+  {
+    buffer[offset++] = 0x30; /* ASDU */
+    offset += ber_len_to_bytes(asdu_len, buffer+offset);
+
+    buffer[offset++] = 0x80; /* svID */
+    offset += ber_len_to_bytes(id_len, buffer+offset);
+    memcpy(buffer+offset, sv_frame->svID, id_len);
+    offset += id_len;
+
+    if (NULL != sv_frame->datSet)
+    {
+      buffer[offset++] = 0x81; /* datSet */
+      offset += ber_len_to_bytes(ds_len, buffer+offset);
+      memcpy(buffer+offset, sv_frame->datSet, ds_len);
+      offset += ds_len;
+    }
+
+    buffer[offset++] = 0x82; /* smpCnt, patched per sample */
+    buffer[offset++] = 0x2;
+    sv_frame->smpCnt_offset[i] = (uint16_t)offset;
+    offset += 2;
+
+    buffer[offset++] = 0x83; /* confRev */
+    buffer[offset++] = 0x4;
+    put_ui32(buffer+offset, sv_frame->confRev);
+    offset += 4;
+
+    buffer[offset++] = 0x85; /* smpSynch, patched per sample */
+    buffer[offset++] = 0x1;
+    offset += 1;
+
+    if (0 != sv_frame->smpRate)
+    {
+      buffer[offset++] = 0x86; /* smpRate */
+      buffer[offset++] = 0x2;
+      buffer[offset++] = (uint8_t)(sv_frame->smpRate >> 8);
+      buffer[offset++] = (uint8_t)(sv_frame->smpRate & 0xff);
+    }
+
+    buffer[offset++] = 0x87; /* seqData, patched per sample */
+    buffer[offset++] = SV_SEQDATA_LEN;
+    sv_frame->data_offset[i] = (uint16_t)offset;
+    offset += SV_SEQDATA_LEN;
+  }
+
+  /* Update the header length, counted from the start of APPID */
+  buffer[hdr_offset + 2] = (uint8_t)((offset - hdr_offset) >> 8);
+  buffer[hdr_offset + 3] = (uint8_t)((offset - hdr_offset) & 0xff);
+
+  /* Fill in the samples */
+  patch_sv_frame(sv_frame, buffer);
+
+  /* Update the encoded buffer length */
+  *encoded_len = (uint16_t)offset;
+  return;
+}
+
+
+void patch_sv_frame(const sv_frame_t *sv_frame, uint8_t *encoded_data)
+{
+  /* Check parameter */
+  if (NULL == sv_frame || NULL == encoded_data)
+  {
+    return;
+  }
+
+  /* Declare local variables */
+  const sv_asdu_t *asdu = NULL;                   /* ASDU being patched */
+  uint8_t *ptr = NULL;                         /* Pointer into the frame */
+  uint8_t i = 0;                                       /* ASDU index */
+  uint8_t j = 0;                                    /* Channel index */
+
+  for (i = 0; i < sv_frame->noASDU; i++)
+  {
+    asdu = &(sv_frame->asdu[i]);
+
+    /* smpCnt, with smpSynch following confRev */
+    ptr = encoded_data + sv_frame->smpCnt_offset[i];
+    ptr[0] = (uint8_t)(asdu->smpCnt >> 8);
+    ptr[1] = (uint8_t)(asdu->smpCnt & 0xff);
+    ptr[10] = asdu->smpSynch;
+
+    /* seqData */
+    ptr = encoded_data + sv_frame->data_offset[i];
+    for (j = 0; j < SV_NUM_CHANNELS; j++)
+    {
+      put_ui32(ptr, (uint32_t)asdu->value[j]);
+      put_ui32(ptr + 4, asdu->quality[j]);
+      ptr += 8;
+    }
+  }
+}
+
+
+/*
+ * Subscriber
+ */
+
+/**
+ * Number of samples behind the newest sample of a stream within which a 
+ * sample is counted as repeated or reordered rather than as a gap
+ */
+#define SV_REORDER_WINDOW 32
+
+
+/**
+ * Function to read a 32-bit value in network byte order
+ */
+static uint32_t get_ui32(const uint8_t *addr)
+{
+  return ((uint32_t)addr[0] << 24) | ((uint32_t)addr[1] << 16) 
+   | ((uint32_t)addr[2] << 8) | (uint32_t)addr[3];
+}
+
+
+/**
+ * Function to extract the values and quality of the channels of seqData, 
+ * portable implementation
+ */
+static void extract_scalar(const uint8_t *seq_data, int32_t *value, 
+ uint32_t *quality)
+{
+  /* Declare local variables */
+  int i = 0;                                              /* Channel index */
+
+  for (i = 0; i < SV_NUM_CHANNELS; i++)
+  {
+    value[i] = (int32_t)get_ui32(seq_data + 8 * i);
+    quality[i] = get_ui32(seq_data + 8 * i + 4);
+  }
+}
+
+
+#ifdef HAVE_SV_SIMD
+
+/**
+ * Function to extract the values and quality of the channels of seqData. The 
+ * four 16 byte loads are byte swapped, then the values and quality are 
+ * separated by shuffling pairs of registers.
+ */
+__attribute__((target("sse4.1")))
+static void extract_sse4(const uint8_t *seq_data, int32_t *value, 
+ uint32_t *quality)
+{
+  /* Declare local variables */
+  const __m128i bswap = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 
+   11, 10, 9, 8, 15, 14, 13, 12);
+  __m128 a = _mm_castsi128_ps(_mm_shuffle_epi8(
+   _mm_loadu_si128((const __m128i *)seq_data), bswap));
+  __m128 b = _mm_castsi128_ps(_mm_shuffle_epi8(
+   _mm_loadu_si128((const __m128i *)(seq_data + 16)), bswap));
+  __m128 c = _mm_castsi128_ps(_mm_shuffle_epi8(
+   _mm_loadu_si128((const __m128i *)(seq_data + 32)), bswap));
+  __m128 d = _mm_castsi128_ps(_mm_shuffle_epi8(
+   _mm_loadu_si128((const __m128i *)(seq_data + 48)), bswap));
+
+  _mm_storeu_ps((float *)value, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+  _mm_storeu_ps((float *)(value + 4), 
+   _mm_shuffle_ps(c, d, _MM_SHUFFLE(2, 0, 2, 0)));
+  _mm_storeu_ps((float *)quality, 
+   _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+  _mm_storeu_ps((float *)(quality + 4), 
+   _mm_shuffle_ps(c, d, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+
+
+/**
+ * Function to extract the values and quality of the channels of seqData. The 
+ * two 32 byte loads are byte swapped, each is permuted into four values and 
+ * four quality words, then the halves are recombined. This is faster than 
+ * gathering the words at a stride of 8 bytes, which AVX2 implements with a 
+ * load per element.
+ */
+__attribute__((target("avx2")))
+static void extract_avx2(const uint8_t *seq_data, int32_t *value, 
+ uint32_t *quality)
+{
+  /* Declare local variables */
+  const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  const __m256i bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 
+   11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 
+   11, 10, 9, 8, 15, 14, 13, 12);
+  __m256i a = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(
+   _mm256_loadu_si256((const __m256i *)seq_data), bswap), split);
+  __m256i b = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(
+   _mm256_loadu_si256((const __m256i *)(seq_data + 32)), bswap), split);
+
+  _mm256_storeu_si256((__m256i *)value, _mm256_permute2x128_si256(a, b, 0x20));
+  _mm256_storeu_si256((__m256i *)quality, 
+   _mm256_permute2x128_si256(a, b, 0x31));
+}
+
+#endif /* HAVE_SV_SIMD */
+
+
+/** Selected sample extraction */
+static void (*SV_EXTRACT)(const uint8_t *, int32_t *, uint32_t *) = NULL;
+static const char *SV_IMPL_NAME = "scalar";
+
+
+int sv_set_impl(sv_impl_t impl)
+{
+  switch (impl)
+  {
+    case SV_IMPL_AUTO:
+#ifdef HAVE_SV_SIMD
+      if (__builtin_cpu_supports("avx2"))
+      {
+        return sv_set_impl(SV_IMPL_AVX2);
+      }
+      if (__builtin_cpu_supports("sse4.1"))
+      {
+        return sv_set_impl(SV_IMPL_SSE4);
+      }
+#endif
+      return sv_set_impl(SV_IMPL_SCALAR);
+    case SV_IMPL_SCALAR:
+      SV_EXTRACT = extract_scalar;
+      SV_IMPL_NAME = "scalar";
+      return 0;
+#ifdef HAVE_SV_SIMD
+    case SV_IMPL_SSE4:
+      if (!__builtin_cpu_supports("sse4.1"))
+      {
+        return -1;
+      }
+      SV_EXTRACT = extract_sse4;
+      SV_IMPL_NAME = "sse4";
+      return 0;
+    case SV_IMPL_AVX2:
+      if (!__builtin_cpu_supports("avx2"))
+      {
+        return -1;
+      }
+      SV_EXTRACT = extract_avx2;
+      SV_IMPL_NAME = "avx2";
+      return 0;
+#endif
+    default:
+      return -1;
+  }
+}
+
+
+const char *sv_impl_name(void)
+{
+  if (NULL == SV_EXTRACT)
+  {
+    sv_set_impl(SV_IMPL_AUTO);
+  }
+  return SV_IMPL_NAME;
+}
+
+
+int sv_sub_init(sv_sub_t *sub, size_t max_streams, uint32_t wrap)
+{
+  /* Check parameters */
+  if (NULL == sub || 0 == max_streams || wrap > 0x10000)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  memset(sub, 0, sizeof(sv_sub_t));
+
+  /* The streams hold 32 byte aligned sample vectors, beyond what malloc 
+   * promises */
+  if (0 != posix_memalign((void **)&sub->streams, _Alignof(sv_stream_t), 
+   max_streams * sizeof(sv_stream_t)))
+  {
+    fprintf(stderr, "ERROR: unable to allocate memory\n");
+    sub->streams = NULL;
+    return -1;
+  }
+  __atomic_fetch_add(&MALLOC_COUNT, 1, __ATOMIC_RELAXED);
+  memset(sub->streams, 0, max_streams * sizeof(sv_stream_t));
+  sub->max_streams = max_streams;
+  sub->wrap = wrap ? wrap : 0x10000;
+
+  if (NULL == SV_EXTRACT)
+  {
+    sv_set_impl(SV_IMPL_AUTO);
+  }
+
+  /* Done */
+  return 0;
+}
+
+
+void sv_sub_free(sv_sub_t *sub)
+{
+  /* Check parameters */
+  if (NULL == sub)
+  {
+    return;
+  }
+
+  FREE(sub->streams);
+  memset(sub, 0, sizeof(sv_sub_t));
+}
+
+
+/**
+ * Function to find the stream of an ASDU, adding it if there is room
+ */
+static sv_stream_t *sv_find_stream(sv_sub_t *sub, uint16_t appid, 
+ const uint8_t *id, size_t id_len)
+{
+  /* Declare local variables */
+  sv_stream_t *stream = NULL;                       /* Stream being matched */
+  size_t i = 0;                                            /* Stream index */
+
+  for (i = 0; i < sub->count; i++)
+  {
+    stream = &sub->streams[i];
+    if (stream->appid == appid && stream->svIDLen == id_len 
+     && 0 == memcmp(stream->svID, id, id_len))
+    {
+      return stream;
+    }
+  }
+
+  if (sub->count == sub->max_streams || id_len > SV_MAX_ID_LEN)
+  {
+    return NULL;
+  }
+
+  stream = &sub->streams[sub->count++];
+  stream->appid = appid;
+  stream->svIDLen = (uint8_t)id_len;
+  memcpy(stream->svID, id, id_len);
+  stream->wrap = sub->wrap;
+  return stream;
+}
+
+
+/**
+ * Function to check the smpCnt of an ASDU against the newest sample of the 
+ * stream, counting any gap
+ *
+ * @return int	- 0 if the sample is new, else -1 if it is repeated or 
+ * 		reordered
+ */
+static int sv_check_smpcnt(sv_stream_t *stream, uint16_t smp_cnt)
+{
+  /* Declare local variables */
+  uint32_t expected = 0;                              /* Next smpCnt due */
+  uint32_t ahead = 0;              /* Samples between expected and smpCnt */
+
+  if (0 == stream->samples)
+  {
+    return 0;
+  }
+
+  expected = ((uint32_t)stream->last_smpCnt + 1) % stream->wrap;
+  if (smp_cnt == expected)
+  {
+    return 0;
+  }
+
+  ahead = ((uint32_t)smp_cnt + stream->wrap - expected) % stream->wrap;
+  if (stream->wrap - ahead <= SV_REORDER_WINDOW)
+  {
+    stream->stale++;
+    return -1;
+  }
+
+  stream->gaps++;
+  stream->missing += ahead;
+  return 0;
+}
+
+
+int decode_sv_frame(const uint8_t *packet, size_t caplen, sv_sub_t *sub)
+{
+  /* Check parameters */
+  if (NULL == packet || NULL == sub || NULL == sub->streams)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  const uint8_t *hdr = NULL;                    /* Pointer to the SV header */
+  const uint8_t *ptr = NULL;               /* Pointer to the current element */
+  const uint8_t *end = NULL;                /* End of the enclosing element */
+  const uint8_t *asdu_end = NULL;                     /* End of the ASDU */
+  const uint8_t *id = NULL;                               /* svID of ASDU */
+  const uint8_t *seq_data = NULL;                      /* seqData of ASDU */
+  size_t id_len = 0;                                  /* Length of svID */
+  size_t seq_len = 0;                              /* Length of seqData */
+  size_t len = 0;                           /* Length of the current element */
+  uint8_t len_size = 0;            /* Number of octets in the length field */
+  uint16_t ethertype = 0;                 /* Ethertype of the received frame */
+  uint16_t appid = 0;                                  /* APPID of frame */
+  int32_t smp_cnt = -1;                     /* smpCnt of ASDU, -1 if absent */
+  sv_stream_t *stream = NULL;                         /* Stream of ASDU */
+  size_t pos = 0;                           /* Index of sample in rings */
+  _Alignas(32) int32_t value[SV_NUM_CHANNELS];    /* Extracted values */
+  _Alignas(32) uint32_t quality[SV_NUM_CHANNELS]; /* Extracted quality */
+  int decoded = 0;                            /* Number of ASDUs decoded */
+  uint8_t tag = 0;                                  /* Tag of the element */
+  size_t i = 0;                                           /* Channel index */
+  size_t channels = 0;                 /* Number of channels in seqData */
+
+  /* Locate the header, bounded by the header length */
+  hdr = get_ether_payload(packet, caplen, &ethertype, NULL);
+  if (NULL == hdr || ETHER_SMV != ethertype)
+  {
+    sub->malformed++;
+    return -1;
+  }
+  caplen -= (size_t)(hdr - packet);
+  len = (caplen >= GOOSE_HDR_LEN) ? (size_t)((hdr[2] << 8) | hdr[3]) : 0;
+  if (len < GOOSE_HDR_LEN + 2 || len > caplen)
+  {
+    sub->malformed++;
+    return -1;
+  }
+  appid = (uint16_t)((hdr[0] << 8) | hdr[1]);
+  ptr = hdr + GOOSE_HDR_LEN;
+  end = hdr + len;
+
+  /* savPdu, then noASDU and seqASDU */
+  if (SV_PREAMBLE != *ptr++)
+  {
+    sub->malformed++;
+    return -1;
+  }
+  len_size = ber_len_from_bytes(ptr, (size_t)(end - ptr), &len);
+  if (0 == len_size || len > (size_t)(end - ptr) - len_size)
+  {
+    sub->malformed++;
+    return -1;
+  }
+  ptr += len_size;
+  end = ptr + len;
+
+  while (ptr < end)
+  {
+    tag = *ptr++;
+    len_size = ber_len_from_bytes(ptr, (size_t)(end - ptr), &len);
+    if (0 == len_size || len > (size_t)(end - ptr) - len_size)
+    {
+      sub->malformed++;
+      return -1;
+    }
+    ptr += len_size;
+    if (0xa2 == tag)
+    {
+      end = ptr + len;
+      break;
+    }
+    ptr += len;
+  }
+  if (0xa2 != tag)
+  {
+    sub->malformed++;
+    return -1;
+  }
+
+  /* Each ASDU of seqASDU */
+  while (ptr < end)
+  {
+    tag = *ptr++;
+    len_size = ber_len_from_bytes(ptr, (size_t)(end - ptr), &len);
+    if (0x30 != tag || 0 == len_size || len > (size_t)(end - ptr) - len_size)
+    {
+      sub->malformed++;
+      return -1;
+    }
+    ptr += len_size;
+    asdu_end = ptr + len;
+
+    /* Find svID, smpCnt and seqData */
+    id = NULL;
+    seq_data = NULL;
+    smp_cnt = -1;
+    while (ptr < asdu_end)
+    {
+      tag = *ptr++;
+      len_size = ber_len_from_bytes(ptr, (size_t)(asdu_end - ptr), &len);
+      if (0 == len_size || len > (size_t)(asdu_end - ptr) - len_size)
+      {
+        sub->malformed++;
+        return -1;
+      }
+      ptr += len_size;
+      switch (tag)
+      {
+        case 0x80: /* svID */
+          id = ptr;
+          id_len = len;
+          break;
+        case 0x82: /* smpCnt */
+          if (2 == len)
+          {
+            smp_cnt = (ptr[0] << 8) | ptr[1];
+          }
+          break;
+        case 0x87: /* seqData */
+          seq_data = ptr;
+          seq_len = len;
+          break;
+        default:
+          break;
+      }
+      ptr += len;
+    }
+    if (NULL == id || NULL == seq_data || smp_cnt < 0 || 0 != (seq_len % 8)
+     || seq_len > SV_SEQDATA_LEN)
+    {
+      sub->malformed++;
+      return -1;
+    }
+
+    /* Match the stream and check for lost samples */
+    stream = sv_find_stream(sub, appid, id, id_len);
+    if (NULL == stream)
+    {
+      sub->dropped++;
+      continue;
+    }
+    if (sv_check_smpcnt(stream, (uint16_t)smp_cnt))
+    {
+      continue;
+    }
+
+    /* Extract the samples into the channel rings */
+    channels = seq_len / 8;
+    if (SV_SEQDATA_LEN == seq_len)
+    {
+      SV_EXTRACT(seq_data, value, quality);
+    }
+    else
+    {
+      for (i = 0; i < channels; i++)
+      {
+        value[i] = (int32_t)get_ui32(seq_data + 8 * i);
+        quality[i] = get_ui32(seq_data + 8 * i + 4);
+      }
+    }
+    pos = (size_t)(stream->samples & (SV_RING_LEN - 1));
+    for (i = 0; i < channels; i++)
+    {
+      stream->value[i][pos] = value[i];
+      stream->quality[i][pos] = quality[i];
+    }
+    stream->smpCnt[pos] = (uint16_t)smp_cnt;
+    stream->last_smpCnt = (uint16_t)smp_cnt;
+    stream->channels = (uint8_t)channels;
+    stream->samples++;
+    decoded++;
+  }
+
+  /* Done */
+  sub->frames++;
+  return decoded;
+}
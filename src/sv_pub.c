@@ -0,0 +1,492 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "goose.h"
+#include "publisher.h"
+#include "stats.h"
+#include "sv.h"
+#include "types.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pcap.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+
+/*
+ * Constants
+ */
+
+/** 
+ * Version of sv_pub utility
+ */
+static const char VER[]="0.1a";
+
+/**
+ * Maximum number of frames whose timing is kept for the jitter report
+ */
+#define MAX_TIMED_FRAMES (1 << 20)
+
+/**
+ * Delay before the first deadline, so that the first frame is not late
+ */
+#define START_DELAY_NS 10000000ULL
+
+/**
+ * Peak current and voltage of the generated waveforms, 100 A and 63.5 kV 
+ * rms, in the 1 mA and 10 mV units of IEC61850-9-2LE
+ */
+#define PEAK_CURRENT 141421.0
+#define PEAK_VOLTAGE 8980256.0
+
+/**
+ * Maximum number of samples before the generated waveforms repeat, the 
+ * sample rate divided by the greatest common divisor of the rate and the 
+ * nominal frequency, bounded by the highest rate
+ */
+#define MAX_WAVE_SAMPLES 15360
+
+
+
+/*
+ * Global variables
+ */
+
+/**
+ * Cleared by the signal handler to stop publishing
+ */
+static volatile sig_atomic_t running = 1;
+
+/**
+ * Samples of the eight channels for one repeat of the waveforms
+ */
+static int32_t WAVE[MAX_WAVE_SAMPLES][SV_NUM_CHANNELS];
+
+
+
+/*
+ * Function prototypes
+ */
+
+/**
+ * Function to display the command usage to stdout
+ */
+void print_usage(void);
+
+/**
+ * Function to stop publishing when interrupted
+ *
+ * @param sig int for the signal number
+ */
+void signal_handler(int sig);
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to generate balanced three phase currents and voltages, with the 
+ * currents lagging by 30 degrees, and the neutrals as the sum of the phases
+ *
+ * @param rate	sample rate in Hz
+ * @param freq	nominal frequency in Hz
+ * @return unsigned int	number of samples before the waveforms repeat
+ */
+static unsigned int generate_waves(unsigned int rate, unsigned int freq)
+{
+  /* Declare local variables */
+  unsigned int a = rate;                        /* Greatest common divisor */
+  unsigned int b = freq;                        /* Greatest common divisor */
+  unsigned int len = 0;                 /* Number of samples in the table */
+  unsigned int i = 0;                                    /* Sample index */
+  unsigned int p = 0;                                     /* Phase index */
+  double angle = 0.0;                     /* Angle of phase A, in radians */
+  double shift = 0.0;                       /* Angle of the phase, radians */
+
+  while (b)
+  {
+    p = a % b;
+    a = b;
+    b = p;
+  }
+  len = rate / a;
+
+  for (i = 0; i < len; i++)
+  {
+    angle = 2.0 * M_PI * (double)freq * (double)i / (double)rate;
+    WAVE[i][3] = 0;
+    WAVE[i][7] = 0;
+    for (p = 0; p < 3; p++)
+    {
+      shift = angle - (2.0 * M_PI * p) / 3.0;
+      WAVE[i][p] = (int32_t)lrint(PEAK_CURRENT * sin(shift - M_PI / 6.0));
+      WAVE[i][4 + p] = (int32_t)lrint(PEAK_VOLTAGE * sin(shift));
+      WAVE[i][3] += WAVE[i][p];
+      WAVE[i][7] += WAVE[i][4 + p];
+    }
+  }
+
+  return len;
+}
+
+
+/**
+ * Function to sleep until the absolute deadline on the monotonic clock, 
+ * spinning for the last part of the wait when spin_ns is not zero
+ *
+ * @param deadline	deadline in ns
+ * @param spin_ns	time before the deadline to stop sleeping and spin
+ */
+static void wait_until(uint64_t deadline, uint64_t spin_ns)
+{
+  /* Declare local variables */
+  struct timespec ts;                           /* Time to sleep until */
+  uint64_t wake = (deadline > spin_ns) ? deadline - spin_ns : 0;
+
+  ts.tv_sec = (time_t)(wake / 1000000000ULL);
+  ts.tv_nsec = (long)(wake % 1000000000ULL);
+  while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) 
+   && running)
+  {
+    /* Resume the sleep if interrupted by anything other than a stop */
+  }
+
+  while (spin_ns && now_ns() < deadline)
+  {
+    /* Spin for the remainder of the wait */
+  }
+}
+
+
+int main(int argc, char *argv[]) 
+{
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  unsigned int rate = 4000;                          /* Sample rate in Hz */
+  unsigned int freq = 50;                      /* Nominal frequency in Hz */
+  int asdus = 0;                /* ASDUs per frame, 0 for the rate default */
+  unsigned int duration = 10;                  /* Seconds to publish for */
+  int vid = -1;              /* 802.1Q VLAN identifier, or -1 for untagged */
+  int prio = 0;                     /* SCHED_FIFO priority, 0 to not change */
+  unsigned int spin_us = 0;         /* Time to spin before each deadline */
+  char *iface = NULL;                          /* Name of network interface */
+
+  /* Check paramaters */
+  while (-1 != (opt = getopt(argc, argv, "A:d:f:P:s:V:w:")))
+  {
+    switch (opt)
+    {
+      case 'A':
+        asdus = atoi(optarg);
+        if (asdus < 1 || asdus > SV_MAX_ASDU)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'd':
+        duration = (unsigned int)atoi(optarg);
+        break;
+      case 'f':
+        freq = (unsigned int)atoi(optarg);
+        if (50 != freq && 60 != freq)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'P':
+        prio = atoi(optarg);
+        if (prio < 1 || prio > 99)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 's':
+        rate = (unsigned int)atoi(optarg);
+        if (4000 != rate && 4800 != rate && 12800 != rate && 14400 != rate 
+         && 15360 != rate)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'V':
+        vid = atoi(optarg);
+        if (vid < 0 || vid > 0x0fff)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 'w':
+        spin_us = (unsigned int)atoi(optarg);
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  if (argc - optind != 1 || 0 == duration) 
+  {
+    print_usage();
+    return -1;
+  }
+  iface = argv[optind];
+
+  /* Default to one ASDU per frame, six at 14400 Hz (See: IEC61869-9), or 
+   * eight at 256 samples per cycle (See: IEC61850-9-2LE) */
+  if (0 == asdus)
+  {
+    asdus = (14400 == rate) ? 6 : (12800 == rate || 15360 == rate) ? 8 : 1;
+  }
+
+  /* Declare local variables */
+  struct sigaction signal_action;                     /* Sigaction structure */
+  struct sched_param param;                         /* Scheduling priority */
+  char errbuf[PCAP_ERRBUF_SIZE] = {0};                  /* PCAP error buffer */
+  pcap_t *pcap = NULL;               /* PCAP handle to the network interface */
+  static sv_frame_t sv_frame;            /* The frame to write to the network */
+  uint8_t buff[MAX_FRAME_SIZE];                /* Encoded sampled values frame */
+  uint16_t len = 0;                              /* Length of encoded frame */
+  uint8_t dmac[6] = { 0x01, 0x0c, 0xcd, 0x04, 0x00, 0x01 };      /* Dest MAC */
+  uint8_t smac[6] = { 0x8, 0x93, 0x01, 0x3e, 0x10, 0x73 };        /* Src MAC */
+  uint8_t svid[] = "MU01";                              /* Sampled values Id */
+  unsigned int wave_len = 0;          /* Samples before the waveforms repeat */
+  unsigned int wave_pos = 0;               /* Next sample of the waveforms */
+  uint16_t smp_cnt = 0;                                 /* Next smpCnt */
+  uint64_t frames = 0;                       /* Number of frames to publish */
+  uint64_t timed = 0;                    /* Number of frames with timings */
+  uint64_t sent = 0;                          /* Number of frames published */
+  uint64_t errors = 0;                  /* Number of frames not published */
+  uint64_t overruns = 0;         /* Frames sent after the next deadline */
+  uint64_t start = 0;                    /* Monotonic time of frame zero */
+  uint64_t deadline = 0;                  /* Deadline of the current frame */
+  uint64_t period = 0;                  /* Nominal frame period, rounded */
+  uint64_t done = 0;                    /* Time the current frame was sent */
+  uint64_t *wake_late = NULL;              /* Wake up time after deadline */
+  uint64_t *send_late = NULL;          /* Frame sent time after deadline */
+  percentiles_t pct;                            /* Summary of a distribution */
+  uint64_t k = 0;                                          /* Frame index */
+  int i = 0;                                               /* ASDU index */
+  int j = 0;                                            /* Channel index */
+
+  /* Initialise sigaction structure */
+  memset(&signal_action, 0, sizeof(struct sigaction));
+  signal_action.sa_handler = &signal_handler;
+  if (-1 == sigaction(SIGINT, &signal_action, (struct sigaction *)NULL))
+  {
+    fprintf(stderr, "[!] unable to register signal handler\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Run ahead of other tasks, and keep the pages resident */
+  if (prio > 0)
+  {
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = prio;
+    if (-1 == sched_setscheduler(0, SCHED_FIFO, &param))
+    {
+      perror("[!] sched_setscheduler");
+    }
+    if (-1 == mlockall(MCL_CURRENT | MCL_FUTURE))
+    {
+      perror("[!] mlockall");
+    }
+  }
+
+  /* Prepare the sampled values frame */
+  memset(&sv_frame, 0, sizeof(sv_frame_t));
+  memcpy(sv_frame.eth_hdr.ether_dhost, dmac, ETHER_ADDR_LEN);
+  memcpy(sv_frame.eth_hdr.ether_shost, smac, ETHER_ADDR_LEN);
+  sv_frame.eth_hdr.ether_type = htons(ETHER_SMV);
+  if (vid >= 0)
+  {
+    sv_frame.vlan.tagged = 1;
+    sv_frame.vlan.vid = (uint16_t)vid;
+    sv_frame.vlan.pcp = GOOSE_DEFAULT_PCP;
+  }
+  sv_frame.sv_header.appid = htons(0x4000);
+  sv_frame.svID = svid;
+  sv_frame.confRev = 1;
+  sv_frame.noASDU = (uint8_t)asdus;
+  encode_sv_frame(&sv_frame, buff, &len);
+  if (0 == len)
+  {
+    fprintf(stderr, "[!] could not encode sampled values frame\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Generate the waveforms once, samples are then copied per frame */
+  wave_len = generate_waves(rate, freq);
+
+  /* Open the network interface specified */
+  pcap = pcap_open_live(iface, BUFSIZ, 0, 0, (char *)&errbuf);
+  if (NULL == pcap)
+  {
+    fprintf(stderr, "[!] could not open pcap (%s - %s)\n", iface, errbuf);
+    exit(EXIT_FAILURE);
+  }
+
+  /* Allocate the timings up front, nothing is allocated while publishing */
+  frames = (uint64_t)duration * rate / (unsigned int)asdus;
+  timed = (frames < MAX_TIMED_FRAMES) ? frames : MAX_TIMED_FRAMES;
+  MALLOC(wake_late, uint64_t, timed * sizeof(uint64_t));
+  MALLOC(send_late, uint64_t, timed * sizeof(uint64_t));
+
+  fprintf(stdout, "[-] publishing %u Hz at %u Hz nominal, %d ASDU per "
+   "frame, %u byte frames, for %u s\n", rate, freq, asdus, len, duration);
+  fflush(stdout);
+
+  /* Publish on absolute deadlines, computed from frame zero so that the 
+   * rounding of the period does not accumulate */
+  period = 1000000000ULL * (unsigned int)asdus / rate;
+  start = now_ns() + START_DELAY_NS;
+  for (k = 0; k < frames && running; k++)
+  {
+    /* Fill in the next samples before waiting */
+    for (i = 0; i < asdus; i++)
+    {
+      sv_frame.asdu[i].smpCnt = smp_cnt;
+      memcpy(sv_frame.asdu[i].value, WAVE[wave_pos], sizeof(WAVE[0]));
+      smp_cnt = (uint16_t)(((unsigned int)smp_cnt + 1 == rate) ? 0 : smp_cnt + 1);
+      wave_pos = (wave_pos + 1 == wave_len) ? 0 : wave_pos + 1;
+      for (j = 0; j < SV_NUM_CHANNELS; j++)
+      {
+        sv_frame.asdu[i].quality[j] = 0;
+      }
+    }
+
+    deadline = start + (k * (unsigned int)asdus * 1000000000ULL) / rate;
+    wait_until(deadline, (uint64_t)spin_us * 1000);
+    if (k < timed)
+    {
+      wake_late[k] = now_ns() - deadline;
+    }
+
+    if (0 == publish_sv(&sv_frame, buff, len, pcap))
+    {
+      sent++;
+    }
+    else
+    {
+      errors++;
+    }
+
+    done = now_ns();
+    if (k < timed)
+    {
+      send_late[k] = done - deadline;
+    }
+    if (done - deadline > period)
+    {
+      overruns++;
+    }
+  }
+
+  /* Report the timing of the frames */
+  if (k < timed)
+  {
+    timed = k;
+  }
+  fprintf(stdout, "[+] published %llu frames, %llu errors, %llu sent after "
+   "the next deadline\n", (unsigned long long)sent, 
+   (unsigned long long)errors, (unsigned long long)overruns);
+  fprintf(stdout, "[=] lateness after deadline in ns\n");
+  compute_percentiles(wake_late, (size_t)timed, &pct);
+  print_percentiles(stdout, "    wake", &pct, 1);
+  compute_percentiles(send_late, (size_t)timed, &pct);
+  print_percentiles(stdout, "    sent", &pct, 1);
+
+  /* Done */
+  FREE(wake_late);
+  FREE(send_late);
+  pcap_close(pcap);
+  fflush(stdout);
+  return 0;
+}
+
+
+void print_usage(void) 
+{
+  fprintf(stdout, "sv_pub, version %s\n\n", VER);
+  fprintf(stdout, "usage: sv_pub [-A asdus] [-d secs] [-f freq] [-P prio] "
+   "[-s rate] [-V vid] [-w us] iface\n\n");
+  fprintf(stdout, "  -A asdus : ASDUs per frame, 1 to %d, default 1, 6 at "
+   "14400 Hz, or 8 at\n       12800 and 15360 Hz\n", SV_MAX_ASDU);
+  fprintf(stdout, "  -d secs : seconds to publish for, default 10\n");
+  fprintf(stdout, "  -f freq : nominal frequency, 50 (default) or 60 Hz\n");
+  fprintf(stdout, "  -P prio : run with SCHED_FIFO priority prio and locked "
+   "memory\n");
+  fprintf(stdout, "  -s rate : sample rate, 4000 (default), 4800, 12800, "
+   "14400 or 15360 Hz\n");
+  fprintf(stdout, "  -V vid : publish 802.1Q tagged frames on VLAN vid with "
+   "priority %u\n", GOOSE_DEFAULT_PCP);
+  fprintf(stdout, "  -w us : spin for the last us microseconds before each "
+   "deadline\n");
+  fprintf(stdout, "  iface : network interface to use\n");
+  fflush(stdout);
+  return;
+}
+
+
+void signal_handler(int sig)
+{
+  (void)sig;
+  running = 0;
+}
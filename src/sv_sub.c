@@ -0,0 +1,380 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "goose.h"
+#include "log.h"
+#include "stats.h"
+#include "subscriber.h"
+#include "sv.h"
+#include "types.h"
+#include "utils.h"
+
+#include <pcap.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+
+
+/*
+ * Constants
+ */
+
+/** 
+ * Version of sv_sub utility
+ */
+static const char VER[]="0.1a";
+
+/**
+ * Number of frames decoded per stream by the benchmark
+ */
+#define BENCH_FRAMES 48000
+
+
+
+/*
+ * Global variables
+ */
+
+/**
+ * Packet capture handle, so that the signal handler can break the loop
+ */
+static pcap_t *PCAP = NULL;
+
+
+
+/*
+ * Function prototypes
+ */
+
+/**
+ * Function to display the command usage to stdout
+ */
+void print_usage(void);
+
+/**
+ * Function to stop subscribing when interrupted or the duration elapses
+ *
+ * @param sig int for the signal number
+ */
+void signal_handler(int sig);
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to print the counters of each stream of a subscriber
+ *
+ * @param sub	pointer to the sampled values subscriber
+ */
+static void print_streams(const sv_sub_t *sub)
+{
+  /* Declare local variables */
+  const sv_stream_t *stream = NULL;                  /* Stream to print */
+  size_t i = 0;                                           /* Stream index */
+
+  fprintf(stdout, "[=] %llu frames, %llu malformed, %llu ASDUs of untracked "
+   "streams\n", (unsigned long long)sub->frames, 
+   (unsigned long long)sub->malformed, (unsigned long long)sub->dropped);
+  for (i = 0; i < sub->count; i++)
+  {
+    stream = &sub->streams[i];
+    fprintf(stdout, "    0x%04x %.*s: %llu samples of %u channels, %llu gaps "
+     "(%llu missing), %llu stale\n", stream->appid, (int)stream->svIDLen, 
+     (const char *)stream->svID, (unsigned long long)stream->samples, 
+     stream->channels, (unsigned long long)stream->gaps, 
+     (unsigned long long)stream->missing, (unsigned long long)stream->stale);
+  }
+}
+
+
+/**
+ * Function to benchmark decoding of the sampled values of many streams with 
+ * each implementation of the sample extraction, reporting the share of one 
+ * core needed to keep up with the streams at the sample rate
+ *
+ * @param streams	number of streams
+ * @param rate	sample rate of each stream in Hz, one ASDU per frame
+ */
+static void sv_bench(unsigned int streams, unsigned int rate)
+{
+  /* Declare local variables */
+  static const sv_impl_t IMPL[] = { SV_IMPL_SCALAR, SV_IMPL_SSE4, 
+   SV_IMPL_AVX2 };
+  static sv_frame_t sv_frame;              /* Frame template of each stream */
+  uint8_t *frames = NULL;                 /* Encoded frame of each stream */
+  uint8_t *frame = NULL;                        /* Frame being decoded */
+  uint16_t len = 0;                         /* Length of an encoded frame */
+  uint8_t svid[16];                                 /* svID of a stream */
+  sv_sub_t sub;                                            /* Subscriber */
+  uint64_t start = 0;                                  /* Start of a run */
+  uint64_t ns = 0;                                  /* Duration of a run */
+  uint64_t allocs = 0;                /* Heap allocations made by a run */
+  unsigned int i = 0;                                     /* Stream index */
+  unsigned int k = 0;                                      /* Frame index */
+  unsigned int j = 0;                                      /* Channel index */
+  size_t m = 0;                                  /* Implementation index */
+
+  /* Encode one frame per stream, all the same length */
+  MALLOC(frames, uint8_t, (size_t)streams * MAX_FRAME_SIZE);
+  memset(&sv_frame, 0, sizeof(sv_frame_t));
+  sv_frame.eth_hdr.ether_type = htons(ETHER_SMV);
+  sv_frame.svID = svid;
+  sv_frame.confRev = 1;
+  sv_frame.noASDU = 1;
+  for (j = 0; j < SV_NUM_CHANNELS; j++)
+  {
+    sv_frame.asdu[0].value[j] = (int32_t)(j * 1000 - 3000);
+  }
+  for (i = 0; i < streams; i++)
+  {
+    snprintf((char *)svid, sizeof(svid), "MU%02u", i);
+    sv_frame.sv_header.appid = htons((uint16_t)(0x4000 + i));
+    encode_sv_frame(&sv_frame, frames + (size_t)i * MAX_FRAME_SIZE, &len);
+  }
+
+  fprintf(stdout, "[-] decoding %u streams of %u frames, %u byte frames\n", 
+   streams, BENCH_FRAMES, len);
+  for (m = 0; m < sizeof(IMPL) / sizeof(IMPL[0]); m++)
+  {
+    if (sv_set_impl(IMPL[m]))
+    {
+      continue;
+    }
+    if (0 != sv_sub_init(&sub, streams, rate))
+    {
+      exit(EXIT_FAILURE);
+    }
+
+    /* Interleave the streams, as they arrive on the wire, only smpCnt 
+     * changes so that the decode dominates the timing */
+    allocs = __atomic_load_n(&MALLOC_COUNT, __ATOMIC_RELAXED);
+    start = now_ns();
+    for (k = 0; k < BENCH_FRAMES; k++)
+    {
+      for (i = 0; i < streams; i++)
+      {
+        frame = frames + (size_t)i * MAX_FRAME_SIZE;
+        frame[sv_frame.smpCnt_offset[0]] = (uint8_t)((k % rate) >> 8);
+        frame[sv_frame.smpCnt_offset[0] + 1] = (uint8_t)((k % rate) & 0xff);
+        decode_sv_frame(frame, len, &sub);
+      }
+    }
+    ns = now_ns() - start;
+    allocs = __atomic_load_n(&MALLOC_COUNT, __ATOMIC_RELAXED) - allocs;
+
+    fprintf(stdout, "%-8s %llu ns/frame, %.1f%% of a core for %u streams "
+     "at %u Hz, %llu gaps, %llu heap allocations\n", sv_impl_name(), 
+     (unsigned long long)(ns / ((uint64_t)BENCH_FRAMES * streams)), 
+     100.0 * (double)ns / ((double)BENCH_FRAMES / rate * 1e9), streams, rate,
+     (unsigned long long)sub.streams[0].gaps, (unsigned long long)allocs);
+    sv_sub_free(&sub);
+  }
+
+  sv_set_impl(SV_IMPL_AUTO);
+  FREE(frames);
+  fflush(stdout);
+}
+
+
+int main(int argc, char *argv[]) 
+{
+  /* Declare local variables */
+  int opt = 0;                               /* Command line option character */
+  unsigned int rate = 4000;                /* smpCnt wrap, the sample rate */
+  unsigned int streams = 32;            /* Maximum number of streams decoded */
+  unsigned int duration = 0;             /* Seconds to subscribe, 0 forever */
+  int goose = 0;                      /* Non-zero to print GOOSE frames too */
+  int bench = 0;                        /* Non-zero to run the benchmark */
+  char *iface = NULL;                          /* Name of network interface */
+
+  /* Check paramaters */
+  while (-1 != (opt = getopt(argc, argv, "Bd:gn:s:")))
+  {
+    switch (opt)
+    {
+      case 'B':
+        bench = 1;
+        break;
+      case 'd':
+        duration = (unsigned int)atoi(optarg);
+        break;
+      case 'g':
+        goose = 1;
+        break;
+      case 'n':
+        streams = (unsigned int)atoi(optarg);
+        if (0 == streams)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      case 's':
+        rate = (unsigned int)atoi(optarg);
+        if (rate > 0x10000)
+        {
+          print_usage();
+          return -1;
+        }
+        break;
+      default:
+        print_usage();
+        return -1;
+    }
+  }
+
+  if (bench)
+  {
+    sv_bench(streams, rate ? rate : 4800);
+    return 0;
+  }
+
+  if (argc - optind != 1) 
+  {
+    print_usage();
+    return -1;
+  }
+  iface = argv[optind];
+
+  /* Declare local variables */
+  struct sigaction signal_action;                     /* Sigaction structure */
+  char errbuf[PCAP_ERRBUF_SIZE] = {0};                  /* PCAP error buffer */
+  dispatch_table_t table;                /* Handlers of each ethertype */
+  sv_sub_t sub;                             /* Sampled values subscriber */
+
+  /* Set up the handlers, sampled values and optionally GOOSE */
+  memset(&table, 0, sizeof(dispatch_table_t));
+  if (0 != sv_sub_init(&sub, streams, rate))
+  {
+    exit(EXIT_FAILURE);
+  }
+  dispatch_register(&table, ETHER_SMV, sv_dispatch_decode, &sub);
+  if (goose)
+  {
+    dispatch_register(&table, ETHER_GOOSE, goose_dispatch_print, NULL);
+    if (0 != log_start(stdout, LOG_LEVEL_INFO))
+    {
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  /* Stop on interrupt, or when the duration elapses */
+  memset(&signal_action, 0, sizeof(struct sigaction));
+  signal_action.sa_handler = &signal_handler;
+  if (-1 == sigaction(SIGINT, &signal_action, (struct sigaction *)NULL) 
+   || -1 == sigaction(SIGALRM, &signal_action, (struct sigaction *)NULL))
+  {
+    fprintf(stderr, "[!] unable to register signal handler\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* Open the network interface specified */
+  PCAP = pcap_open_live(iface, BUFSIZ, 1, 100, (char *)&errbuf);
+  if (NULL == PCAP)
+  {
+    fprintf(stderr, "[!] could not open pcap (%s - %s)\n", iface, errbuf);
+    exit(EXIT_FAILURE);
+  }
+
+  fprintf(stdout, "[-] subscribing on %s, %s sample extraction\n", iface, 
+   sv_impl_name());
+  fflush(stdout);
+  if (duration)
+  {
+    alarm(duration);
+  }
+  subscribe_dispatch(PCAP, 0, &table);
+  log_stop();
+
+  /* Done */
+  print_streams(&sub);
+  if (table.unhandled)
+  {
+    fprintf(stdout, "    %llu frames of other ethertypes\n", 
+     (unsigned long long)table.unhandled);
+  }
+  pcap_close(PCAP);
+  sv_sub_free(&sub);
+  fflush(stdout);
+  return 0;
+}
+
+
+void print_usage(void) 
+{
+  fprintf(stdout, "sv_sub, version %s\n\n", VER);
+  fprintf(stdout, "usage: sv_sub [-d secs] [-g] [-n streams] [-s rate] "
+   "iface\n");
+  fprintf(stdout, "       sv_sub -B [-n streams] [-s rate]\n\n");
+  fprintf(stdout, "  -B : benchmark decoding of streams with each sample "
+   "extraction\n");
+  fprintf(stdout, "  -d secs : seconds to subscribe for, default until "
+   "interrupted\n");
+  fprintf(stdout, "  -g : print GOOSE frames received on the same "
+   "subscription\n");
+  fprintf(stdout, "  -n streams : maximum number of streams, default 32\n");
+  fprintf(stdout, "  -s rate : sample rate at which smpCnt wraps, default "
+   "4000, 0 for 65536\n");
+  fprintf(stdout, "  iface : network interface to use\n");
+  fflush(stdout);
+  return;
+}
+
+
+void signal_handler(int sig)
+{
+  (void)sig;
+  if (PCAP)
+  {
+    pcap_breakloop(PCAP);
+  }
+}
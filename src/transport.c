@@ -0,0 +1,1049 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#define _GNU_SOURCE             /* recvmmsg and sendmmsg */
+
+#include "pool.h"
+#include "transport.h"
+#include "types.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <pcap.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+
+
+
+/*
+ * Constants
+ */
+
+/**
+ * Longest a receive waits between checks for transport_break(), in ms
+ */
+#define TRANSPORT_POLL_MS 100
+
+/**
+ * Maximum length of the name of a loopback ring, including the '\0'
+ */
+#define TRANSPORT_LOOP_NAME_LEN 32
+
+
+
+
+/*
+ * Types
+ */
+
+/** State of a pcap transport. Frames are copied out of the capture buffer, 
+ * libpcap only keeps them valid during the callback.
+ */
+typedef struct _pcap_impl_t_ {
+  pcap_t *pcap;                         /* Packet capture descriptor */
+  int fd;                    /* Selectable descriptor, -1 if it has none */
+  uint8_t *buf;          /* TRANSPORT_BATCH_MAX buffers of POOL_BUF_SIZE */
+  transport_frame_t *frames;             /* Frames of the current receive */
+  int count;                   /* Frames received by the current receive */
+  uint64_t ns;                           /* Time of the current receive */
+} pcap_impl_t;
+
+
+/** State of a raw AF_PACKET transport, with the message headers of a batch 
+ * set up once
+ */
+typedef struct _packet_impl_t_ {
+  int fd;                                       /* Raw packet socket */
+  uint8_t *buf;          /* TRANSPORT_BATCH_MAX buffers of POOL_BUF_SIZE */
+  struct mmsghdr rx_msg[TRANSPORT_BATCH_MAX];      /* Received messages */
+  struct iovec rx_iov[TRANSPORT_BATCH_MAX];       /* Receive buffers */
+  struct sockaddr_ll from[TRANSPORT_BATCH_MAX];   /* Source of each frame */
+  struct mmsghdr tx_msg[TRANSPORT_BATCH_MAX];          /* Sent messages */
+  struct iovec tx_iov[TRANSPORT_BATCH_MAX];           /* Sent frames */
+  uint64_t drops;      /* Frames dropped, the kernel resets it on each read */
+} packet_impl_t;
+
+
+/** Slot of a loopback ring, one frame
+ */
+typedef struct _loop_slot_t_ {
+  uint8_t data[POOL_BUF_SIZE];                         /* Frame */
+  uint32_t len;                                  /* Bytes in the frame */
+} __attribute__((aligned(64))) loop_slot_t;
+
+
+/** Loopback ring, a single producer single consumer queue of frames. The 
+ * head is written only by the sender and the tail only by the receiver, 
+ * each on its own cache line.
+ */
+typedef struct _loop_ring_t_ {
+  char name[TRANSPORT_LOOP_NAME_LEN];             /* Name of the ring */
+  struct _loop_ring_t_ *next;                /* Next ring of the list */
+  int refs;                            /* Transports open on the ring */
+  uint64_t head __attribute__((aligned(64)));  /* Next slot written */
+  uint64_t drops;                  /* Frames dropped as the ring was full */
+  uint64_t tail __attribute__((aligned(64)));     /* Next slot read */
+  loop_slot_t slot[TRANSPORT_LOOP_LEN];                     /* Frames */
+} loop_ring_t;
+
+
+/** State of a loopback transport
+ */
+typedef struct _loop_impl_t_ {
+  loop_ring_t *ring;                           /* Shared ring */
+  uint64_t tail_cache;  /* Tail last read by the sender, to spare the line */
+  uint64_t held;        /* Frames of the last receive, released on the next */
+} loop_impl_t;
+
+
+
+
+/*
+ * Global variables
+ */
+
+/** Loopback rings of the process, and the lock held to open or close one
+ */
+static loop_ring_t *LOOP_RINGS = NULL;
+static pthread_mutex_t LOOP_LOCK = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return the monotonic clock in nanoseconds
+ */
+static uint64_t mono_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/**
+ * Function to allocate the frame buffers of a batch, cache-line aligned
+ *
+ * @return uint8_t *	pointer to TRANSPORT_BATCH_MAX buffers of 
+ * 			POOL_BUF_SIZE, else NULL
+ */
+static uint8_t *batch_alloc(void)
+{
+  void *buf = NULL;                                 /* Allocated buffers */
+
+  if (0 != posix_memalign(&buf, POOL_ALIGN, 
+   (size_t)TRANSPORT_BATCH_MAX * POOL_BUF_SIZE))
+  {
+    fprintf(stderr, "ERROR: unable to allocate memory\n");
+    return NULL;
+  }
+  __atomic_fetch_add(&MALLOC_COUNT, 1, __ATOMIC_RELAXED);
+  return (uint8_t *)buf;
+}
+
+
+/**
+ * Function to wait for a descriptor to become readable, in slices of 
+ * TRANSPORT_POLL_MS so that a break is seen
+ *
+ * @param tp	pointer to the transport
+ * @param fd	descriptor to wait on, -1 to not wait
+ * @param timeout_ms	time to wait, 0 for none and -1 for no limit
+ * @return int	1 if the descriptor may be read, else 0
+ */
+static int wait_readable(transport_t *tp, int fd, int timeout_ms)
+{
+  /* Declare local variables */
+  struct pollfd pfd = { .fd = fd, .events = POLLIN, .revents = 0 };
+  int slice = 0;                           /* Time of the next poll in ms */
+  int ret = 0;                                    /* Result of the poll */
+
+  if (fd < 0)
+  {
+    return 1;
+  }
+
+  do
+  {
+    if (__atomic_load_n(&tp->stop, __ATOMIC_RELAXED))
+    {
+      return 0;
+    }
+    slice = (timeout_ms < 0 || timeout_ms > TRANSPORT_POLL_MS) 
+     ? TRANSPORT_POLL_MS : timeout_ms;
+    ret = poll(&pfd, 1, slice);
+    if (ret > 0)
+    {
+      return 1;
+    }
+    if (timeout_ms > 0)
+    {
+      timeout_ms -= slice;
+    }
+  }
+  while (0 != timeout_ms && (ret == 0 || EINTR == errno));
+
+  return 0;
+}
+
+
+/*
+ * pcap transport
+ */
+
+static int pcap_tp_open(transport_t *tp, const char *iface)
+{
+  /* Declare local variables */
+  char errbuf[PCAP_ERRBUF_SIZE] = {0};                  /* PCAP error buffer */
+  pcap_impl_t *impl = NULL;                        /* State of transport */
+
+  MALLOC(impl, pcap_impl_t, sizeof(pcap_impl_t));
+  memset(impl, 0, sizeof(pcap_impl_t));
+  impl->buf = batch_alloc();
+  if (NULL == impl->buf)
+  {
+    FREE(impl);
+    return -1;
+  }
+
+  /* No frame is longer than a pool buffer, so that is the snapshot length */
+  impl->pcap = pcap_open_live(iface, POOL_BUF_SIZE, 1, TRANSPORT_POLL_MS, 
+   errbuf);
+  if (NULL == impl->pcap)
+  {
+    fprintf(stderr, "ERROR: could not open pcap (%s - %s)\n", iface, errbuf);
+    FREE(impl->buf);
+    FREE(impl);
+    return -1;
+  }
+  if (-1 == pcap_setnonblock(impl->pcap, 1, errbuf) 
+   || 0 != pcap_setdirection(impl->pcap, PCAP_D_IN))
+  {
+    fprintf(stderr, "ERROR: could not set up pcap (%s)\n", iface);
+    pcap_close(impl->pcap);
+    FREE(impl->buf);
+    FREE(impl);
+    return -1;
+  }
+  impl->fd = pcap_get_selectable_fd(impl->pcap);
+  tp->impl = impl;
+
+  /* Done */
+  return 0;
+}
+
+
+static int pcap_tp_send(transport_t *tp, const uint8_t *frame, size_t len)
+{
+  /* Declare local variables */
+  pcap_impl_t *impl = (pcap_impl_t *)tp->impl;     /* State of transport */
+
+  return (-1 == pcap_inject(impl->pcap, frame, len)) ? -1 : 0;
+}
+
+
+static int pcap_tp_send_batch(transport_t *tp, uint8_t *const *frames, 
+ const size_t *lens, int count)
+{
+  /* Declare local variables */
+  pcap_impl_t *impl = (pcap_impl_t *)tp->impl;     /* State of transport */
+  int sent = 0;                                /* Number of frames sent */
+  int i = 0;                                              /* Frame index */
+
+  /* libpcap has no batch send, inject each frame */
+  for (i = 0; i < count; i++)
+  {
+    sent += (-1 != pcap_inject(impl->pcap, frames[i], lens[i]));
+  }
+
+  return (0 == sent && count > 0) ? -1 : sent;
+}
+
+
+/**
+ * Packet handler callback function to copy a frame into the next buffer of 
+ * the current receive
+ */
+static void pcap_tp_frame(u_char *args, const struct pcap_pkthdr *header, 
+ const u_char *packet)
+{
+  /* Declare local variables */
+  pcap_impl_t *impl = (pcap_impl_t *)args;         /* State of transport */
+  uint8_t *buf = impl->buf + (size_t)impl->count * POOL_BUF_SIZE;
+  uint32_t len = (header->caplen < POOL_BUF_SIZE) 
+   ? header->caplen : POOL_BUF_SIZE;                /* Bytes to copy */
+
+  memcpy(buf, packet, len);
+  impl->frames[impl->count].data = buf;
+  impl->frames[impl->count].len = len;
+  impl->frames[impl->count].ns = impl->ns;
+  impl->frames[impl->count].ts = header->ts;
+  impl->count++;
+}
+
+
+static int pcap_tp_recv_batch(transport_t *tp, transport_frame_t *frames, 
+ int max, int timeout_ms)
+{
+  /* Declare local variables */
+  pcap_impl_t *impl = (pcap_impl_t *)tp->impl;     /* State of transport */
+
+  /* A readable descriptor may yield no frames, e.g. only frames sent from 
+   * the interface, so wait again when there is no time limit */
+  impl->frames = frames;
+  impl->count = 0;
+  do
+  {
+    if (!wait_readable(tp, impl->fd, timeout_ms))
+    {
+      return 0;
+    }
+
+    impl->ns = mono_ns();
+    if (-1 == pcap_dispatch(impl->pcap, max, pcap_tp_frame, (u_char *)impl))
+    {
+      fprintf(stderr, "ERROR: %s\n", pcap_geterr(impl->pcap));
+      return -1;
+    }
+  }
+  while (0 == impl->count && timeout_ms < 0);
+
+  return impl->count;
+}
+
+
+static int pcap_tp_drops(transport_t *tp, uint64_t *drops)
+{
+  /* Declare local variables */
+  pcap_impl_t *impl = (pcap_impl_t *)tp->impl;     /* State of transport */
+  struct pcap_stat ps;                             /* Capture statistics */
+
+  if (0 != pcap_stats(impl->pcap, &ps))
+  {
+    return -1;
+  }
+  *drops = ps.ps_drop;
+
+  return 0;
+}
+
+
+static int pcap_tp_fd(transport_t *tp)
+{
+  return ((pcap_impl_t *)tp->impl)->fd;
+}
+
+
+static void pcap_tp_close(transport_t *tp)
+{
+  /* Declare local variables */
+  pcap_impl_t *impl = (pcap_impl_t *)tp->impl;     /* State of transport */
+
+  pcap_close(impl->pcap);
+  FREE(impl->buf);
+  FREE(impl);
+}
+
+
+/*
+ * Attached pcap transport, the state is the descriptor of the caller
+ */
+
+static int handle_tp_open(transport_t *tp, const char *iface)
+{
+  (void)tp;
+  fprintf(stderr, "ERROR: use transport_pcap_attach() (%s)\n", iface);
+  return -1;
+}
+
+
+static int handle_tp_send(transport_t *tp, const uint8_t *frame, size_t len)
+{
+  return (-1 == pcap_inject((pcap_t *)tp->impl, frame, len)) ? -1 : 0;
+}
+
+
+static int handle_tp_send_batch(transport_t *tp, uint8_t *const *frames, 
+ const size_t *lens, int count)
+{
+  /* Declare local variables */
+  int sent = 0;                                /* Number of frames sent */
+  int i = 0;                                              /* Frame index */
+
+  for (i = 0; i < count; i++)
+  {
+    sent += (-1 != pcap_inject((pcap_t *)tp->impl, frames[i], lens[i]));
+  }
+
+  return (0 == sent && count > 0) ? -1 : sent;
+}
+
+
+/**
+ * Function to receive the next frame. libpcap keeps a frame returned by 
+ * pcap_next_ex() valid until the next call, so it is not copied. The wait 
+ * is the read timeout of the descriptor rather than timeout_ms, a poll could 
+ * miss frames libpcap has already read from the kernel.
+ */
+static int handle_tp_recv_batch(transport_t *tp, transport_frame_t *frames, 
+ int max, int timeout_ms)
+{
+  /* Declare local variables */
+  pcap_t *pcap = (pcap_t *)tp->impl;          /* Packet capture descriptor */
+  struct pcap_pkthdr *header = NULL;                      /* Frame header */
+  const u_char *packet = NULL;                                   /* Frame */
+  int ret = 0;                                 /* Result of the receive */
+
+  (void)max;
+  do
+  {
+    if (__atomic_load_n(&tp->stop, __ATOMIC_RELAXED))
+    {
+      return 0;
+    }
+    ret = pcap_next_ex(pcap, &header, &packet);
+  }
+  while (0 == ret && timeout_ms < 0);
+
+  if (1 == ret)
+  {
+    frames[0].data = packet;
+    frames[0].len = (header->caplen < header->len) 
+     ? header->caplen : header->len;
+    frames[0].ns = mono_ns();
+    frames[0].ts = header->ts;
+    return 1;
+  }
+  if (PCAP_ERROR_BREAK == ret)
+  {
+    /* End of the capture file, or pcap_breakloop() */
+    transport_break(tp);
+    return 0;
+  }
+  if (0 != ret)
+  {
+    fprintf(stderr, "ERROR: %s\n", pcap_geterr(pcap));
+    return -1;
+  }
+
+  return 0;
+}
+
+
+static int handle_tp_drops(transport_t *tp, uint64_t *drops)
+{
+  /* Declare local variables */
+  struct pcap_stat ps;                             /* Capture statistics */
+
+  if (0 != pcap_stats((pcap_t *)tp->impl, &ps))
+  {
+    return -1;
+  }
+  *drops = ps.ps_drop;
+
+  return 0;
+}
+
+
+static int handle_tp_fd(transport_t *tp)
+{
+  return pcap_get_selectable_fd((pcap_t *)tp->impl);
+}
+
+
+static void handle_tp_close(transport_t *tp)
+{
+  /* The descriptor belongs to the caller */
+  tp->impl = NULL;
+}
+
+
+/*
+ * Raw AF_PACKET transport
+ */
+
+static int packet_tp_open(transport_t *tp, const char *iface)
+{
+  /* Declare local variables */
+  packet_impl_t *impl = NULL;                      /* State of transport */
+  struct sockaddr_ll sll;                 /* Link layer address to bind to */
+  struct packet_mreq mreq;                  /* Promiscuous mode request */
+  int one = 1;                                      /* Socket option on */
+  int i = 0;                                              /* Frame index */
+
+  MALLOC(impl, packet_impl_t, sizeof(packet_impl_t));
+  memset(impl, 0, sizeof(packet_impl_t));
+  impl->fd = -1;
+  impl->buf = batch_alloc();
+  if (NULL == impl->buf)
+  {
+    FREE(impl);
+    return -1;
+  }
+
+  memset(&sll, 0, sizeof(struct sockaddr_ll));
+  sll.sll_family = AF_PACKET;
+  sll.sll_protocol = htons(ETH_P_ALL);
+  sll.sll_ifindex = (int)if_nametoindex(iface);
+  if (0 == sll.sll_ifindex)
+  {
+    fprintf(stderr, "ERROR: unknown interface (%s)\n", iface);
+    goto fail;
+  }
+
+  impl->fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+  if (-1 == impl->fd 
+   || -1 == bind(impl->fd, (struct sockaddr *)&sll, sizeof(sll)))
+  {
+    fprintf(stderr, "ERROR: could not open packet socket (%s)\n", 
+     strerror(errno));
+    goto fail;
+  }
+
+  /* Promiscuous, as the pcap transport, and without the frames we send 
+   * where the kernel can skip them (Linux 4.20), else they are filtered */
+  memset(&mreq, 0, sizeof(struct packet_mreq));
+  mreq.mr_ifindex = sll.sll_ifindex;
+  mreq.mr_type = PACKET_MR_PROMISC;
+  if (-1 == setsockopt(impl->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, 
+   sizeof(mreq)))
+  {
+    fprintf(stderr, "ERROR: could not set promiscuous mode (%s)\n", 
+     strerror(errno));
+    goto fail;
+  }
+#ifdef PACKET_IGNORE_OUTGOING
+  setsockopt(impl->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one));
+#else
+  (void)one;
+#endif
+
+  for (i = 0; i < TRANSPORT_BATCH_MAX; i++)
+  {
+    impl->rx_iov[i].iov_base = impl->buf + (size_t)i * POOL_BUF_SIZE;
+    impl->rx_iov[i].iov_len = POOL_BUF_SIZE;
+    impl->rx_msg[i].msg_hdr.msg_iov = &impl->rx_iov[i];
+    impl->rx_msg[i].msg_hdr.msg_iovlen = 1;
+    impl->rx_msg[i].msg_hdr.msg_name = &impl->from[i];
+    impl->tx_msg[i].msg_hdr.msg_iov = &impl->tx_iov[i];
+    impl->tx_msg[i].msg_hdr.msg_iovlen = 1;
+  }
+  tp->impl = impl;
+
+  /* Done */
+  return 0;
+
+fail:
+  if (impl->fd >= 0)
+  {
+    close(impl->fd);
+  }
+  FREE(impl->buf);
+  FREE(impl);
+  return -1;
+}
+
+
+static int packet_tp_send(transport_t *tp, const uint8_t *frame, size_t len)
+{
+  /* Declare local variables */
+  packet_impl_t *impl = (packet_impl_t *)tp->impl; /* State of transport */
+
+  return (-1 == send(impl->fd, frame, len, 0)) ? -1 : 0;
+}
+
+
+static int packet_tp_send_batch(transport_t *tp, uint8_t *const *frames, 
+ const size_t *lens, int count)
+{
+  /* Declare local variables */
+  packet_impl_t *impl = (packet_impl_t *)tp->impl; /* State of transport */
+  int i = 0;                                              /* Frame index */
+
+  for (i = 0; i < count; i++)
+  {
+    impl->tx_iov[i].iov_base = frames[i];
+    impl->tx_iov[i].iov_len = lens[i];
+  }
+
+  return sendmmsg(impl->fd, impl->tx_msg, (unsigned int)count, 0);
+}
+
+
+static int packet_tp_recv_batch(transport_t *tp, transport_frame_t *frames, 
+ int max, int timeout_ms)
+{
+  /* Declare local variables */
+  packet_impl_t *impl = (packet_impl_t *)tp->impl; /* State of transport */
+  uint64_t ns = 0;                                 /* Time of the receive */
+  struct timeval ts;                          /* Capture time of the batch */
+  int n = 0;                                /* Number of frames read */
+  int count = 0;                        /* Number of frames received */
+  int i = 0;                                              /* Frame index */
+
+  /* A batch may hold only frames sent from the interface, or the read may 
+   * be interrupted, so wait again when there is no time limit */
+  do
+  {
+    if (!wait_readable(tp, impl->fd, timeout_ms))
+    {
+      return 0;
+    }
+
+    for (i = 0; i < max; i++)
+    {
+      impl->rx_msg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_ll);
+    }
+    n = recvmmsg(impl->fd, impl->rx_msg, (unsigned int)max, MSG_DONTWAIT, 
+     NULL);
+    if (n < 0 && EAGAIN != errno && EINTR != errno)
+    {
+      return -1;
+    }
+
+    ns = mono_ns();
+    gettimeofday(&ts, NULL);
+    for (i = 0; i < n; i++)
+    {
+      if (PACKET_OUTGOING == impl->from[i].sll_pkttype)
+      {
+        continue;
+      }
+      frames[count].data = (const uint8_t *)impl->rx_iov[i].iov_base;
+      frames[count].len = (impl->rx_msg[i].msg_len < POOL_BUF_SIZE) 
+       ? impl->rx_msg[i].msg_len : POOL_BUF_SIZE;
+      frames[count].ns = ns;
+      frames[count].ts = ts;
+      count++;
+    }
+  }
+  while (0 == count && timeout_ms < 0);
+
+  return count;
+}
+
+
+static int packet_tp_drops(transport_t *tp, uint64_t *drops)
+{
+  /* Declare local variables */
+  packet_impl_t *impl = (packet_impl_t *)tp->impl; /* State of transport */
+  struct tpacket_stats st;                          /* Socket statistics */
+  socklen_t len = sizeof(st);                   /* Length of statistics */
+
+  if (-1 == getsockopt(impl->fd, SOL_PACKET, PACKET_STATISTICS, &st, &len))
+  {
+    return -1;
+  }
+  impl->drops += st.tp_drops;
+  *drops = impl->drops;
+
+  return 0;
+}
+
+
+static int packet_tp_fd(transport_t *tp)
+{
+  return ((packet_impl_t *)tp->impl)->fd;
+}
+
+
+static void packet_tp_close(transport_t *tp)
+{
+  /* Declare local variables */
+  packet_impl_t *impl = (packet_impl_t *)tp->impl; /* State of transport */
+
+  close(impl->fd);
+  FREE(impl->buf);
+  FREE(impl);
+}
+
+
+/*
+ * In-process loopback transport
+ */
+
+static int loop_tp_open(transport_t *tp, const char *iface)
+{
+  /* Check parameters */
+  if (strlen(iface) >= TRANSPORT_LOOP_NAME_LEN)
+  {
+    fprintf(stderr, "ERROR: loopback name too long (%s)\n", iface);
+    return -1;
+  }
+
+  /* Declare local variables */
+  loop_impl_t *impl = NULL;                        /* State of transport */
+  loop_ring_t *ring = NULL;                             /* Shared ring */
+  void *mem = NULL;                               /* Memory of a new ring */
+
+  pthread_mutex_lock(&LOOP_LOCK);
+  for (ring = LOOP_RINGS; NULL != ring; ring = ring->next)
+  {
+    if (0 == strcmp(ring->name, iface))
+    {
+      break;
+    }
+  }
+  if (NULL == ring)
+  {
+    if (0 != posix_memalign(&mem, POOL_ALIGN, sizeof(loop_ring_t)))
+    {
+      pthread_mutex_unlock(&LOOP_LOCK);
+      fprintf(stderr, "ERROR: unable to allocate memory\n");
+      return -1;
+    }
+    __atomic_fetch_add(&MALLOC_COUNT, 1, __ATOMIC_RELAXED);
+    ring = (loop_ring_t *)mem;
+    memset(ring, 0, offsetof(loop_ring_t, slot));
+    strcpy(ring->name, iface);
+    ring->next = LOOP_RINGS;
+    LOOP_RINGS = ring;
+  }
+  ring->refs++;
+  pthread_mutex_unlock(&LOOP_LOCK);
+
+  MALLOC(impl, loop_impl_t, sizeof(loop_impl_t));
+  memset(impl, 0, sizeof(loop_impl_t));
+  impl->ring = ring;
+  impl->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  tp->impl = impl;
+
+  /* Done */
+  return 0;
+}
+
+
+static int loop_tp_send(transport_t *tp, const uint8_t *frame, size_t len)
+{
+  /* Check parameters */
+  if (len > POOL_BUF_SIZE)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  loop_impl_t *impl = (loop_impl_t *)tp->impl;     /* State of transport */
+  loop_ring_t *ring = impl->ring;                          /* Shared ring */
+  uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  loop_slot_t *slot = NULL;                          /* Slot of the frame */
+
+  /* Only read the tail, a line the receiver writes, when the ring looks 
+   * full, and drop the frame like a NIC if it is */
+  if (head - impl->tail_cache >= TRANSPORT_LOOP_LEN)
+  {
+    impl->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - impl->tail_cache >= TRANSPORT_LOOP_LEN)
+    {
+      __atomic_fetch_add(&ring->drops, 1, __ATOMIC_RELAXED);
+      return -1;
+    }
+  }
+
+  slot = &ring->slot[head & (TRANSPORT_LOOP_LEN - 1)];
+  memcpy(slot->data, frame, len);
+  slot->len = (uint32_t)len;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+  /* Done */
+  return 0;
+}
+
+
+static int loop_tp_send_batch(transport_t *tp, uint8_t *const *frames, 
+ const size_t *lens, int count)
+{
+  /* Declare local variables */
+  int sent = 0;                                /* Number of frames sent */
+  int i = 0;                                              /* Frame index */
+
+  for (i = 0; i < count; i++)
+  {
+    sent += (0 == loop_tp_send(tp, frames[i], lens[i]));
+  }
+
+  return (0 == sent && count > 0) ? -1 : sent;
+}
+
+
+static int loop_tp_recv_batch(transport_t *tp, transport_frame_t *frames, 
+ int max, int timeout_ms)
+{
+  /* Declare local variables */
+  loop_impl_t *impl = (loop_impl_t *)tp->impl;     /* State of transport */
+  loop_ring_t *ring = impl->ring;                          /* Shared ring */
+  uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+  uint64_t head = 0;                           /* Slot the sender writes */
+  uint64_t ns = mono_ns();                         /* Time of the receive */
+  uint64_t deadline = ns + (uint64_t)timeout_ms * 1000000ULL;
+  struct timeval ts;                          /* Capture time of the batch */
+  uint64_t n = 0;                            /* Number of frames received */
+  uint64_t i = 0;                                         /* Frame index */
+
+  /* Hand the slots of the last receive back to the sender */
+  tail += impl->held;
+  impl->held = 0;
+  __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+  /* Yield while the ring is empty, there is no descriptor to sleep on */
+  while (tail == (head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)))
+  {
+    if (0 == timeout_ms || __atomic_load_n(&tp->stop, __ATOMIC_RELAXED) 
+     || (timeout_ms > 0 && (ns = mono_ns()) >= deadline))
+    {
+      return 0;
+    }
+    sched_yield();
+  }
+
+  n = head - tail;
+  n = (n < (uint64_t)max) ? n : (uint64_t)max;
+  ns = mono_ns();
+  gettimeofday(&ts, NULL);
+  for (i = 0; i < n; i++)
+  {
+    frames[i].data = ring->slot[(tail + i) & (TRANSPORT_LOOP_LEN - 1)].data;
+    frames[i].len = ring->slot[(tail + i) & (TRANSPORT_LOOP_LEN - 1)].len;
+    frames[i].ns = ns;
+    frames[i].ts = ts;
+  }
+  impl->held = n;
+
+  return (int)n;
+}
+
+
+static int loop_tp_drops(transport_t *tp, uint64_t *drops)
+{
+  *drops = __atomic_load_n(&((loop_impl_t *)tp->impl)->ring->drops, 
+   __ATOMIC_RELAXED);
+  return 0;
+}
+
+
+static int loop_tp_fd(transport_t *tp)
+{
+  /* There is no descriptor to sleep on */
+  (void)tp;
+  return -1;
+}
+
+
+static void loop_tp_close(transport_t *tp)
+{
+  /* Declare local variables */
+  loop_impl_t *impl = (loop_impl_t *)tp->impl;     /* State of transport */
+  loop_ring_t *ring = impl->ring;                          /* Shared ring */
+  loop_ring_t **link = NULL;                /* Link to the ring in the list */
+
+  __atomic_fetch_add(&ring->tail, impl->held, __ATOMIC_RELEASE);
+  FREE(impl);
+
+  pthread_mutex_lock(&LOOP_LOCK);
+  if (0 == --ring->refs)
+  {
+    for (link = &LOOP_RINGS; *link != ring; link = &(*link)->next)
+    {
+      /* Find the link to the ring */
+    }
+    *link = ring->next;
+    free(ring);
+  }
+  pthread_mutex_unlock(&LOOP_LOCK);
+}
+
+
+const transport_ops_t TRANSPORT_PCAP = {
+  "pcap", pcap_tp_open, pcap_tp_send, pcap_tp_send_batch, pcap_tp_recv_batch, 
+  pcap_tp_drops, pcap_tp_fd, pcap_tp_close
+};
+
+static const transport_ops_t TRANSPORT_PCAP_HANDLE = {
+  "pcap", handle_tp_open, handle_tp_send, handle_tp_send_batch, 
+  handle_tp_recv_batch, handle_tp_drops, handle_tp_fd, handle_tp_close
+};
+
+const transport_ops_t TRANSPORT_PACKET = {
+  "packet", packet_tp_open, packet_tp_send, packet_tp_send_batch, 
+  packet_tp_recv_batch, packet_tp_drops, packet_tp_fd, packet_tp_close
+};
+
+const transport_ops_t TRANSPORT_LOOPBACK = {
+  "loopback", loop_tp_open, loop_tp_send, loop_tp_send_batch, 
+  loop_tp_recv_batch, loop_tp_drops, loop_tp_fd, loop_tp_close
+};
+
+
+const transport_ops_t *transport_find(const char *name)
+{
+  /* Declare local variables */
+  static const transport_ops_t *ALL[] = { &TRANSPORT_PCAP, &TRANSPORT_PACKET, 
+   &TRANSPORT_LOOPBACK };
+  size_t i = 0;                                       /* Transport index */
+
+  for (i = 0; NULL != name && i < sizeof(ALL) / sizeof(ALL[0]); i++)
+  {
+    if (0 == strcmp(ALL[i]->name, name))
+    {
+      return ALL[i];
+    }
+  }
+
+  return NULL;
+}
+
+
+int transport_open(transport_t *tp, const transport_ops_t *ops, 
+ const char *iface)
+{
+  /* Check parameters */
+  if (NULL == tp || NULL == ops || NULL == iface)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  tp->ops = ops;
+  tp->impl = NULL;
+  tp->stop = 0;
+  return ops->open(tp, iface);
+}
+
+
+int transport_pcap_attach(transport_t *tp, pcap_t *pcap_ptr)
+{
+  /* Check parameters */
+  if (NULL == tp || NULL == pcap_ptr)
+  {
+    fprintf(stderr, "ERROR: invalid parameters\n");
+    return -1;
+  }
+
+  tp->ops = &TRANSPORT_PCAP_HANDLE;
+  tp->impl = pcap_ptr;
+  tp->stop = 0;
+  return 0;
+}
+
+
+int transport_send(transport_t *tp, const uint8_t *frame, size_t len)
+{
+  return tp->ops->send(tp, frame, len);
+}
+
+
+int transport_send_batch(transport_t *tp, uint8_t *const *frames, 
+ const size_t *lens, int count)
+{
+  /* Check parameters */
+  if (count < 0 || count > TRANSPORT_BATCH_MAX)
+  {
+    fprintf(stderr, "ERROR: invalid batch size\n");
+    return -1;
+  }
+
+  return tp->ops->send_batch(tp, frames, lens, count);
+}
+
+
+int transport_recv_batch(transport_t *tp, transport_frame_t *frames, int max, 
+ int timeout_ms)
+{
+  /* Check parameters */
+  if (max <= 0 || max > TRANSPORT_BATCH_MAX)
+  {
+    fprintf(stderr, "ERROR: invalid batch size\n");
+    return -1;
+  }
+
+  if (__atomic_load_n(&tp->stop, __ATOMIC_RELAXED))
+  {
+    return 0;
+  }
+
+  return tp->ops->recv_batch(tp, frames, max, timeout_ms);
+}
+
+
+int transport_drops(transport_t *tp, uint64_t *drops)
+{
+  /* Check parameters */
+  if (NULL == tp || NULL == tp->impl || NULL == drops)
+  {
+    return -1;
+  }
+
+  return tp->ops->drops(tp, drops);
+}
+
+
+int transport_fd(transport_t *tp)
+{
+  /* Check parameters */
+  if (NULL == tp || NULL == tp->impl)
+  {
+    return -1;
+  }
+
+  return tp->ops->fd(tp);
+}
+
+
+void transport_break(transport_t *tp)
+{
+  __atomic_store_n(&tp->stop, 1, __ATOMIC_RELAXED);
+}
+
+
+void transport_close(transport_t *tp)
+{
+  if (NULL != tp && NULL != tp->impl)
+  {
+    tp->ops->close(tp);
+    tp->impl = NULL;
+  }
+}
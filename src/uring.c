@@ -0,0 +1,562 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "types.h"
+#include "uring.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#if defined(__linux__) && defined(__NR_io_uring_setup) \
+ && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <arpa/inet.h>
+#include <linux/io_uring.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+
+/*
+ * Types
+ */
+
+/** io_uring transmit ring. The submission and completion rings are shared with 
+ * the kernel through mmap, the frame pool is one contiguous registered buffer 
+ * split into URING_SLOT_SIZE slots and the free slots are kept on a stack.
+ */
+struct _uring_tx_t_ {
+  int ring_fd;              /* io_uring file descriptor */
+  int sock_fd;              /* Raw packet socket bound to the interface */
+
+  void *sq_ring;            /* Mapped submission queue ring */
+  void *cq_ring;            /* Mapped completion queue ring */
+  size_t sq_ring_sz;        /* Size of the submission ring mapping */
+  size_t cq_ring_sz;        /* Size of the completion ring mapping */
+  struct io_uring_sqe *sqes;/* Mapped submission queue entries */
+
+  unsigned *sq_head;        /* Submission ring head, advanced by kernel */
+  unsigned *sq_tail;        /* Submission ring tail, advanced by us */
+  unsigned *sq_mask;        /* Submission ring index mask */
+  unsigned *sq_array;       /* Submission ring index array */
+  unsigned *cq_head;        /* Completion ring head, advanced by us */
+  unsigned *cq_tail;        /* Completion ring tail, advanced by kernel */
+  unsigned *cq_mask;        /* Completion ring index mask */
+  struct io_uring_cqe *cqes;/* Completion queue entries */
+  unsigned entries;         /* Number of submission queue entries */
+
+  uint8_t *pool;            /* Registered frame buffer pool */
+  size_t pool_sz;           /* Size of the frame buffer pool */
+  uint32_t *free_slots;     /* Stack of free slot indices */
+  unsigned num_free;        /* Number of free slots on the stack */
+  unsigned queued;          /* Frames queued but not yet submitted */
+  unsigned in_flight;       /* Frames submitted but not yet completed */
+  uint64_t errors;          /* Frames completed with an error */
+};
+
+
+/*
+ * Function definitions
+ */
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p)
+{
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, 
+ unsigned min_complete, unsigned flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+   NULL, 0);
+}
+
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void *arg, 
+ unsigned nr_args)
+{
+  return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+
+/**
+ * Function to drain the completion ring, returning the frame buffers of each 
+ * completed frame to the free stack.
+ *
+ * @param tx	- pointer to the transmit ring
+ * @return unsigned	- number of completions reaped
+ */
+static unsigned uring_tx_reap(uring_tx_t *tx)
+{
+  /* Declare local variables */
+  unsigned head = *tx->cq_head;      /* Only we advance the completion head */
+  unsigned tail = __atomic_load_n(tx->cq_tail, __ATOMIC_ACQUIRE);
+  unsigned reaped = 0;                       /* Number of completions reaped */
+  struct io_uring_cqe *cqe = NULL;          /* Pointer to current completion */
+
+  while (head != tail)
+  {
+    cqe = &tx->cqes[head & *tx->cq_mask];
+    if (cqe->res < 0)
+    {
+      tx->errors++;
+    }
+    tx->free_slots[tx->num_free++] = (uint32_t)cqe->user_data;
+    head++;
+    reaped++;
+  }
+
+  __atomic_store_n(tx->cq_head, head, __ATOMIC_RELEASE);
+  tx->in_flight -= reaped;
+  return reaped;
+}
+
+
+uring_tx_t *uring_tx_open(const char *iface, unsigned int depth)
+{
+  /* Check parameters */
+  if (NULL == iface)
+  {
+    fprintf(stderr, "ERROR: interface not specified\n");
+    return NULL;
+  }
+
+  if (0 == depth)
+  {
+    depth = URING_DEFAULT_DEPTH;
+  }
+
+  /* Declare local variables */
+  uring_tx_t *tx = NULL;                   /* Transmit ring being constructed */
+  struct io_uring_params params;                   /* io_uring set-up params */
+  struct sockaddr_ll sll;                 /* Link layer address to bind to */
+  struct iovec iov;                   /* Registered frame pool description */
+  uint8_t *sq_ptr = NULL;                    /* Base of submission ring map */
+  uint8_t *cq_ptr = NULL;                    /* Base of completion ring map */
+  unsigned i = 0;                                              /* Loop index */
+
+  MALLOC(tx, uring_tx_t, sizeof(uring_tx_t));
+  memset(tx, 0, sizeof(uring_tx_t));
+  tx->ring_fd = -1;
+  tx->sock_fd = -1;
+
+  /* Open a transmit only raw socket, protocol 0 receives nothing */
+  tx->sock_fd = socket(AF_PACKET, SOCK_RAW, 0);
+  if (-1 == tx->sock_fd)
+  {
+    fprintf(stderr, "ERROR: could not open packet socket (%s)\n", 
+     strerror(errno));
+    goto fail;
+  }
+
+  memset(&sll, 0, sizeof(struct sockaddr_ll));
+  sll.sll_family = AF_PACKET;
+  sll.sll_ifindex = (int)if_nametoindex(iface);
+  if (0 == sll.sll_ifindex)
+  {
+    fprintf(stderr, "ERROR: unknown interface (%s)\n", iface);
+    goto fail;
+  }
+
+  if (-1 == bind(tx->sock_fd, (struct sockaddr *)&sll, sizeof(sll)))
+  {
+    fprintf(stderr, "ERROR: could not bind packet socket (%s)\n", 
+     strerror(errno));
+    goto fail;
+  }
+
+  /* Set up the ring */
+  memset(&params, 0, sizeof(struct io_uring_params));
+  tx->ring_fd = sys_io_uring_setup(depth, &params);
+  if (tx->ring_fd < 0)
+  {
+    fprintf(stderr, "ERROR: io_uring_setup failed (%s)\n", strerror(errno));
+    goto fail;
+  }
+  tx->entries = params.sq_entries;
+
+  tx->sq_ring_sz = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  tx->cq_ring_sz = params.cq_off.cqes 
+   + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (tx->cq_ring_sz > tx->sq_ring_sz)
+    {
+      tx->sq_ring_sz = tx->cq_ring_sz;
+    }
+    tx->cq_ring_sz = tx->sq_ring_sz;
+  }
+
+  tx->sq_ring = mmap(NULL, tx->sq_ring_sz, PROT_READ | PROT_WRITE, 
+   MAP_SHARED | MAP_POPULATE, tx->ring_fd, IORING_OFF_SQ_RING);
+  if (MAP_FAILED == tx->sq_ring)
+  {
+    tx->sq_ring = NULL;
+    fprintf(stderr, "ERROR: could not map io_uring (%s)\n", strerror(errno));
+    goto fail;
+  }
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    tx->cq_ring = tx->sq_ring;
+  }
+  else
+  {
+    tx->cq_ring = mmap(NULL, tx->cq_ring_sz, PROT_READ | PROT_WRITE, 
+     MAP_SHARED | MAP_POPULATE, tx->ring_fd, IORING_OFF_CQ_RING);
+    if (MAP_FAILED == tx->cq_ring)
+    {
+      tx->cq_ring = NULL;
+      fprintf(stderr, "ERROR: could not map io_uring (%s)\n", 
+       strerror(errno));
+      goto fail;
+    }
+  }
+
+  tx->sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe), 
+   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, tx->ring_fd, 
+   IORING_OFF_SQES);
+  if (MAP_FAILED == tx->sqes)
+  {
+    tx->sqes = NULL;
+    fprintf(stderr, "ERROR: could not map io_uring (%s)\n", strerror(errno));
+    goto fail;
+  }
+
+  sq_ptr = (uint8_t *)tx->sq_ring;
+  cq_ptr = (uint8_t *)tx->cq_ring;
+  tx->sq_head = (unsigned *)(sq_ptr + params.sq_off.head);
+  tx->sq_tail = (unsigned *)(sq_ptr + params.sq_off.tail);
+  tx->sq_mask = (unsigned *)(sq_ptr + params.sq_off.ring_mask);
+  tx->sq_array = (unsigned *)(sq_ptr + params.sq_off.array);
+  tx->cq_head = (unsigned *)(cq_ptr + params.cq_off.head);
+  tx->cq_tail = (unsigned *)(cq_ptr + params.cq_off.tail);
+  tx->cq_mask = (unsigned *)(cq_ptr + params.cq_off.ring_mask);
+  tx->cqes = (struct io_uring_cqe *)(cq_ptr + params.cq_off.cqes);
+
+  /* Allocate and register the frame pool, one slot per submission entry so 
+   * that completions can never overflow the completion ring */
+  tx->pool_sz = (size_t)tx->entries * URING_SLOT_SIZE;
+  tx->pool = mmap(NULL, tx->pool_sz, PROT_READ | PROT_WRITE, 
+   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (MAP_FAILED == tx->pool)
+  {
+    tx->pool = NULL;
+    fprintf(stderr, "ERROR: could not allocate frame pool (%s)\n", 
+     strerror(errno));
+    goto fail;
+  }
+
+  iov.iov_base = tx->pool;
+  iov.iov_len = tx->pool_sz;
+  if (0 != sys_io_uring_register(tx->ring_fd, IORING_REGISTER_BUFFERS, &iov, 
+   1))
+  {
+    fprintf(stderr, "ERROR: could not register frame pool (%s)\n", 
+     strerror(errno));
+    goto fail;
+  }
+
+  MALLOC(tx->free_slots, uint32_t, tx->entries * sizeof(uint32_t));
+  for (i = 0; i < tx->entries; i++)
+  {
+    tx->free_slots[i] = tx->entries - 1 - i;
+  }
+  tx->num_free = tx->entries;
+
+  /* Done */
+  return tx;
+
+fail:
+  uring_tx_close(tx);
+  return NULL;
+}
+
+
+uint8_t *uring_tx_frame(uring_tx_t *tx)
+{
+  /* Check parameters */
+  if (NULL == tx)
+  {
+    return NULL;
+  }
+
+  /* Reclaim buffers from completed frames before blocking */
+  if (0 == tx->num_free)
+  {
+    uring_tx_reap(tx);
+  }
+
+  /* Wait for the kernel to finish with at least one buffer */
+  while (0 == tx->num_free)
+  {
+    if (tx->queued)
+    {
+      if (-1 == uring_tx_submit(tx, 0))
+      {
+        return NULL;
+      }
+      continue;
+    }
+
+    /* Every buffer is held by the caller, nothing will ever complete */
+    if (0 == tx->in_flight)
+    {
+      fprintf(stderr, "ERROR: io_uring frame pool exhausted\n");
+      return NULL;
+    }
+
+    if (sys_io_uring_enter(tx->ring_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 
+     && EINTR != errno)
+    {
+      fprintf(stderr, "ERROR: io_uring_enter failed (%s)\n", strerror(errno));
+      return NULL;
+    }
+    uring_tx_reap(tx);
+  }
+
+  return tx->pool + (size_t)tx->free_slots[--tx->num_free] * URING_SLOT_SIZE;
+}
+
+
+int uring_tx_queue(uring_tx_t *tx, uint8_t *frame, uint16_t len)
+{
+  /* Check parameters */
+  if (NULL == tx || NULL == frame || frame < tx->pool 
+   || frame >= tx->pool + tx->pool_sz || len > URING_SLOT_SIZE)
+  {
+    fprintf(stderr, "ERROR: frame not from io_uring frame pool\n");
+    return -1;
+  }
+
+  /* Declare local variables */
+  unsigned tail = *tx->sq_tail;      /* Only we advance the submission tail */
+  unsigned idx = tail & *tx->sq_mask;            /* Submission entry index */
+  struct io_uring_sqe *sqe = &tx->sqes[idx];      /* Entry to be populated */
+
+  /* The pool holds exactly as many buffers as there are entries, so having a 
+   * buffer guarantees a free submission entry */
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  sqe->opcode = IORING_OP_WRITE_FIXED;
+  sqe->fd = tx->sock_fd;
+  sqe->addr = (uint64_t)(uintptr_t)frame;
+  sqe->len = len;
+  sqe->buf_index = 0;
+  sqe->user_data = (uint64_t)((size_t)(frame - tx->pool) / URING_SLOT_SIZE);
+  tx->sq_array[idx] = idx;
+
+  __atomic_store_n(tx->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  tx->queued++;
+  return 0;
+}
+
+
+void uring_tx_release(uring_tx_t *tx, uint8_t *frame)
+{
+  /* Check parameters */
+  if (NULL == tx || NULL == frame || frame < tx->pool 
+   || frame >= tx->pool + tx->pool_sz)
+  {
+    return;
+  }
+
+  tx->free_slots[tx->num_free++] = 
+   (uint32_t)((size_t)(frame - tx->pool) / URING_SLOT_SIZE);
+}
+
+
+int uring_tx_submit(uring_tx_t *tx, int wait)
+{
+  /* Check parameters */
+  if (NULL == tx)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  int ret = 0;                               /* Return from io_uring_enter */
+  unsigned submitted = tx->queued;          /* Frames handed to the kernel */
+  unsigned min_complete = 0;       /* Completions to wait for before return */
+
+  if (wait)
+  {
+    min_complete = tx->in_flight + tx->queued;
+  }
+
+  /* Nothing to do */
+  if (0 == submitted && 0 == min_complete)
+  {
+    uring_tx_reap(tx);
+    return 0;
+  }
+
+  do
+  {
+    ret = sys_io_uring_enter(tx->ring_fd, tx->queued, min_complete, 
+     min_complete ? IORING_ENTER_GETEVENTS : 0);
+  }
+  while (ret < 0 && EINTR == errno);
+
+  if (ret < 0)
+  {
+    fprintf(stderr, "ERROR: io_uring_enter failed (%s)\n", strerror(errno));
+    return -1;
+  }
+
+  tx->in_flight += (unsigned)ret;
+  tx->queued -= (unsigned)ret;
+  uring_tx_reap(tx);
+
+  /* Done */
+  return (int)submitted;
+}
+
+
+uint64_t uring_tx_errors(const uring_tx_t *tx)
+{
+  return (NULL == tx) ? 0 : tx->errors;
+}
+
+
+void uring_tx_close(uring_tx_t *tx)
+{
+  /* Check parameters */
+  if (NULL == tx)
+  {
+    return;
+  }
+
+  /* Let anything still in flight complete before unmapping its buffer */
+  if (tx->ring_fd >= 0 && tx->free_slots && (tx->queued || tx->in_flight))
+  {
+    uring_tx_submit(tx, 1);
+  }
+
+  if (tx->sqes)
+  {
+    munmap(tx->sqes, tx->entries * sizeof(struct io_uring_sqe));
+  }
+  if (tx->cq_ring && tx->cq_ring != tx->sq_ring)
+  {
+    munmap(tx->cq_ring, tx->cq_ring_sz);
+  }
+  if (tx->sq_ring)
+  {
+    munmap(tx->sq_ring, tx->sq_ring_sz);
+  }
+  if (tx->ring_fd >= 0)
+  {
+    close(tx->ring_fd);
+  }
+  if (tx->pool)
+  {
+    munmap(tx->pool, tx->pool_sz);
+  }
+  if (tx->sock_fd >= 0)
+  {
+    close(tx->sock_fd);
+  }
+  FREE(tx->free_slots);
+  FREE(tx);
+}
+
+#else /* HAVE_IO_URING */
+
+struct _uring_tx_t_ {
+  int unused; /* io_uring is not available on this platform */
+};
+
+
+uring_tx_t *uring_tx_open(const char *iface, unsigned int depth)
+{
+  (void)iface;
+  (void)depth;
+  fprintf(stderr, "ERROR: io_uring is not supported on this platform\n");
+  return NULL;
+}
+
+
+uint8_t *uring_tx_frame(uring_tx_t *tx)
+{
+  (void)tx;
+  return NULL;
+}
+
+
+int uring_tx_queue(uring_tx_t *tx, uint8_t *frame, uint16_t len)
+{
+  (void)tx;
+  (void)frame;
+  (void)len;
+  return -1;
+}
+
+
+void uring_tx_release(uring_tx_t *tx, uint8_t *frame)
+{
+  (void)tx;
+  (void)frame;
+}
+
+
+int uring_tx_submit(uring_tx_t *tx, int wait)
+{
+  (void)tx;
+  (void)wait;
+  return -1;
+}
+
+
+uint64_t uring_tx_errors(const uring_tx_t *tx)
+{
+  (void)tx;
+  return 0;
+}
+
+
+void uring_tx_close(uring_tx_t *tx)
+{
+  (void)tx;
+}
+
+#endif /* HAVE_IO_URING */
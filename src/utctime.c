@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2015, Nishchal Kush, All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided;
+ *   - Redistributions of source code must retain the copyright information,
+ *     this list of conditions, and the following disclaimer.
+ *   - Redistributions in binary form must reproduce the copyright information, 
+ *     this list of conditions, and the following disclaimer in the 
+ *     documentation and/or other materials provided with the distribution.
+ *   - Neither the name of the author (Nishchal Kush) nor the names of any
+ *     other contributors may be used to endorse or promote products derived 
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * $Id$
+ * $Revision$
+ * $Author$
+ */
+
+#include "utctime.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+
+
+
+/*
+ * Constants
+ */
+
+/**
+ * The fraction of second is floor(nsec * 2^24 / 10^9), i.e. 
+ * floor(nsec * 2^15 / 5^9). FRAC_MUL / 2^FRAC_SHIFT is 2^24 / 10^9 rounded 
+ * up, which keeps nsec * FRAC_MUL within 64 bits and is at most one too 
+ * large, corrected by comparing against 5^9.
+ */
+#define FRAC_MUL 9223372037ULL
+#define FRAC_SHIFT 39
+#define FIVE_POW_9 1953125ULL
+
+/**
+ * Dividing by 10^9 is a multiply of the value shifted right by 9 by 
+ * DIV_MUL, keeping the high 64 bits, shifted right by DIV_SHIFT
+ */
+#define DIV_MUL 0x44b82fa09b5a53ULL
+#define DIV_SHIFT 11
+
+
+
+
+/*
+ * Function definitions
+ */
+
+/**
+ * Function to return the high 64 bits of a 64 by 64 bit multiply, from 32 
+ * bit halves so that it needs no 128-bit type
+ */
+static uint64_t mul_hi64(uint64_t a, uint64_t b)
+{
+  /* Declare local variables */
+  uint64_t a_lo = (uint32_t)a;
+  uint64_t a_hi = a >> 32;
+  uint64_t b_lo = (uint32_t)b;
+  uint64_t b_hi = b >> 32;
+  uint64_t lo_lo = a_lo * b_lo;
+  uint64_t hi_lo = a_hi * b_lo;
+  uint64_t lo_hi = a_lo * b_hi;
+  uint64_t cross = (lo_lo >> 32) + (uint32_t)hi_lo + lo_hi;
+
+  return a_hi * b_hi + (hi_lo >> 32) + (cross >> 32);
+}
+
+
+/**
+ * Function to write a UtcTime from the seconds and nanoseconds
+ *
+ * @param sec	seconds since the epoch
+ * @param nsec	nanoseconds, less than 10^9
+ * @param quality	time quality octet
+ * @param addr	pointer to the UTC_TIME_LEN octets to write
+ */
+static void utc_time_put(uint64_t sec, uint64_t nsec, uint8_t quality, 
+ uint8_t *addr)
+{
+  /* Declare local variables */
+  uint64_t frac = (nsec * FRAC_MUL) >> FRAC_SHIFT;    /* Fraction of second */
+
+  frac -= (frac * FIVE_POW_9 > (nsec << 15));
+
+  addr[0] = (uint8_t)(sec >> 24);
+  addr[1] = (uint8_t)(sec >> 16);
+  addr[2] = (uint8_t)(sec >> 8);
+  addr[3] = (uint8_t)sec;
+  addr[4] = (uint8_t)(frac >> 16);
+  addr[5] = (uint8_t)(frac >> 8);
+  addr[6] = (uint8_t)frac;
+  addr[7] = quality;
+}
+
+
+void utc_time_encode(uint64_t ns, uint8_t quality, uint8_t *addr)
+{
+  /* Declare local variables */
+  uint64_t sec = mul_hi64(ns >> 9, DIV_MUL) >> DIV_SHIFT;    /* ns / 10^9 */
+
+  utc_time_put(sec, ns - sec * 1000000000ULL, quality, addr);
+}
+
+
+void utc_time_encode_ts(const struct timespec *ts, uint8_t quality, 
+ uint8_t *addr)
+{
+  utc_time_put((uint64_t)ts->tv_sec, (uint64_t)ts->tv_nsec, quality, addr);
+}
+
+
+void utc_time_now(uint8_t quality, uint8_t *addr)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  utc_time_put((uint64_t)ts.tv_sec, (uint64_t)ts.tv_nsec, quality, addr);
+}
+
+
+uint64_t utc_time_decode(const uint8_t *addr, uint8_t *quality)
+{
+  /* Declare local variables */
+  uint64_t sec = ((uint64_t)addr[0] << 24) | ((uint64_t)addr[1] << 16) 
+   | ((uint64_t)addr[2] << 8) | addr[3];            /* Seconds of century */
+  uint64_t frac = ((uint64_t)addr[4] << 16) | ((uint64_t)addr[5] << 8) 
+   | addr[6];                                       /* Fraction of second */
+
+  if (NULL != quality)
+  {
+    *quality = addr[7];
+  }
+
+  /* Round up, the smallest nsec whose fraction is frac */
+  return sec * 1000000000ULL + ((frac * 1000000000ULL + 0xffffff) >> 24);
+}
@@ -29,6 +29,7 @@
  * $Author$
  */
 #include "types.h"
+#include "utctime.h"
 #include "utils.h"
 
 #include <stdint.h>
@@ -47,11 +48,177 @@
  */
 static const long int BYTE_MASK[4] = { 0xff, 0xff00, 0xff0000, 0xff000000 };
 
+/** Number of allocations made through MALLOC */
+uint64_t MALLOC_COUNT = 0;
+
 
 /*
  * Function definitions
  */
 
+uint8_t ber_len_from_bytes(const uint8_t *addr, size_t avail, size_t *len)
+{
+  /* Check parameters */
+  if (NULL == addr || NULL == len || 0 == avail)
+  {
+    return 0;
+  }
+
+  /* Declare local variables */
+  uint8_t num_bytes = 0;                /* Number of subsequent length octets */
+  uint8_t i = 0;                                               /* Loop index */
+  size_t val = 0;                                          /* Decoded length */
+
+  /* Short form */
+  if (addr[0] < 0x80)
+  {
+    *len = addr[0];
+    return 1;
+  }
+
+  /* Long form, 0x80 is the indefinite form which GOOSE does not use */
+  num_bytes = addr[0] & 0x7f;
+  if (0 == num_bytes || num_bytes > 4 || (size_t)num_bytes + 1 > avail)
+  {
+    return 0;
+  }
+
+  for (i = 1; i <= num_bytes; i++)
+  {
+    val = (val << 8) | addr[i];
+  }
+
+  *len = val;
+  return num_bytes + 1;
+}
+
+
+uint8_t ber_int_size(const int64_t num)
+{
+  /* Declare local variables */
+  uint8_t num_bytes = 1;                         /* Number of value octets */
+
+  /* Drop leading octets while the next octet still carries the sign */
+  while (num_bytes < 8 && (num >> (8 * num_bytes - 1)) != 0 
+   && (num >> (8 * num_bytes - 1)) != -1)
+  {
+    num_bytes++;
+  }
+
+  return num_bytes;
+}
+
+
+uint8_t ber_int_to_bytes(const int64_t num, uint8_t *addr)
+{
+  /* Check parameters */
+  if (NULL == addr)
+  {
+    return 0;
+  }
+
+  /* Declare local variables */
+  uint8_t num_bytes = ber_int_size(num);         /* Number of value octets */
+  uint8_t i = 0;                                               /* Loop index */
+
+  for (i = 0; i < num_bytes; i++)
+  {
+    addr[i] = (uint8_t)((uint64_t)num >> (8 * (num_bytes - 1 - i)));
+  }
+
+  return num_bytes;
+}
+
+
+uint8_t ber_len_size(const size_t len)
+{
+  if (len < 0x80)
+  {
+    return 1;
+  }
+
+  return 1 + num_bytes_for_ui32((uint32_t)len);
+}
+
+
+uint8_t ber_len_to_bytes(const size_t len, uint8_t *addr)
+{
+  /* Check parameters */
+  if (NULL == addr)
+  {
+    return 0;
+  }
+
+  /* Short form */
+  if (len < 0x80)
+  {
+    addr[0] = (uint8_t)len;
+    return 1;
+  }
+
+  /* Long form, count of octets followed by the big-endian length */
+  addr[0] = (uint8_t)(0x80 | num_bytes_for_ui32((uint32_t)len));
+  return 1 + ui32_to_bytes((uint32_t)len, addr + 1);
+}
+
+
+int bytes_to_ui32(const uint8_t *addr, size_t len, uint32_t *num)
+{
+  /* Check parameters */
+  if (NULL == addr || NULL == num || 0 == len)
+  {
+    return -1;
+  }
+
+  /* Skip the sign octet of values with the most significant bit set */
+  if (len == 5 && 0x00 == addr[0])
+  {
+    addr++;
+    len--;
+  }
+  if (len > 4)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  uint32_t val = 0;                                        /* Decoded value */
+  size_t i = 0;                                               /* Loop index */
+
+  for (i = 0; i < len; i++)
+  {
+    val = (val << 8) | addr[i];
+  }
+
+  /* Done */
+  *num = val;
+  return 0;
+}
+
+
+int bytes_to_i32(const uint8_t *addr, size_t len, int32_t *num)
+{
+  /* Check parameters */
+  if (NULL == addr || NULL == num || 0 == len || len > 4)
+  {
+    return -1;
+  }
+
+  /* Declare local variables */
+  int32_t val = (int8_t)addr[0];              /* Decoded value, sign extended */
+  size_t i = 0;                                               /* Loop index */
+
+  for (i = 1; i < len; i++)
+  {
+    val = (int32_t)((uint32_t)val << 8) | addr[i];
+  }
+
+  /* Done */
+  *num = val;
+  return 0;
+}
+
+
 int compare_mac(const uint8_t *first, const uint8_t *second)
 {
   /* Check parameter */
@@ -110,6 +277,59 @@ void hex_dump(const void *data, const size_t len)
 }
 
 
+size_t hex_to_bytes(const char *hex, uint8_t *addr, size_t max_len)
+{
+  /* Check parameters */
+  if (NULL == hex || NULL == addr)
+  {
+    return 0;
+  }
+
+  /* Declare local variables */
+  size_t len = strlen(hex);                  /* Number of hexadecimal digits */
+  size_t i = 0;                                                /* Loop index */
+  int nibble = 0;                           /* Value of a hexadecimal digit */
+  char c = 0;                              /* Current hexadecimal character */
+
+  if (0 == len || (len % 2) || len / 2 > max_len)
+  {
+    return 0;
+  }
+
+  for (i = 0; i < len; i++)
+  {
+    c = hex[i];
+    if (c >= '0' && c <= '9')
+    {
+      nibble = c - '0';
+    }
+    else if (c >= 'a' && c <= 'f')
+    {
+      nibble = c - 'a' + 10;
+    }
+    else if (c >= 'A' && c <= 'F')
+    {
+      nibble = c - 'A' + 10;
+    }
+    else
+    {
+      return 0;
+    }
+
+    if (0 == (i % 2))
+    {
+      addr[i / 2] = (uint8_t)(nibble << 4);
+    }
+    else
+    {
+      addr[i / 2] |= (uint8_t)nibble;
+    }
+  }
+
+  return len / 2;
+}
+
+
 #if 0
 #define IS_BIG_ENDIAN() \
 do \
@@ -223,15 +443,11 @@ void time_to_bytes(const long int tv, uint8_t *addr)
     return;
   }
 
-  /* Declare local variables */
-  size_t i; /* Loop index */
-
-  /* Convert to bytes and append to address */
-  /* TODO: Check if uint32_to_bytes can be used here? */
-  for(i = 0; i < 4; i++ ) 
-  {
-    addr[i] = (tv & BYTE_MASK[i]) >> (8*i);
-  }
+  /* Network byte order, as every field of the frame */
+  addr[0] = (uint8_t)((unsigned long)tv >> 24);
+  addr[1] = (uint8_t)((unsigned long)tv >> 16);
+  addr[2] = (uint8_t)((unsigned long)tv >> 8);
+  addr[3] = (uint8_t)tv;
   return;
 }
 
@@ -244,12 +460,15 @@ void timevalq_to_bytes(const timevalq_t *t, uint8_t *addr)
     return;
   }
 
+  /* Declare local variables */
+  struct timespec ts;                          /* Time with ns resolution */
+
   /* The UTCTime is encoded into 64-bit (8-bytes). The first 32-bits are the
-   * seconds-of-century (SOC) and the last 32-bits are meant to include the
-   * 24-bit fractions-of-second (FRACSEC) and 8-bit time quality. */
-  time_to_bytes(t->timeval.tv_sec, addr );                            /* SOC */
-  time_to_bytes(reverse_ui32(t->timeval.tv_usec/1000), addr+4);   /* FRACSEC */
-  addr[7] = t->time_quality;/* Overwrite the last octet with the quality flag */
+   * seconds-of-century (SOC) and the last 32-bits are the 24-bit binary 
+   * fraction of second (FRACSEC) and 8-bit time quality. */
+  ts.tv_sec = t->timeval.tv_sec;
+  ts.tv_nsec = (long)t->timeval.tv_usec * 1000;
+  utc_time_encode_ts(&ts, t->time_quality, addr);
   return;
 }
 